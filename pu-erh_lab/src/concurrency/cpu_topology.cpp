@@ -0,0 +1,251 @@
+/*
+ * @file        pu-erh_lab/src/concurrency/cpu_topology.cpp
+ * @brief       CPU cache domains and NUMA nodes read from sysfs
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "concurrency/cpu_topology.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace puerhlab {
+namespace {
+/**
+ * @brief First line of a sysfs attribute, empty if it cannot be read
+ */
+auto ReadLine(const std::filesystem::path& path) -> std::string {
+  std::ifstream file(path);
+  std::string   line;
+  std::getline(file, line);
+  return line;
+}
+
+/**
+ * @brief CPUs sharing the last-level cache with cpu, as written in sysfs. Empty if the kernel does
+ * not report an L3 cache.
+ */
+auto SharedL3(const std::filesystem::path& cpu_dir) -> std::string {
+  std::error_code ec;
+  for (const auto& entry : std::filesystem::directory_iterator(cpu_dir / "cache", ec)) {
+    if (entry.path().filename().string().starts_with("index") &&
+        ReadLine(entry.path() / "level") == "3") {
+      return ReadLine(entry.path() / "shared_cpu_list");
+    }
+  }
+  return {};
+}
+};  // namespace
+
+/**
+ * @brief Parse a kernel CPU list such as "0-3,8,10-11"
+ *
+ * @param list
+ * @return std::vector<uint32_t> the CPUs in ascending order, empty if the list is malformed
+ */
+auto ParseCpuList(std::string_view list) -> std::vector<uint32_t> {
+  std::vector<uint32_t> cpus;
+  while (!list.empty()) {
+    auto comma = list.find(',');
+    auto range = list.substr(0, comma);
+    list       = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1);
+    while (!range.empty() && (range.back() == '\n' || range.back() == ' ')) {
+      range.remove_suffix(1);
+    }
+    if (range.empty()) {
+      continue;
+    }
+
+    uint32_t first = 0;
+    auto     dash  = range.find('-');
+    auto     end   = range.data() + (dash == std::string_view::npos ? range.size() : dash);
+    if (std::from_chars(range.data(), end, first).ptr != end) {
+      return {};
+    }
+    uint32_t last = first;
+    if (dash != std::string_view::npos) {
+      auto tail = range.substr(dash + 1);
+      if (std::from_chars(tail.data(), tail.data() + tail.size(), last).ptr !=
+              tail.data() + tail.size() ||
+          last < first) {
+        return {};
+      }
+    }
+    for (uint32_t cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  std::sort(cpus.begin(), cpus.end());
+  cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+  return cpus;
+}
+
+/**
+ * @brief Read the topology from sysfs. CPUs sharing an L3 cache form a domain, on machines which
+ * do not report one the domains are the NUMA nodes.
+ *
+ * @param sysfs_root normally /sys/devices/system, tests point it at a fake tree
+ * @return CpuTopology a single domain if the online CPUs cannot be read
+ */
+auto CpuTopology::Discover(const std::filesystem::path& sysfs_root) -> CpuTopology {
+  auto online = ParseCpuList(ReadLine(sysfs_root / "cpu" / "online"));
+  if (online.empty()) {
+    return Uniform(std::thread::hardware_concurrency());
+  }
+
+  std::map<uint32_t, uint32_t> node_of;
+  std::error_code              ec;
+  for (const auto& entry : std::filesystem::directory_iterator(sysfs_root / "node", ec)) {
+    auto name = entry.path().filename().string();
+    if (!name.starts_with("node")) {
+      continue;
+    }
+    uint32_t node = 0;
+    if (std::from_chars(name.data() + 4, name.data() + name.size(), node).ptr !=
+        name.data() + name.size()) {
+      continue;
+    }
+    auto cpus = ParseCpuList(ReadLine(entry.path() / "cpulist"));
+    if (cpus.empty()) {
+      // Memory-only nodes have no CPU to place workers on
+      continue;
+    }
+    for (auto cpu : cpus) {
+      node_of[cpu] = node;
+    }
+  }
+
+  // Keyed by node then shared cache, so that domains come out grouped by node
+  std::map<std::pair<uint32_t, std::string>, CpuDomain> domains;
+  for (auto cpu : online) {
+    auto  found  = node_of.find(cpu);
+    auto  node   = found == node_of.end() ? 0u : found->second;
+    auto  l3     = SharedL3(sysfs_root / "cpu" / ("cpu" + std::to_string(cpu)));
+    auto& domain = domains[{node, l3}];
+    domain._node = node;
+    domain._cpus.push_back(cpu);
+  }
+
+  std::vector<CpuDomain> ordered;
+  for (auto& [key, domain] : domains) {
+    ordered.push_back(std::move(domain));
+  }
+  return FromDomains(std::move(ordered));
+}
+
+/**
+ * @brief A topology made of the given domains, e.g. to test placement on a machine it does not
+ * run on
+ *
+ * @param domains
+ * @return CpuTopology
+ */
+auto CpuTopology::FromDomains(std::vector<CpuDomain> domains) -> CpuTopology {
+  std::set<uint32_t> nodes;
+  for (const auto& domain : domains) {
+    nodes.insert(domain._node);
+  }
+  CpuTopology topology;
+  topology._domains    = std::move(domains);
+  topology._node_count = std::max<size_t>(nodes.size(), 1);
+  return topology;
+}
+
+/**
+ * @brief A topology without placement, every CPU in one domain
+ *
+ * @param cpu_count
+ * @return CpuTopology
+ */
+auto CpuTopology::Uniform(size_t cpu_count) -> CpuTopology {
+  CpuTopology topology;
+  auto&       domain = topology._domains.emplace_back();
+  for (size_t cpu = 0; cpu < std::max<size_t>(cpu_count, 1); ++cpu) {
+    domain._cpus.push_back(static_cast<uint32_t>(cpu));
+  }
+  return topology;
+}
+
+auto CpuTopology::Domains() const -> const std::vector<CpuDomain>& { return _domains; }
+
+auto CpuTopology::NodeCount() const -> size_t { return _node_count; }
+
+auto CpuTopology::CpuCount() const -> size_t {
+  size_t count = 0;
+  for (const auto& domain : _domains) {
+    count += domain._cpus.size();
+  }
+  return count;
+}
+
+/**
+ * @brief Whether memory is local to some CPUs only. Workers are only placed on such machines,
+ * elsewhere placement costs more than it saves.
+ *
+ * @return true more than one NUMA node has CPUs
+ */
+auto CpuTopology::IsNuma() const -> bool { return _node_count > 1 && _domains.size() > 1; }
+
+/**
+ * @brief Restrict the calling thread to a set of CPUs
+ *
+ * @param cpus
+ * @return true the thread was pinned
+ * @return false not supported on this platform, or refused by the system
+ */
+auto PinCurrentThread(const std::vector<uint32_t>& cpus) -> bool {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (auto cpu : cpus) {
+    if (cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &set);
+    }
+  }
+  return !cpus.empty() && pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  return false;
+#endif
+}
+};  // namespace puerhlab
@@ -0,0 +1,82 @@
+/*
+ * @file        pu-erh_lab/src/concurrency/executor.cpp
+ * @brief       Process-wide CPU and I/O thread pools
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "concurrency/executor.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+
+namespace puerhlab {
+/**
+ * @brief Construct a new Executor object, most callers use the shared Instance() instead
+ *
+ * @param cpu_threads number of threads running decoding and rendering
+ * @param io_threads number of threads doing blocking file reads
+ * @param topology the CPU workers are placed on its cache domains when it spans several NUMA
+ * nodes, the I/O workers are never placed
+ */
+Executor::Executor(size_t cpu_threads, size_t io_threads, const CpuTopology& topology)
+    : _cpu(cpu_threads, topology), _io(io_threads) {}
+
+/**
+ * @brief Return the executor shared by the whole process, created on first use. The topology is
+ * discovered once, on single-node machines the workers are left to the system scheduler.
+ *
+ * @return Executor&
+ */
+auto Executor::Instance() -> Executor& {
+  static Executor executor{DefaultCpuThreads(), DefaultIoThreads(), CpuTopology::Discover()};
+  return executor;
+}
+
+/**
+ * @brief One thread per hardware thread, more would only add context switches
+ *
+ * @return size_t
+ */
+auto Executor::DefaultCpuThreads() -> size_t {
+  return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+/**
+ * @brief I/O threads spend most of their time blocked, there may be more of them than cores but
+ * a disk gains little from many more parallel reads
+ *
+ * @return size_t
+ */
+auto Executor::DefaultIoThreads() -> size_t {
+  return std::clamp<size_t>(std::thread::hardware_concurrency(), 4, 16);
+}
+
+auto Executor::Cpu() -> ThreadPool& { return _cpu; }
+
+auto Executor::Io() -> ThreadPool& { return _io; }
+};  // namespace puerhlab
@@ -31,49 +31,345 @@
 #include "concurrency/thread_pool.hpp"
 
 #include <algorithm>
-#include <future>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <thread>
+#include <utility>
 #include <vector>
 
 namespace puerhlab {
-ThreadPool::ThreadPool(size_t thread_count) : stop(false) {
+namespace {
+// The pool and the queue of the worker running on this thread, if any
+thread_local const ThreadPool* tl_pool  = nullptr;
+thread_local size_t            tl_index = 0;
+};  // namespace
+
+/**
+ * @brief Construct a new ThreadPool object
+ *
+ * @param thread_count
+ * @param topology on a NUMA topology the workers are spread over its domains in proportion to
+ * their CPUs and pinned to them, any other topology leaves the workers unplaced
+ */
+ThreadPool::ThreadPool(size_t thread_count, const CpuTopology& topology) {
+  thread_count = std::max<size_t>(thread_count, 1);
+  _placed      = topology.IsNuma();
+  if (_placed) {
+    for (const auto& domain : topology.Domains()) {
+      _domains.push_back(std::make_unique<Domain>());
+      _domains.back()->_cpus = domain._cpus;
+    }
+  } else {
+    _domains.push_back(std::make_unique<Domain>());
+  }
+
+  // One slot per CPU, taken at even intervals when there are fewer workers than CPUs
+  std::vector<size_t> slots;
+  for (size_t domain = 0; domain < _domains.size(); ++domain) {
+    slots.insert(slots.end(), std::max<size_t>(_domains[domain]->_cpus.size(), 1), domain);
+  }
+  for (size_t i = 0; i < thread_count; ++i) {
+    auto domain    = slots[i * slots.size() / thread_count];
+    auto queue     = std::make_unique<WorkerQueue>();
+    queue->_domain = domain;
+    _domains[domain]->_workers.push_back(i);
+    _queues.push_back(std::move(queue));
+  }
   for (size_t i = 0; i < thread_count; ++i) {
-    workers.emplace_back(&ThreadPool::WorkerThread, this);
+    _workers.emplace_back(&ThreadPool::WorkerThread, this, i);
   }
 }
 
+/**
+ * @brief Run the tasks still queued, then join the workers
+ *
+ */
 ThreadPool::~ThreadPool() {
   {
-    std::unique_lock<std::mutex> lock(mtx);
-    stop = true;
+    std::lock_guard<std::mutex> lock(_sleep_mtx);
+    _stop = true;
   }
-  condition.notify_all();
-  for (std::thread& worker : workers) {
+  _wake.notify_all();
+  for (std::thread& worker : _workers) {
     worker.join();
   }
 }
 
-void ThreadPool::Submit(std::function<void()> task) {
+auto ThreadPool::ThreadCount() const -> size_t { return _workers.size(); }
+
+/**
+ * @brief Number of domains the workers are placed in, 1 when they are not placed
+ *
+ * @return size_t
+ */
+auto ThreadPool::DomainCount() const -> size_t { return _domains.size(); }
+
+/**
+ * @brief Domain of the calling worker
+ *
+ * @return size_t 0 when called from outside the pool
+ */
+auto ThreadPool::CurrentDomain() const -> size_t {
+  return tl_pool == this ? _queues[tl_index]->_domain : 0;
+}
+
+/**
+ * @brief Queue tasks with a single synchronization: they all go to the same queue and sleeping
+ * workers are woken once, idle workers then steal from that queue
+ *
+ * @param tasks moved from, the vector keeps its capacity
+ * @param priority
+ */
+void ThreadPool::SubmitBatch(std::vector<Task>&& tasks, TaskPriority priority) {
+  if (!tasks.empty()) {
+    Enqueue(tasks.data(), tasks.size(), priority);
+  }
+  tasks.clear();
+}
+
+/**
+ * @brief Move tasks to the deque of the calling worker, or to the inbox of the next worker in turn
+ * when called from outside the pool, then wake sleeping workers if there are any
+ *
+ * @param tasks
+ * @param count
+ * @param priority
+ */
+void ThreadPool::Enqueue(Task* tasks, size_t count, TaskPriority priority) {
+  bool   local = tl_pool == this;
+  size_t index =
+      local ? tl_index : _next_queue.fetch_add(1, std::memory_order_relaxed) % _queues.size();
+  auto&  queue = *_queues[index];
+  auto   lane  = static_cast<size_t>(priority);
   {
-    std::lock_guard<std::mutex> lock(mtx);
-    tasks.push(task);
+    std::lock_guard<std::mutex> lock(queue._mtx);
+    // Counted before it can be taken, so that the counters never go below zero
+    _queued.fetch_add(count);
+    queue._size.fetch_add(count);
+    auto& deque = local ? queue._local[lane] : queue._inbox[lane];
+    for (size_t i = 0; i < count; ++i) {
+      deque.push_back(std::move(tasks[i]));
+    }
   }
-  condition.notify_one();
+  Wake(count, true);
 }
 
-void ThreadPool::WorkerThread() {
-  while (true) {
-    std::function<void()> task;
-    {
-      std::unique_lock<std::mutex> lock(mtx);
-      condition.wait(lock, [this] { return stop || !tasks.empty(); });
-      if (stop && tasks.empty()) return;
-      task = std::move(tasks.front());
-      tasks.pop();
+/**
+ * @brief Move tasks to the affine deque of the next worker of a domain in turn, falls back to
+ * Enqueue() when the workers are not placed or the domain has none
+ *
+ * @param domain
+ * @param tasks
+ * @param count
+ * @param priority
+ */
+void ThreadPool::EnqueueToDomain(size_t domain, Task* tasks, size_t count, TaskPriority priority) {
+  auto& target = *_domains[domain % _domains.size()];
+  if (!_placed || target._workers.empty()) {
+    Enqueue(tasks, count, priority);
+    return;
+  }
+  auto  worker = target._next_worker.fetch_add(1, std::memory_order_relaxed);
+  auto& queue  = *_queues[target._workers[worker % target._workers.size()]];
+  auto  lane   = static_cast<size_t>(priority);
+  {
+    std::lock_guard<std::mutex> lock(queue._mtx);
+    target._queued.fetch_add(count);
+    queue._size.fetch_add(count);
+    for (size_t i = 0; i < count; ++i) {
+      queue._affine[lane].push_back(std::move(tasks[i]));
     }
-    task();
   }
+  Wake(count, false);
 }
 
+/**
+ * @brief Wake sleeping workers for new tasks. Tasks of one domain wake every sleeper, a single
+ * one woken could belong to another domain and go back to sleep.
+ *
+ * @param count
+ * @param any_worker whether any worker may take the tasks
+ */
+void ThreadPool::Wake(size_t count, bool any_worker) {
+  // A worker going to sleep registers itself before checking the task counters, so either it
+  // sees these tasks or this sees it sleeping
+  if (_sleeping.load() > 0) {
+    { std::lock_guard<std::mutex> lock(_sleep_mtx); }
+    if (count > 1 || !any_worker) {
+      _wake.notify_all();
+    } else {
+      _wake.notify_one();
+    }
+  }
+}
+
+/**
+ * @brief Whether there are tasks a worker may take
+ *
+ * @param index the worker's queue
+ */
+auto ThreadPool::HasWork(size_t index) const -> bool {
+  return _queued.load() > 0 || _domains[_queues[index]->_domain]->_queued.load() > 0;
+}
+
+/**
+ * @brief Run fn(0) to fn(count - 1) and return once they have all returned. The calling thread
+ * runs its share, so a worker may call it without a deadlock. Called from a placed worker, the
+ * helpers stay in its domain and memory first written by fn ends up local to that domain.
+ *
+ * @param count
+ * @param fn called concurrently with distinct indices. The first exception it throws is rethrown
+ * once every call has returned.
+ * @param priority of the helper tasks, HIGH by default since the caller is waiting for them
+ */
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& fn,
+                             TaskPriority priority) {
+  // Shared with the helpers, a helper may only start after the caller has returned
+  struct State {
+    const std::function<void(size_t)>* _fn;
+    size_t                              _count;
+    std::atomic<size_t>                 _next = 0;
+    std::atomic<size_t>                 _done = 0;
+    std::mutex                          _error_mtx;
+    std::exception_ptr                  _error;
+
+    void                                Run() {
+      for (size_t i = _next.fetch_add(1); i < _count; i = _next.fetch_add(1)) {
+        try {
+          (*_fn)(i);
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(_error_mtx);
+          if (!_error) {
+            _error = std::current_exception();
+          }
+        }
+        if (_done.fetch_add(1) + 1 == _count) {
+          _done.notify_all();
+        }
+      }
+    }
+  };
+  if (count == 0) {
+    return;
+  }
+  auto state    = std::make_shared<State>();
+  state->_fn    = &fn;
+  state->_count = count;
+
+  bool   worker  = tl_pool == this;
+  size_t domain  = CurrentDomain();
+  size_t workers = worker && _placed ? _domains[domain]->_workers.size() : _queues.size();
+  // A calling worker is one of them
+  size_t helpers = std::min(count - 1, worker ? workers - 1 : workers);
+  if (helpers > 0) {
+    std::vector<Task> tasks;
+    tasks.reserve(helpers);
+    for (size_t i = 0; i < helpers; ++i) {
+      tasks.emplace_back([state] { state->Run(); });
+    }
+    if (worker) {
+      EnqueueToDomain(domain, tasks.data(), helpers, priority);
+    } else {
+      Enqueue(tasks.data(), helpers, priority);
+    }
+  }
+
+  state->Run();
+  for (size_t done = state->_done.load(); done < count; done = state->_done.load()) {
+    state->_done.wait(done);
+  }
+  if (state->_error) {
+    std::rethrow_exception(state->_error);
+  }
+}
+
+/**
+ * @brief Take the next task for a worker: lane by lane, the newest task it submitted itself, then
+ * the oldest task of its inbox, then the oldest tasks of the other workers of its domain, then
+ * those of the other domains. Tasks posted to a domain are left to its workers.
+ *
+ * @param index the worker's queue
+ * @param task receives the task
+ * @return true a task was taken
+ * @return false every queue looked empty
+ */
+auto ThreadPool::TryPop(size_t index, Task& task) -> bool {
+  size_t count  = _queues.size();
+  size_t domain = _queues[index]->_domain;
+  for (size_t lane = 0; lane < kTaskPriorityCount; ++lane) {
+    // The first pass visits the workers sharing a cache with this one, the second the others
+    for (size_t pass = 0; pass < (_placed ? 2 : 1); ++pass) {
+      for (size_t i = 0; i < count; ++i) {
+        auto& queue = *_queues[(index + i) % count];
+        bool  near  = queue._domain == domain;
+        if (near != (pass == 0) || queue._size.load(std::memory_order_relaxed) == 0) {
+          continue;
+        }
+        std::lock_guard<std::mutex> lock(queue._mtx);
+        auto&                       local  = queue._local[lane];
+        auto&                       inbox  = queue._inbox[lane];
+        auto&                       affine = queue._affine[lane];
+        if (!local.empty() && i == 0) {
+          task = std::move(local.back());
+          local.pop_back();
+        } else if (!local.empty()) {
+          task = std::move(local.front());
+          local.pop_front();
+        } else if (near && !affine.empty()) {
+          task = std::move(affine.front());
+          affine.pop_front();
+          queue._size.fetch_sub(1);
+          _domains[domain]->_queued.fetch_sub(1);
+          return true;
+        } else if (!inbox.empty()) {
+          task = std::move(inbox.front());
+          inbox.pop_front();
+        } else {
+          continue;
+        }
+        queue._size.fetch_sub(1);
+        _queued.fetch_sub(1);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void ThreadPool::WorkerThread(size_t index) {
+  tl_pool  = this;
+  tl_index = index;
+  if (_placed) {
+    // Best effort, an unpinned worker only loses locality
+    PinCurrentThread(_domains[_queues[index]->_domain]->_cpus);
+  }
+  Task   task;
+  size_t idle_rounds = 0;
+  while (true) {
+    if (TryPop(index, task)) {
+      task();
+      task        = nullptr;
+      idle_rounds = 0;
+      continue;
+    }
+    // A burst of small tasks usually follows, yielding a few times is cheaper than a sleep and a
+    // wake-up for each of them
+    if (idle_rounds++ < _spin_rounds) {
+      std::this_thread::yield();
+      continue;
+    }
+    idle_rounds = 0;
+    std::unique_lock<std::mutex> lock(_sleep_mtx);
+    _sleeping.fetch_add(1);
+    _wake.wait(lock, [this, index] { return _stop || HasWork(index); });
+    _sleeping.fetch_sub(1);
+    if (_stop && !HasWork(index)) {
+      return;
+    }
+  }
+}
 };  // namespace puerhlab
\ No newline at end of file
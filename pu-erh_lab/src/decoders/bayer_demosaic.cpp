@@ -0,0 +1,189 @@
+/*
+ * @file        pu-erh_lab/src/decoders/bayer_demosaic.cpp
+ * @brief       Parallel demosaic of Bayer raw data into linear RGB
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "decoders/bayer_demosaic.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <opencv2/core.hpp>
+#include <stdexcept>
+#include <vector>
+
+#include "concurrency/executor.hpp"
+
+namespace puerhlab {
+namespace {
+// Rows and columns of context needed on each side by the 5x5 filters
+constexpr int kPad = 2;
+
+/**
+ * @brief Mirror an index into [0, size) without repeating the edge, which keeps its parity and
+ * therefore its color in the pattern
+ */
+auto Reflect(int index, int size) -> int {
+  if (index < 0) {
+    index = -index;
+  } else if (index >= size) {
+    index = 2 * size - 2 - index;
+  }
+  return std::clamp(index, 0, size - 1);
+}
+
+auto ToRGB(uint8_t color) -> int { return color == 3 ? 1 : color; }
+
+/**
+ * @brief Black-subtracted, white-balanced samples of a band with kPad rows and columns of
+ * context on each side
+ */
+struct Tile {
+  std::vector<float> _data;
+  int                _stride;
+
+  auto At(int row, int col) const -> float { return _data[row * _stride + col]; }
+};
+
+void FillTile(const cv::Mat& cfa, int first_row, int last_row, const float (&black)[2][2],
+              const float (&scale)[2][2], Tile& tile) {
+  int rows     = last_row - first_row + 2 * kPad;
+  tile._stride = cfa.cols + 2 * kPad;
+  tile._data.resize(static_cast<size_t>(rows) * tile._stride);
+  for (int row = 0; row < rows; ++row) {
+    int         src_row = Reflect(first_row + row - kPad, cfa.rows);
+    const auto* src     = cfa.ptr<uint16_t>(src_row);
+    float*      dst     = tile._data.data() + static_cast<size_t>(row) * tile._stride;
+    for (int col = 0; col < tile._stride; ++col) {
+      int   src_col = Reflect(col - kPad, cfa.cols);
+      int   site_y  = src_row & 1;
+      int   site_x  = src_col & 1;
+      float value   = (static_cast<float>(src[src_col]) - black[site_y][site_x]) *
+                    scale[site_y][site_x];
+      dst[col] = std::clamp(value, 0.0f, 1.0f);
+    }
+  }
+}
+
+/**
+ * @brief Interpolate the missing colors of the pixel at (row, col) of the tile
+ *
+ * @param tile
+ * @param row
+ * @param col
+ * @param color color of the pixel, 0 red, 1 green, 2 blue
+ * @param row_color color of the horizontal neighbours of a green pixel
+ * @param rgb
+ */
+void Interpolate(const Tile& tile, int row, int col, int color, int row_color, float (&rgb)[3]) {
+  auto  p      = [&](int dy, int dx) { return tile.At(row + dy, col + dx); };
+  float center = p(0, 0);
+  float cross1 = p(-1, 0) + p(1, 0) + p(0, -1) + p(0, 1);
+  float cross2 = p(-2, 0) + p(2, 0) + p(0, -2) + p(0, 2);
+  float diag   = p(-1, -1) + p(-1, 1) + p(1, -1) + p(1, 1);
+  rgb[color]   = center;
+  if (color == 1) {
+    float horizontal2 = p(0, -2) + p(0, 2);
+    float vertical2   = p(-2, 0) + p(2, 0);
+    float along_row =
+        5.0f * center + 4.0f * (p(0, -1) + p(0, 1)) - horizontal2 - diag + 0.5f * vertical2;
+    float along_col =
+        5.0f * center + 4.0f * (p(-1, 0) + p(1, 0)) - vertical2 - diag + 0.5f * horizontal2;
+    rgb[row_color]     = along_row * 0.125f;
+    rgb[2 - row_color] = along_col * 0.125f;
+  } else {
+    rgb[1]         = (4.0f * center + 2.0f * cross1 - cross2) * 0.125f;
+    rgb[2 - color] = (6.0f * center + 2.0f * diag - 1.5f * cross2) * 0.125f;
+  }
+}
+};  // namespace
+
+/**
+ * @brief Develop a Bayer mosaic into linear output RGB
+ *
+ * @param cfa CV_16UC1 mosaic of the visible area, the pattern starts at its top-left corner
+ * @param params
+ * @return cv::Mat CV_32FC3 clipped to [0, 1] like LibRaw's 16-bit output
+ */
+auto BayerDemosaic::Develop(const cv::Mat& cfa, const BayerDevelopParams& params) -> cv::Mat {
+  if (cfa.type() != CV_16UC1 || cfa.rows < 2 || cfa.cols < 2) {
+    throw std::runtime_error("BayerDemosaic: Unsupported mosaic");
+  }
+  // The smallest multiplier maps the white level to 1, the other channels clip like LibRaw
+  float wb_min = std::min({params._wb[0], params._wb[1], params._wb[2], params._wb[3]});
+  if (wb_min <= 0.0f) {
+    throw std::runtime_error("BayerDemosaic: Invalid white balance");
+  }
+  float scale[2][2];
+  for (int y = 0; y < 2; ++y) {
+    for (int x = 0; x < 2; ++x) {
+      float range = params._white - params._black[y][x];
+      if (range <= 0.0f) {
+        throw std::runtime_error("BayerDemosaic: Invalid black or white level");
+      }
+      scale[y][x] = params._wb[params._pattern[y][x]] / wb_min / range;
+    }
+  }
+
+  constexpr int    band_rows = _rows_per_band;
+  // Left unwritten here, each band is first written by the worker developing it. The workers stay
+  // in the domain of the calling one, so on NUMA machines the image ends up in local memory.
+  cv::Mat          rgb_out(cfa.rows, cfa.cols, CV_32FC3);
+  int              bands     = (cfa.rows + band_rows - 1) / band_rows;
+  std::atomic<int> next_band = 0;
+  auto&            pool      = Executor::Instance().Cpu();
+  pool.ParallelFor(std::min<size_t>(bands, pool.ThreadCount()), [&](size_t) {
+    // One tile per task, reused for the bands it claims
+    Tile tile;
+    for (int band = next_band++; band < bands; band = next_band++) {
+      int first_row = band * band_rows;
+      int last_row  = std::min(first_row + band_rows, cfa.rows);
+      FillTile(cfa, first_row, last_row, params._black, scale, tile);
+      for (int row = first_row; row < last_row; ++row) {
+        auto* dst = rgb_out.ptr<cv::Vec3f>(row);
+        for (int col = 0; col < cfa.cols; ++col) {
+          int   color     = ToRGB(params._pattern[row & 1][col & 1]);
+          int   row_color = ToRGB(params._pattern[row & 1][(col + 1) & 1]);
+          float cam[3];
+          Interpolate(tile, row - first_row + kPad, col + kPad, color, row_color, cam);
+          for (float& value : cam) {
+            value = std::clamp(value, 0.0f, 1.0f);
+          }
+          for (int c = 0; c < 3; ++c) {
+            float value = params._cam_to_out[c][0] * cam[0] + params._cam_to_out[c][1] * cam[1] +
+                          params._cam_to_out[c][2] * cam[2];
+            dst[col][c] = std::clamp(value, 0.0f, 1.0f);
+          }
+        }
+      }
+    }
+  });
+  return rgb_out;
+}
+};  // namespace puerhlab
@@ -0,0 +1,122 @@
+/*
+ * @file        pu-erh_lab/src/decoders/decoder_registry.cpp
+ * @brief       Decoders selected by sniffed format and capabilities
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "decoders/decoder_registry.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <utility>
+
+#include "decoders/import_decoder.hpp"
+#include "decoders/metadata_decoder.hpp"
+#include "decoders/raw_decoder.hpp"
+#include "decoders/regular_decoder.hpp"
+#include "decoders/thumbnail_decoder.hpp"
+
+namespace puerhlab {
+auto DecoderEntry::Supports(ImageType format) const -> bool {
+  return _formats.empty() || std::find(_formats.begin(), _formats.end(), format) != _formats.end();
+}
+
+auto DecoderEntry::Provides(uint32_t required) const -> bool {
+  return (_capabilities & required) == required;
+}
+
+/**
+ * @brief Add a decoder, among decoders of equal cost the first registered one wins
+ *
+ * @param entry
+ */
+void DecoderRegistry::Register(DecoderEntry entry) {
+  std::unique_lock<std::shared_mutex> lock(_mtx);
+  _entries.push_back(std::move(entry));
+}
+
+/**
+ * @brief Register the decoders shipped with the application
+ *
+ */
+void DecoderRegistry::RegisterBuiltins() {
+  constexpr ImageType regular[] = {ImageType::DEFAULT, ImageType::JPEG, ImageType::PNG,
+                                   ImageType::TIFF};
+  constexpr ImageType raw[]     = {ImageType::ARW, ImageType::CR2, ImageType::CR3,
+                                   ImageType::NEF, ImageType::DNG, ImageType::ORF,
+                                   ImageType::RAF, ImageType::RW2, ImageType::PEF,
+                                   ImageType::OTHER_RAW};
+
+  Register({"Metadata", {}, METADATA_ONLY, 1,
+            [](const DecoderContext&) { return std::make_shared<MetadataDecoder>(); }});
+  Register({"Import", {}, METADATA_ONLY | EMBEDDED_PREVIEW | SCALED_DECODE, 4,
+            [](const DecoderContext& context) {
+              return std::make_shared<ImportDecoder>(
+                  context._thumbnail_store, context._content_hash, context._import_profiler);
+            }});
+  Register({"Thumbnail", {}, EMBEDDED_PREVIEW | SCALED_DECODE, 2,
+            [](const DecoderContext& context) -> std::shared_ptr<ImageDecoder> {
+              if (context._fingerprint.has_value()) {
+                return std::make_shared<ThumbnailDecoder>(context._thumbnail_store,
+                                                          *context._fingerprint);
+              }
+              return std::make_shared<ThumbnailDecoder>();
+            }});
+  Register({"Regular", {std::begin(regular), std::end(regular)}, FULL_DECODE, 8,
+            [](const DecoderContext&) { return std::make_shared<RegularDecoder>(); }});
+  Register({"Raw", {std::begin(raw), std::end(raw)}, FULL_DECODE, 16,
+            [](const DecoderContext& context) {
+              return std::make_shared<RawDecoder>(context._interactive ? RawQuality::PREVIEW
+                                                                       : RawQuality::FULL);
+            }});
+}
+
+/**
+ * @brief Find the cheapest decoder handling format which provides every required capability
+ *
+ * @param format
+ * @param required a combination of DecoderCapability
+ * @return std::optional<DecoderEntry> std::nullopt if no decoder fits
+ */
+auto DecoderRegistry::Select(ImageType format, uint32_t required) -> std::optional<DecoderEntry> {
+  std::shared_lock<std::shared_mutex> lock(_mtx);
+  const DecoderEntry*                 best = nullptr;
+  for (const auto& entry : _entries) {
+    if (entry.Supports(format) && entry.Provides(required) &&
+        (best == nullptr || entry._cost < best->_cost)) {
+      best = &entry;
+    }
+  }
+  if (best == nullptr) {
+    return std::nullopt;
+  }
+  return *best;
+}
+};  // namespace puerhlab
@@ -32,34 +32,126 @@
 
 #include <easy/profiler.h>
 
+#include <algorithm>
+#include <chrono>
 #include <exception>
 #include <filesystem>
-#include <fstream>
 #include <future>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <stdexcept>
 #include <utility>
 #include <vector>
 
+#include "decoders/data_decoder.hpp"
+#include "decoders/decoder_registry.hpp"
 #include "decoders/image_decoder.hpp"
-#include "decoders/metadata_decoder.hpp"
-#include "decoders/raw_decoder.hpp"
-#include "decoders/thumbnail_decoder.hpp"
 #include "image/image.hpp"
+#include "storage/thumbnail_store/thumbnail_store.hpp"
 #include "type/type.hpp"
+#include "utils/hash/content_hash.hpp"
+#include "utils/io/file_reader.hpp"
 #include "utils/queue/queue.hpp"
 
 namespace puerhlab {
+namespace {
 /**
- * @brief Construct a new Image Decoder::Image Decoder object
+ * @brief Capabilities a decoder needs to serve a decode type
+ */
+auto RequiredCapabilities(DecodeType decode_type, ImageType format) -> uint32_t {
+  switch (decode_type) {
+    case DecodeType::SLEEVE_LOADING:
+      return METADATA_ONLY;
+    case DecodeType::IMPORT:
+      return METADATA_ONLY | EMBEDDED_PREVIEW;
+    case DecodeType::THUMB:
+      // Raw files carry a preview, other files are decoded at a reduced scale
+      return IsRawType(format) ? EMBEDDED_PREVIEW : SCALED_DECODE;
+    default:
+      return FULL_DECODE;
+  }
+}
+
+/**
+ * @brief Heap comparator, the request with the highest priority (then the oldest one) is placed
+ * on top of the heap
+ */
+struct DecodeRequestCompare {
+  auto operator()(const DecodeRequest& lhs, const DecodeRequest& rhs) const -> bool {
+    if (lhs._priority != rhs._priority) {
+      return lhs._priority > rhs._priority;
+    }
+    return lhs._sequence > rhs._sequence;
+  }
+};
+};  // namespace
+
+/**
+ * @brief Construct a new Image Decoder::Image Decoder object. Reads and decodes run on the
+ * pools of the shared executor, the scheduler starts no thread of its own.
  *
- * @param thread_count
- * @param total_request
+ * @param fallback_reads number of file reads kept in flight when io_uring is not available
+ * @param decoded_buffer
+ * @param read_queue_depth number of file reads kept in flight when io_uring is available
  */
-DecoderScheduler::DecoderScheduler(size_t thread_count, std::shared_ptr<BufferQueue> decoded_buffer)
-    : _file_read_thread_pool(thread_count),
-      _thread_pool(thread_count),
-      _decoded_buffer(decoded_buffer) {}
+DecoderScheduler::DecoderScheduler(size_t                       fallback_reads,
+                                   std::shared_ptr<BufferQueue> decoded_buffer,
+                                   uint32_t                     read_queue_depth)
+    : _decoded_buffer(decoded_buffer),
+      _file_reader(FileReader::Create(read_queue_depth, fallback_reads)) {
+  _registry.RegisterBuiltins();
+  if (_decoded_buffer) {
+    _delivery          = std::make_shared<Delivery>();
+    _delivery->_buffer = _decoded_buffer;
+    _decoded_buffer->set_on_space([delivery = std::weak_ptr<Delivery>(_delivery)] {
+      if (auto alive = delivery.lock()) alive->Drain();
+    });
+  }
+
+  auto& io_pool     = Executor::Instance().Io();
+  auto  cpu_threads = Executor::Instance().Cpu().ThreadCount();
+  // Unbounded like the pending heap, the requests hold no file data yet. The store is read from
+  // disk, so the lookups run on the IO pool.
+  _lookups.AddStage({"thumbnail lookup", io_pool.ThreadCount(),
+                     std::numeric_limits<size_t>::max(), false, &io_pool},
+                    [this](DecodeRequest& request) { return LookUpThumbnail(request); });
+  // Never full, a file is only read while the read queue depth allows it
+  _decodes.AddStage({"decode", cpu_threads, _file_reader->QueueDepth()},
+                    [this](DecodeJob& job) { return Decode(job); });
+  // Never full either, delivering does not block
+  _decodes.AddStage({"deliver", 1, std::numeric_limits<size_t>::max()}, [this](DecodeJob& job) {
+    Deliver(job._decoded);
+    return true;
+  });
+}
+
+/**
+ * @brief Let the reads in flight finish, then the decode tasks they started. Requests still
+ * pending are dropped, their futures receive an exception and awaiting coroutines are resumed.
+ *
+ */
+DecoderScheduler::~DecoderScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(_pending_mtx);
+    _stopping = true;
+  }
+  // The shared pools outlive the scheduler, the stages refer to this
+  _lookups.WaitIdle();
+  _file_reader.reset();
+  _decodes.WaitIdle();
+
+  std::vector<DecodeRequest> dropped;
+  {
+    std::lock_guard<std::mutex> lock(_pending_mtx);
+    dropped = std::move(_pending);
+  }
+  for (auto& request : dropped) {
+    Fail(request, std::make_exception_ptr(std::runtime_error("Decoder scheduler stopped.")));
+  }
+}
 
 /**
  * @brief Schedule a decode task for initialize image data. The decode type can only be
@@ -67,53 +159,34 @@ DecoderScheduler::DecoderScheduler(size_t thread_count, std::shared_ptr<BufferQu
  *
  * @param image_path the path of the file to be decoded
  * @param decode_promise the corresponding promise to be collected
+ * @param priority
+ * @param token the request is dropped if the token is cancelled before the file is read
  */
 void DecoderScheduler::ScheduleDecode(image_id_t id, image_path_t image_path,
-                                      std::shared_ptr<std::promise<image_id_t>> decode_promise) {
-  _file_read_thread_pool.Submit([id, image_path, decode_promise, this] {
-    // Open file as an ifstream
-    EASY_FUNCTION(profiler::colors::Cyan);
-    EASY_BLOCK("Read file from disk");
-    std::ifstream file(image_path, std::ios::binary | std::ios::ate);
-
-    if (!file.is_open()) {
-      // Check whether file openned successfully
-      decode_promise->set_exception(
-          std::make_exception_ptr(std::runtime_error("File not exists or no read permission.")));
-      return;
-    }
-
-    // Assign a decoder for the task
-    std::shared_ptr<LoadingDecoder> decoder  = std::make_shared<MetadataDecoder>();
+                                      std::shared_ptr<std::promise<image_id_t>> decode_promise,
+                                      DecodePriority priority, CancellationToken token) {
+  ScheduleDecode(id, std::move(image_path), DecodeType::SLEEVE_LOADING, std::move(decode_promise),
+                 priority, std::move(token));
+}
 
-    // Read file into memory
-    std::streamsize                 fileSize = file.tellg();
-    file.seekg(0, std::ios::beg);
-    std::vector<char> buffer(fileSize);
-    if (!file.read(buffer.data(), fileSize)) {
-      decode_promise->set_exception(
-          std::make_exception_ptr(std::runtime_error("File not exists or no read permission.")));
-      return;
-    }
-    file.close();
-
-    EASY_END_BLOCK;
-    EASY_BLOCK("Schedule decoding");
-    // Submit a new decode request
-    auto&                 decoded_buffer = _decoded_buffer;
-    std::filesystem::path file_path(image_path);
-
-    // auto                  task = std::make_shared<std::packaged_task<void()>>(
-    //     [decoder, buffer = std::move(buffer), file_path, decoded_buffer, id, decode_promise]()
-    //     mutable {
-    //       decoder->Decode(std::move(buffer), file_path, decoded_buffer, id, decode_promise);
-    //     });
-
-    _thread_pool.Submit([decoder, buffer = std::move(buffer), file_path, decoded_buffer, id,
-                         decode_promise]() mutable {
-      decoder->Decode(std::move(buffer), file_path, decoded_buffer, id, decode_promise);
-    });
-  });
+/**
+ * @brief Schedule a decode task which creates a new image
+ *
+ * @param image_path the path of the file to be decoded
+ * @param decode_type SLEEVE_LOADING or IMPORT
+ * @param decode_promise the corresponding promise to be collected
+ * @param priority
+ * @param token the request is dropped if the token is cancelled before the file is read
+ */
+void DecoderScheduler::ScheduleDecode(image_id_t id, image_path_t image_path,
+                                      DecodeType                                decode_type,
+                                      std::shared_ptr<std::promise<image_id_t>> decode_promise,
+                                      DecodePriority priority, CancellationToken token) {
+  if (decode_type != DecodeType::SLEEVE_LOADING && decode_type != DecodeType::IMPORT) {
+    throw std::runtime_error("Incompatible decode type.");
+  }
+  Enqueue({id, std::move(image_path), nullptr, decode_type, priority, std::move(token),
+           std::move(decode_promise), 0, std::nullopt});
 }
 
 /**
@@ -121,57 +194,439 @@ void DecoderScheduler::ScheduleDecode(image_id_t id, image_path_t image_path,
  *
  * @param source_img
  * @param decode_promise
+ * @param priority
+ * @param token the request is dropped if the token is cancelled before the file is read
+ */
+void DecoderScheduler::ScheduleDecode(std::shared_ptr<Image> source_img, DecodeType decode_type,
+                                      std::shared_ptr<std::promise<image_id_t>> decode_promise,
+                                      DecodePriority priority, CancellationToken token) {
+  ScheduleDecode(std::move(source_img), decode_type, std::move(decode_promise), nullptr, priority,
+                 std::move(token));
+}
+
+/**
+ * @brief Schedule a decode task for loading image data into an Image object. When on_complete
+ * is set it is called instead of pushing the image to the decoded buffer, which lets a coroutine
+ * awaiting the request be resumed without blocking a thread on the future.
+ *
+ * @param source_img
+ * @param decode_type
+ * @param decode_promise satisfied before on_complete is called
+ * @param on_complete called exactly once, from whichever thread finishes the request
+ * @param priority
+ * @param token the request is dropped if the token is cancelled before the file is read
  */
 void DecoderScheduler::ScheduleDecode(std::shared_ptr<Image> source_img, DecodeType decode_type,
-                                      std::shared_ptr<std::promise<image_id_t>> decode_promise) {
-  // Open file as an ifstream
+                                      std::shared_ptr<std::promise<image_id_t>> decode_promise,
+                                      std::function<void()> on_complete, DecodePriority priority,
+                                      CancellationToken token) {
+  if (decode_type == DecodeType::SLEEVE_LOADING || decode_type == DecodeType::IMPORT) {
+    throw std::runtime_error("Incompatible decode type.");
+  }
+  auto id   = source_img->_image_id;
+  // The JPEG of a RAW+JPEG pair is much cheaper to turn into a thumbnail than the raw file
+  auto path = decode_type == DecodeType::THUMB && !source_img->_sidecar_path.empty()
+                  ? source_img->_sidecar_path
+                  : source_img->_image_path;
+  DecodeRequest request{id, std::move(path), std::move(source_img), decode_type, priority,
+                        std::move(token), std::move(decode_promise), 0, std::nullopt};
+  request._on_complete = std::move(on_complete);
+  Enqueue(std::move(request));
+}
+
+/**
+ * @brief Attach a persistent thumbnail store. THUMB requests are served from the store when the
+ * source file is unchanged, and decoded thumbnails are written back to it.
+ *
+ * @param store
+ */
+void DecoderScheduler::SetThumbnailStore(std::shared_ptr<ThumbnailStore> store) {
+  _thumbnail_store = std::move(store);
+}
+
+/**
+ * @brief Attach a profiler which times the queue, read and dispatch stages of IMPORT requests and
+ * hands itself to the import decoder for the metadata and thumbnail stages
+ *
+ * @param profiler nullptr to stop profiling
+ */
+void DecoderScheduler::SetImportProfiler(std::shared_ptr<ImportProfiler> profiler) {
+  _import_profiler = std::move(profiler);
+}
+
+/**
+ * @brief Return the decoder registry, decoders registered here are considered by the following
+ * requests
+ *
+ * @return DecoderRegistry&
+ */
+auto DecoderScheduler::Registry() -> DecoderRegistry& { return _registry; }
+
+/**
+ * @brief Return the number of requests still waiting for the file reader
+ *
+ * @return size_t
+ */
+auto DecoderScheduler::PendingCount() -> size_t {
+  std::lock_guard<std::mutex> lock(_pending_mtx);
+  return _pending.size();
+}
 
-  std::ifstream file(source_img->_image_path, std::ios::binary | std::ios::ate);
+/**
+ * @brief Return the metrics of the lookup, decode and deliver stages
+ *
+ * @return std::vector<StageMetrics>
+ */
+auto DecoderScheduler::Metrics() -> std::vector<StageMetrics> {
+  auto metrics = _lookups.Metrics();
+  auto decodes = _decodes.Metrics();
+  metrics.insert(metrics.end(), decodes.begin(), decodes.end());
+  return metrics;
+}
 
-  if (!file.is_open()) {
-    // Check file status
-    decode_promise->set_exception(
-        std::make_exception_ptr(std::runtime_error("File not exists or no read permission.")));
+/**
+ * @brief Place a request into the pending heap. THUMB requests first go through the lookup
+ * stage, only thumbnail store misses are queued for reading.
+ *
+ * @param request
+ */
+void DecoderScheduler::Enqueue(DecodeRequest&& request) {
+  if (request._decode_type == DecodeType::THUMB && _thumbnail_store) {
+    _lookups.Push(std::move(request));
     return;
   }
+  PushPending(std::move(request));
+}
 
-  // Assign a decoder for the task
-  std::shared_ptr<DataDecoder> decoder;
+/**
+ * @brief Lookup stage, a stored thumbnail of an unchanged file saves both the read and the
+ * decoding
+ *
+ * @param request
+ * @return true missed, the request was queued for reading
+ * @return false served from the thumbnail store
+ */
+auto DecoderScheduler::LookUpThumbnail(DecodeRequest& request) -> bool {
+  request._fingerprint = ThumbnailFingerprint::FromFile(request._image_path);
+  if (request._fingerprint.has_value() && TryLoadStoredThumbnail(request, *request._fingerprint)) {
+    return false;
+  }
+  PushPending(std::move(request));
+  return true;
+}
 
-  // Assign a decoder according to the decode type
-  switch (decode_type) {
-    case DecodeType::THUMB:
-      decoder = std::make_shared<ThumbnailDecoder>();
-      break;
-    case DecodeType::RAW:
-      decoder = std::make_shared<RawDecoder>();
-      break;
-    case DecodeType::REGULAR:
-      // FIXME: Add RegularDecoder
-      decoder = std::make_shared<ThumbnailDecoder>();
-      break;
-    default:
+void DecoderScheduler::PushPending(DecodeRequest&& request) {
+  if (_import_profiler && request._decode_type == DecodeType::IMPORT) {
+    request._stage_start = ImportProfiler::Clock::now();
+  }
+  if (request._token.CanBeCancelled()) {
+    // Registered outside the lock, the callback runs right away if the token is cancelled
+    request._cancel_hook = std::make_shared<CancellationRegistration>(
+        request._token.OnCancel([this] { DropCancelled(); }));
+  }
+  {
+    std::lock_guard<std::mutex> lock(_pending_mtx);
+    request._sequence = _next_sequence++;
+    _pending.push_back(std::move(request));
+    std::push_heap(_pending.begin(), _pending.end(), DecodeRequestCompare{});
+  }
+  Pump();
+}
+
+/**
+ * @brief Remove the cancelled requests from the pending heap and fail them right away, so that
+ * their awaiters do not wait for the requests to reach the top of the heap. Runs on the thread
+ * which cancelled a token.
+ *
+ */
+void DecoderScheduler::DropCancelled() {
+  std::vector<DecodeRequest> dropped;
+  {
+    std::lock_guard<std::mutex> lock(_pending_mtx);
+    auto cancelled = std::partition(_pending.begin(), _pending.end(), [](const auto& request) {
+      return !request._token.IsCancelled();
+    });
+    if (cancelled == _pending.end()) {
+      return;
+    }
+    std::move(cancelled, _pending.end(), std::back_inserter(dropped));
+    _pending.erase(cancelled, _pending.end());
+    std::make_heap(_pending.begin(), _pending.end(), DecodeRequestCompare{});
+  }
+  // Failed outside the lock, destroying a registration may wait for its callback
+  for (auto& request : dropped) {
+    Fail(request, std::make_exception_ptr(OperationCancelled("Decode request cancelled.")));
+  }
+}
+
+/**
+ * @brief Hand the most urgent pending requests to the file reader until its queue depth is
+ * reached. Requests are held back in the heap rather than in the reader so that a later, more
+ * urgent request can still overtake them.
+ *
+ */
+void DecoderScheduler::Pump() {
+  while (true) {
+    DecodeRequest request;
+    {
+      std::lock_guard<std::mutex> lock(_pending_mtx);
+      if (_stopping || _pending.empty() || _reads_in_flight >= _file_reader->QueueDepth()) {
+        return;
+      }
+      std::pop_heap(_pending.begin(), _pending.end(), DecodeRequestCompare{});
+      request = std::move(_pending.back());
+      _pending.pop_back();
+      ++_reads_in_flight;
+    }
+    // Past this point cancellation is checked between the stages of the request
+    request._cancel_hook.reset();
+
+    // Stale requests are dropped before they touch the disk
+    if (request._token.IsCancelled()) {
+      {
+        std::lock_guard<std::mutex> lock(_pending_mtx);
+        --_reads_in_flight;
+      }
+      Fail(request, std::make_exception_ptr(OperationCancelled("Decode request cancelled.")));
+      continue;
+    }
+
+    auto path = request._image_path;
+    EndStage(request, ImportStage::QUEUE);
+    if (request._decode_type == DecodeType::IMPORT) {
+      // The content hash of imported files is computed chunk by chunk during the read
+      _file_reader->ReadHashed(
+          path, [this, request = std::move(request)](std::vector<char>&& buffer, ContentHash hash,
+                                                     std::exception_ptr error) mutable {
+            request._content_hash = hash;
+            OnReadComplete(std::move(request), std::move(buffer), error);
+          });
+      continue;
+    }
+    _file_reader->Read(path, [this, request = std::move(request)](
+                                 std::vector<char>&& buffer, std::exception_ptr error) mutable {
+      OnReadComplete(std::move(request), std::move(buffer), error);
+    });
+  }
+}
+
+/**
+ * @brief Called by the file reader once a file is in memory, hands the buffer over to the decode
+ * stage. A failed read refills the reader right away.
+ *
+ * @param request
+ * @param buffer
+ * @param error
+ */
+void DecoderScheduler::OnReadComplete(DecodeRequest&& request, std::vector<char>&& buffer,
+                                      std::exception_ptr error) {
+  EASY_FUNCTION(profiler::colors::Cyan);
+  EndStage(request, ImportStage::READ);
+  if (error) {
+    ReleaseRead();
+    Fail(request, error);
+    return;
+  }
+  if (request._token.IsCancelled()) {
+    ReleaseRead();
+    Fail(request, std::make_exception_ptr(OperationCancelled("Decode request cancelled.")));
+    return;
+  }
+  _decodes.Push({std::move(request), std::move(buffer), nullptr});
+}
+
+/**
+ * @brief Give back the read queue slot of a request and refill the reader
+ *
+ */
+void DecoderScheduler::ReleaseRead() {
+  {
+    std::lock_guard<std::mutex> lock(_pending_mtx);
+    --_reads_in_flight;
+  }
+  Pump();
+}
+
+/**
+ * @brief Serve a THUMB request from the thumbnail store
+ *
+ * @param request
+ * @param fingerprint
+ * @return true the thumbnail was found and the request is fulfilled
+ * @return false cache miss, the request needs to be decoded
+ */
+auto DecoderScheduler::TryLoadStoredThumbnail(DecodeRequest&              request,
+                                              const ThumbnailFingerprint& fingerprint) -> bool {
+  EASY_BLOCK("Load stored thumbnail");
+  auto stored = _thumbnail_store->Get(request._id, fingerprint);
+  if (!stored.has_value()) {
+    return false;
+  }
+  cv::Mat thumbnail;
+  stored->convertTo(thumbnail, CV_MAKETYPE(CV_32F, stored->channels()), 1.0 / 255.0);
+  request._source_img->LoadThumbnail({std::move(thumbnail)});
+  if (!request._on_complete && _delivery) _delivery->Deliver(request._source_img);
+  request._promise->set_value(request._id);
+  Notify(request);
+  return true;
+}
+
+/**
+ * @brief Decode stage, the decoder is selected from the registry according to the format sniffed
+ * from the buffer and to what the decode type requires
+ *
+ * @param job
+ * @return true the decoder wrote to the job's queue, the images go on to the deliver stage
+ * @return false the request is complete
+ */
+auto DecoderScheduler::Decode(DecodeJob& job) -> bool {
+  EASY_BLOCK("Decode");
+  auto& request = job._request;
+  auto& buffer  = job._buffer;
+  EndStage(request, ImportStage::DISPATCH);
+  // The buffer is owned by the stage now, the next file may be read
+  ReleaseRead();
+  // The request may have gone stale while waiting for a decode thread
+  if (request._token.IsCancelled()) {
+    Fail(request, std::make_exception_ptr(OperationCancelled("Decode request cancelled.")));
+    return false;
+  }
+
+  // A throwing decoder, e.g. LibRaw or OpenCV on a corrupt file, fails its request only. An
+  // exception escaping the stage would terminate the program.
+  try {
+    auto format = DetectImageType(buffer.data(), buffer.size(), request._image_path);
+    auto entry  = _registry.Select(format, RequiredCapabilities(request._decode_type, format));
+    if (!entry.has_value()) {
+      throw std::runtime_error("No decoder for the file format.");
+    }
+    job._decoded     = ResultBuffer(request);
+    auto profiler    = request._decode_type == DecodeType::IMPORT ? _import_profiler : nullptr;
+    // RAW requests open an image for editing, final renders construct their decoder themselves
+    bool interactive = request._decode_type == DecodeType::RAW;
+    auto decoder     = entry->_factory({_thumbnail_store, request._fingerprint,
+                                        request._content_hash, std::move(profiler), interactive});
+    decoder->SetCancellationToken(request._token);
+
+    if (request._decode_type == DecodeType::SLEEVE_LOADING ||
+        request._decode_type == DecodeType::IMPORT) {
+      decoder->Decode(std::move(buffer), std::filesystem::path(request._image_path), job._decoded,
+                      request._id, request._promise);
+      Notify(request);
+      return job._decoded != nullptr;
+    }
+    auto data_decoder = std::dynamic_pointer_cast<DataDecoder>(decoder);
+    if (!data_decoder) {
       throw std::runtime_error("Incompatible decode type.");
+    }
+    if (request._decode_type != DecodeType::THUMB) {
+      // THUMB requests may have read the sidecar rather than the image file itself
+      request._source_img->_image_type = format;
+    }
+    data_decoder->Decode(std::move(buffer), request._source_img, job._decoded, request._promise);
+    Notify(request);
+    return job._decoded != nullptr;
+  } catch (...) {
+    Fail(request, std::current_exception());
+    return false;
   }
+}
 
-  // Read file into memory
-  std::streamsize fileSize = file.tellg();
-  file.seekg(0, std::ios::beg);
-  std::vector<char> buffer(fileSize);
-  if (!file.read(buffer.data(), fileSize)) {
-    decode_promise->set_exception(
-        std::make_exception_ptr(std::runtime_error("File not exists or no read permission.")));
+/**
+ * @brief Deliver stage, move what a decoder produced on to the decoded buffer. Never blocks, so
+ * that a full buffer cannot park the threads of the shared CPU pool.
+ *
+ * @param decoded the request's own queue, nullptr for awaited requests
+ */
+void DecoderScheduler::Deliver(const std::shared_ptr<BufferQueue>& decoded) {
+  if (!decoded) {
     return;
   }
-  file.close();
+  while (auto img = decoded->try_pop_for(std::chrono::milliseconds(0))) {
+    _delivery->Deliver(std::move(*img));
+  }
+}
+
+/**
+ * @brief Push the image if the buffer has room and no earlier image is still waiting, keep it
+ * for Drain() otherwise
+ *
+ * @param img
+ */
+void DecoderScheduler::Delivery::Deliver(std::shared_ptr<Image> img) {
+  std::lock_guard<std::mutex> lock(_mtx);
+  if (_overflow.empty() && _buffer->try_push(img)) {
+    return;
+  }
+  _overflow.push_back(std::move(img));
+}
+
+/**
+ * @brief Push the waiting images while the buffer has room, run by the consumer after each pop
+ *
+ */
+void DecoderScheduler::Delivery::Drain() {
+  std::lock_guard<std::mutex> lock(_mtx);
+  while (!_overflow.empty() && _buffer->try_push(_overflow.front())) {
+    _overflow.pop_front();
+  }
+}
 
-  // Submit a new decode request
-  auto                  decoded_buffer = _decoded_buffer;
-  std::filesystem::path file_path(source_img->_image_path);
+/**
+ * @brief Satisfy the request's promise with an error, unless it already is, and notify its
+ * awaiter
+ *
+ * @param request
+ * @param error
+ */
+void DecoderScheduler::Fail(DecodeRequest& request, std::exception_ptr error) {
+  try {
+    request._promise->set_exception(error);
+  } catch (const std::future_error&) {
+    // The decoder satisfied the promise before it threw
+  }
+  Notify(request);
+}
 
-  _thread_pool.Submit(
-      [decoder, buffer = std::move(buffer), decoded_buffer, source_img, decode_promise]() mutable {
-        decoder->Decode(std::move(buffer), source_img, decoded_buffer, decode_promise);
-      });
+/**
+ * @brief Awaited requests hand their result over through the promise only. The decoders of the
+ * others write to an unbounded queue of the request's own, Deliver() moves it on to the decoded
+ * buffer.
+ *
+ * @param request
+ * @return std::shared_ptr<BufferQueue> nullptr for awaited requests
+ */
+auto DecoderScheduler::ResultBuffer(const DecodeRequest& request) const
+    -> std::shared_ptr<BufferQueue> {
+  if (request._on_complete || !_delivery) {
+    return nullptr;
+  }
+  return std::make_shared<BufferQueue>();
+}
+
+/**
+ * @brief Run the completion callback of an awaited request, once its promise is satisfied
+ *
+ * @param request
+ */
+void DecoderScheduler::Notify(DecodeRequest& request) {
+  if (request._on_complete) std::exchange(request._on_complete, nullptr)();
+}
+
+/**
+ * @brief Record the time a profiled IMPORT request spent in a stage, the next stage starts now
+ *
+ * @param request
+ * @param stage
+ */
+void DecoderScheduler::EndStage(DecodeRequest& request, ImportStage stage) {
+  // Requests queued before the profiler was attached have no start time
+  if (!_import_profiler || request._decode_type != DecodeType::IMPORT ||
+      request._stage_start == ImportProfiler::Clock::time_point{}) {
+    return;
+  }
+  auto now = ImportProfiler::Clock::now();
+  _import_profiler->Record(request._image_path, stage, now - request._stage_start);
+  request._stage_start = now;
 }
 };  // namespace puerhlab
\ No newline at end of file
@@ -0,0 +1,211 @@
+/*
+ * @file        pu-erh_lab/src/decoders/import_decoder.cpp
+ * @brief       A decoder producing metadata, thumbnail and checksum from one read
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "decoders/import_decoder.hpp"
+
+#include <easy/profiler.h>
+#include <libraw/libraw.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <future>
+#include <memory>
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <utility>
+
+#include "concurrency/cancellation_token.hpp"
+#include "image/image.hpp"
+#include "image/metadata.hpp"
+#include "image/sidecar.hpp"
+#include "utils/io/mapped_file.hpp"
+
+namespace puerhlab {
+namespace {
+/**
+ * @brief Decode the preview embedded in a raw file
+ *
+ * @param data
+ * @param size
+ * @return cv::Mat 8-bit BGR, empty if the file is not a raw file or has no preview
+ */
+auto DecodeEmbeddedPreview(const char* data, size_t size) -> cv::Mat {
+  LibRaw raw_processor;
+  if (raw_processor.open_buffer((void*)data, size) != LIBRAW_SUCCESS ||
+      raw_processor.unpack_thumb() != LIBRAW_SUCCESS) {
+    return {};
+  }
+  int                       err       = 0;
+  libraw_processed_image_t* thumbnail = raw_processor.dcraw_make_mem_thumb(&err);
+  if (!thumbnail) {
+    return {};
+  }
+
+  cv::Mat preview;
+  if (thumbnail->type == LIBRAW_IMAGE_JPEG) {
+    cv::Mat jpeg_data(1, static_cast<int>(thumbnail->data_size), CV_8UC1, thumbnail->data);
+    // Embedded previews are often full size, the DCT scaling keeps this cheap
+    preview = cv::imdecode(jpeg_data, cv::IMREAD_REDUCED_COLOR_4);
+  } else if (thumbnail->type == LIBRAW_IMAGE_BITMAP && thumbnail->colors == 3) {
+    cv::Mat bitmap(thumbnail->height, thumbnail->width, CV_8UC3, thumbnail->data);
+    cv::cvtColor(bitmap, preview, cv::COLOR_RGB2BGR);
+  }
+  LibRaw::dcraw_clear_mem(thumbnail);
+  return preview;
+}
+};  // namespace
+
+/**
+ * @brief Construct an ImportDecoder which writes the thumbnails to a thumbnail store
+ *
+ * @param store
+ * @param content_hash the hash of the file computed while reading it, if any
+ * @param profiler records the time spent on the metadata and on the thumbnail, may be nullptr
+ */
+ImportDecoder::ImportDecoder(std::shared_ptr<ThumbnailStore> store, ContentHash content_hash,
+                             std::shared_ptr<ImportProfiler> profiler)
+    : _store(std::move(store)), _content_hash(content_hash), _profiler(std::move(profiler)) {}
+
+/**
+ * @brief Produce a thumbnail from an in-memory file, using the embedded preview of raw files and
+ * a reduced decode of regular files
+ *
+ * @param buffer
+ * @return cv::Mat 8-bit BGR no larger than ThumbnailStore::_default_max_edge, empty on failure
+ */
+auto ImportDecoder::DecodeThumbnail(const std::vector<char>& buffer) -> cv::Mat {
+  return DecodeThumbnail(buffer.data(), buffer.size());
+}
+
+auto ImportDecoder::DecodeThumbnail(const char* data, size_t size) -> cv::Mat {
+  cv::Mat thumbnail;
+  auto    format = SniffImageType(data, size);
+  // LibRaw would only reject these after parsing them
+  if (format != ImageType::JPEG && format != ImageType::PNG) {
+    thumbnail = DecodeEmbeddedPreview(data, size);
+  }
+  if (thumbnail.empty()) {
+    cv::Mat file_data(1, static_cast<int>(size), CV_8UC1, const_cast<char*>(data));
+    thumbnail = cv::imdecode(file_data, cv::IMREAD_REDUCED_COLOR_8);
+  }
+  if (thumbnail.empty()) {
+    return thumbnail;
+  }
+
+  int long_edge = std::max(thumbnail.rows, thumbnail.cols);
+  if (long_edge > static_cast<int>(ThumbnailStore::_default_max_edge)) {
+    double  scale = static_cast<double>(ThumbnailStore::_default_max_edge) / long_edge;
+    cv::Mat resized;
+    cv::resize(thumbnail, resized, cv::Size(), scale, scale, cv::INTER_AREA);
+    thumbnail = std::move(resized);
+  }
+  return thumbnail;
+}
+
+/**
+ * @brief A callback used to import a file
+ *
+ * @param buffer
+ * @param file_path
+ * @param result
+ * @param id
+ * @param promise
+ */
+void ImportDecoder::Decode(std::vector<char> buffer, std::filesystem::path file_path,
+                           std::shared_ptr<BufferQueue> result, image_id_t id,
+                           std::shared_ptr<std::promise<image_id_t>> promise) {
+  EASY_FUNCTION(profiler::colors::Green);
+  std::shared_ptr<Image> img =
+      std::make_shared<Image>(id, file_path, file_path.filename(),
+                              DetectImageType(buffer.data(), buffer.size(), file_path));
+  img->_content_hash = _content_hash.IsEmpty()
+                           ? ContentHash::FromBuffer(buffer.data(), buffer.size())
+                           : _content_hash;
+
+  try {
+    ImportStageTimer timer(_profiler.get(), file_path, ImportStage::EXIF);
+    auto             metadata = ImageMetadata::FromBuffer(buffer.data(), buffer.size());
+    img->_has_exif           = metadata.has_value();
+    if (metadata.has_value()) {
+      img->_metadata = *metadata;
+    }
+  } catch (const std::exception&) {
+    // Unreadable metadata leaves the image without exif, the file is still imported
+  }
+
+  // Metadata is cheap, the thumbnail is not
+  if (_token.IsCancelled()) {
+    promise->set_exception(std::make_exception_ptr(OperationCancelled("Import cancelled.")));
+    return;
+  }
+
+  // Same extension rule as the walker which skipped the JPEG, not the sniffed type
+  if (auto sidecar = Sidecar::FindJpeg(file_path); sidecar.has_value()) {
+    img->_sidecar_path = std::move(*sidecar);
+  }
+
+  try {
+    ImportStageTimer timer(_profiler.get(), file_path, ImportStage::THUMBNAIL);
+    cv::Mat          thumbnail;
+    image_path_t     thumbnail_source = file_path;
+    if (!img->_sidecar_path.empty()) {
+      // Shot as RAW+JPEG, the JPEG is decoded at 1/8 scale during the DCT instead of going
+      // through the raw file
+      MappedFile jpeg(img->_sidecar_path);
+      if (jpeg.IsOpen()) {
+        thumbnail = DecodeThumbnail(reinterpret_cast<const char*>(jpeg.Data()), jpeg.Size());
+      }
+      if (!thumbnail.empty()) {
+        thumbnail_source = img->_sidecar_path;
+      }
+    }
+    if (thumbnail.empty()) {
+      thumbnail = DecodeThumbnail(buffer);
+    }
+    if (!thumbnail.empty()) {
+      // Matches the file THUMB requests read, see DecoderScheduler::ScheduleDecode
+      auto fingerprint = ThumbnailFingerprint::FromFile(thumbnail_source);
+      if (_store && fingerprint.has_value()) {
+        _store->Put(id, *fingerprint, thumbnail);
+      } else {
+        thumbnail.convertTo(thumbnail, CV_32FC3, 1.0 / 255.0);
+        img->LoadThumbnail({std::move(thumbnail)});
+      }
+    }
+  } catch (const std::exception&) {
+    // A missing thumbnail must not fail the import, it is decoded again when browsing
+  }
+
+  result->push(img);
+  promise->set_value(id);
+}
+};  // namespace puerhlab
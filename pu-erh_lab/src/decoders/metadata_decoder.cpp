@@ -58,10 +58,14 @@ void MetadataDecoder::Decode(std::vector<char> buffer, std::filesystem::path fil
                              std::shared_ptr<std::promise<image_id_t>> promise) {
   try {
     std::shared_ptr<Image> img =
-        std::make_shared<Image>(id, file_path, file_path.filename(), ImageType::DEFAULT);
-    img->_exif_data = Exiv2::ImageFactory::open((Exiv2::byte*)buffer.data(), buffer.size());
-    img->_exif_data->readMetadata();
-    img->_has_exif = !img->_exif_data->exifData().empty();
+        std::make_shared<Image>(id, file_path, file_path.filename(),
+                                DetectImageType(buffer.data(), buffer.size(), file_path));
+    // The Exiv2 image is dropped right away, only the compact record is kept
+    auto metadata = ImageMetadata::FromBuffer(buffer.data(), buffer.size());
+    img->_has_exif = metadata.has_value();
+    if (metadata.has_value()) {
+      img->_metadata = *metadata;
+    }
     result->push(img);
     promise->set_value(id);
     return;
@@ -80,10 +84,13 @@ void MetadataDecoder::Decode(std::vector<char> buffer, std::shared_ptr<Image> so
                              std::shared_ptr<BufferQueue>              result,
                              std::shared_ptr<std::promise<image_id_t>> promise) {
   try {
-    source_img->_exif_data = Exiv2::ImageFactory::open((Exiv2::byte*)buffer.data(), buffer.size());
-    source_img->_exif_data->readMetadata();
-    source_img->_has_exif = !source_img->_exif_data->exifData().empty();
-    result->push(source_img);
+    // The Exiv2 image is dropped right away, only the compact record is kept
+    auto metadata        = ImageMetadata::FromBuffer(buffer.data(), buffer.size());
+    source_img->_has_exif = metadata.has_value();
+    if (metadata.has_value()) {
+      source_img->_metadata = *metadata;
+    }
+    if (result) result->push(source_img);
     promise->set_value(source_img->_image_id);
 
     return;
@@ -92,7 +99,7 @@ void MetadataDecoder::Decode(std::vector<char> buffer, std::shared_ptr<Image> so
     std::cout << e.what() << std::endl;
   }
   // If it fails to read metadata, produce a plain image with minimum metadata
-  result->push(source_img);
+  if (result) result->push(source_img);
   promise->set_value(source_img->_image_id);
 }
 
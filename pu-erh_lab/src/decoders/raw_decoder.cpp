@@ -33,30 +33,153 @@
 #include <libraw/libraw_const.h>
 #include <opencv2/core/hal/interface.h>
 
+#include <algorithm>
 #include <cstdint>
+#include <exception>
 #include <memory>
+#include <opencv2/core.hpp>
 #include <opencv2/core/mat.hpp>
 #include <opencv2/core/matx.hpp>
+#include <optional>
 #include <stdexcept>
+#include <utility>
 
+#include "decoders/bayer_demosaic.hpp"
+#include "image/image.hpp"
 #include "type/type.hpp"
 
 namespace puerhlab {
+namespace {
+// sRGB (D65) to ACES2065-1, Bradford adapted to the ACES white point
+constexpr float kSRGBToACES[3][3] = {{0.43963298f, 0.38298870f, 0.17737832f},
+                                     {0.08977644f, 0.81343943f, 0.09678413f},
+                                     {0.01754117f, 0.11154655f, 0.87091228f}};
+
 /**
- * @brief A callback used to decode a raw file
+ * @brief Collect what BayerDemosaic needs from an unpacked raw file
  *
- * @param file
+ * @param raw
+ * @return std::optional<BayerDevelopParams> std::nullopt if the sensor is not a 2x2 Bayer
+ */
+auto BayerParams(LibRaw& raw) -> std::optional<BayerDevelopParams> {
+  const auto& idata = raw.imgdata.idata;
+  const auto& color = raw.imgdata.color;
+  if (raw.imgdata.rawdata.raw_image == nullptr || idata.filters < 1000 || idata.colors != 3 ||
+      raw.get_internal_data_pointer()->internal_output_params.fuji_width != 0) {
+    return std::nullopt;
+  }
+  // LibRaw describes patterns of up to 8 rows, only 2x2 repetitions are handled
+  for (int row = 2; row < 8; ++row) {
+    for (int col = 0; col < 2; ++col) {
+      if (raw.COLOR(row, col) != raw.COLOR(row & 1, col)) {
+        return std::nullopt;
+      }
+    }
+  }
+  // Per-site black levels are stored after the per-color ones, as a pattern of cblack[4] rows
+  // and cblack[5] columns
+  unsigned pattern_rows = color.cblack[4];
+  unsigned pattern_cols = color.cblack[5];
+  bool     has_pattern  = pattern_rows != 0 && pattern_cols != 0;
+  if (has_pattern && (pattern_rows > 2 || pattern_cols > 2)) {
+    return std::nullopt;
+  }
+
+  BayerDevelopParams params;
+  for (int row = 0; row < 2; ++row) {
+    for (int col = 0; col < 2; ++col) {
+      int   c     = raw.COLOR(row, col);
+      float black = static_cast<float>(color.black + color.cblack[c]);
+      if (has_pattern) {
+        black += static_cast<float>(
+            color.cblack[6 + (row % pattern_rows) * pattern_cols + col % pattern_cols]);
+      }
+      params._pattern[row][col] = static_cast<uint8_t>(c);
+      params._black[row][col]   = black;
+    }
+  }
+  params._white = static_cast<float>(color.maximum);
+
+  const float* wb = color.cam_mul;
+  if (*std::min_element(wb, wb + 3) <= 0.0f) {
+    wb = color.pre_mul;
+  }
+  for (int c = 0; c < 4; ++c) {
+    params._wb[c] = wb[c];
+  }
+  if (params._wb[3] <= 0.0f) {
+    params._wb[3] = params._wb[1];
+  }
+  if (*std::min_element(params._wb, params._wb + 4) <= 0.0f) {
+    return std::nullopt;
+  }
+
+  // rgb_cam maps white balanced camera RGB to linear sRGB
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      float sum = 0.0f;
+      for (int k = 0; k < 3; ++k) {
+        sum += kSRGBToACES[i][k] * color.rgb_cam[k][j];
+      }
+      params._cam_to_out[i][j] = sum;
+    }
+  }
+  return params;
+}
+
+/**
+ * @brief Apply the orientation LibRaw read from the file, as dcraw_make_mem_image() does
+ */
+void ApplyFlip(cv::Mat& image, int flip) {
+  switch (flip) {
+    case 3:
+      cv::rotate(image, image, cv::ROTATE_180);
+      break;
+    case 5:
+      cv::rotate(image, image, cv::ROTATE_90_COUNTERCLOCKWISE);
+      break;
+    case 6:
+      cv::rotate(image, image, cv::ROTATE_90_CLOCKWISE);
+      break;
+    default:
+      break;
+  }
+}
+};  // namespace
+
+/**
+ * @brief Construct a new RawDecoder object
+ *
+ * @param quality
+ */
+RawDecoder::RawDecoder(RawQuality quality) : _quality(quality) {}
+
+auto RawDecoder::Quality() const -> RawQuality { return _quality; }
+
+/**
+ * @brief A callback used to decode a raw file into a new image
+ *
+ * @param buffer
  * @param file_path
+ * @param result
  * @param id
+ * @param promise
  */
 void RawDecoder::Decode(std::vector<char> buffer, std::filesystem::path file_path,
                         std::shared_ptr<BufferQueue> result, image_id_t id,
                         std::shared_ptr<std::promise<image_id_t>> promise) {
-  // TODO: Add Implementation
+  try {
+    auto img = std::make_shared<Image>(id, file_path,
+                                       DetectImageType(buffer.data(), buffer.size(), file_path));
+    Decode(std::move(buffer), img);
+    result->push(img);
+    promise->set_value(id);
+  } catch (...) {
+    promise->set_exception(std::current_exception());
+  }
 }
 
 void RawDecoder::Decode(std::vector<char>&& buffer, std::shared_ptr<Image> source_img) {
-  // TODO: Add Implementation
   LibRaw raw_processor;
   int    ret = raw_processor.open_buffer((void*)buffer.data(), buffer.size());
   if (ret != LIBRAW_SUCCESS) {
@@ -70,9 +193,29 @@ void RawDecoder::Decode(std::vector<char>&& buffer, std::shared_ptr<Image> sourc
   raw_processor.imgdata.params.no_auto_bright = 1;  // Disable auto brightness
   raw_processor.imgdata.params.use_camera_wb  = 1;
   raw_processor.imgdata.params.highlight      = 0;
-  raw_processor.unpack();
+  _token.ThrowIfCancelled();
+  if (raw_processor.unpack() != LIBRAW_SUCCESS) {
+    throw std::runtime_error("RawDecoder: Unable to unpack raw file using LibRAW");
+  }
+  // A stale request stops here, before the expensive development
+  _token.ThrowIfCancelled();
+
+  if (_quality == RawQuality::PREVIEW) {
+    if (auto params = BayerParams(raw_processor); params.has_value()) {
+      const auto& sizes = raw_processor.imgdata.sizes;
+      cv::Mat     raw_data(sizes.raw_height, sizes.raw_width, CV_16UC1,
+                           raw_processor.imgdata.rawdata.raw_image, sizes.raw_pitch);
+      cv::Rect    visible(sizes.left_margin, sizes.top_margin, sizes.width, sizes.height);
+      cv::Mat     image_32f = BayerDemosaic::Develop(raw_data(visible), *params);
+      ApplyFlip(image_32f, sizes.flip);
+      raw_processor.recycle();
+      source_img->LoadData({std::move(image_32f)});
+      return;
+    }
+  }
 
   raw_processor.dcraw_process();
+  _token.ThrowIfCancelled();
 
   auto img = raw_processor.dcraw_make_mem_image();
   if (!img || img->type != LIBRAW_IMAGE_BITMAP) {
@@ -98,6 +241,12 @@ void RawDecoder::Decode(std::vector<char>&& buffer, std::shared_ptr<Image> sourc
 void RawDecoder::Decode(std::vector<char> buffer, std::shared_ptr<Image> source_img,
                         std::shared_ptr<BufferQueue>              result,
                         std::shared_ptr<std::promise<image_id_t>> promise) {
-  throw std::runtime_error("RawDecoder: Not implemented");
+  try {
+    Decode(std::move(buffer), source_img);
+    if (result) result->push(source_img);
+    promise->set_value(source_img->_image_id);
+  } catch (...) {
+    promise->set_exception(std::current_exception());
+  }
 }
 };  // namespace puerhlab
@@ -0,0 +1,181 @@
+/*
+ * @file        pu-erh_lab/src/decoders/regular_decoder.cpp
+ * @brief       A decoder used to decode regular files at full or reduced resolution
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "decoders/regular_decoder.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <memory>
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "concurrency/executor.hpp"
+#include "image/image.hpp"
+#include "image/image_buffer.hpp"
+
+namespace puerhlab {
+namespace {
+auto SRGBToLinear(float v) -> float {
+  return v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+}
+
+/**
+ * @brief Lookup table from an encoded 8-bit or 16-bit sample to its linear value
+ */
+template <size_t N>
+auto MakeLinearLUT() -> std::vector<float> {
+  std::vector<float> lut(N);
+  for (size_t i = 0; i < N; ++i) {
+    lut[i] = SRGBToLinear(static_cast<float>(i) / static_cast<float>(N - 1));
+  }
+  return lut;
+}
+
+auto LinearLUT8() -> const std::vector<float>& {
+  static const std::vector<float> lut = MakeLinearLUT<256>();
+  return lut;
+}
+
+auto LinearLUT16() -> const std::vector<float>& {
+  static const std::vector<float> lut = MakeLinearLUT<65536>();
+  return lut;
+}
+
+/**
+ * @brief Convert decoded BGR samples into linear RGB floats, one band of rows per task. The bands
+ * run on the CPU pool of the shared executor, like the other decode work.
+ *
+ * @param encoded
+ * @param lut encoded sample to linear value
+ * @return cv::Mat CV_32FC3
+ */
+template <typename T>
+auto Linearize(const cv::Mat& encoded, const std::vector<float>& lut) -> cv::Mat {
+  constexpr int band_rows = RegularDecoder::_rows_per_band;
+  cv::Mat       linear(encoded.rows, encoded.cols, CV_32FC3);
+  int           bands = (encoded.rows + band_rows - 1) / band_rows;
+  Executor::Instance().Cpu().ParallelFor(bands, [&](size_t band) {
+    int first_row = static_cast<int>(band) * band_rows;
+    int last_row  = std::min(first_row + band_rows, encoded.rows);
+    for (int row = first_row; row < last_row; ++row) {
+      const auto* src = encoded.ptr<cv::Vec<T, 3>>(row);
+      auto*       dst = linear.ptr<cv::Vec3f>(row);
+      for (int col = 0; col < encoded.cols; ++col) {
+        dst[col][0] = lut[src[col][2]];
+        dst[col][1] = lut[src[col][1]];
+        dst[col][2] = lut[src[col][0]];
+      }
+    }
+  });
+  return linear;
+}
+};  // namespace
+
+/**
+ * @brief Decode an in-memory file into linear RGB
+ *
+ * @param buffer
+ * @return cv::Mat CV_32FC3
+ */
+auto RegularDecoder::Decode(const std::vector<char>& buffer) -> cv::Mat {
+  cv::Mat file_data(1, static_cast<int>(buffer.size()), CV_8UC1,
+                    const_cast<char*>(buffer.data()));
+  // Keep 16-bit samples instead of going through 8 bits
+  cv::Mat encoded = cv::imdecode(file_data, cv::IMREAD_COLOR | cv::IMREAD_ANYDEPTH);
+  if (encoded.empty()) {
+    throw std::runtime_error("RegularDecoder: Unable to decode the image");
+  }
+  _token.ThrowIfCancelled();
+
+  switch (encoded.depth()) {
+    case CV_8U:
+      return Linearize<uint8_t>(encoded, LinearLUT8());
+    case CV_16U:
+      return Linearize<uint16_t>(encoded, LinearLUT16());
+    case CV_32F: {
+      // Floating point files, e.g. 32-bit TIFF, already hold linear data
+      cv::Mat linear;
+      cv::cvtColor(encoded, linear, cv::COLOR_BGR2RGB);
+      return linear;
+    }
+    default:
+      throw std::runtime_error("RegularDecoder: Unsupported sample depth");
+  }
+}
+
+/**
+ * @brief A callback used to decode a regular file into a new image
+ *
+ * @param buffer
+ * @param file_path
+ * @param result
+ * @param id
+ * @param promise
+ */
+void RegularDecoder::Decode(std::vector<char> buffer, std::filesystem::path file_path,
+                            std::shared_ptr<BufferQueue> result, image_id_t id,
+                            std::shared_ptr<std::promise<image_id_t>> promise) {
+  try {
+    auto img = std::make_shared<Image>(id, file_path, ImageType::DEFAULT);
+    img->LoadData({Decode(buffer)});
+    result->push(img);
+    promise->set_value(id);
+  } catch (...) {
+    promise->set_exception(std::current_exception());
+  }
+}
+
+/**
+ * @brief A callback used to load the full image data of a regular file into source_img
+ *
+ * @param buffer
+ * @param source_img
+ * @param result
+ * @param promise
+ */
+void RegularDecoder::Decode(std::vector<char> buffer, std::shared_ptr<Image> source_img,
+                            std::shared_ptr<BufferQueue>              result,
+                            std::shared_ptr<std::promise<image_id_t>> promise) {
+  try {
+    source_img->LoadData({Decode(buffer)});
+    if (result) result->push(source_img);
+    promise->set_value(source_img->_image_id);
+  } catch (...) {
+    promise->set_exception(std::current_exception());
+  }
+}
+};  // namespace puerhlab
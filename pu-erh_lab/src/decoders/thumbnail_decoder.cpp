@@ -37,12 +37,25 @@
 #include <memory>
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/opencv.hpp>
+#include <stdexcept>
 #include <utility>
 
+#include "concurrency/cancellation_token.hpp"
+#include "decoders/import_decoder.hpp"
 #include "image/image.hpp"
 #include "image/image_buffer.hpp"
 
 namespace puerhlab {
+/**
+ * @brief Construct a ThumbnailDecoder which populates the thumbnail store after decoding
+ *
+ * @param store
+ * @param fingerprint fingerprint of the file to be decoded
+ */
+ThumbnailDecoder::ThumbnailDecoder(std::shared_ptr<ThumbnailStore> store,
+                                   ThumbnailFingerprint            fingerprint)
+    : _store(std::move(store)), _fingerprint(fingerprint) {}
+
 /**
  * @brief A callback used to decode the thumbnail of a regular file
  *
@@ -62,9 +75,12 @@ void ThumbnailDecoder::Decode(std::vector<char> buffer, std::filesystem::path fi
   try {
     // Push the decoded image into the buffer queue
     std::shared_ptr<Image> img = std::make_shared<Image>(id, file_path, ImageType::DEFAULT);
-    img->_exif_data = Exiv2::ImageFactory::open((Exiv2::byte*)buffer.data(), buffer.size());
-    img->_exif_data->readMetadata();
-    img->_has_exif = !img->_exif_data->exifData().empty();
+    // The Exiv2 image is dropped right away, only the compact record is kept
+    auto metadata = ImageMetadata::FromBuffer(buffer.data(), buffer.size());
+    img->_has_exif = metadata.has_value();
+    if (metadata.has_value()) {
+      img->_metadata = *metadata;
+    }
 
     img->LoadThumbnail({std::move(thumbnail)});
     result->push(img);
@@ -74,17 +90,40 @@ void ThumbnailDecoder::Decode(std::vector<char> buffer, std::filesystem::path fi
   }
 }
 
+/**
+ * @brief A callback used to load the thumbnail of source_img, from the embedded preview of raw
+ * files or from a reduced decode of regular files
+ *
+ * @param buffer
+ * @param source_img
+ * @param result
+ * @param promise
+ */
 void ThumbnailDecoder::Decode(std::vector<char> buffer, std::shared_ptr<Image> source_img,
                               std::shared_ptr<BufferQueue>              result,
                               std::shared_ptr<std::promise<image_id_t>> promise) {
-  // Open the datastream as a cv::Mat image
-  cv::Mat image_data((int)buffer.size(), 1, CV_32FC1, buffer.data());
-  // Using IMREAD_REDUCED_COLOR_8 flag to get the low-res thumbnail image
-  cv::Mat thumbnail = cv::imdecode(image_data, cv::IMREAD_COLOR);
+  cv::Mat thumbnail = ImportDecoder::DecodeThumbnail(buffer);
+  if (thumbnail.empty()) {
+    promise->set_exception(
+        std::make_exception_ptr(std::runtime_error("ThumbnailDecoder: Unable to decode")));
+    return;
+  }
+  // Stored even when the request went stale meanwhile, the decoding is already paid for
+  if (_store && _fingerprint.has_value()) {
+    try {
+      _store->Put(source_img->_image_id, *_fingerprint, thumbnail);
+    } catch (const std::exception&) {
+      // The store is only a cache, a failed write must not fail the decoding
+    }
+  }
+  if (_token.IsCancelled()) {
+    promise->set_exception(std::make_exception_ptr(OperationCancelled()));
+    return;
+  }
   thumbnail.convertTo(thumbnail, CV_32FC3, 1.0 / 255.0);
   ImageBuffer thumbnail_data{std::move(thumbnail)};
   source_img->LoadThumbnail(std::move(thumbnail_data));
-  result->push(source_img);
+  if (result) result->push(source_img);
   promise->set_value(source_img->_image_id);
 }
 };  // namespace puerhlab
\ No newline at end of file
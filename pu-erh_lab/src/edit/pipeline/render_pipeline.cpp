@@ -0,0 +1,74 @@
+/*
+ * @file        pu-erh_lab/src/edit/pipeline/render_pipeline.cpp
+ * @brief       Coroutine render pipeline applying a chain of operators on render threads
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "edit/pipeline/render_pipeline.hpp"
+
+#include <cstddef>
+#include <utility>
+
+namespace puerhlab {
+/**
+ * @brief Construct a new RenderPipeline object
+ *
+ * @param pool runs the renders, the CPU pool of the shared executor by default
+ */
+RenderPipeline::RenderPipeline(ThreadPool& pool) : _pool(pool) {}
+
+/**
+ * @brief Append a stage, it receives the output of the previous one
+ *
+ * @param stage
+ */
+void RenderPipeline::AddStage(Stage stage) { _stages.push_back(std::move(stage)); }
+
+auto RenderPipeline::StageCount() const -> size_t { return _stages.size(); }
+
+/**
+ * @brief Run every stage over input on a render thread
+ *
+ * @param input
+ * @param priority HIGH for what is on screen, LOW for exports
+ * @param token checked before each stage, e.g. cancelled when a slider moves again. A cancelled
+ * render throws OperationCancelled and releases its buffers right away.
+ * @return Task<ImageBuffer> the rendered image, the awaiting coroutine is resumed on the render
+ * thread. An exception thrown by a stage is rethrown to it.
+ */
+auto RenderPipeline::Render(ImageBuffer input, TaskPriority priority, CancellationToken token)
+    -> Task<ImageBuffer> {
+  token.ThrowIfCancelled();
+  co_await _pool.Schedule(priority);
+  ImageBuffer output = std::move(input);
+  for (auto& stage : _stages) {
+    token.ThrowIfCancelled();
+    output = stage(output);
+  }
+  co_return output;
+}
+};  // namespace puerhlab
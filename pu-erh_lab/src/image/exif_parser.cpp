@@ -0,0 +1,426 @@
+/*
+ * @file        pu-erh_lab/src/image/exif_parser.cpp
+ * @brief       An allocation-free EXIF reader for the indexed metadata fields
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "image/exif_parser.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string_view>
+
+#include "image/metadata.hpp"
+
+namespace puerhlab {
+namespace {
+enum TiffType : uint16_t {
+  BYTE      = 1,
+  ASCII     = 2,
+  SHORT     = 3,
+  LONG      = 4,
+  RATIONAL  = 5,
+  UNDEFINED = 7,
+  SLONG     = 9,
+  SRATIONAL = 10,
+  // A LONG holding the offset of a sub-IFD, e.g. the EXIF IFD pointer written by some cameras
+  IFD       = 13
+};
+
+enum TiffTag : uint16_t {
+  IMAGE_WIDTH         = 0x0100,
+  IMAGE_LENGTH        = 0x0101,
+  MAKE                = 0x010F,
+  MODEL               = 0x0110,
+  ORIENTATION         = 0x0112,
+  SUB_IFDS            = 0x014A,
+  EXPOSURE_TIME       = 0x829A,
+  F_NUMBER            = 0x829D,
+  EXIF_IFD            = 0x8769,
+  ISO_SPEED           = 0x8827,
+  DATE_TIME_ORIGINAL  = 0x9003,
+  FOCAL_LENGTH        = 0x920A,
+  PIXEL_X_DIMENSION   = 0xA002,
+  PIXEL_Y_DIMENSION   = 0xA003,
+  LENS_MODEL          = 0xA434,
+  DNG_VERSION         = 0xC612
+};
+
+auto TypeSize(uint16_t type) -> uint32_t {
+  switch (type) {
+    case BYTE:
+    case ASCII:
+    case UNDEFINED:
+      return 1;
+    case SHORT:
+      return 2;
+    case LONG:
+    case SLONG:
+    case IFD:
+      return 4;
+    case RATIONAL:
+    case SRATIONAL:
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+/**
+ * @brief Bounds-checked view over a TIFF structure, offsets are relative to the TIFF header
+ */
+struct TiffView {
+  const uint8_t* _data;
+  size_t         _size;
+  bool           _little_endian;
+
+  auto           Has(uint64_t offset, uint64_t length) const -> bool {
+    return offset <= _size && length <= _size - offset;
+  }
+
+  auto U16(size_t offset) const -> uint16_t {
+    const uint8_t* p = _data + offset;
+    return _little_endian ? static_cast<uint16_t>(p[0] | p[1] << 8)
+                          : static_cast<uint16_t>(p[0] << 8 | p[1]);
+  }
+
+  auto U32(size_t offset) const -> uint32_t {
+    const uint8_t* p = _data + offset;
+    return _little_endian ? static_cast<uint32_t>(p[0] | p[1] << 8 | p[2] << 16 | p[3] << 24)
+                          : static_cast<uint32_t>(p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3]);
+  }
+};
+
+struct IfdEntry {
+  uint16_t _tag;
+  uint16_t _type;
+  uint32_t _count;
+  // Where the value lives, inline in the entry when it fits in four bytes
+  size_t   _value_offset;
+
+  auto     UInt(const TiffView& tiff, uint32_t index = 0) const -> uint32_t {
+    if (index >= _count) {
+      return 0;
+    }
+    if (_type == SHORT) {
+      return tiff.U16(_value_offset + index * 2);
+    }
+    if (_type == LONG || _type == IFD) {
+      return tiff.U32(_value_offset + index * 4);
+    }
+    return 0;
+  }
+
+  auto Real(const TiffView& tiff) const -> float {
+    if (_type != RATIONAL && _type != SRATIONAL) {
+      return static_cast<float>(UInt(tiff));
+    }
+    uint32_t num = tiff.U32(_value_offset);
+    uint32_t den = tiff.U32(_value_offset + 4);
+    if (den == 0) {
+      return 0.0f;
+    }
+    if (_type == SRATIONAL) {
+      return static_cast<float>(static_cast<int32_t>(num)) /
+             static_cast<float>(static_cast<int32_t>(den));
+    }
+    return static_cast<float>(num) / static_cast<float>(den);
+  }
+
+  auto Text(const TiffView& tiff) const -> std::string_view {
+    if (_type != ASCII) {
+      return {};
+    }
+    const char* text = reinterpret_cast<const char*>(tiff._data + _value_offset);
+    return {text, strnlen(text, _count)};
+  }
+};
+
+/**
+ * @brief Visit every well-formed entry of the IFD at offset
+ *
+ * @return false if the IFD itself lies outside of the data
+ */
+template <typename Visitor>
+auto WalkIfd(const TiffView& tiff, uint32_t offset, Visitor&& visit) -> bool {
+  if (!tiff.Has(offset, 2)) {
+    return false;
+  }
+  uint16_t count = tiff.U16(offset);
+  if (count > ExifParser::_max_ifd_entries || !tiff.Has(offset + 2, count * 12ull)) {
+    return false;
+  }
+  for (uint16_t i = 0; i < count; ++i) {
+    size_t   entry_offset = offset + 2 + i * 12ull;
+    IfdEntry entry{tiff.U16(entry_offset), tiff.U16(entry_offset + 2),
+                   tiff.U32(entry_offset + 4), entry_offset + 8};
+    uint64_t length = static_cast<uint64_t>(TypeSize(entry._type)) * entry._count;
+    if (length == 0) {
+      continue;
+    }
+    if (length > 4) {
+      entry._value_offset = tiff.U32(entry_offset + 8);
+    }
+    // Entries pointing outside of the data are skipped rather than failing the whole file
+    if (tiff.Has(entry._value_offset, length)) {
+      visit(entry);
+    }
+  }
+  return true;
+}
+
+auto BigEndian16(const uint8_t* p) -> uint16_t { return static_cast<uint16_t>(p[0] << 8 | p[1]); }
+};  // namespace
+
+/**
+ * @brief Parse the indexed metadata fields of an in-memory file
+ *
+ * @param data
+ * @param size
+ * @return std::optional<ImageMetadata> std::nullopt if the container is not supported or carries
+ * no EXIF, the caller should then fall back to Exiv2
+ */
+auto ExifParser::Parse(const char* data, size_t size) -> std::optional<ImageMetadata> {
+  const auto* bytes = reinterpret_cast<const uint8_t*>(data);
+  if (size >= 2 && bytes[0] == 0xFF && bytes[1] == 0xD8) {
+    return ParseJpeg(bytes, size);
+  }
+  return ParseTiff(bytes, size);
+}
+
+/**
+ * @brief Parse a TIFF structure, either a whole TIFF based file or the payload of an EXIF segment
+ *
+ * @param data pointer to the TIFF header
+ * @param size
+ * @return std::optional<ImageMetadata> std::nullopt if the structure is not supported or carries
+ * no EXIF tag
+ */
+auto ExifParser::ParseTiff(const uint8_t* data, size_t size) -> std::optional<ImageMetadata> {
+  if (size < 8) {
+    return std::nullopt;
+  }
+  TiffView tiff{data, size, false};
+  if (data[0] == 'I' && data[1] == 'I') {
+    tiff._little_endian = true;
+  } else if (data[0] != 'M' || data[1] != 'M') {
+    return std::nullopt;
+  }
+  // Variants with another magic number, e.g. ORF or RW2, are left to Exiv2
+  if (tiff.U16(2) != 42) {
+    return std::nullopt;
+  }
+
+  ImageMetadata metadata;
+  // Set once a tag of the EXIF IFD or a camera tag of IFD0 was read
+  bool          has_exif    = false;
+  uint32_t      exif_offset = 0;
+  uint32_t      sub_ifds[_max_sub_ifds];
+  uint32_t      sub_ifd_count = 0;
+  uint32_t      ifd_width     = 0;
+  uint32_t      ifd_height    = 0;
+  // Raw files keep the sensor data in a sub-IFD and a preview in IFD0, the largest image wins
+  auto          visit_dimensions = [&](const IfdEntry& entry) {
+    if (entry._tag == IMAGE_WIDTH) {
+      ifd_width = entry.UInt(tiff);
+    } else if (entry._tag == IMAGE_LENGTH) {
+      ifd_height = entry.UInt(tiff);
+    }
+  };
+  auto keep_largest = [&] {
+    if (static_cast<uint64_t>(ifd_width) * ifd_height >
+        static_cast<uint64_t>(metadata._width) * metadata._height) {
+      metadata._width  = ifd_width;
+      metadata._height = ifd_height;
+    }
+    ifd_width  = 0;
+    ifd_height = 0;
+  };
+
+  bool ifd0_ok = WalkIfd(tiff, tiff.U32(4), [&](const IfdEntry& entry) {
+    switch (entry._tag) {
+      case MAKE:
+        ImageMetadata::CopyField(metadata._make, entry.Text(tiff));
+        has_exif = true;
+        break;
+      case MODEL:
+        ImageMetadata::CopyField(metadata._model, entry.Text(tiff));
+        has_exif = true;
+        break;
+      case ORIENTATION:
+        metadata._orientation = static_cast<uint16_t>(entry.UInt(tiff));
+        break;
+      case EXIF_IFD:
+        exif_offset = entry.UInt(tiff);
+        break;
+      case SUB_IFDS:
+        for (uint32_t i = 0; i < entry._count && sub_ifd_count < _max_sub_ifds; ++i) {
+          sub_ifds[sub_ifd_count++] = entry.UInt(tiff, i);
+        }
+        break;
+      default:
+        visit_dimensions(entry);
+    }
+  });
+  if (!ifd0_ok) {
+    return std::nullopt;
+  }
+  keep_largest();
+  for (uint32_t i = 0; i < sub_ifd_count; ++i) {
+    WalkIfd(tiff, sub_ifds[i], visit_dimensions);
+    keep_largest();
+  }
+
+  uint32_t pixel_x = 0;
+  uint32_t pixel_y = 0;
+  if (exif_offset != 0) {
+    WalkIfd(tiff, exif_offset, [&](const IfdEntry& entry) {
+      has_exif = true;
+      switch (entry._tag) {
+        case EXPOSURE_TIME:
+          metadata._exposure_time = entry.Real(tiff);
+          break;
+        case F_NUMBER:
+          metadata._aperture = entry.Real(tiff);
+          break;
+        case ISO_SPEED:
+          metadata._iso = entry.UInt(tiff);
+          break;
+        case DATE_TIME_ORIGINAL:
+          metadata._capture_time = ImageMetadata::ParseCaptureTime(entry.Text(tiff));
+          break;
+        case FOCAL_LENGTH:
+          metadata._focal_length = entry.Real(tiff);
+          break;
+        case LENS_MODEL:
+          ImageMetadata::CopyField(metadata._lens, entry.Text(tiff));
+          break;
+        case PIXEL_X_DIMENSION:
+          pixel_x = entry.UInt(tiff);
+          break;
+        case PIXEL_Y_DIMENSION:
+          pixel_y = entry.UInt(tiff);
+          break;
+        default:
+          break;
+      }
+    });
+  }
+  // The IFDs of a plain TIFF only describe its pixels
+  if (!has_exif) {
+    return std::nullopt;
+  }
+  if ((metadata._width == 0 || metadata._height == 0) && pixel_x != 0 && pixel_y != 0) {
+    metadata._width  = pixel_x;
+    metadata._height = pixel_y;
+  }
+  if (metadata._orientation < 1 || metadata._orientation > 8) {
+    metadata._orientation = 1;
+  }
+  return metadata;
+}
+
+/**
+ * @brief Check whether a TIFF structure is a DNG file, which IFD0 marks with a DNGVersion tag
+ *
+ * @param data pointer to the TIFF header
+ * @param size
+ * @return true
+ * @return false
+ */
+auto ExifParser::IsDng(const uint8_t* data, size_t size) -> bool {
+  if (size < 8 || (data[0] != 'I' && data[0] != 'M') || data[0] != data[1]) {
+    return false;
+  }
+  TiffView tiff{data, size, data[0] == 'I'};
+  bool     dng = false;
+  WalkIfd(tiff, tiff.U32(4), [&](const IfdEntry& entry) { dng |= entry._tag == DNG_VERSION; });
+  return dng;
+}
+
+/**
+ * @brief Parse the EXIF segment of a JPEG file, the dimensions come from the frame header
+ *
+ * @param data
+ * @param size
+ * @return std::optional<ImageMetadata> std::nullopt if there is no EXIF segment
+ */
+auto ExifParser::ParseJpeg(const uint8_t* data, size_t size) -> std::optional<ImageMetadata> {
+  static constexpr uint8_t exif_header[] = {'E', 'x', 'i', 'f', 0, 0};
+
+  std::optional<ImageMetadata> metadata;
+  uint32_t                     frame_width  = 0;
+  uint32_t                     frame_height = 0;
+  size_t                       pos          = 2;
+  while (pos + 4 <= size) {
+    if (data[pos] != 0xFF) {
+      return std::nullopt;
+    }
+    uint8_t marker = data[pos + 1];
+    if (marker == 0xFF) {
+      // Fill byte
+      ++pos;
+      continue;
+    }
+    if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) {
+      pos += 2;
+      continue;
+    }
+    uint16_t length = BigEndian16(data + pos + 2);
+    if (length < 2 || pos + 2 + length > size) {
+      break;
+    }
+    const uint8_t* segment      = data + pos + 4;
+    size_t         segment_size = length - 2;
+
+    if (marker == 0xE1 && !metadata.has_value() && segment_size > sizeof(exif_header) &&
+        std::memcmp(segment, exif_header, sizeof(exif_header)) == 0) {
+      metadata = ParseTiff(segment + sizeof(exif_header), segment_size - sizeof(exif_header));
+    }
+    // SOF0 to SOF15, except DHT, JPG and DAC
+    bool is_frame = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 &&
+                    marker != 0xCC;
+    if (is_frame && segment_size >= 5) {
+      frame_height = BigEndian16(segment + 1);
+      frame_width  = BigEndian16(segment + 3);
+    }
+    // Start of scan, no more headers follow
+    if (marker == 0xDA || is_frame) {
+      break;
+    }
+    pos += 2 + length;
+  }
+
+  if (metadata.has_value() && frame_width != 0 && frame_height != 0) {
+    metadata->_width  = frame_width;
+    metadata->_height = frame_height;
+  }
+  return metadata;
+}
+};  // namespace puerhlab
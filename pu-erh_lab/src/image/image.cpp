@@ -33,13 +33,16 @@
 #include <easy/profiler.h>
 
 #include <cstdint>
+#include <cstring>
 #include <exception>
 #include <exiv2/exif.hpp>
 #include <exiv2/tags.hpp>
 #include <json.hpp>
 #include <string>
 #include <utility>
-#include <xxhash.hpp>
+
+#include "image/exif_parser.hpp"
+#include "type/supported_file_type.hpp"
 
 namespace puerhlab {
 struct ExifLite {
@@ -49,6 +52,99 @@ struct ExifLite {
 };
 
 using json = nlohmann::json;
+
+/**
+ * @brief Detect the format of a file from its content rather than from its extension
+ *
+ * @param data the beginning of the file, a few kilobytes are enough for most files
+ * @param size
+ * @return ImageType DEFAULT if the format is not recognized
+ */
+auto SniffImageType(const char* data, size_t size) -> ImageType {
+  const auto* bytes = reinterpret_cast<const uint8_t*>(data);
+  if (size >= 3 && bytes[0] == 0xFF && bytes[1] == 0xD8 && bytes[2] == 0xFF) {
+    return ImageType::JPEG;
+  }
+  if (size >= 8 && std::memcmp(bytes, "\x89PNG\r\n\x1a\n", 8) == 0) {
+    return ImageType::PNG;
+  }
+  // ISO base media file with a Canon brand
+  if (size >= 12 && std::memcmp(bytes + 4, "ftypcrx ", 8) == 0) {
+    return ImageType::CR3;
+  }
+  if (size >= 15 && std::memcmp(bytes, "FUJIFILMCCD-RAW", 15) == 0) {
+    return ImageType::RAF;
+  }
+  // Olympus and Panasonic replace the TIFF magic number with their own
+  if (size >= 8 && (std::memcmp(bytes, "IIRO", 4) == 0 || std::memcmp(bytes, "IIRS", 4) == 0 ||
+                    std::memcmp(bytes, "MMOR", 4) == 0)) {
+    return ImageType::ORF;
+  }
+  if (size >= 8 && std::memcmp(bytes, "IIU\0", 4) == 0) {
+    return ImageType::RW2;
+  }
+  bool little_tiff = size >= 8 && std::memcmp(bytes, "II*\0", 4) == 0;
+  bool big_tiff    = size >= 8 && std::memcmp(bytes, "MM\0*", 4) == 0;
+  if (!little_tiff && !big_tiff) {
+    return ImageType::DEFAULT;
+  }
+  if (little_tiff && size >= 10 && bytes[8] == 'C' && bytes[9] == 'R') {
+    return ImageType::CR2;
+  }
+  if (ExifParser::IsDng(bytes, size)) {
+    return ImageType::DNG;
+  }
+  // The other TIFF based raws only differ by their maker
+  if (auto metadata = ExifParser::ParseTiff(bytes, size); metadata.has_value()) {
+    auto make = metadata->Make();
+    if (make.starts_with("NIKON")) {
+      return ImageType::NEF;
+    }
+    if (make.starts_with("SONY")) {
+      return ImageType::ARW;
+    }
+    if (make.starts_with("PENTAX") || make.starts_with("RICOH IMAGING")) {
+      return ImageType::PEF;
+    }
+  }
+  return ImageType::TIFF;
+}
+
+/**
+ * @brief Detect the format of a file from its content, falling back to its extension for the raw
+ * formats the content sniffing does not know, so that they still go to LibRaw
+ *
+ * @param data the beginning of the file
+ * @param size
+ * @param path the file the data was read from
+ * @return ImageType OTHER_RAW for an unrecognized file with a raw extension
+ */
+auto DetectImageType(const char* data, size_t size, const image_path_t& path) -> ImageType {
+  auto type = SniffImageType(data, size);
+  if ((type == ImageType::DEFAULT || type == ImageType::TIFF) && is_raw_file(path)) {
+    return ImageType::OTHER_RAW;
+  }
+  return type;
+}
+
+auto IsRawType(ImageType type) -> bool {
+  switch (type) {
+    case ImageType::ARW:
+    case ImageType::CR2:
+    case ImageType::CR3:
+    case ImageType::NEF:
+    case ImageType::DNG:
+    case ImageType::ORF:
+    case ImageType::RAF:
+    case ImageType::RW2:
+    case ImageType::PEF:
+    case ImageType::OTHER_RAW:
+      return true;
+    default:
+      return false;
+  }
+}
+
 /**
  * @brief Construct a new Image object
  *
@@ -72,10 +168,12 @@ Image::Image(image_path_t image_path, ImageType image_type)
 Image::Image(Image&& other)
     : _image_id(other._image_id),
       _image_path(std::move(other._image_path)),
-      _exif_data(std::move(other._exif_data)),
+      _sidecar_path(std::move(other._sidecar_path)),
+      _metadata(other._metadata),
       _image_data(std::move(other._image_data)),
       _thumbnail(std::move(other._thumbnail)),
-      _image_type(other._image_type) {}
+      _image_type(other._image_type),
+      _content_hash(other._content_hash) {}
 
 std::wostream& operator<<(std::wostream& os, const Image& img) {
   os << "img_id: " << img._image_id << "\timage_path: " << img._image_path.wstring()
@@ -109,48 +207,62 @@ void Image::ClearThumbnail() {
 }
 
 auto Image::ExifToJson() const -> std::string {
-  // If the image has exif json, return it directly
-  if (_has_exif_json) {
-    return nlohmann::to_string(_exif_json);
-  }
-
-  json o;
-  // Temporary remove the support for reading exif
   if (!_has_exif) {
-    return nlohmann::to_string(o);
-  }
-  try {
-    auto                          exif_data = _exif_data->exifData();
-    // Suggestion from ChatGPT to improve performance
-    std::vector<Exiv2::Exifdatum> local;
-    for (const auto& entry : exif_data) {
-      local.emplace_back(entry);
-    }
-    for (auto& data : local) {
-      auto type_id    = static_cast<uint32_t>(data.typeId());  // debug
-      auto type       = data.ifdName();
-      auto type_value = data.value().toUint32();  // debug
-      // o[type]         = std::array<std::string, 2>{std::to_string(type_id), type_value};
-      o[type]         = std::pair<uint32_t, uint32_t>{type_id, type_value};
-    }
-
-  } catch (std::exception& e) {
-    std::cerr << e.what() << std::endl;
+    return nlohmann::to_string(json::object());
   }
-
-  return nlohmann::to_string(o);
+  return nlohmann::to_string(_metadata.ToJson());
 }
 
 void Image::JsonToExif(std::string json_str) {
   try {
-    _exif_json     = nlohmann::json::parse(json_str);
-    _has_exif_json = true;
+    auto metadata_json = nlohmann::json::parse(json_str);
+    _metadata          = ImageMetadata::FromJson(metadata_json);
+    // Records of older versions may carry none of the known fields
+    _has_exif          = !_metadata.IsEmpty();
   } catch (nlohmann::json::parse_error& e) {
     throw std::exception("Image: JSON parse error");
   }
 }
 
-void Image::ComputeChecksum() { _checksum = xxh::xxhash<64>(this, sizeof(*this)); }
+/**
+ * @brief Hash the content of the file, for images which did not go through an import
+ *
+ * @return true
+ * @return false the file cannot be read
+ */
+auto Image::ComputeChecksum() -> bool {
+  auto hash = ContentHash::FromFile(_image_path);
+  if (!hash.has_value()) {
+    return false;
+  }
+  _content_hash = *hash;
+  return true;
+}
+
+/**
+ * @brief Read the complete EXIF of the image file again. Only the compact metadata record is kept
+ * in memory, so this touches the disk on every call.
+ *
+ * @return Exiv2::ExifData empty if the file has no readable metadata
+ */
+auto Image::ReadFullExif() const -> Exiv2::ExifData {
+  try {
+    auto exif_image = Exiv2::ImageFactory::open(_image_path.string());
+    exif_image->readMetadata();
+    return exif_image->exifData();
+  } catch (std::exception& e) {
+    return {};
+  }
+}
+
+/**
+ * @brief Estimate the memory held by this image, used to bound the buffers of decoded images
+ *
+ * @return size_t
+ */
+auto Image::EstimateBytes() const -> size_t {
+  return sizeof(Image) + _image_data.ByteSize() + _thumbnail.ByteSize();
+}
 
 auto Image::GetImageData() -> cv::Mat& { return _image_data.GetCPUData(); }
 
@@ -39,6 +39,13 @@ auto ImageBuffer::GetCPUData() -> cv::Mat& {
   return _cpu_data;
 }
 
+/**
+ * @brief Return the number of bytes held by the CPU copy of the image
+ *
+ * @return size_t
+ */
+auto ImageBuffer::ByteSize() const -> size_t { return _cpu_data.total() * _cpu_data.elemSize(); }
+
 void ImageBuffer::ReleaseCPUData() { _cpu_data.release(); }
 
 void ImageBuffer::ReleaseGPUData() { _gpu_data.release(); }
@@ -0,0 +1,244 @@
+/*
+ * @file        pu-erh_lab/src/image/metadata.cpp
+ * @brief       A compact metadata record kept for every image
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "image/metadata.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <exiv2/exif.hpp>
+#include <exiv2/image.hpp>
+#include <exiv2/tags.hpp>
+#include <json.hpp>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "image/exif_parser.hpp"
+
+namespace puerhlab {
+namespace {
+template <size_t N>
+auto FieldView(const char (&field)[N]) -> std::string_view {
+  return {field, strnlen(field, N)};
+}
+
+auto ParseDigits(std::string_view text, size_t pos, size_t len, int& value) -> bool {
+  value = 0;
+  for (size_t i = pos; i < pos + len; ++i) {
+    if (text[i] < '0' || text[i] > '9') {
+      return false;
+    }
+    value = value * 10 + (text[i] - '0');
+  }
+  return true;
+}
+
+auto FindKey(const Exiv2::ExifData& exif, const char* key) -> Exiv2::ExifData::const_iterator {
+  return exif.findKey(Exiv2::ExifKey(key));
+}
+};  // namespace
+
+/**
+ * @brief Parse the metadata of an in-memory file. The common containers go through the built-in
+ * ExifParser, anything it declines is parsed by Exiv2, whose image only lives for the duration of
+ * this call.
+ *
+ * @param data
+ * @param size
+ * @return std::optional<ImageMetadata> std::nullopt if the file carries no EXIF
+ */
+auto ImageMetadata::FromBuffer(const char* data, size_t size) -> std::optional<ImageMetadata> {
+  if (auto metadata = ExifParser::Parse(data, size); metadata.has_value()) {
+    return metadata;
+  }
+  auto exif_image =
+      Exiv2::ImageFactory::open(reinterpret_cast<const Exiv2::byte*>(data), size);
+  exif_image->readMetadata();
+  const auto& exif = exif_image->exifData();
+  if (exif.empty()) {
+    return std::nullopt;
+  }
+  auto metadata = FromExif(exif, static_cast<uint32_t>(exif_image->pixelWidth()),
+                           static_cast<uint32_t>(exif_image->pixelHeight()));
+  // Exiv2 also lists the tags of a plain TIFF, which only describe its pixels
+  if (!metadata.HasCameraFields()) {
+    return std::nullopt;
+  }
+  return metadata;
+}
+
+/**
+ * @brief Extract the record from parsed EXIF, missing tags keep their default value
+ *
+ * @param exif
+ * @param width pixel width reported by the container
+ * @param height pixel height reported by the container
+ * @return ImageMetadata
+ */
+auto ImageMetadata::FromExif(const Exiv2::ExifData& exif, uint32_t width, uint32_t height)
+    -> ImageMetadata {
+  ImageMetadata metadata;
+  metadata._width  = width;
+  metadata._height = height;
+
+  if (auto it = FindKey(exif, "Exif.Image.Make"); it != exif.end()) {
+    CopyField(metadata._make, it->toString());
+  }
+  if (auto it = FindKey(exif, "Exif.Image.Model"); it != exif.end()) {
+    CopyField(metadata._model, it->toString());
+  }
+  if (auto it = FindKey(exif, "Exif.Photo.LensModel"); it != exif.end()) {
+    CopyField(metadata._lens, it->toString());
+  }
+  if (auto it = FindKey(exif, "Exif.Photo.FNumber"); it != exif.end()) {
+    metadata._aperture = it->toFloat();
+  }
+  if (auto it = FindKey(exif, "Exif.Photo.FocalLength"); it != exif.end()) {
+    metadata._focal_length = it->toFloat();
+  }
+  if (auto it = FindKey(exif, "Exif.Photo.ExposureTime"); it != exif.end()) {
+    metadata._exposure_time = it->toFloat();
+  }
+  if (auto it = FindKey(exif, "Exif.Photo.ISOSpeedRatings"); it != exif.end()) {
+    metadata._iso = it->toUint32();
+  }
+  if (auto it = FindKey(exif, "Exif.Photo.DateTimeOriginal"); it != exif.end()) {
+    metadata._capture_time = ParseCaptureTime(it->toString());
+  }
+  if (auto it = FindKey(exif, "Exif.Image.Orientation"); it != exif.end()) {
+    metadata._orientation = static_cast<uint16_t>(it->toUint32());
+  }
+  if (metadata._width == 0 || metadata._height == 0) {
+    auto x = FindKey(exif, "Exif.Photo.PixelXDimension");
+    auto y = FindKey(exif, "Exif.Photo.PixelYDimension");
+    if (x != exif.end() && y != exif.end()) {
+      metadata._width  = x->toUint32();
+      metadata._height = y->toUint32();
+    }
+  }
+  return metadata;
+}
+
+/**
+ * @brief Parse an EXIF date, e.g. "2025:03:20 14:02:51"
+ *
+ * @param date_time
+ * @return int64_t seconds since the epoch, 0 if the date is malformed
+ */
+auto ImageMetadata::ParseCaptureTime(std::string_view date_time) -> int64_t {
+  // "YYYY:MM:DD HH:MM:SS", some writers use other separators
+  int year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0;
+  if (date_time.size() < 19 || !ParseDigits(date_time, 0, 4, year) ||
+      !ParseDigits(date_time, 5, 2, month) || !ParseDigits(date_time, 8, 2, day) ||
+      !ParseDigits(date_time, 11, 2, hour) || !ParseDigits(date_time, 14, 2, minute) ||
+      !ParseDigits(date_time, 17, 2, second)) {
+    return 0;
+  }
+  std::chrono::year_month_day date{std::chrono::year{year},
+                                   std::chrono::month{static_cast<unsigned>(month)},
+                                   std::chrono::day{static_cast<unsigned>(day)}};
+  if (!date.ok()) {
+    return 0;
+  }
+  auto days = std::chrono::sys_days{date}.time_since_epoch();
+  return std::chrono::duration_cast<std::chrono::seconds>(days).count() + hour * 3600 +
+         minute * 60 + second;
+}
+
+auto ImageMetadata::Make() const -> std::string_view { return FieldView(_make); }
+
+auto ImageMetadata::Model() const -> std::string_view { return FieldView(_model); }
+
+auto ImageMetadata::Lens() const -> std::string_view { return FieldView(_lens); }
+
+/**
+ * @brief Whether a field describing the camera or the shot is set, the pixel size and the
+ * orientation do not count
+ *
+ * @return true
+ * @return false
+ */
+auto ImageMetadata::HasCameraFields() const -> bool {
+  return !Make().empty() || !Model().empty() || !Lens().empty() || _aperture != 0.0f ||
+         _focal_length != 0.0f || _exposure_time != 0.0f || _iso != 0 || _capture_time != 0;
+}
+
+/**
+ * @brief Whether every field still holds its default value, e.g. the record of a file without
+ * EXIF or one restored from JSON carrying none of the known fields
+ *
+ * @return true
+ * @return false
+ */
+auto ImageMetadata::IsEmpty() const -> bool {
+  return !HasCameraFields() && _width == 0 && _height == 0 && _orientation == 1;
+}
+
+auto ImageMetadata::ToJson() const -> nlohmann::json {
+  return {{"make", Make()},
+          {"model", Model()},
+          {"lens", Lens()},
+          {"aperture", _aperture},
+          {"focal_length", _focal_length},
+          {"exposure_time", _exposure_time},
+          {"iso", _iso},
+          {"capture_time", _capture_time},
+          {"width", _width},
+          {"height", _height},
+          {"orientation", _orientation}};
+}
+
+/**
+ * @brief Restore a record saved by ToJson(), missing fields keep their default value
+ *
+ * @param metadata_json
+ * @return ImageMetadata
+ */
+auto ImageMetadata::FromJson(const nlohmann::json& metadata_json) -> ImageMetadata {
+  ImageMetadata metadata;
+  if (!metadata_json.is_object()) {
+    return metadata;
+  }
+  CopyField(metadata._make, metadata_json.value("make", std::string{}));
+  CopyField(metadata._model, metadata_json.value("model", std::string{}));
+  CopyField(metadata._lens, metadata_json.value("lens", std::string{}));
+  metadata._aperture      = metadata_json.value("aperture", 0.0f);
+  metadata._focal_length  = metadata_json.value("focal_length", 0.0f);
+  metadata._exposure_time = metadata_json.value("exposure_time", 0.0f);
+  metadata._iso           = metadata_json.value("iso", uint32_t{0});
+  metadata._capture_time  = metadata_json.value("capture_time", int64_t{0});
+  metadata._width         = metadata_json.value("width", uint32_t{0});
+  metadata._height        = metadata_json.value("height", uint32_t{0});
+  metadata._orientation   = metadata_json.value("orientation", uint16_t{1});
+  return metadata;
+}
+};  // namespace puerhlab
@@ -0,0 +1,116 @@
+/*
+ * @file        pu-erh_lab/src/image/sidecar.cpp
+ * @brief       Detection of RAW+JPEG pairs shot together
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "image/sidecar.hpp"
+
+#include <algorithm>
+#include <cwctype>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <system_error>
+
+#include "type/supported_file_type.hpp"
+
+namespace puerhlab {
+namespace {
+const wchar_t* const kJpegExtensions[] = {L".jpg", L".jpeg"};
+
+auto LowerExtension(const image_path_t& path) -> std::wstring {
+  std::wstring ext = path.extension().wstring();
+  std::transform(ext.begin(), ext.end(), ext.begin(),
+                 [](wchar_t c) { return static_cast<wchar_t>(std::towlower(c)); });
+  return ext;
+}
+
+template <size_t N>
+auto Contains(const wchar_t* const (&extensions)[N], const std::wstring& ext) -> bool {
+  return std::find(std::begin(extensions), std::end(extensions), ext) != std::end(extensions);
+}
+
+auto ToUpper(std::wstring ext) -> std::wstring {
+  std::transform(ext.begin(), ext.end(), ext.begin(),
+                 [](wchar_t c) { return static_cast<wchar_t>(std::towupper(c)); });
+  return ext;
+}
+
+/**
+ * @brief Find a regular file next to path with the same stem and one of the extensions, in lower
+ * or upper case as cameras write either
+ */
+template <typename Extensions>
+auto FindSibling(const image_path_t& path, const Extensions& extensions)
+    -> std::optional<image_path_t> {
+  image_path_t    sibling = path;
+  std::error_code ec;
+  for (const std::wstring ext : extensions) {
+    for (const auto& candidate_ext : {std::wstring(ext), ToUpper(ext)}) {
+      sibling.replace_extension(candidate_ext);
+      if (std::filesystem::is_regular_file(sibling, ec)) {
+        return sibling;
+      }
+    }
+  }
+  return std::nullopt;
+}
+};  // namespace
+
+auto Sidecar::IsRawFile(const image_path_t& path) -> bool {
+  return is_raw_file(path);
+}
+
+auto Sidecar::IsJpegFile(const image_path_t& path) -> bool {
+  return Contains(kJpegExtensions, LowerExtension(path));
+}
+
+/**
+ * @brief Find the JPEG shot together with a raw file
+ *
+ * @param raw_path
+ * @return std::optional<image_path_t> std::nullopt if the raw file was shot alone
+ */
+auto Sidecar::FindJpeg(const image_path_t& raw_path) -> std::optional<image_path_t> {
+  if (!IsRawFile(raw_path)) {
+    return std::nullopt;
+  }
+  return FindSibling(raw_path, kJpegExtensions);
+}
+
+/**
+ * @brief Whether a JPEG is the sidecar of a raw file, such a JPEG is not imported on its own
+ *
+ * @param jpeg_path
+ * @return true
+ * @return false
+ */
+auto Sidecar::HasRawSibling(const image_path_t& jpeg_path) -> bool {
+  return IsJpegFile(jpeg_path) && FindSibling(jpeg_path, raw_extensions).has_value();
+}
+};  // namespace puerhlab
@@ -0,0 +1,138 @@
+/*
+ * @file        pu-erh_lab/src/include/concurrency/cancellation_token.hpp
+ * @brief       A lightweight token used to cancel scheduled work
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <utility>
+
+namespace puerhlab {
+/**
+ * @brief Thrown by work which noticed that its token was cancelled
+ */
+class OperationCancelled : public std::runtime_error {
+ public:
+  explicit OperationCancelled(const std::string& what = "Operation cancelled.")
+      : std::runtime_error(what) {}
+};
+
+/**
+ * @brief Keeps a callback registered with a token, the callback is unregistered when the
+ * registration is destroyed. Destruction waits for the callback if it is running on another
+ * thread, so the callback must not wait for the thread destroying its registration.
+ */
+class CancellationRegistration {
+ private:
+  using Callback = std::stop_callback<std::function<void()>>;
+
+  std::unique_ptr<Callback> _callback;
+
+ public:
+  CancellationRegistration() = default;
+  explicit CancellationRegistration(std::unique_ptr<Callback> callback)
+      : _callback(std::move(callback)) {}
+
+  void Reset() { _callback.reset(); }
+};
+
+/**
+ * @brief A copyable handle to a shared cancellation state. A default-constructed token can never
+ * be cancelled, so APIs can take one by value without forcing callers to create it.
+ *
+ * Tokens form a tree with CreateLinked(): cancelling a token cancels every token linked to it,
+ * e.g. closing a view cancels all of its loads while a single load can still be dropped alone.
+ */
+class CancellationToken {
+ private:
+  std::stop_source      _source{std::nostopstate};
+  // Set for linked tokens, keeps them registered with their parent while any copy is alive
+  std::shared_ptr<void> _parent_link;
+
+  explicit CancellationToken(std::stop_source source) : _source(std::move(source)) {}
+
+ public:
+  CancellationToken() = default;
+
+  /**
+   * @brief Create a token that can be cancelled through any of its copies
+   *
+   * @return CancellationToken
+   */
+  static auto Create() -> CancellationToken { return CancellationToken{std::stop_source{}}; }
+
+  /**
+   * @brief Create a token cancelled together with parent, or on its own
+   *
+   * @param parent a token that cannot be cancelled gives a plain new token
+   * @return CancellationToken
+   */
+  static auto CreateLinked(const CancellationToken& parent) -> CancellationToken {
+    auto child = Create();
+    if (parent.CanBeCancelled()) {
+      child._parent_link = std::make_shared<std::stop_callback<std::function<void()>>>(
+          parent._source.get_token(),
+          [source = child._source]() mutable { source.request_stop(); });
+    }
+    return child;
+  }
+
+  void Cancel() { _source.request_stop(); }
+
+  auto IsCancelled() const -> bool { return _source.stop_requested(); }
+
+  auto CanBeCancelled() const -> bool { return _source.stop_possible(); }
+
+  /**
+   * @brief Throw OperationCancelled if the token was cancelled, meant to be called between the
+   * stages of long work so that it stops and releases its buffers early
+   */
+  void ThrowIfCancelled() const {
+    if (IsCancelled()) throw OperationCancelled();
+  }
+
+  /**
+   * @brief Run callback when the token is cancelled, on the thread calling Cancel(). It runs
+   * right away if the token is already cancelled, and never if the token cannot be cancelled.
+   *
+   * @param callback
+   * @return CancellationRegistration the callback stays registered while it is alive
+   */
+  auto OnCancel(std::function<void()> callback) const -> CancellationRegistration {
+    if (!CanBeCancelled()) return {};
+    return CancellationRegistration{std::make_unique<std::stop_callback<std::function<void()>>>(
+        _source.get_token(), std::move(callback))};
+  }
+};
+};  // namespace puerhlab
@@ -0,0 +1,72 @@
+/*
+ * @file        pu-erh_lab/src/include/concurrency/cpu_topology.hpp
+ * @brief       CPU cache domains and NUMA nodes read from sysfs
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+#include <vector>
+
+namespace puerhlab {
+/**
+ * @brief Logical CPUs sharing a last-level cache, all on the same NUMA node
+ */
+struct CpuDomain {
+  uint32_t              _node = 0;
+  std::vector<uint32_t> _cpus;
+};
+
+/**
+ * @brief Layout of the logical CPUs into cache domains and NUMA nodes, read from sysfs. When
+ * sysfs cannot be read (other platforms, containers) every CPU is placed in one domain.
+ *
+ */
+class CpuTopology {
+ private:
+  std::vector<CpuDomain> _domains;
+  size_t                 _node_count = 1;
+
+ public:
+  static auto Discover(const std::filesystem::path& sysfs_root = "/sys/devices/system")
+      -> CpuTopology;
+  static auto Uniform(size_t cpu_count) -> CpuTopology;
+  static auto FromDomains(std::vector<CpuDomain> domains) -> CpuTopology;
+
+  auto        Domains() const -> const std::vector<CpuDomain>&;
+  auto        NodeCount() const -> size_t;
+  auto        CpuCount() const -> size_t;
+  auto        IsNuma() const -> bool;
+};
+
+auto ParseCpuList(std::string_view list) -> std::vector<uint32_t>;
+auto PinCurrentThread(const std::vector<uint32_t>& cpus) -> bool;
+};  // namespace puerhlab
@@ -0,0 +1,148 @@
+/*
+ * @file        pu-erh_lab/src/include/concurrency/executor.hpp
+ * @brief       Process-wide CPU and I/O thread pools
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "concurrency/cpu_topology.hpp"
+#include "concurrency/thread_pool.hpp"
+
+namespace puerhlab {
+/**
+ * @brief Process-wide thread pools shared by the loaders, decoders and render pipelines. CPU
+ * bound work runs on a pool sized to the hardware threads, blocking file reads run on a separate
+ * pool so that a slow disk does not leave decode threads idle.
+ *
+ */
+class Executor {
+ public:
+  Executor(size_t cpu_threads, size_t io_threads, const CpuTopology& topology = {});
+  Executor(const Executor&)                    = delete;
+  auto operator=(const Executor&) -> Executor& = delete;
+
+  static auto Instance() -> Executor&;
+  static auto DefaultCpuThreads() -> size_t;
+  static auto DefaultIoThreads() -> size_t;
+
+  auto        Cpu() -> ThreadPool&;
+  auto        Io() -> ThreadPool&;
+
+ private:
+  ThreadPool _cpu;
+  ThreadPool _io;
+};
+
+/**
+ * @brief Counts the tasks an object has posted to a shared pool, so that it can wait for them
+ * before it is destroyed. Tasks may post further tasks to the same group.
+ *
+ */
+class TaskGroup {
+ public:
+  explicit TaskGroup(ThreadPool& pool) : _pool(pool) {}
+  TaskGroup(const TaskGroup&)                    = delete;
+  auto operator=(const TaskGroup&) -> TaskGroup& = delete;
+  ~TaskGroup() { Wait(); }
+
+  /**
+   * @brief Queue a task on the group's pool, an exception escaping the task terminates the
+   * program
+   *
+   * @param task
+   * @param priority
+   */
+  template <typename F>
+  void Post(F&& task, TaskPriority priority = TaskPriority::NORMAL) {
+    Begin(1);
+    _pool.Post(
+        [this, task = std::forward<F>(task)]() mutable {
+          task();
+          End();
+        },
+        priority);
+  }
+
+  /**
+   * @brief Queue a batch of tasks under a single lock of the pool
+   *
+   * @param tasks
+   * @param priority
+   */
+  void PostBatch(std::vector<ThreadPool::Task>&& tasks,
+                 TaskPriority                    priority = TaskPriority::NORMAL) {
+    std::vector<ThreadPool::Task> tracked;
+    tracked.reserve(tasks.size());
+    for (auto& task : tasks) {
+      tracked.emplace_back([this, task = std::move(task)]() mutable {
+        task();
+        End();
+      });
+    }
+    Begin(tracked.size());
+    _pool.SubmitBatch(std::move(tracked), priority);
+  }
+
+  /**
+   * @brief Block until every task of the group has returned. Must not be called from one of
+   * them.
+   *
+   */
+  void Wait() {
+    std::unique_lock<std::mutex> lock(_mtx);
+    _idle.wait(lock, [this] { return _in_flight == 0; });
+  }
+
+  auto Pool() -> ThreadPool& { return _pool; }
+
+ private:
+  ThreadPool&             _pool;
+  std::mutex              _mtx;
+  std::condition_variable _idle;
+  size_t                  _in_flight = 0;
+
+  void Begin(size_t count) {
+    std::lock_guard<std::mutex> lock(_mtx);
+    _in_flight += count;
+  }
+
+  void End() {
+    // Notified under the lock, a waiter may destroy the group as soon as it reacquires it
+    std::lock_guard<std::mutex> lock(_mtx);
+    if (--_in_flight == 0) {
+      _idle.notify_all();
+    }
+  }
+};
+};  // namespace puerhlab
@@ -0,0 +1,335 @@
+/*
+ * @file        pu-erh_lab/src/include/concurrency/stage_pipeline.hpp
+ * @brief       Staged processing pipeline on the shared executor
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "concurrency/executor.hpp"
+#include "concurrency/thread_pool.hpp"
+
+namespace puerhlab {
+struct StageOptions {
+  std::string  _name;
+  // Items the stage processes at once
+  size_t       _parallelism    = 1;
+  // Items waiting for the stage, the previous stage holds its items back once it is full
+  size_t       _queue_capacity = 64;
+  // Hand items to the next stage in the order the stage received them
+  bool         _ordered        = false;
+  // nullptr for the CPU pool of the shared executor
+  ThreadPool*  _pool           = nullptr;
+  TaskPriority _priority       = TaskPriority::NORMAL;
+};
+
+struct StageMetrics {
+  std::string              _name;
+  uint64_t                 _processed  = 0;
+  // Items the stage function did not pass on
+  uint64_t                 _dropped    = 0;
+  // Time spent in the stage function, summed over all items
+  std::chrono::nanoseconds _busy       = {};
+  // Time items spent in the stage's queue, summed over all items
+  std::chrono::nanoseconds _waiting    = {};
+  size_t                   _peak_queue = 0;
+};
+
+/**
+ * @brief A chain of stages an item flows through, e.g. read -> decode -> process -> consume.
+ * Each stage runs its function on a thread pool with a bounded parallelism and takes its input
+ * from a bounded queue. A stage only starts an item when the next queue has room for it, so a
+ * slow stage holds back the ones before it without blocking any pool thread.
+ *
+ * @tparam T moved from stage to stage
+ */
+template <typename T>
+class StagePipeline {
+ public:
+  using Clock   = std::chrono::steady_clock;
+  // Returns false when the item leaves the pipeline at this stage, e.g. it was served from a
+  // cache or failed. An exception escaping the function terminates the program.
+  using StageFn = std::function<bool(T&)>;
+
+  StagePipeline() = default;
+  StagePipeline(const StagePipeline&)                    = delete;
+  auto operator=(const StagePipeline&) -> StagePipeline& = delete;
+  ~StagePipeline() { WaitIdle(); }
+
+  /**
+   * @brief Append a stage, stages must all be added before the first item is pushed
+   *
+   * @param options
+   * @param fn
+   * @return StagePipeline& to chain the calls
+   */
+  auto AddStage(StageOptions options, StageFn fn) -> StagePipeline& {
+    std::lock_guard<std::mutex> lock(_mtx);
+    if (_items > 0) {
+      throw std::runtime_error("Stages cannot be added to a running pipeline.");
+    }
+    options._parallelism    = std::max<size_t>(options._parallelism, 1);
+    options._queue_capacity = std::max<size_t>(options._queue_capacity, 1);
+    if (options._pool == nullptr) {
+      options._pool = &Executor::Instance().Cpu();
+    }
+    auto& stage          = _stages.emplace_back();
+    stage._metrics._name = options._name;
+    stage._options       = std::move(options);
+    stage._fn            = std::move(fn);
+    return *this;
+  }
+
+  /**
+   * @brief Feed an item to the first stage, blocks while its queue is full. Must not be called
+   * from a stage function.
+   *
+   * @param item
+   */
+  void Push(T item) {
+    std::unique_lock<std::mutex> lock(_mtx);
+    _room.wait(lock, [this] { return HasRoom(); });
+    Admit(std::move(item));
+  }
+
+  /**
+   * @brief Feed an item to the first stage if its queue has room
+   *
+   * @param item moved from only on success
+   * @return true the item was accepted
+   */
+  auto TryPush(T& item) -> bool {
+    std::lock_guard<std::mutex> lock(_mtx);
+    if (!HasRoom()) {
+      return false;
+    }
+    Admit(std::move(item));
+    return true;
+  }
+
+  /**
+   * @brief Block until every item pushed so far has left the pipeline
+   *
+   */
+  void WaitIdle() {
+    std::unique_lock<std::mutex> lock(_mtx);
+    _idle.wait(lock, [this] { return _items == 0; });
+  }
+
+  /**
+   * @brief Number of items queued, running or waiting to be handed on in order
+   *
+   * @return size_t
+   */
+  auto InFlight() -> size_t {
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _items;
+  }
+
+  auto StageCount() -> size_t {
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _stages.size();
+  }
+
+  /**
+   * @brief Snapshot of the metrics of every stage, in stage order
+   *
+   * @return std::vector<StageMetrics>
+   */
+  auto Metrics() -> std::vector<StageMetrics> {
+    std::lock_guard<std::mutex> lock(_mtx);
+    std::vector<StageMetrics>   metrics;
+    metrics.reserve(_stages.size());
+    for (const auto& stage : _stages) {
+      metrics.push_back(stage._metrics);
+    }
+    return metrics;
+  }
+
+ private:
+  struct Entry {
+    T                 _item;
+    // Arrival order at the stage, ordered stages hand items on in this order
+    uint64_t          _sequence;
+    Clock::time_point _queued_at;
+  };
+
+  struct Stage {
+    StageOptions                         _options;
+    StageFn                              _fn;
+    std::deque<Entry>                    _queue;
+    size_t                               _running       = 0;
+    uint64_t                             _next_sequence = 0;
+    // Ordered stages only: the next item to hand on, and the finished items waiting for it.
+    // Dropped items are kept as std::nullopt until their turn.
+    uint64_t                             _next_out      = 0;
+    std::map<uint64_t, std::optional<T>> _finished;
+    StageMetrics                         _metrics;
+  };
+
+  std::mutex              _mtx;
+  // Notified when the first queue has room again
+  std::condition_variable _room;
+  std::condition_variable _idle;
+  // A deque so that a running stage is never moved
+  std::deque<Stage>       _stages;
+  // Items pushed which have not left the pipeline yet
+  size_t                  _items = 0;
+
+  auto HasRoom() const -> bool {
+    return _stages.empty() ||
+           _stages.front()._queue.size() < _stages.front()._options._queue_capacity;
+  }
+
+  void Admit(T&& item) {
+    ++_items;
+    if (_stages.empty()) {
+      Leave();
+      return;
+    }
+    Enqueue(0, std::move(item));
+    Pump();
+  }
+
+  void Enqueue(size_t index, T&& item) {
+    auto& stage = _stages[index];
+    stage._queue.push_back({std::move(item), stage._next_sequence++, Clock::now()});
+    stage._metrics._peak_queue = std::max(stage._metrics._peak_queue, stage._queue.size());
+  }
+
+  /**
+   * @brief Whether a stage may start one more item. Its running and finished items are counted
+   * against the next queue, so a handed-on item always finds room.
+   *
+   */
+  auto CanStart(size_t index) const -> bool {
+    const auto& stage = _stages[index];
+    if (stage._queue.empty() || stage._running >= stage._options._parallelism) {
+      return false;
+    }
+    if (index + 1 == _stages.size()) {
+      return true;
+    }
+    const auto& next = _stages[index + 1];
+    return next._queue.size() + stage._running + stage._finished.size() <
+           next._options._queue_capacity;
+  }
+
+  /**
+   * @brief Start every item that may run, from the last stage back so that freed room is used
+   * first where it was freed. Called with the lock held.
+   *
+   */
+  void Pump() {
+    for (size_t index = _stages.size(); index-- > 0;) {
+      while (CanStart(index)) {
+        auto& stage = _stages[index];
+        Entry entry = std::move(stage._queue.front());
+        stage._queue.pop_front();
+        ++stage._running;
+        stage._metrics._waiting += Clock::now() - entry._queued_at;
+        stage._options._pool->Post(
+            [this, index, entry = std::move(entry)]() mutable { Run(index, std::move(entry)); },
+            stage._options._priority);
+        if (index == 0) {
+          _room.notify_one();
+        }
+      }
+    }
+  }
+
+  void Run(size_t index, Entry&& entry) {
+    auto& stage = _stages[index];
+    auto  start = Clock::now();
+    bool  keep  = stage._fn(entry._item);
+    auto  busy  = Clock::now() - start;
+
+    std::lock_guard<std::mutex> lock(_mtx);
+    --stage._running;
+    ++stage._metrics._processed;
+    stage._metrics._busy += busy;
+    if (!keep) {
+      ++stage._metrics._dropped;
+    }
+    if (!stage._options._ordered) {
+      if (keep) {
+        HandOn(index, std::move(entry._item));
+      } else {
+        Leave();
+      }
+    } else {
+      if (keep) {
+        stage._finished.emplace(entry._sequence, std::move(entry._item));
+      } else {
+        stage._finished.emplace(entry._sequence, std::nullopt);
+      }
+      auto it = stage._finished.begin();
+      while (it != stage._finished.end() && it->first == stage._next_out) {
+        if (it->second.has_value()) {
+          HandOn(index, std::move(*it->second));
+        } else {
+          Leave();
+        }
+        it = stage._finished.erase(it);
+        ++stage._next_out;
+      }
+    }
+    // Still under the lock, a waiter notified of the last item may destroy the pipeline as soon
+    // as it is released
+    Pump();
+  }
+
+  void HandOn(size_t index, T&& item) {
+    if (index + 1 == _stages.size()) {
+      Leave();
+      return;
+    }
+    Enqueue(index + 1, std::move(item));
+  }
+
+  void Leave() {
+    if (--_items == 0) {
+      _idle.notify_all();
+    }
+  }
+};
+};  // namespace puerhlab
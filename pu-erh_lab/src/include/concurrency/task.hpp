@@ -0,0 +1,316 @@
+/*
+ * @file        pu-erh_lab/src/include/concurrency/task.hpp
+ * @brief       Lazily started coroutine task with symmetric transfer, SyncWait and WhenAll
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace puerhlab {
+template <typename T = void>
+class Task;
+
+/**
+ * @brief State shared by the promises of all Task<T>. A task starts suspended. When it
+ * finishes, it resumes the coroutine awaiting it only if that coroutine has already suspended.
+ * A task which finishes synchronously returns to its awaiter instead, so a loop of co_await
+ * does not grow the stack even in builds where the compiler does not emit tail calls.
+ */
+class TaskPromiseBase {
+ public:
+  struct FinalAwaiter {
+    auto await_ready() const noexcept -> bool { return false; }
+
+    template <typename Promise>
+    void await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+      auto& promise = handle.promise();
+      if (promise._handoff.exchange(true, std::memory_order_acq_rel)) {
+        promise._continuation.resume();
+      }
+    }
+
+    void await_resume() const noexcept {}
+  };
+
+  auto initial_suspend() const noexcept -> std::suspend_always { return {}; }
+  auto final_suspend() const noexcept -> FinalAwaiter { return {}; }
+  void unhandled_exception() noexcept { _exception = std::current_exception(); }
+
+  std::coroutine_handle<> _continuation;
+  std::exception_ptr      _exception;
+  // Set by whichever of the task's completion and its awaiter's suspension happens first, the
+  // second one then knows the other side is done
+  std::atomic<bool>       _handoff = false;
+};
+
+template <typename T>
+class TaskPromise : public TaskPromiseBase {
+ public:
+  auto get_return_object() noexcept -> Task<T>;
+
+  template <typename U>
+    requires std::convertible_to<U&&, T>
+  void return_value(U&& value) {
+    _value.emplace(std::forward<U>(value));
+  }
+
+  auto Result() -> T {
+    if (_exception) std::rethrow_exception(_exception);
+    return std::move(*_value);
+  }
+
+ private:
+  std::optional<T> _value;
+};
+
+template <>
+class TaskPromise<void> : public TaskPromiseBase {
+ public:
+  auto get_return_object() noexcept -> Task<void>;
+
+  void return_void() const noexcept {}
+
+  void Result() const {
+    if (_exception) std::rethrow_exception(_exception);
+  }
+};
+
+/**
+ * @brief A lazily started coroutine producing a T. The body runs when the task is awaited, on
+ * the awaiting thread, until it suspends on something asynchronous such as
+ * ThreadPool::Schedule() or an image load; whoever completes that resumes it. A task can be
+ * awaited once.
+ *
+ * @tparam T
+ */
+template <typename T>
+class [[nodiscard]] Task {
+ public:
+  using promise_type = TaskPromise<T>;
+  using Handle       = std::coroutine_handle<promise_type>;
+
+  Task() = default;
+  explicit Task(Handle handle) : _handle(handle) {}
+  Task(Task&& other) noexcept : _handle(std::exchange(other._handle, {})) {}
+  Task& operator=(Task&& other) noexcept {
+    if (this != &other) {
+      if (_handle) _handle.destroy();
+      _handle = std::exchange(other._handle, {});
+    }
+    return *this;
+  }
+  Task(const Task&)            = delete;
+  Task& operator=(const Task&) = delete;
+  ~Task() {
+    if (_handle) _handle.destroy();
+  }
+
+  auto operator co_await() noexcept {
+    struct Awaiter {
+      Handle _handle;
+
+      auto   await_ready() const noexcept -> bool { return _handle.done(); }
+      auto   await_suspend(std::coroutine_handle<> awaiting) -> bool {
+        _handle.promise()._continuation = awaiting;
+        _handle.resume();
+        // The task may have finished synchronously, the awaiter then goes on without suspending
+        return !_handle.promise()._handoff.exchange(true, std::memory_order_acq_rel);
+      }
+      auto await_resume() -> T { return _handle.promise().Result(); }
+    };
+    return Awaiter{_handle};
+  }
+
+  auto Valid() const -> bool { return static_cast<bool>(_handle); }
+
+ private:
+  Handle _handle;
+};
+
+template <typename T>
+auto TaskPromise<T>::get_return_object() noexcept -> Task<T> {
+  return Task<T>{std::coroutine_handle<TaskPromise<T>>::from_promise(*this)};
+}
+
+inline auto TaskPromise<void>::get_return_object() noexcept -> Task<void> {
+  return Task<void>{std::coroutine_handle<TaskPromise<void>>::from_promise(*this)};
+}
+
+/**
+ * @brief An eagerly started coroutine which frees itself when done, used to drive a Task from
+ * non-coroutine code. Exceptions must not escape it.
+ */
+struct DetachedTask {
+  struct promise_type {
+    auto get_return_object() const noexcept -> DetachedTask { return {}; }
+    auto initial_suspend() const noexcept -> std::suspend_never { return {}; }
+    auto final_suspend() const noexcept -> std::suspend_never { return {}; }
+    void return_void() const noexcept {}
+    void unhandled_exception() const noexcept { std::terminate(); }
+  };
+};
+
+/**
+ * @brief Start a task without waiting for it, an exception escaping the task terminates
+ *
+ * @param task
+ */
+inline auto Detach(Task<void> task) -> DetachedTask { co_await task; }
+
+/**
+ * @brief Run a task to completion and block the calling thread until it has finished. Meant for
+ * the boundary between synchronous and coroutine code, never call it from a pool thread the
+ * task needs.
+ *
+ * @param task
+ * @return T the value of the task, its exception is rethrown
+ */
+template <typename T>
+auto SyncWait(Task<T> task) -> T {
+  using Stored = std::conditional_t<std::is_void_v<T>, bool, T>;
+  std::optional<Stored> result;
+  std::exception_ptr    error;
+  std::atomic<bool>     done = false;
+
+  [](Task<T> task, std::optional<Stored>& result, std::exception_ptr& error,
+     std::atomic<bool>& done) -> DetachedTask {
+    try {
+      if constexpr (std::is_void_v<T>) {
+        co_await task;
+      } else {
+        result.emplace(co_await task);
+      }
+    } catch (...) {
+      error = std::current_exception();
+    }
+    done.store(true, std::memory_order_release);
+    done.notify_one();
+  }(std::move(task), result, error, done);
+
+  done.wait(false, std::memory_order_acquire);
+  if (error) std::rethrow_exception(error);
+  if constexpr (!std::is_void_v<T>) return std::move(*result);
+}
+
+/**
+ * @brief Bookkeeping of a WhenAll, lives in the frame of the awaiting coroutine
+ */
+template <typename T>
+struct WhenAllState {
+  using Slot = std::conditional_t<std::is_void_v<T>, bool, std::optional<T>>;
+
+  std::vector<Slot>       _results;
+  // One count per task plus one held by the awaiting coroutine while it launches them
+  std::atomic<size_t>     _remaining;
+  std::coroutine_handle<> _continuation;
+  std::mutex              _error_mtx;
+  std::exception_ptr      _error;
+
+  void                    Arrive() {
+    if (_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) _continuation.resume();
+  }
+};
+
+template <typename T>
+auto RunWhenAllChild(Task<T> task, WhenAllState<T>& state, size_t index) -> DetachedTask {
+  try {
+    if constexpr (std::is_void_v<T>) {
+      co_await task;
+    } else {
+      state._results[index].emplace(co_await task);
+    }
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(state._error_mtx);
+    if (!state._error) state._error = std::current_exception();
+  }
+  state.Arrive();
+}
+
+template <typename T>
+class WhenAllAwaiter {
+ public:
+  WhenAllAwaiter(std::vector<Task<T>>& tasks, WhenAllState<T>& state)
+      : _tasks(tasks), _state(state) {}
+
+  auto await_ready() const noexcept -> bool { return _tasks.empty(); }
+
+  auto await_suspend(std::coroutine_handle<> awaiting) -> bool {
+    _state._continuation = awaiting;
+    for (size_t i = 0; i < _tasks.size(); ++i) {
+      RunWhenAllChild(std::move(_tasks[i]), _state, i);
+    }
+    // Tasks which completed synchronously did not resume us, the last one to arrive does
+    return _state._remaining.fetch_sub(1, std::memory_order_acq_rel) != 1;
+  }
+
+  void await_resume() const noexcept {}
+
+ private:
+  std::vector<Task<T>>& _tasks;
+  WhenAllState<T>&      _state;
+};
+
+/**
+ * @brief Run all tasks concurrently and complete once every one of them has finished. The tasks
+ * are started in order on the awaiting thread, each runs until its first suspension.
+ *
+ * @param tasks
+ * @return Task<std::vector<T>> the results in the order of tasks, the first exception thrown by
+ * a task is rethrown instead
+ */
+template <typename T>
+auto WhenAll(std::vector<Task<T>> tasks) -> Task<std::vector<T>> {
+  WhenAllState<T> state;
+  state._results.resize(tasks.size());
+  state._remaining.store(tasks.size() + 1, std::memory_order_relaxed);
+  co_await WhenAllAwaiter<T>{tasks, state};
+  if (state._error) std::rethrow_exception(state._error);
+
+  std::vector<T> results;
+  results.reserve(state._results.size());
+  for (auto& result : state._results) results.push_back(std::move(*result));
+  co_return results;
+}
+
+inline auto WhenAll(std::vector<Task<void>> tasks) -> Task<void> {
+  WhenAllState<void> state;
+  state._results.resize(tasks.size());
+  state._remaining.store(tasks.size() + 1, std::memory_order_relaxed);
+  co_await WhenAllAwaiter<void>{tasks, state};
+  if (state._error) std::rethrow_exception(state._error);
+}
+};  // namespace puerhlab
@@ -28,37 +28,181 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
-// TODO: Change tasks to MPMS Queue to improve efficiency
-
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
 #include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <functional>
 #include <future>
 #include <memory>
-#include <queue>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
-#include "type/type.hpp"
-#include "utils/queue/queue.hpp"
+#include "concurrency/cpu_topology.hpp"
+#include "concurrency/unique_task.hpp"
 
 #pragma once
 
 namespace puerhlab {
+/**
+ * @brief Priority lanes of the thread pool, every queued HIGH task runs before any NORMAL one
+ */
+enum class TaskPriority : uint8_t { HIGH = 0, NORMAL = 1, LOW = 2 };
+
+constexpr size_t kTaskPriorityCount = 3;
+
+/**
+ * @brief A work-stealing thread pool. Every worker owns a deque per priority lane: tasks
+ * submitted from a worker go to its own deque and are run newest first while their data is still
+ * in cache, idle workers steal the oldest tasks of the others. Tasks submitted from outside the
+ * pool are spread over the workers' inboxes and run in submission order, so submitters and
+ * workers do not serialize on one lock.
+ *
+ * On NUMA machines the workers may be placed: each one is pinned to the CPUs of a cache domain,
+ * steals from its own domain first, and tasks posted to a domain only run there.
+ *
+ */
 class ThreadPool {
  public:
-  ThreadPool(size_t thread_count);
+  using Task = UniqueTask;
+
+  // Times an idle worker looks for work again before going to sleep
+  static constexpr size_t _spin_rounds = 64;
+
+  explicit ThreadPool(size_t thread_count, const CpuTopology& topology = {});
   ~ThreadPool();
 
-  void Submit(std::function<void()> task);
+  /**
+   * @brief Queue a task
+   *
+   * @param task any callable taking no argument, it does not need to be copyable
+   * @param priority
+   * @return std::future of the task's result, an exception thrown by the task is rethrown by
+   * get(). The future may be discarded, it does not block on destruction.
+   */
+  template <typename F>
+  auto Submit(F&& task, TaskPriority priority = TaskPriority::NORMAL)
+      -> std::future<std::invoke_result_t<std::decay_t<F>&>> {
+    using Result = std::invoke_result_t<std::decay_t<F>&>;
+    std::packaged_task<Result()> packaged(std::forward<F>(task));
+    auto                         future = packaged.get_future();
+    Task                         wrapped(std::move(packaged));
+    Enqueue(&wrapped, 1, priority);
+    return future;
+  }
+
+  /**
+   * @brief Queue a task nobody waits for, it saves the shared state of a future. An exception
+   * escaping the task terminates the program.
+   *
+   * @param task
+   * @param priority
+   */
+  template <typename F>
+  void Post(F&& task, TaskPriority priority = TaskPriority::NORMAL) {
+    Task wrapped(std::forward<F>(task));
+    Enqueue(&wrapped, 1, priority);
+  }
+
+  /**
+   * @brief Queue a task only the workers of one domain may run, e.g. because it works on memory
+   * first written there. Same as Post() when the workers are not placed.
+   *
+   * @param domain index into the topology's domains, wraps around
+   * @param task
+   * @param priority
+   */
+  template <typename F>
+  void PostToDomain(size_t domain, F&& task, TaskPriority priority = TaskPriority::NORMAL) {
+    Task wrapped(std::forward<F>(task));
+    EnqueueToDomain(domain, &wrapped, 1, priority);
+  }
+
+  /**
+   * @brief Awaitable returned by Schedule(), resumes the awaiting coroutine on a worker
+   */
+  class ScheduleAwaiter {
+   public:
+    ScheduleAwaiter(ThreadPool& pool, TaskPriority priority) : _pool(pool), _priority(priority) {}
+
+    auto await_ready() const noexcept -> bool { return false; }
+    void await_suspend(std::coroutine_handle<> handle) {
+      _pool.Post([handle] { handle.resume(); }, _priority);
+    }
+    void await_resume() const noexcept {}
+
+   private:
+    ThreadPool&  _pool;
+    TaskPriority _priority;
+  };
+
+  /**
+   * @brief co_await pool.Schedule() moves the rest of a coroutine onto the pool
+   *
+   * @param priority
+   * @return ScheduleAwaiter
+   */
+  auto Schedule(TaskPriority priority = TaskPriority::NORMAL) -> ScheduleAwaiter {
+    return {*this, priority};
+  }
+
+  void SubmitBatch(std::vector<Task>&& tasks, TaskPriority priority = TaskPriority::NORMAL);
+  void ParallelFor(size_t count, const std::function<void(size_t)>& fn,
+                   TaskPriority priority = TaskPriority::HIGH);
+  auto ThreadCount() const -> size_t;
+  auto DomainCount() const -> size_t;
+  auto CurrentDomain() const -> size_t;
 
  private:
-  std::queue<std::function<void()>> tasks;
-  std::mutex                        mtx;
-  std::condition_variable           condition;
-  std::vector<std::thread>          workers;
+  // Aligned so that two workers never contend on the same cache line
+  struct alignas(64) WorkerQueue {
+    std::mutex                                       _mtx;
+    // Tasks submitted by the worker itself, the owner takes the back and thieves the front
+    std::array<std::deque<Task>, kTaskPriorityCount> _local;
+    // Tasks submitted from outside the pool, taken from the front by everyone
+    std::array<std::deque<Task>, kTaskPriorityCount> _inbox;
+    // Tasks posted to the worker's domain, taken from the front by the workers of the domain
+    std::array<std::deque<Task>, kTaskPriorityCount> _affine;
+    // Tasks in all lanes, read without the lock to skip empty queues
+    std::atomic<size_t>                              _size   = 0;
+    size_t                                           _domain = 0;
+  };
+
+  struct alignas(64) Domain {
+    std::vector<size_t>   _workers;
+    std::vector<uint32_t> _cpus;
+    // Tasks posted to the domain and not taken yet, its workers do not sleep while there are any
+    std::atomic<size_t>   _queued      = 0;
+    std::atomic<size_t>   _next_worker = 0;
+  };
 
-  bool                              stop;
+  std::vector<std::unique_ptr<WorkerQueue>> _queues;
+  std::vector<std::unique_ptr<Domain>>      _domains;
+  // Whether the workers are pinned to the CPUs of their domain
+  bool                                      _placed     = false;
+  std::vector<std::thread>                  _workers;
+  // Round-robin cursor for tasks submitted from outside the pool
+  std::atomic<size_t>                       _next_queue = 0;
+  // Tasks any worker may take, idle workers sleep while it and their domain's count are zero
+  std::atomic<size_t>                       _queued     = 0;
+  std::atomic<size_t>                       _sleeping   = 0;
+  std::atomic<bool>                         _stop       = false;
+  std::mutex                                _sleep_mtx;
+  std::condition_variable                   _wake;
 
-  void                              WorkerThread();
+  void                                      Enqueue(Task* tasks, size_t count,
+                                                    TaskPriority priority);
+  void                                      EnqueueToDomain(size_t domain, Task* tasks,
+                                                            size_t count, TaskPriority priority);
+  void                                      Wake(size_t count, bool any_worker);
+  auto                                      HasWork(size_t index) const -> bool;
+  auto                                      TryPop(size_t index, Task& task) -> bool;
+  void                                      WorkerThread(size_t index);
 };
 };  // namespace puerhlab
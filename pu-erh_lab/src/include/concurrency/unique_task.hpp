@@ -0,0 +1,138 @@
+/*
+ * @file        pu-erh_lab/src/include/concurrency/unique_task.hpp
+ * @brief       Move-only task with inline storage for small callables
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace puerhlab {
+/**
+ * @brief A move-only `void()` callable. Callables of up to _inline_size bytes are stored inline,
+ * so submitting a lambda which captures a few pointers or shared pointers does not allocate, and
+ * larger ones are moved to the heap once instead of being copied.
+ *
+ */
+class UniqueTask {
+ public:
+  static constexpr size_t _inline_size = 48;
+
+  UniqueTask() noexcept = default;
+  UniqueTask(std::nullptr_t) noexcept {}
+
+  template <typename F, typename Fn = std::decay_t<F>,
+            typename = std::enable_if_t<!std::is_same_v<Fn, UniqueTask> &&
+                                        std::is_invocable_v<Fn&>>>
+  UniqueTask(F&& callable) {
+    if constexpr (kFitsInline<Fn>) {
+      ::new (static_cast<void*>(_storage)) Fn(std::forward<F>(callable));
+      _ops = &kInlineOps<Fn>;
+    } else {
+      ::new (static_cast<void*>(_storage)) Fn*(new Fn(std::forward<F>(callable)));
+      _ops = &kHeapOps<Fn>;
+    }
+  }
+
+  UniqueTask(UniqueTask&& other) noexcept { MoveFrom(other); }
+
+  auto operator=(UniqueTask&& other) noexcept -> UniqueTask& {
+    if (this != &other) {
+      Reset();
+      MoveFrom(other);
+    }
+    return *this;
+  }
+
+  auto operator=(std::nullptr_t) noexcept -> UniqueTask& {
+    Reset();
+    return *this;
+  }
+
+  UniqueTask(const UniqueTask&)            = delete;
+  UniqueTask& operator=(const UniqueTask&) = delete;
+
+  ~UniqueTask() { Reset(); }
+
+  explicit operator bool() const noexcept { return _ops != nullptr; }
+
+  void     operator()() { _ops->_invoke(_storage); }
+
+ private:
+  struct Ops {
+    void (*_invoke)(void* storage);
+    // Move-constructs into dst and destroys src
+    void (*_relocate)(void* dst, void* src) noexcept;
+    void (*_destroy)(void* storage) noexcept;
+  };
+
+  template <typename Fn>
+  static constexpr bool kFitsInline = sizeof(Fn) <= _inline_size &&
+                                      alignof(Fn) <= alignof(std::max_align_t) &&
+                                      std::is_nothrow_move_constructible_v<Fn>;
+
+  template <typename Fn>
+  static constexpr Ops kInlineOps = {
+      [](void* storage) { (*static_cast<Fn*>(storage))(); },
+      [](void* dst, void* src) noexcept {
+        ::new (dst) Fn(std::move(*static_cast<Fn*>(src)));
+        static_cast<Fn*>(src)->~Fn();
+      },
+      [](void* storage) noexcept { static_cast<Fn*>(storage)->~Fn(); }};
+
+  template <typename Fn>
+  static constexpr Ops kHeapOps = {
+      [](void* storage) { (**static_cast<Fn**>(storage))(); },
+      [](void* dst, void* src) noexcept { ::new (dst) Fn*(*static_cast<Fn**>(src)); },
+      [](void* storage) noexcept { delete *static_cast<Fn**>(storage); }};
+
+  alignas(std::max_align_t) std::byte _storage[_inline_size];
+  const Ops*                          _ops = nullptr;
+
+  void                                MoveFrom(UniqueTask& other) noexcept;
+  void                                Reset() noexcept;
+};
+
+inline void UniqueTask::MoveFrom(UniqueTask& other) noexcept {
+  if (other._ops) {
+    other._ops->_relocate(_storage, other._storage);
+    _ops       = other._ops;
+    other._ops = nullptr;
+  }
+}
+
+inline void UniqueTask::Reset() noexcept {
+  if (_ops) {
+    _ops->_destroy(_storage);
+    _ops = nullptr;
+  }
+}
+};  // namespace puerhlab
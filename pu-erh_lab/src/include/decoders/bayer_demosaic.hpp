@@ -0,0 +1,67 @@
+/*
+ * @file        pu-erh_lab/src/include/decoders/bayer_demosaic.hpp
+ * @brief       Parallel demosaic of Bayer raw data into linear RGB
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include <opencv2/core.hpp>
+
+namespace puerhlab {
+/**
+ * @brief Everything needed to develop a Bayer mosaic, usually taken from LibRaw after unpack()
+ *
+ */
+struct BayerDevelopParams {
+  // LibRaw color index of each site of the 2x2 pattern, 3 stands for the second green
+  uint8_t _pattern[2][2];
+  // Black level of each site of the 2x2 pattern
+  float   _black[2][2];
+  float   _white;
+  // White balance multipliers indexed by LibRaw color index
+  float   _wb[4];
+  // Camera RGB to output RGB, applied after white balance
+  float   _cam_to_out[3][3];
+};
+
+/**
+ * @brief An in-house demosaic used to open raw files for editing without waiting for LibRaw's
+ * single-threaded dcraw_process(). The mosaic is split into bands of rows, each band is
+ * normalized into a small padded tile and interpolated with the gradient-corrected bilinear
+ * filter of Malvar, He and Cutler.
+ *
+ */
+class BayerDemosaic {
+ public:
+  // Number of rows claimed at once by each task developing the mosaic
+  static constexpr int _rows_per_band = 64;
+
+  static auto Develop(const cv::Mat& cfa, const BayerDevelopParams& params) -> cv::Mat;
+};
+};  // namespace puerhlab
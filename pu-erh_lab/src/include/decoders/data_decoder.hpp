@@ -11,6 +11,7 @@ class DataDecoder : public ImageDecoder {
                       std::shared_ptr<BufferQueue> result, image_id_t id,
                       std::shared_ptr<std::promise<image_id_t>> promise) = 0;
 
+  // result is null for awaited requests, the caller already holds source_img
   virtual void Decode(std::vector<char> buffer, std::shared_ptr<Image> source_img,
                       std::shared_ptr<BufferQueue>              result,
                       std::shared_ptr<std::promise<image_id_t>> promise) = 0;
@@ -0,0 +1,112 @@
+/*
+ * @file        pu-erh_lab/src/include/decoders/decoder_registry.hpp
+ * @brief       Decoders selected by sniffed format and capabilities
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+#include "decoders/image_decoder.hpp"
+#include "image/image.hpp"
+#include "storage/thumbnail_store/thumbnail_store.hpp"
+#include "utils/hash/content_hash.hpp"
+#include "utils/profiling/import_profiler.hpp"
+
+namespace puerhlab {
+/**
+ * @brief What a decoder is able to produce, a request is served by a decoder covering all of its
+ * required capabilities
+ */
+enum DecoderCapability : uint32_t {
+  // Reads the metadata without decoding any pixel
+  METADATA_ONLY    = 1u << 0,
+  // Extracts a preview stored inside the file
+  EMBEDDED_PREVIEW = 1u << 1,
+  // Decodes at a reduced resolution, e.g. JPEG DCT scaling
+  SCALED_DECODE    = 1u << 2,
+  // Decodes the full resolution image data
+  FULL_DECODE      = 1u << 3,
+  // Only needs the beginning of the file
+  PARTIAL_READ     = 1u << 4
+};
+
+/**
+ * @brief State of the scheduler a decoder may need when it is created
+ */
+struct DecoderContext {
+  std::shared_ptr<ThumbnailStore>     _thumbnail_store;
+  // Set for THUMB requests which missed the thumbnail store, to write the result back
+  std::optional<ThumbnailFingerprint> _fingerprint;
+  // Content hash computed while reading an IMPORT request, empty otherwise
+  ContentHash                         _content_hash;
+  // Set for IMPORT requests when the import is profiled
+  std::shared_ptr<ImportProfiler>     _import_profiler;
+  // Set when an image is opened for editing, decoders may trade quality for latency
+  bool                                _interactive = false;
+};
+
+using DecoderFactory = std::function<std::shared_ptr<ImageDecoder>(const DecoderContext&)>;
+
+struct DecoderEntry {
+  std::string            _name;
+  // Formats sniffed from the file content, empty to accept every format
+  std::vector<ImageType> _formats;
+  uint32_t               _capabilities;
+  // Relative cost of a decode, the cheapest suitable decoder is selected
+  uint32_t               _cost;
+  DecoderFactory         _factory;
+
+  auto                   Supports(ImageType format) const -> bool;
+  auto                   Provides(uint32_t required) const -> bool;
+};
+
+/**
+ * @brief Decoders known to the scheduler. New fast paths are added by registering an entry, the
+ * scheduler only states what a request needs.
+ *
+ */
+class DecoderRegistry {
+ private:
+  std::vector<DecoderEntry> _entries;
+  std::shared_mutex         _mtx;
+
+ public:
+  DecoderRegistry() = default;
+
+  void Register(DecoderEntry entry);
+  void RegisterBuiltins();
+  auto Select(ImageType format, uint32_t required) -> std::optional<DecoderEntry>;
+};
+};  // namespace puerhlab
@@ -31,36 +31,163 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
 #include <exiv2/exif.hpp>
 #include <exiv2/image.hpp>
+#include <functional>
 #include <future>
 #include <memory>
+#include <mutex>
 #include <opencv2/imgcodecs.hpp>
+#include <optional>
+#include <vector>
 
-#include "concurrency/thread_pool.hpp"
+#include "concurrency/cancellation_token.hpp"
+#include "concurrency/executor.hpp"
+#include "concurrency/stage_pipeline.hpp"
+#include "decoders/decoder_registry.hpp"
 #include "image/image.hpp"
+#include "storage/thumbnail_store/thumbnail_store.hpp"
 #include "type/type.hpp"
+#include "utils/hash/content_hash.hpp"
+#include "utils/io/file_reader.hpp"
+#include "utils/profiling/import_profiler.hpp"
 #include "utils/queue/queue.hpp"
 
 #define MAX_REQUEST_SIZE 64u
 namespace puerhlab {
 
-enum class DecodeType { SLEEVE_LOADING, THUMB, RAW, REGULAR };
+/**
+ * @brief SLEEVE_LOADING and IMPORT create a new image, IMPORT also produces its thumbnail and
+ * checksum from the same read
+ */
+enum class DecodeType { SLEEVE_LOADING, THUMB, RAW, REGULAR, IMPORT };
+
+/**
+ * @brief Priority of a decode request, lower value is served first
+ */
+enum class DecodePriority : uint8_t { VISIBLE = 0, PREFETCH = 1, BACKGROUND = 2 };
+
+struct DecodeRequest {
+  image_id_t                                _id;
+  image_path_t                              _image_path;
+  // Empty for SLEEVE_LOADING and IMPORT requests, which create a new image
+  std::shared_ptr<Image>                    _source_img;
+  DecodeType                                _decode_type;
+  DecodePriority                            _priority;
+  CancellationToken                         _token;
+  std::shared_ptr<std::promise<image_id_t>> _promise;
+  uint64_t                                  _sequence;
+  // Set for THUMB requests which missed the thumbnail store, to write the result back
+  std::optional<ThumbnailFingerprint>       _fingerprint;
+  // Set for IMPORT requests, computed by the file reader while the file is read
+  ContentHash                               _content_hash;
+  // Start of the current stage of a profiled IMPORT request
+  ImportProfiler::Clock::time_point         _stage_start;
+  // Set for awaited requests, runs once the promise is satisfied. Their result is not pushed to
+  // the decoded buffer.
+  std::function<void()>                     _on_complete;
+  // Drops the request from the pending heap as soon as its token is cancelled
+  std::shared_ptr<CancellationRegistration> _cancel_hook;
+};
 
 class DecoderScheduler {
  private:
-  ThreadPool                   _file_read_thread_pool;
-  ThreadPool                   _thread_pool;
-  std::shared_ptr<BufferQueue> _decoded_buffer;
+  struct DecodeJob {
+    DecodeRequest                _request;
+    std::vector<char>            _buffer;
+    // Written by the decoder, nullptr for awaited requests
+    std::shared_ptr<BufferQueue> _decoded;
+  };
+
+  // Hands decoded images to the bounded buffer without blocking a decode thread. Images the
+  // buffer has no room for wait here, in order, until the consumer pops.
+  struct Delivery {
+    std::shared_ptr<BufferQueue>       _buffer;
+    std::deque<std::shared_ptr<Image>> _overflow;
+    std::mutex                         _mtx;
+
+    void                               Deliver(std::shared_ptr<Image> img);
+    void                               Drain();
+  };
+
+  DecoderRegistry                 _registry;
+  // THUMB requests looked up in the thumbnail store before they are read, hits leave here
+  StagePipeline<DecodeRequest>    _lookups;
+  // Files read and waiting for a decoder, then their decoded images for delivery. They count
+  // against the read queue depth until they are decoded, so that reading stops running ahead of
+  // slow decoders.
+  // The lookups are not chained in front: a miss goes to the pending heap and the file reader,
+  // which order the reads by priority.
+  StagePipeline<DecodeJob>        _decodes;
+  std::shared_ptr<BufferQueue>    _decoded_buffer;
+  // Shared with the buffer's space callback, which may outlive the scheduler
+  std::shared_ptr<Delivery>       _delivery;
+  // Persistent thumbnail cache consulted by THUMB requests, optional
+  std::shared_ptr<ThumbnailStore> _thumbnail_store;
+  // Times the stages of IMPORT requests, optional
+  std::shared_ptr<ImportProfiler> _import_profiler;
+
+  // Requests waiting for the file reader, kept as a heap ordered by priority then arrival
+  std::vector<DecodeRequest>      _pending;
+  std::mutex                      _pending_mtx;
+  uint64_t                        _next_sequence   = 0;
+  uint32_t                        _reads_in_flight = 0;
+  bool                            _stopping        = false;
+  std::unique_ptr<FileReader>     _file_reader;
+
+  void                            Enqueue(DecodeRequest&& request);
+  void                            PushPending(DecodeRequest&& request);
+  void                            DropCancelled();
+  void                            Pump();
+  void                            OnReadComplete(DecodeRequest&&     request,
+                                                 std::vector<char>&& buffer,
+                                                 std::exception_ptr  error);
+  void                            ReleaseRead();
+  auto                            LookUpThumbnail(DecodeRequest& request) -> bool;
+  auto                            TryLoadStoredThumbnail(DecodeRequest&              request,
+                                                         const ThumbnailFingerprint& fingerprint)
+      -> bool;
+  auto                            Decode(DecodeJob& job) -> bool;
+  void                            Deliver(const std::shared_ptr<BufferQueue>& decoded);
+  void                            EndStage(DecodeRequest& request, ImportStage stage);
+  void                            Fail(DecodeRequest& request, std::exception_ptr error);
+  auto                            ResultBuffer(const DecodeRequest& request) const
+      -> std::shared_ptr<BufferQueue>;
+  static void                     Notify(DecodeRequest& request);
 
  public:
-  explicit DecoderScheduler(size_t thread_count, std::shared_ptr<BufferQueue> decoded_buffer);
+  explicit DecoderScheduler(size_t fallback_reads, std::shared_ptr<BufferQueue> decoded_buffer,
+                            uint32_t read_queue_depth = FileReader::_default_queue_depth);
+  ~DecoderScheduler();
 
   void ScheduleDecode(image_id_t id, image_path_t image_path,
-                      std::shared_ptr<std::promise<image_id_t>> decode_promise);
+                      std::shared_ptr<std::promise<image_id_t>> decode_promise,
+                      DecodePriority priority = DecodePriority::BACKGROUND,
+                      CancellationToken token = {});
+
+  void ScheduleDecode(image_id_t id, image_path_t image_path, DecodeType decode_type,
+                      std::shared_ptr<std::promise<image_id_t>> decode_promise,
+                      DecodePriority priority = DecodePriority::BACKGROUND,
+                      CancellationToken token = {});
 
   void ScheduleDecode(std::shared_ptr<Image> source_img, DecodeType decode_type,
-                      std::shared_ptr<std::promise<image_id_t>> decode_promise);
+                      std::shared_ptr<std::promise<image_id_t>> decode_promise,
+                      DecodePriority priority = DecodePriority::VISIBLE,
+                      CancellationToken token = {});
+
+  void ScheduleDecode(std::shared_ptr<Image> source_img, DecodeType decode_type,
+                      std::shared_ptr<std::promise<image_id_t>> decode_promise,
+                      std::function<void()> on_complete, DecodePriority priority,
+                      CancellationToken token);
+
+  void SetThumbnailStore(std::shared_ptr<ThumbnailStore> store);
+  void SetImportProfiler(std::shared_ptr<ImportProfiler> profiler);
+  auto Registry() -> DecoderRegistry&;
+  auto PendingCount() -> size_t;
+  auto Metrics() -> std::vector<StageMetrics>;
 };
 
 };  // namespace puerhlab
\ No newline at end of file
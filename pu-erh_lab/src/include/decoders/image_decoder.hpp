@@ -38,6 +38,7 @@
 #include <opencv2/imgcodecs.hpp>
 #include <vector>
 
+#include "concurrency/cancellation_token.hpp"
 #include "image/image.hpp"
 #include "type/type.hpp"
 #include "utils/queue/queue.hpp"
@@ -46,9 +47,15 @@
 namespace puerhlab {
 
 class ImageDecoder {
+ protected:
+  // Token of the request being decoded, checked between the stages of a decode
+  CancellationToken _token;
+
  public:
   virtual void Decode(std::vector<char> buffer, std::filesystem::path file_path,
                       std::shared_ptr<BufferQueue> result, image_id_t id,
                       std::shared_ptr<std::promise<image_id_t>> promise) = 0;
+
+  void SetCancellationToken(CancellationToken token) { _token = std::move(token); }
 };
 };  // namespace puerhlab
\ No newline at end of file
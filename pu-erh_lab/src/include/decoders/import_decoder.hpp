@@ -0,0 +1,71 @@
+/*
+ * @file        pu-erh_lab/src/include/decoders/import_decoder.hpp
+ * @brief       A decoder producing metadata, thumbnail and checksum from one read
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <opencv2/core/mat.hpp>
+#include <vector>
+
+#include "loading_decoder.hpp"
+#include "storage/thumbnail_store/thumbnail_store.hpp"
+#include "type/type.hpp"
+#include "utils/hash/content_hash.hpp"
+#include "utils/profiling/import_profiler.hpp"
+
+namespace puerhlab {
+/**
+ * @brief A decoder used to import a file from a single read: the metadata, the thumbnail and the
+ * content checksum are all produced from the same buffer
+ *
+ */
+class ImportDecoder : public LoadingDecoder {
+ private:
+  // When set, the thumbnail goes to the store rather than staying in the image
+  std::shared_ptr<ThumbnailStore> _store;
+  // Hash computed by the file reader, the buffer is hashed here when it is empty
+  ContentHash                     _content_hash;
+  // Times the metadata and thumbnail stages, optional
+  std::shared_ptr<ImportProfiler> _profiler;
+
+ public:
+  ImportDecoder() = default;
+  explicit ImportDecoder(std::shared_ptr<ThumbnailStore> store, ContentHash content_hash = {},
+                         std::shared_ptr<ImportProfiler> profiler = nullptr);
+
+  void Decode(std::vector<char> buffer, std::filesystem::path file_path,
+              std::shared_ptr<BufferQueue> result, image_id_t id,
+              std::shared_ptr<std::promise<image_id_t>> promise);
+
+  static auto DecodeThumbnail(const std::vector<char>& buffer) -> cv::Mat;
+  static auto DecodeThumbnail(const char* data, size_t size) -> cv::Mat;
+};
+};  // namespace puerhlab
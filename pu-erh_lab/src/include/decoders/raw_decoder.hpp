@@ -32,6 +32,7 @@
 
 #include <libraw/libraw.h>
 
+#include <cstdint>
 #include <memory>
 
 #include "data_decoder.hpp"
@@ -50,9 +51,20 @@ enum class OutputColorSpace : int {
   REC2020     = 8
 };
 
+/**
+ * @brief How a raw file is developed. PREVIEW demosaics Bayer sensors in parallel on all cores,
+ * FULL goes through LibRaw's single-threaded AHD. Non-Bayer sensors always use LibRaw. FULL is
+ * the default, PREVIEW is only chosen when an image is opened for editing.
+ */
+enum class RawQuality : uint8_t { PREVIEW, FULL };
+
 class RawDecoder : public DataDecoder {
+ private:
+  RawQuality _quality;
+
  public:
-  RawDecoder() = default;
+  explicit RawDecoder(RawQuality quality = RawQuality::FULL);
+  auto Quality() const -> RawQuality;
   void Decode(std::vector<char> buffer, std::filesystem::path file_path,
               std::shared_ptr<BufferQueue> result, image_id_t id,
               std::shared_ptr<std::promise<image_id_t>> promise);
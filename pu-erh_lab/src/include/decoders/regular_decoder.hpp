@@ -0,0 +1,59 @@
+/*
+ * @file        pu-erh_lab/src/include/decoders/regular_decoder.hpp
+ * @brief       A decoder used to decode regular files at full or reduced resolution
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <memory>
+
+#include "data_decoder.hpp"
+#include "type/type.hpp"
+
+namespace puerhlab {
+/**
+ * @brief A decoder used to decode regular files, e.g. .jpg, .png, .tif, into linear float RGB
+ * data for editing
+ *
+ */
+class RegularDecoder : public DataDecoder {
+ public:
+  // Number of rows converted by each parallel task
+  static constexpr int _rows_per_band = 64;
+
+  void Decode(std::vector<char> buffer, std::filesystem::path file_path,
+              std::shared_ptr<BufferQueue> result, image_id_t id,
+              std::shared_ptr<std::promise<image_id_t>> promise);
+
+  void Decode(std::vector<char> buffer, std::shared_ptr<Image> source_img,
+              std::shared_ptr<BufferQueue>              result,
+              std::shared_ptr<std::promise<image_id_t>> promise);
+
+  auto Decode(const std::vector<char>& buffer) -> cv::Mat;
+};
+};  // namespace puerhlab
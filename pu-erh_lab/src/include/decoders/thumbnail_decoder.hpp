@@ -31,13 +31,23 @@
 
 #pragma once
 
+#include <memory>
+#include <optional>
+
 #include "data_decoder.hpp"
+#include "storage/thumbnail_store/thumbnail_store.hpp"
 #include "type/type.hpp"
 
 namespace puerhlab {
 class ThumbnailDecoder : public DataDecoder {
+ private:
+  // Decoded thumbnails are written back to the store if it is set
+  std::shared_ptr<ThumbnailStore>     _store;
+  std::optional<ThumbnailFingerprint> _fingerprint;
+
  public:
   ThumbnailDecoder() = default;
+  ThumbnailDecoder(std::shared_ptr<ThumbnailStore> store, ThumbnailFingerprint fingerprint);
 
   void Decode(std::vector<char> buffer, std::filesystem::path file_path,
               std::shared_ptr<BufferQueue> result, image_id_t id,
@@ -0,0 +1,76 @@
+/*
+ * @file        pu-erh_lab/src/include/edit/pipeline/render_pipeline.hpp
+ * @brief       Coroutine render pipeline applying a chain of operators on render threads
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "concurrency/cancellation_token.hpp"
+#include "concurrency/executor.hpp"
+#include "concurrency/task.hpp"
+#include "concurrency/thread_pool.hpp"
+#include "image/image_buffer.hpp"
+
+namespace puerhlab {
+/**
+ * @brief Applies a chain of operators to image buffers on a shared thread pool. Renders are
+ * coroutines, so a caller awaiting many of them (a sleeve view, an export) holds no thread while
+ * they run. The pipeline must outlive the renders it has started.
+ */
+class RenderPipeline {
+ public:
+  using Stage = std::function<ImageBuffer(ImageBuffer&)>;
+
+  explicit RenderPipeline(ThreadPool& pool = Executor::Instance().Cpu());
+
+  /**
+   * @brief Append an operator, any type with Apply(ImageBuffer&) -> ImageBuffer. Stages must not
+   * be changed while renders are running.
+   *
+   * @param op shared with the pipeline, its parameters are read at each render
+   */
+  template <typename Op>
+  void AddOperator(std::shared_ptr<Op> op) {
+    AddStage([op = std::move(op)](ImageBuffer& input) { return op->Apply(input); });
+  }
+
+  void AddStage(Stage stage);
+  auto StageCount() const -> size_t;
+  auto Render(ImageBuffer input, TaskPriority priority = TaskPriority::NORMAL,
+              CancellationToken token = {}) -> Task<ImageBuffer>;
+
+ private:
+  std::vector<Stage> _stages;
+  ThreadPool&        _pool;
+};
+};  // namespace puerhlab
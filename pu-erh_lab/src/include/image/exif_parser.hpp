@@ -0,0 +1,57 @@
+/*
+ * @file        pu-erh_lab/src/include/image/exif_parser.hpp
+ * @brief       An allocation-free EXIF reader for the indexed metadata fields
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "image/metadata.hpp"
+
+namespace puerhlab {
+/**
+ * @brief A minimal EXIF reader for the fields kept in ImageMetadata. It walks the IFDs of TIFF
+ * based files (DNG and most raws) and of the APP1 segment of JPEG files in place, without
+ * allocating. Files it does not understand are left to Exiv2.
+ *
+ */
+class ExifParser {
+ public:
+  // Guards against corrupted entry counts and IFD loops
+  static constexpr uint32_t _max_ifd_entries = 1024;
+  static constexpr uint32_t _max_sub_ifds    = 8;
+
+  static auto Parse(const char* data, size_t size) -> std::optional<ImageMetadata>;
+  static auto ParseTiff(const uint8_t* data, size_t size) -> std::optional<ImageMetadata>;
+  static auto ParseJpeg(const uint8_t* data, size_t size) -> std::optional<ImageMetadata>;
+  static auto IsDng(const uint8_t* data, size_t size) -> bool;
+};
+};  // namespace puerhlab
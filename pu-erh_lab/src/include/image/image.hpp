@@ -42,9 +42,30 @@
 
 #include "image/image_buffer.hpp"
 #include "image/metadata.hpp"
+#include "utils/hash/content_hash.hpp"
 
 namespace puerhlab {
-enum class ImageType { DEFAULT, JPEG, PNG, TIFF, ARW, CR2, CR3, NEF, DNG };
+// New values are appended, the type is persisted as its integer value
+enum class ImageType {
+  DEFAULT,
+  JPEG,
+  PNG,
+  TIFF,
+  ARW,
+  CR2,
+  CR3,
+  NEF,
+  DNG,
+  ORF,
+  RAF,
+  RW2,
+  PEF,
+  OTHER_RAW
+};
+
+auto SniffImageType(const char* data, size_t size) -> ImageType;
+auto DetectImageType(const char* data, size_t size, const image_path_t& path) -> ImageType;
+auto IsRawType(ImageType type) -> bool;
 
 /**
  * @brief Represent a tracked image file
@@ -55,10 +76,11 @@ class Image {
   image_id_t              _image_id;
   image_path_t            _image_path;
   file_name_t             _image_name;
+  // JPEG shot together with a raw file, used for thumbnails. Empty if there is none
+  image_path_t            _sidecar_path;
 
-  Exiv2::Image::UniquePtr _exif_data;
-  nlohmann::json          _exif_json;
-  ExifDisplayMetaData     _exif_display;
+  // Extracted at decode time, the complete EXIF is read from the file on demand
+  ImageMetadata           _metadata;
 
   ImageBuffer             _image_data;
   ImageBuffer             _thumbnail;
@@ -66,14 +88,14 @@ class Image {
 
   std::atomic<bool>       _has_thumbnail;
 
-  p_hash_t                _checksum;
+  // XXH3-128 of the file content
+  ContentHash             _content_hash;
 
   std::atomic<bool>       _has_full_img;
   std::atomic<bool>       _has_thumb;
   std::atomic<bool>       _has_exif;
-  std::atomic<bool>       _has_exif_json;
-  std::atomic<bool>       _has_exif_display;
 
+  // Set through ImagePoolManager::Pin and Unpin, which keep the cache's eviction order in step
   std::atomic<bool>       _thumb_pinned = false;
   std::atomic<bool>       _full_pinned  = false;
 
@@ -94,8 +116,10 @@ class Image {
   void                  SetId(image_id_t image_id);
   void                  ClearData();
   void                  ClearThumbnail();
-  void                  ComputeChecksum();
+  auto                  ComputeChecksum() -> bool;
+  auto                  EstimateBytes() const -> size_t;
   auto                  ExifToJson() const -> std::string;
+  auto                  ReadFullExif() const -> Exiv2::ExifData;
   void                  JsonToExif(std::string json_str);
 };
 };  // namespace puerhlab
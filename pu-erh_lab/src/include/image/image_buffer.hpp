@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <opencv2/core/cuda.hpp>
 #include <opencv2/opencv.hpp>
@@ -32,6 +33,7 @@ class ImageBuffer {
 
   auto         GetCPUData() -> cv::Mat&;
   auto         GetGPUData() -> cv::cuda::GpuMat&;
+  auto         ByteSize() const -> size_t;
 
   void         ReleaseCPUData();
   void         ReleaseGPUData();
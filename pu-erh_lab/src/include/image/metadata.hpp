@@ -1,27 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exiv2/exif.hpp>
 #include <json.hpp>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "type/type.hpp"
 
 namespace puerhlab {
-class ExifDisplayMetaData {
- public:
-  std::string    make           = "";
-  std::string    model          = "";
-
-  // libraw_image_size_t
-  unsigned short height         = 0;
-  unsigned short width          = 0;
-
-  // libraw_lensinfo_t
-  // libraw_makernotes_lens_t
-  std::string    lens           = "";
-  std::string    lens_make      = "";
-  float          aperture       = 0.0f;
-  float          focal          = 0.0f;
-  bool           has_attachment = false;
-
-  ExifDisplayMetaData()         = default;
-  ExifDisplayMetaData(nlohmann::json exif_json);
-
-  void ExtractFromJson(nlohmann::json exif_json);
+/**
+ * @brief The metadata kept in memory for every tracked image. The record has a fixed layout and
+ * owns no heap memory, the complete EXIF is read again from the file when it is needed.
+ *
+ */
+struct ImageMetadata {
+  char     _make[32]      = {};
+  char     _model[32]     = {};
+  char     _lens[64]      = {};
+
+  float    _aperture      = 0.0f;
+  // In millimeters
+  float    _focal_length  = 0.0f;
+  // In seconds
+  float    _exposure_time = 0.0f;
+  uint32_t _iso           = 0;
+  // Seconds since the epoch, the camera clock carries no time zone so it is taken as UTC
+  int64_t  _capture_time  = 0;
+
+  uint32_t _width         = 0;
+  uint32_t _height        = 0;
+  // EXIF orientation, 1 to 8
+  uint16_t _orientation   = 1;
+
+  static auto FromBuffer(const char* data, size_t size) -> std::optional<ImageMetadata>;
+  static auto FromExif(const Exiv2::ExifData& exif, uint32_t width, uint32_t height)
+      -> ImageMetadata;
+  static auto FromJson(const nlohmann::json& metadata_json) -> ImageMetadata;
+  static auto ParseCaptureTime(std::string_view date_time) -> int64_t;
+
+  template <size_t N>
+  static void CopyField(char (&field)[N], std::string_view value);
+
+  auto        Make() const -> std::string_view;
+  auto        Model() const -> std::string_view;
+  auto        Lens() const -> std::string_view;
+  auto        HasCameraFields() const -> bool;
+  auto        IsEmpty() const -> bool;
+  auto        ToJson() const -> nlohmann::json;
 };
-};  // namespace puerhlab
\ No newline at end of file
+static_assert(std::is_trivially_copyable_v<ImageMetadata>,
+              "ImageMetadata must not own heap memory");
+
+/**
+ * @brief Copy a string into a fixed-size field, truncating it if needed
+ *
+ * @param field
+ * @param value
+ */
+template <size_t N>
+void ImageMetadata::CopyField(char (&field)[N], std::string_view value) {
+  // Exif strings are often padded with spaces or NULs
+  auto end = value.find_last_not_of(std::string_view(" \0", 2));
+  value    = end == std::string_view::npos ? std::string_view{} : value.substr(0, end + 1);
+  auto len = std::min(value.size(), N - 1);
+  std::memcpy(field, value.data(), len);
+  field[len] = '\0';
+}
+};  // namespace puerhlab
@@ -0,0 +1,52 @@
+/*
+ * @file        pu-erh_lab/src/include/image/sidecar.hpp
+ * @brief       Detection of RAW+JPEG pairs shot together
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <filesystem>
+#include <optional>
+
+#include "type/type.hpp"
+
+namespace puerhlab {
+/**
+ * @brief RAW+JPEG shots are written by the camera as two files sharing the same stem in the same
+ * directory. The JPEG is linked to the raw file as its sidecar instead of being imported on its
+ * own, it serves the thumbnails while the raw file stays the edit source.
+ *
+ */
+class Sidecar {
+ public:
+  static auto IsRawFile(const image_path_t& path) -> bool;
+  static auto IsJpegFile(const image_path_t& path) -> bool;
+  static auto FindJpeg(const image_path_t& raw_path) -> std::optional<image_path_t>;
+  static auto HasRawSibling(const image_path_t& jpeg_path) -> bool;
+};
+};  // namespace puerhlab
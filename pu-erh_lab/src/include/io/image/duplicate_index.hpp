@@ -0,0 +1,94 @@
+/*
+ * @file        pu-erh_lab/src/include/io/image/duplicate_index.hpp
+ * @brief       Pre-decode detection of files which were already imported
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "image/image.hpp"
+#include "type/type.hpp"
+#include "utils/hash/content_hash.hpp"
+
+namespace puerhlab {
+/**
+ * @brief Cheap identity of a file: its size, its modification time and a hash of its first and
+ * last blocks. Computing it costs a stat and at most two block reads, whatever the size of the
+ * file.
+ *
+ */
+struct QuickSignature {
+  uint64_t                _file_size     = 0;
+  int64_t                 _modified_time = 0;
+  // XXH3-64 of the first and last blocks, seeded with the file size
+  uint64_t                _partial_hash  = 0;
+
+  static constexpr size_t _block_size    = 64 << 10;
+
+  static auto             FromFile(const image_path_t& path) -> std::optional<QuickSignature>;
+
+  auto                    operator==(const QuickSignature& other) const -> bool = default;
+};
+
+/**
+ * @brief Index of the files already imported, consulted before a file is scheduled for decoding
+ * so that re-importing a card or an overlapping folder skips the known files.
+ *
+ * A file whose size, partial hash and modification time all match a known image is a duplicate.
+ * If only the modification time differs, e.g. the file was copied off the card, the full content
+ * hash settles it.
+ *
+ */
+class DuplicateIndex {
+ private:
+  struct Entry {
+    uint64_t    _file_size;
+    int64_t     _modified_time;
+    ContentHash _content_hash;
+  };
+
+  std::mutex                                       _mtx;
+  // Keyed by the partial hash, which already depends on the file size
+  std::unordered_map<uint64_t, std::vector<Entry>> _entries;
+  size_t                                           _size = 0;
+
+ public:
+  void Add(const QuickSignature& signature, const ContentHash& content_hash);
+  auto Add(const Image& image) -> bool;
+  auto Contains(const image_path_t& path) -> bool;
+  auto Contains(const image_path_t& path, const QuickSignature& signature) -> bool;
+  auto Size() -> size_t;
+};
+};  // namespace puerhlab
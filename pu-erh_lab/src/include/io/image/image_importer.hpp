@@ -0,0 +1,143 @@
+/*
+ * @file        pu-erh_lab/src/include/io/image/image_importer.hpp
+ * @brief       Streaming import of image files with bounded in-flight work
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "concurrency/cancellation_token.hpp"
+#include "image/image.hpp"
+#include "io/image/duplicate_index.hpp"
+#include "io/image/image_loader.hpp"
+#include "type/type.hpp"
+#include "utils/profiling/import_profiler.hpp"
+
+namespace puerhlab {
+/**
+ * @brief Lazily walks a directory tree and yields the supported image files one at a time. Only
+ * the iterators of the directories on the current path are kept in memory.
+ *
+ * The JPEG of a RAW+JPEG pair is skipped, it is linked to the raw file when the raw file is
+ * imported.
+ *
+ */
+class DirectoryWalker {
+ private:
+  std::vector<std::filesystem::directory_iterator> _stack;
+  bool                                             _recursive;
+  bool                                             _pair_sidecars;
+
+ public:
+  explicit DirectoryWalker(const image_path_t& root, bool recursive = true,
+                           bool pair_sidecars = true);
+
+  auto Next() -> std::optional<image_path_t>;
+};
+
+struct ImportProgress {
+  uint64_t _discovered = 0;
+  uint64_t _imported   = 0;
+  uint64_t _failed     = 0;
+  // Already imported files, left out before being decoded
+  uint64_t _skipped    = 0;
+  // Files in flight when the import was cancelled, dropped before or after being decoded
+  uint64_t _cancelled  = 0;
+};
+
+/**
+ * @brief Shared between the importing thread and the UI to pause, resume or cancel an import
+ *
+ */
+class ImportControl {
+ private:
+  std::mutex              _mtx;
+  std::condition_variable _cv;
+  bool                    _paused = false;
+  CancellationToken       _token  = CancellationToken::Create();
+
+ public:
+  void Pause();
+  void Resume();
+  void Cancel();
+  auto IsPaused() -> bool;
+  auto IsCancelled() const -> bool;
+  auto Token() const -> CancellationToken;
+  auto WaitWhilePaused() -> bool;
+};
+
+/**
+ * @brief Feeds paths from a lazy source into an ImageLoader while bounding the number of
+ * requests in flight, so that memory stays flat regardless of the size of the import
+ *
+ */
+class ImageImporter {
+ public:
+  // Returns std::nullopt once the source is exhausted
+  using PathSource       = std::function<std::optional<image_path_t>()>;
+  using LoadedCallback   = std::function<void(std::shared_ptr<Image>)>;
+  using ProgressCallback = std::function<void(const ImportProgress&)>;
+
+  static constexpr uint32_t                  _default_max_in_flight = 64;
+  // How long the importer waits for a decoded image before checking the requests again
+  static constexpr std::chrono::milliseconds _poll_interval{10};
+
+ private:
+  ImageLoader&                    _loader;
+  uint32_t                        _max_in_flight;
+  DecodeType                      _decode_type;
+  std::shared_ptr<DuplicateIndex> _known_files;
+  std::shared_ptr<ImportProfiler> _profiler;
+
+  auto                            Resolve(std::deque<std::future<image_id_t>>& in_flight,
+                                          ImportProgress&                      progress) -> size_t;
+  auto                            IsKnown(const image_path_t&            path,
+                                          std::optional<QuickSignature>& signature) -> bool;
+
+ public:
+  explicit ImageImporter(ImageLoader& loader, uint32_t max_in_flight = _default_max_in_flight,
+                         DecodeType decode_type = DecodeType::SLEEVE_LOADING);
+
+  void SetDuplicateIndex(std::shared_ptr<DuplicateIndex> known_files);
+  void SetImportProfiler(std::shared_ptr<ImportProfiler> profiler);
+
+  auto Import(PathSource next_path, LoadedCallback on_loaded, ProgressCallback on_progress = {},
+              std::shared_ptr<ImportControl> control = nullptr) -> ImportProgress;
+};
+};  // namespace puerhlab
@@ -30,15 +30,20 @@
 
 #pragma once
 
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <future>
 #include <memory>
 #include <vector>
 
+#include "concurrency/cancellation_token.hpp"
+#include "concurrency/task.hpp"
 #include "decoders/decoder_scheduler.hpp"
 #include "image/image.hpp"
+#include "storage/thumbnail_store/thumbnail_store.hpp"
 #include "type/type.hpp"
+#include "utils/io/file_reader.hpp"
 #include "utils/queue/queue.hpp"
 namespace puerhlab {
 
@@ -48,6 +53,7 @@ class ImageLoader {
   // Image decoding part
   std::shared_ptr<BufferQueue>                           _buffer_decoded;
   uint32_t                                               _buffer_size;
+  size_t                                                 _buffer_bytes;
   size_t                                                 _use_thread;
   image_id_t                                             _start_id;
   image_id_t                                             _next_id;
@@ -57,10 +63,30 @@ class ImageLoader {
   std::vector<std::future<image_id_t>>                   futures;
 
  public:
-  explicit ImageLoader(uint32_t buffer_size, size_t _use_thread, image_id_t start_id);
+  // Decoded images beyond this estimate wait in the scheduler until the consumer takes one
+  static constexpr size_t _default_buffer_bytes = size_t{1} << 30;
 
-  void StartLoading(std::vector<image_path_t> images, DecodeType decode_type);
-  void StartLoading(std::shared_ptr<Image> source_img, DecodeType decode_type);
+  explicit ImageLoader(uint32_t buffer_size, size_t _use_thread, image_id_t start_id,
+                       size_t   buffer_bytes     = _default_buffer_bytes,
+                       uint32_t read_queue_depth = FileReader::_default_queue_depth);
+
+  void StartLoading(std::vector<image_path_t> images, DecodeType decode_type,
+                    CancellationToken token = {});
+  void StartLoading(std::shared_ptr<Image> source_img, DecodeType decode_type,
+                    DecodePriority priority = DecodePriority::VISIBLE,
+                    CancellationToken token = {});
+  auto StartLoading(image_path_t image_path, DecodeType decode_type, DecodePriority priority,
+                    CancellationToken token) -> std::future<image_id_t>;
+  auto LoadAsync(std::shared_ptr<Image> image, DecodeType decode_type,
+                 DecodePriority priority = DecodePriority::VISIBLE, CancellationToken token = {})
+      -> Task<std::shared_ptr<Image>>;
+  auto LoadThumb(std::shared_ptr<Image> image, DecodePriority priority = DecodePriority::VISIBLE,
+                 CancellationToken token = {}) -> Task<std::shared_ptr<Image>>;
   auto LoadImage() -> std::shared_ptr<Image>;
+  auto TryLoadImage(std::chrono::milliseconds timeout) -> std::shared_ptr<Image>;
+  void SetThumbnailStore(std::shared_ptr<ThumbnailStore> store);
+  void SetImportProfiler(std::shared_ptr<ImportProfiler> profiler);
+  auto Metrics() -> std::vector<StageMetrics>;
+  auto NextId() const -> image_id_t;
 };
 };  // namespace puerhlab
\ No newline at end of file
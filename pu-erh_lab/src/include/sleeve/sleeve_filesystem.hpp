@@ -24,6 +24,8 @@ class FileSystem {
 
   // ID Generation
   IncrID::IDGenerator<sl_element_id_t> _id_gen;
+  // Ids of the imported images, the thumbnail store and the image table are keyed by them
+  IncrID::IDGenerator<image_id_t>      _image_id_gen;
   /** @name Database interaction */
   ///@{
   std::filesystem::path                _db_path;
@@ -45,6 +47,10 @@ class FileSystem {
   auto Get(sl_element_id_t id) -> std::shared_ptr<SleeveElement>;
   void Copy(std::filesystem::path from, std::filesystem::path dest);
 
+  auto NextImageId() -> image_id_t;
+  void ReserveImageIds(image_id_t next_id);
+  auto GetStoredImages() -> std::vector<std::shared_ptr<Image>>;
+
   void SyncToDB();
   void WriteSleeveMeta(const std::filesystem::path& meta_path);
   void ReadSleeveMeta(const std::filesystem::path& meta_path);
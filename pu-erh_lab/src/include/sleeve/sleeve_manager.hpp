@@ -4,16 +4,21 @@
 
 #include <cstdint>
 #include <filesystem>
+#include <future>
 #include <memory>
 #include <string>
 #include <unordered_map>
 
+#include "io/image/duplicate_index.hpp"
+#include "io/image/image_importer.hpp"
 #include "io/image/image_loader.hpp"
 #include "sleeve/sleeve_filesystem.hpp"
 #include "sleeve_base.hpp"
 #include "sleeve_view.hpp"
 #include "storage/image_pool/image_pool_manager.hpp"
+#include "storage/thumbnail_store/thumbnail_store.hpp"
 #include "type/type.hpp"
+#include "utils/profiling/import_profiler.hpp"
 
 namespace puerhlab {
 class SleeveManager {
@@ -21,6 +26,20 @@ class SleeveManager {
   std::shared_ptr<FileSystem>       _fs;
   std::shared_ptr<SleeveView>       _view;
   std::shared_ptr<ImagePoolManager> _image_pool;
+  std::shared_ptr<ThumbnailStore>   _thumbnail_store;
+  // Files imported into this sleeve, re-importing them is a no-op
+  std::shared_ptr<DuplicateIndex>   _known_files;
+  // Ready once the images stored by earlier sessions are in _known_files
+  std::shared_future<void>          _known_files_seeded;
+  // Stage timings of the last import
+  std::shared_ptr<ImportProfiler>   _import_profiler;
+
+  void                              SeedKnownFiles();
+  auto                              ImportFrom(ImageImporter::PathSource       next_path,
+                                               sl_path_t                       dest,
+                                               ImageImporter::ProgressCallback on_progress,
+                                               std::shared_ptr<ImportControl>  control)
+      -> ImportProgress;
 
  public:
   explicit SleeveManager(std::filesystem::path db_path);
@@ -28,8 +47,14 @@ class SleeveManager {
   auto GetFilesystem() -> std::shared_ptr<FileSystem>;
   auto GetView() -> std::shared_ptr<SleeveView>;
   auto GetPool() -> std::shared_ptr<ImagePoolManager>;
+  auto GetThumbnailStore() -> std::shared_ptr<ThumbnailStore>;
+  auto GetImportProfiler() -> std::shared_ptr<ImportProfiler>;
   auto GetImgCount() -> uint32_t;
   auto LoadToPath(std::vector<image_path_t> img_os_path, sl_path_t dest) -> uint32_t;
+  auto ImportDirectory(const image_path_t& root, sl_path_t dest,
+                       ImageImporter::ProgressCallback on_progress = {},
+                       std::shared_ptr<ImportControl> control = nullptr, bool recursive = true)
+      -> ImportProgress;
 
   auto RestoreSleeveFromDB(sleeve_id_t sleeve_id) -> std::shared_ptr<FileSystem>;
 };
@@ -1,9 +1,12 @@
 #pragma once
 
 #include <cstdint>
+#include <future>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
+#include "concurrency/cancellation_token.hpp"
 #include "io/image/image_loader.hpp"
 #include "sleeve/sleeve_element/sleeve_element.hpp"
 #include "sleeve/sleeve_element/sleeve_folder.hpp"
@@ -11,32 +14,58 @@
 #include "sleeve/sleeve_filter/filter_combo.hpp"
 #include "sleeve_base.hpp"
 #include "storage/image_pool/image_pool_manager.hpp"
+#include "storage/thumbnail_store/thumbnail_store.hpp"
 #include "type/type.hpp"
 
 namespace puerhlab {
 
+/**
+ * @brief Pin the buffers of an image in the pool while it is displayed
+ *
+ */
 struct DisplayingImage {
  private:
-  std::shared_ptr<Image> _displaying;
-  bool                   _require_thumb;
-  bool                   _require_full;
+  std::shared_ptr<ImagePoolManager> _pool;
+  std::shared_ptr<Image>            _displaying;
+  bool                              _require_thumb;
+  bool                              _require_full;
 
  public:
-  DisplayingImage(std::weak_ptr<Image> _displaying, bool _require_thumb, bool _require_full);
-  DisplayingImage(std::shared_ptr<Image> _displaying, bool _require_thumb, bool _require_full);
+  DisplayingImage(std::shared_ptr<ImagePoolManager> pool, std::weak_ptr<Image> displaying,
+                  bool require_thumb, bool require_full);
+  DisplayingImage(std::shared_ptr<ImagePoolManager> pool, std::shared_ptr<Image> displaying,
+                  bool require_thumb, bool require_full);
+  DisplayingImage(DisplayingImage&& other) noexcept;
+  DisplayingImage(const DisplayingImage&)                    = delete;
+  auto operator=(const DisplayingImage&) -> DisplayingImage& = delete;
   ~DisplayingImage();
 };
 
+/**
+ * @brief A thumbnail request of the view. It always completes, the thumbnail is nullptr if the
+ * request failed or was cancelled.
+ *
+ */
+struct ThumbRequest {
+  CancellationToken                   _token;
+  std::future<std::shared_ptr<Image>> _thumb;
+};
+
 class SleeveView {
  private:
-  std::shared_ptr<FileSystem>               _fs;
-  std::weak_ptr<SleeveFolder>               _viewing_node;
-  sl_path_t                                 _viewing_path;
-  std::vector<std::weak_ptr<SleeveElement>> _children;
+  std::shared_ptr<FileSystem>                  _fs;
+  std::weak_ptr<SleeveFolder>                  _viewing_node;
+  sl_path_t                                    _viewing_path;
+  std::vector<std::weak_ptr<SleeveElement>>    _children;
+
+  std::shared_ptr<ImagePoolManager>            _image_pool;
 
-  std::shared_ptr<ImagePoolManager>         _image_pool;
+  ImageLoader                                  _loader;
 
-  ImageLoader                               _loader;
+  // Prefetches that have been scheduled but not yet collected
+  std::unordered_map<image_id_t, ThumbRequest> _in_flight;
+  // Number of elements on each side of the visible range to be prefetched
+  uint32_t                                     _prefetch_margin = 8;
 
  public:
   SleeveView(std::shared_ptr<FileSystem> base, std::shared_ptr<ImagePoolManager> image_pool);
@@ -49,5 +78,7 @@ class SleeveView {
   void UpdateView(sl_path_t new_viewing_path);
   void LoadPreview(uint32_t range_low, uint32_t range_high,
                    std::function<void(size_t, std::weak_ptr<Image>)> callback);
+  void SetPrefetchMargin(uint32_t margin);
+  void SetThumbnailStore(std::shared_ptr<ThumbnailStore> store);
 };
 };  // namespace puerhlab
\ No newline at end of file
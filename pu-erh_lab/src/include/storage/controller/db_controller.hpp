@@ -22,7 +22,7 @@ class DBController {
   constexpr static const char* init_table_query =
       "CREATE TABLE Sleeve (id BIGINT PRIMARY KEY);"
       "CREATE TABLE Image (id BIGINT PRIMARY KEY, image_path TEXT, file_name TEXT, type INTEGER, "
-      "metadata JSON);"
+      "metadata JSON, sidecar_path TEXT, content_hash TEXT);"
       "CREATE TABLE SleeveRoot (id BIGINT PRIMARY KEY);"
       "CREATE TABLE Element (id BIGINT PRIMARY KEY, type INTEGER, element_name TEXT, added_time "
       "TIMESTAMP, modified_time "
@@ -39,6 +39,12 @@ class DBController {
       "content "
       "JSON)";
 
+  // Brings a database created by an older version up to init_table_query, new columns are
+  // appended in the order they were introduced so that they keep the same position
+  constexpr static const char* upgrade_table_query =
+      "ALTER TABLE Image ADD COLUMN IF NOT EXISTS sidecar_path TEXT;"
+      "ALTER TABLE Image ADD COLUMN IF NOT EXISTS content_hash TEXT;";
+
  public:
   explicit DBController(file_path_t& db_path);
   ~DBController();
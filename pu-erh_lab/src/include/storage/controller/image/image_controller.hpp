@@ -28,5 +28,6 @@ class ImageController {
   auto GetImageByType(const ImageType type) -> std::vector<std::shared_ptr<Image>>;
   auto GetImageByName(const std::wstring name) -> std::vector<std::shared_ptr<Image>>;
   auto GetImageByPath(const std::filesystem::path path) -> std::vector<std::shared_ptr<Image>>;
+  auto GetAllImages() -> std::vector<std::shared_ptr<Image>>;
 };
 };  // namespace puerhlab
\ No newline at end of file
@@ -1,15 +1,17 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
-#include <queue>
-#include <set>
-#include <string>
+#include <shared_mutex>
 #include <unordered_map>
-#include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include "image/image.hpp"
 #include "type/type.hpp"
@@ -18,36 +20,87 @@ namespace puerhlab {
 
 enum class AccessType { THUMB, FULL_IMG, META };
 
+/**
+ * @brief Pool of the tracked images with LRU caches for their thumbnails and full images. Safe to
+ * share between threads.
+ *
+ * Each cache is bounded by a byte budget. Recording an access charges the cache the size of the
+ * image's buffer, and the least recently used images are evicted until the cache is back under
+ * budget. Pinned images are charged but kept out of the eviction order.
+ *
+ * The pool is sharded by image id, each shard behind its own reader-writer lock, so lookups only
+ * contend with inserts into the same shard. A cache hit does not touch the LRU order, it stamps the
+ * image with the current access clock instead. Every cache keeps its order under its own mutex,
+ * taken by RecordAccess, eviction and pinning, and brings an image whose stamp has moved on up to
+ * date when the image reaches the eviction end. Locks are always taken cache first, shard second.
+ */
 class ImagePoolManager {
-  using ListIterator = std::list<image_id_t>::iterator;
-
  private:
-  std::unordered_map<image_id_t, std::shared_ptr<Image>> _image_pool;
-
-  std::unordered_map<image_id_t, ListIterator>           _cache_map_thumb;
-  std::list<image_id_t>                                  _cache_list_thumb;
-
-  std::unordered_map<image_id_t, ListIterator>           _cache_map_full;
-  std::list<image_id_t>                                  _cache_list_full;
-
-  uint32_t                                               _capacity_thumb;
-  uint32_t                                               _capacity_full;
-
-  std::unordered_set<image_id_t>                         _with_thumb;
-  std::unordered_set<image_id_t>                         _with_full;
+  static constexpr size_t _shard_count = 16;
+  static constexpr size_t _cache_count = 2;
+
+  struct Entry {
+    std::shared_ptr<Image>                          _image;
+    // Clock value of the last access per cache, 0 while the image is not cached there
+    std::array<std::atomic<uint64_t>, _cache_count> _stamps{};
+  };
+
+  struct alignas(64) Shard {
+    mutable std::shared_mutex             _mutex;
+    // Node based, entries keep their address until they are erased
+    std::unordered_map<image_id_t, Entry> _entries;
+  };
+
+  struct Record {
+    // Key in the eviction order, for a pinned image the key it had when it was pinned
+    uint64_t _key    = 0;
+    // Size of the buffer when the access was recorded, released from the usage on eviction
+    size_t   _bytes  = 0;
+    bool     _pinned = false;
+  };
+
+  struct Cache {
+    std::mutex                             _mutex;
+    // Unpinned images by the stamp they were ordered with, the least recently used first
+    std::map<uint64_t, image_id_t>         _order;
+    std::unordered_map<image_id_t, Record> _records;
+    // Written under the mutex, read without it
+    std::atomic<size_t>                    _usage  = 0;
+    std::atomic<size_t>                    _budget = 0;
+  };
+
+  std::array<Shard, _shard_count> _shards;
+  std::array<Cache, _cache_count> _caches;
+  std::atomic<uint64_t>           _clock = 0;
+  std::atomic<size_t>             _size  = 0;
+
+  auto                            ShardOf(const image_id_t& id) -> Shard&;
+  auto                            CacheOf(const AccessType type) -> Cache*;
+  auto                            Find(const image_id_t& id)
+      -> std::pair<std::shared_ptr<Image>, Entry*>;
+  auto                            EvictLocked(Cache& cache, const AccessType type,
+                                              const std::optional<image_id_t>& keep)
+      -> std::optional<std::weak_ptr<Image>>;
+  void                            ShrinkLocked(Cache& cache, const AccessType type,
+                                               const std::optional<image_id_t>& keep);
+  void                            FlushLocked(Cache& cache, const AccessType type);
 
  public:
-  static const uint32_t _default_capacity_thumb = 64;
-  static const uint32_t _default_capacity_full  = 3;
+  static constexpr size_t _default_budget_thumb = size_t{256} << 20;
+  static constexpr size_t _default_budget_full  = size_t{2} << 30;
 
   explicit ImagePoolManager();
-  explicit ImagePoolManager(uint32_t capacity_thumb, uint32_t capacity_full);
+  explicit ImagePoolManager(size_t budget_thumb, size_t budget_full);
 
-  auto GetPool() -> std::unordered_map<image_id_t, std::shared_ptr<Image>>&;
+  auto Snapshot() const -> std::vector<std::shared_ptr<Image>>;
   void Insert(const std::shared_ptr<Image> img);
   auto PoolContains(const image_id_t& id) -> bool;
 
-  auto Capacity(const AccessType type) -> uint32_t;
+  auto Count(const AccessType type) -> uint32_t;
+  auto Budget(const AccessType type) -> size_t;
+  auto Usage(const AccessType type) -> size_t;
+  void SetBudget(const AccessType type, const size_t bytes);
+
   auto AccessElement(const image_id_t& id, const AccessType type)
       -> std::optional<std::weak_ptr<Image>>;
   void RecordAccess(const image_id_t& id, const AccessType type);
@@ -55,7 +108,8 @@ class ImagePoolManager {
   auto Evict(const AccessType type) -> std::optional<std::weak_ptr<Image>>;
   auto CacheContains(const image_id_t& id, const AccessType type) -> bool;
 
-  void ResizeCache(const uint32_t new_capacity, const AccessType type);
+  void Pin(const image_id_t& id, const AccessType type);
+  void Unpin(const image_id_t& id, const AccessType type);
 
   void Flush();
   void Clear();
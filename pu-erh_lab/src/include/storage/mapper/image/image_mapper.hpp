@@ -10,25 +10,31 @@
 
 namespace puerhlab {
 // CREATE TABLE Image (id BIGINT PRIMARY KEY, image_path TEXT, file_name TEXT, type INTEGER,
-// metadata JSON);
+// metadata JSON, sidecar_path TEXT, content_hash TEXT);
 struct ImageMapperParams {
   image_id_t                   id;
   std::unique_ptr<std::string> image_path;
   std::unique_ptr<std::string> file_name;
   uint32_t                     type;
   std::unique_ptr<std::string> metadata;
+  // Empty if the image has no RAW+JPEG sidecar
+  std::unique_ptr<std::string> sidecar_path;
+  // XXH3-128 in hex, empty if the content was never hashed
+  std::unique_ptr<std::string> content_hash;
 };
 
 class ImageMapper : public MapperInterface<ImageMapper, ImageMapperParams, image_id_t>,
                     public FieldReflectable<ImageMapper> {
  private:
-  static constexpr uint32_t                                         _field_count      = 5;
+  static constexpr uint32_t                                         _field_count      = 7;
   static constexpr const char*                                      _table_name       = "Image";
   static constexpr const char*                                      _prime_key_clause = "id={}";
   static constexpr std::array<duckorm::DuckFieldDesc, _field_count> _field_descs      = {
       FIELD(ImageMapperParams, id, UINT32), FIELD(ImageMapperParams, image_path, VARCHAR),
       FIELD(ImageMapperParams, file_name, VARCHAR), FIELD(ImageMapperParams, type, UINT32),
-      FIELD(ImageMapperParams, metadata, VARCHAR)};
+      FIELD(ImageMapperParams, metadata, VARCHAR),
+      FIELD(ImageMapperParams, sidecar_path, VARCHAR),
+      FIELD(ImageMapperParams, content_hash, VARCHAR)};
 
  public:
   static auto FromRawData(std::vector<duckorm::VarTypes>&& data) -> ImageMapperParams;
@@ -11,6 +11,7 @@
 #include "storage/mapper/image/image_mapper.hpp"
 #include "storage/service/service_interface.hpp"
 #include "type/type.hpp"
+#include "utils/hash/content_hash.hpp"
 
 namespace puerhlab {
 class ImageService : public ServiceInterface<ImageService, std::shared_ptr<Image>,
@@ -25,5 +26,7 @@ class ImageService : public ServiceInterface<ImageService, std::shared_ptr<Image
   auto        GetImageByName(const std::wstring name) -> std::vector<std::shared_ptr<Image>>;
   auto GetImageByPath(const std::filesystem::path path) -> std::vector<std::shared_ptr<Image>>;
   auto GetImageByType(const ImageType type) -> std::vector<std::shared_ptr<Image>>;
+  auto GetImageByContentHash(const ContentHash& hash) -> std::vector<std::shared_ptr<Image>>;
+  auto GetAllImages() -> std::vector<std::shared_ptr<Image>>;
 };
 };  // namespace puerhlab
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <opencv2/core/mat.hpp>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "type/type.hpp"
+#include "utils/io/mapped_file.hpp"
+
+namespace puerhlab {
+/**
+ * @brief Identifies the version of a source file a thumbnail was generated from
+ *
+ */
+struct ThumbnailFingerprint {
+  uint64_t _path_hash     = 0;
+  int64_t  _modified_time = 0;
+  uint64_t _file_size     = 0;
+
+  static auto FromFile(const image_path_t& path) -> std::optional<ThumbnailFingerprint>;
+
+  auto        operator==(const ThumbnailFingerprint& other) const -> bool = default;
+};
+
+/**
+ * @brief On-disk layout of one record of the thumbnail index. Records are only ever appended, a
+ * later record for the same image supersedes the earlier ones, a record with zero length is a
+ * tombstone.
+ *
+ */
+struct ThumbnailIndexEntry {
+  uint32_t _image_id;
+  uint32_t _type;
+  uint64_t _path_hash;
+  int64_t  _modified_time;
+  uint64_t _file_size;
+  uint64_t _offset;
+  uint32_t _length;
+  uint32_t _rows;
+  uint32_t _cols;
+  uint32_t _reserved[3];
+};
+static_assert(sizeof(ThumbnailIndexEntry) == 64, "ThumbnailIndexEntry must stay 64 bytes");
+
+/**
+ * @brief A persistent thumbnail cache, made of a packed append-only pixel file and a memory mapped
+ * index keyed by image id. Thumbnails are stored as raw 8-bit pixels so a hit costs one memory
+ * copy.
+ *
+ */
+class ThumbnailStore {
+ private:
+  std::filesystem::path                               _pack_path;
+  std::filesystem::path                               _index_path;
+  uint32_t                                            _max_edge;
+
+  std::shared_mutex                                   _mtx;
+  std::unordered_map<image_id_t, ThumbnailIndexEntry> _index;
+  MappedFile                                          _pack_map;
+  std::ofstream                                       _pack_out;
+  std::ofstream                                       _index_out;
+  uint64_t                                            _pack_size  = 0;
+  uint64_t                                            _dead_bytes = 0;
+  // Bumped by every write, used by compaction to detect concurrent modifications
+  uint64_t                                            _generation = 0;
+
+  std::thread                                         _compaction_thread;
+  std::atomic<bool>                                   _compacting = false;
+
+ public:
+  static constexpr uint32_t _default_max_edge     = 512;
+  // Compaction is triggered once stale data takes this share of the pack file
+  static constexpr double   _compaction_threshold = 0.3;
+  static constexpr uint64_t _compaction_min_bytes = 64ull << 20;
+
+  explicit ThumbnailStore(const std::filesystem::path& store_dir,
+                          uint32_t                     max_edge = _default_max_edge);
+  ~ThumbnailStore();
+
+  auto Get(const image_id_t id, const ThumbnailFingerprint& fingerprint) -> std::optional<cv::Mat>;
+  void Put(const image_id_t id, const ThumbnailFingerprint& fingerprint, const cv::Mat& thumbnail);
+  void Invalidate(const image_id_t id);
+  auto Contains(const image_id_t id) -> bool;
+  auto Size() -> size_t;
+  auto StaleRatio() -> double;
+
+  void Compact();
+  void CompactAsync();
+
+ private:
+  void LoadIndex();
+  void OpenWriters();
+  void AppendEntry(const ThumbnailIndexEntry& entry);
+  void MaybeScheduleCompaction();
+};
+};  // namespace puerhlab
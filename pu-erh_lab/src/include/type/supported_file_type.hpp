@@ -30,6 +30,8 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cwctype>
 #include <filesystem>
 #include <string>
 #include <unordered_set>
@@ -39,8 +41,13 @@ namespace fs = std::filesystem;
 namespace puerhlab {
 static const std::unordered_set<std::wstring> supported_extensions = {
     L".jpg", L".jpeg", L".png", L".raw", L".cr2",  L".nef", L".tiff", L".bmp",
-    L".dng", L".arw",  L".cr3", L".JPG", L".JPEG", L".PNG", L".RAW",  L".CR2",
-    L".NEF", L".TIFF", L".BMP", L".DNG", L".ARW",  L".CR3"};
+    L".dng", L".arw",  L".cr3", L".orf", L".raf",  L".rw2", L".pef",  L".JPG",
+    L".JPEG", L".PNG", L".RAW", L".CR2", L".NEF",  L".TIFF", L".BMP", L".DNG",
+    L".ARW", L".CR3",  L".ORF", L".RAF", L".RW2",  L".PEF"};
+
+// Lower case, the files go to LibRaw whether or not their content is recognized
+static const std::unordered_set<std::wstring> raw_extensions = {
+    L".arw", L".cr2", L".cr3", L".dng", L".nef", L".orf", L".pef", L".raf", L".raw", L".rw2"};
 
 inline bool is_supported_file(const fs::path& path) {
   if (!fs::is_regular_file(path)) return false;
@@ -48,4 +55,11 @@ inline bool is_supported_file(const fs::path& path) {
   std::wstring ext = path.extension().wstring();
   return supported_extensions.count(ext) > 0;
 }
+
+inline bool is_raw_file(const fs::path& path) {
+  std::wstring ext = path.extension().wstring();
+  std::transform(ext.begin(), ext.end(), ext.begin(),
+                 [](wchar_t c) { return static_cast<wchar_t>(std::towlower(c)); });
+  return raw_extensions.count(ext) > 0;
+}
 };  // namespace puerhlab
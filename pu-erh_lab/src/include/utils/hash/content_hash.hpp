@@ -0,0 +1,82 @@
+/*
+ * @file        pu-erh_lab/src/include/utils/hash/content_hash.hpp
+ * @brief       XXH3-128 content hash of image files
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <xxhash.hpp>
+
+namespace puerhlab {
+/**
+ * @brief XXH3-128 of the content of a file, used to detect duplicates and as a cache key which
+ * survives renames and moves
+ *
+ */
+struct ContentHash {
+  uint64_t    _low  = 0;
+  uint64_t    _high = 0;
+
+  auto        IsEmpty() const -> bool { return _low == 0 && _high == 0; }
+  auto        ToHex() const -> std::string;
+
+  static auto FromHex(std::string_view hex) -> std::optional<ContentHash>;
+  static auto FromBuffer(const void* data, size_t size) -> ContentHash;
+  static auto FromFile(const std::filesystem::path& path) -> std::optional<ContentHash>;
+
+  friend auto operator==(const ContentHash&, const ContentHash&) -> bool = default;
+};
+
+/**
+ * @brief Streaming XXH3-128, fed with the chunks of a file as they are read so that hashing
+ * needs no pass of its own over the data
+ *
+ */
+class ContentHasher {
+ private:
+  xxh::hash3_state128_t _state;
+
+ public:
+  // Chunk size readers use when hashing, small enough for a chunk to still be in cache when it
+  // is hashed
+  static constexpr size_t _chunk_size = size_t{4} << 20;
+
+  ContentHasher()                                = default;
+  ContentHasher(const ContentHasher&)            = delete;
+  ContentHasher& operator=(const ContentHasher&) = delete;
+
+  void Update(const void* data, size_t size);
+  auto Digest() -> ContentHash;
+};
+};  // namespace puerhlab
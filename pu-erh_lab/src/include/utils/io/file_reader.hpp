@@ -0,0 +1,94 @@
+/*
+ * @file        pu-erh_lab/src/include/utils/io/file_reader.hpp
+ * @brief       Asynchronous whole-file readers feeding the decoders
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "concurrency/executor.hpp"
+#include "concurrency/thread_pool.hpp"
+#include "type/type.hpp"
+#include "utils/hash/content_hash.hpp"
+
+namespace puerhlab {
+/**
+ * @brief Asynchronous whole-file reader. Completion callbacks are invoked on a reader-owned
+ * thread and should only hand the buffer over to other workers.
+ *
+ */
+class FileReader {
+ public:
+  // On failure the buffer is empty and the exception_ptr is set
+  using Callback       = std::function<void(std::vector<char>&& buffer, std::exception_ptr error)>;
+  // Also given the XXH3-128 of the content, computed chunk by chunk while the file is read
+  using HashedCallback = std::function<void(std::vector<char>&& buffer, ContentHash hash,
+                                            std::exception_ptr error)>;
+
+  static constexpr uint32_t _default_queue_depth = 32;
+
+  virtual ~FileReader() = default;
+
+  virtual void Read(const image_path_t& path, Callback callback)             = 0;
+  virtual void ReadHashed(const image_path_t& path, HashedCallback callback) = 0;
+  /**
+   * @brief Number of reads the reader is able to keep in flight, callers are expected to hold
+   * back further requests so that they can still be reordered
+   *
+   * @return uint32_t
+   */
+  virtual auto QueueDepth() const -> uint32_t                    = 0;
+
+  static auto  Create(uint32_t queue_depth, size_t fallback_threads) -> std::unique_ptr<FileReader>;
+};
+
+/**
+ * @brief Portable reader doing blocking reads on the shared I/O pool
+ *
+ */
+class ThreadPoolFileReader : public FileReader {
+ private:
+  uint32_t  _max_in_flight;
+  // Waited for on destruction, completion callbacks may still refer to the reader's owner
+  TaskGroup _reads;
+
+ public:
+  explicit ThreadPoolFileReader(size_t max_in_flight, ThreadPool& pool = Executor::Instance().Io());
+
+  void Read(const image_path_t& path, Callback callback) override;
+  void ReadHashed(const image_path_t& path, HashedCallback callback) override;
+  auto QueueDepth() const -> uint32_t override;
+};
+};  // namespace puerhlab
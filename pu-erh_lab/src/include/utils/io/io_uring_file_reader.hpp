@@ -0,0 +1,107 @@
+/*
+ * @file        pu-erh_lab/src/include/utils/io/io_uring_file_reader.hpp
+ * @brief       Batched file reads on io_uring
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#ifdef PUERHLAB_HAS_IO_URING
+
+#include <liburing.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "type/type.hpp"
+#include "utils/hash/content_hash.hpp"
+#include "utils/io/file_reader.hpp"
+
+namespace puerhlab {
+/**
+ * @brief Linux reader keeping up to queue_depth reads in flight on a single io_uring instance. A
+ * dedicated thread submits the reads and reaps their completions.
+ *
+ */
+class IoUringFileReader : public FileReader {
+ private:
+  struct Submission {
+    image_path_t   _path;
+    bool           _hash;
+    HashedCallback _callback;
+  };
+
+  struct ReadOperation {
+    int                            _fd = -1;
+    std::vector<char>              _buffer;
+    size_t                         _offset = 0;
+    // Set when the content is hashed, the file is then read in chunks of
+    // ContentHasher::_chunk_size which are hashed as they complete
+    std::unique_ptr<ContentHasher> _hasher;
+    HashedCallback                 _callback;
+  };
+
+  io_uring                                      _ring;
+  uint32_t                                      _queue_depth;
+  // Written to by Read() to wake up the ring thread
+  int                                           _wakeup_fd;
+  uint64_t                                      _wakeup_value = 0;
+
+  std::mutex                                    _submission_mtx;
+  std::deque<Submission>                        _submissions;
+  bool                                          _stop      = false;
+  // Only touched by the ring thread
+  uint32_t                                      _in_flight = 0;
+
+  std::thread                                   _ring_thread;
+
+  void                                          Submit(Submission&& submission);
+  void                                          RingLoop();
+  void                                          ArmWakeup();
+  auto                                          StartReads() -> bool;
+  void                                          SubmitRead(ReadOperation* op);
+  void                                          Complete(ReadOperation* op, int result);
+
+ public:
+  explicit IoUringFileReader(uint32_t queue_depth);
+  ~IoUringFileReader() override;
+
+  void Read(const image_path_t& path, Callback callback) override;
+  void ReadHashed(const image_path_t& path, HashedCallback callback) override;
+  auto QueueDepth() const -> uint32_t override;
+};
+};  // namespace puerhlab
+
+#endif
@@ -0,0 +1,137 @@
+/*
+ * @file        pu-erh_lab/src/include/utils/profiling/import_profiler.hpp
+ * @brief       Per-file timing of the import stages
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "type/type.hpp"
+
+namespace puerhlab {
+/**
+ * @brief Stages a file goes through during an import, in pipeline order
+ */
+enum class ImportStage : uint8_t {
+  DEDUP,      // Duplicate pre-check on the importing thread
+  QUEUE,      // Waiting in the scheduler for a read slot
+  READ,       // File read, including the content hash
+  DISPATCH,   // Waiting for a decode thread
+  EXIF,       // Metadata parse
+  THUMBNAIL,  // Thumbnail decode and store write
+  CREATE,     // FileSystem::Create of the sleeve element
+  INSERT      // Registering the image with the sleeve, its pool and duplicate index
+};
+
+constexpr size_t kImportStageCount = static_cast<size_t>(ImportStage::INSERT) + 1;
+
+auto ImportStageName(ImportStage stage) -> const char*;
+
+/**
+ * @brief Percentiles of the time spent in one stage, over the files which went through it
+ *
+ */
+struct ImportStageStats {
+  ImportStage _stage;
+  size_t      _count    = 0;
+  double      _p50_ms   = 0.0;
+  double      _p90_ms   = 0.0;
+  double      _p99_ms   = 0.0;
+  double      _max_ms   = 0.0;
+  double      _total_ms = 0.0;
+};
+
+struct ImportSlowFile {
+  image_path_t _path;
+  double       _total_ms;
+  // The stage in which the file spent the most time
+  ImportStage  _bottleneck;
+  double       _bottleneck_ms;
+};
+
+struct ImportReport {
+  std::vector<ImportStageStats> _stages;
+  // Slowest first
+  std::vector<ImportSlowFile>   _slowest;
+
+  auto                          ToString() const -> std::string;
+};
+
+/**
+ * @brief Collects the time every file spends in each import stage. Stages are timed with the
+ * steady clock and recorded from whichever thread runs them, a record costs a clock read and a
+ * short critical section, negligible next to reading the file.
+ *
+ */
+class ImportProfiler {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr size_t _default_slowest_count = 10;
+
+ private:
+  using StageDurations = std::array<Clock::duration, kImportStageCount>;
+
+  std::mutex                                                    _mtx;
+  std::unordered_map<image_path_t::string_type, StageDurations> _files;
+
+ public:
+  void Record(const image_path_t& path, ImportStage stage, Clock::duration elapsed);
+  auto Report(size_t slowest_count = _default_slowest_count) -> ImportReport;
+  auto FileCount() -> size_t;
+  void Clear();
+};
+
+/**
+ * @brief Times a scope as one stage of a file, does nothing without a profiler
+ *
+ */
+class ImportStageTimer {
+ private:
+  ImportProfiler*                   _profiler;
+  const image_path_t&               _path;
+  ImportStage                       _stage;
+  ImportProfiler::Clock::time_point _start;
+
+ public:
+  ImportStageTimer(ImportProfiler* profiler, const image_path_t& path, ImportStage stage);
+  ImportStageTimer(const ImportStageTimer&)            = delete;
+  ImportStageTimer& operator=(const ImportStageTimer&) = delete;
+  ~ImportStageTimer();
+};
+};  // namespace puerhlab
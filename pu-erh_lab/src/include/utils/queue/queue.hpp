@@ -28,11 +28,17 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <mutex>
 #include <optional>
 #include <queue>
 
+#include "utils/queue/ring_buffer.hpp"
+
 #pragma once
 
 namespace puerhlab {
@@ -42,42 +48,96 @@ namespace puerhlab {
 template <typename T>
 class ConcurrentBlockingQueue {
  public:
+  using Weigher       = std::function<size_t(const T&)>;
+  using SpaceCallback = std::function<void()>;
+
   std::uint32_t           _max_size;
   bool                    _has_capacity_limit = true;
   std::queue<T>           _queue;
+  // Optional byte budget, the weigher estimates the memory held by an element
+  Weigher                 _weigher;
+  size_t                  _max_bytes     = 0;
+  size_t                  _current_bytes = 0;
+  // Weight of each queued element, recorded at push time
+  std::queue<size_t>      _weights;
   // Mutex used for non-blocking queue
   std::mutex              mtx;
   std::condition_variable _producer_cv;
   std::condition_variable _consumer_cv;
+  // Called after every pop, outside the lock, see set_on_space()
+  SpaceCallback           _on_space;
 
   explicit ConcurrentBlockingQueue() { _has_capacity_limit = false; };
 
   explicit ConcurrentBlockingQueue(uint32_t max_size) : _max_size(max_size) {}
 
+  /**
+   * @brief Construct a queue bounded both by element count and by estimated bytes
+   *
+   * @param max_size
+   * @param max_bytes 0 for no byte budget
+   * @param weigher
+   */
+  explicit ConcurrentBlockingQueue(uint32_t max_size, size_t max_bytes, Weigher weigher)
+      : _max_size(max_size), _weigher(std::move(weigher)), _max_bytes(max_bytes) {}
+
+  /**
+   * @brief A thread-safe wrapper for _request_queue push() method. Blocks while the queue is
+   * full, an element is always admitted into an empty queue so that an element larger than the
+   * byte budget cannot block forever.
+   *
+   * @param new_request the request to enqueue
+   */
+  void push(T new_request) { push_r(std::move(new_request)); }
+
   /**
    * @brief A thread-safe wrapper for _request_queue push() method
    *
    * @param new_request the request to enqueue
    */
-  void push(T new_request) {
+  void push_r(T&& new_request) {
+    size_t weight = _weigher ? _weigher(new_request) : 0;
     {
       std::unique_lock<std::mutex> lock(mtx);
+      _producer_cv.wait(lock, [this, weight] { return HasRoomFor(weight); });
       _queue.push(std::move(new_request));
+      _weights.push(weight);
+      _current_bytes += weight;
     }
-    _consumer_cv.notify_all();
+    // A single element can only satisfy a single consumer
+    _consumer_cv.notify_one();
   }
 
   /**
-   * @brief A thread-safe wrapper for _request_queue push() method
+   * @brief Enqueue without blocking, under the same admission rule as push()
    *
-   * @param new_request the request to enqueue
+   * @param new_request moved from only on success
+   * @return true the element was enqueued
+   * @return false the queue is full
    */
-  void push_r(T&& new_request) {
+  auto try_push(T& new_request) -> bool {
+    size_t weight = _weigher ? _weigher(new_request) : 0;
     {
-      std::unique_lock<std::mutex> lock(mtx);
+      std::lock_guard<std::mutex> lock(mtx);
+      if (!HasRoomFor(weight)) return false;
       _queue.push(std::move(new_request));
+      _weights.push(weight);
+      _current_bytes += weight;
     }
-    _consumer_cv.notify_all();
+    _consumer_cv.notify_one();
+    return true;
+  }
+
+  /**
+   * @brief Set a callback run by the consumer after each pop, so that a producer which gave up on
+   * try_push() can be told about the room. Must be set before the queue is shared, the callback
+   * may call try_push() but must not pop.
+   *
+   * @param on_space
+   */
+  void set_on_space(SpaceCallback on_space) {
+    std::lock_guard<std::mutex> lock(mtx);
+    _on_space = std::move(on_space);
   }
 
   /**
@@ -90,8 +150,8 @@ class ConcurrentBlockingQueue {
     // Wait for the queue to be fill with at least one value
     _consumer_cv.wait(lock, [this] { return !_queue.empty(); });
 
-    auto handled_request = _queue.front();
-    _queue.pop();
+    auto handled_request = std::move(_queue.front());
+    PopFront(lock);
 
     return handled_request;
   }
@@ -107,125 +167,59 @@ class ConcurrentBlockingQueue {
     _consumer_cv.wait(lock, [this] { return !_queue.empty(); });
 
     auto handled_request = std::move(_queue.front());
-    _queue.pop();
+    PopFront(lock);
 
     return handled_request;
   }
-};
 
-/**
- * @brief A thread-safe non-blocking ring buffer.
- */
-template <typename T>
-class LockFreeMPMCQueue {
- public:
-  explicit LockFreeMPMCQueue(size_t capacity) : _capacity(capacity), _buffer(capacity) {
-    for (size_t i = 0; i < capacity; ++i) {
-      _buffer[i].sequence.store(i, std::memory_order_relaxed);
+  /**
+   * @brief Pop the front-most element, waiting at most timeout for one to arrive
+   *
+   * @param timeout
+   * @return std::optional<T> std::nullopt on timeout
+   */
+  template <typename Rep, typename Period>
+  auto try_pop_for(const std::chrono::duration<Rep, Period>& timeout) -> std::optional<T> {
+    std::unique_lock<std::mutex> lock(mtx);
+    if (!_consumer_cv.wait_for(lock, timeout, [this] { return !_queue.empty(); })) {
+      return std::nullopt;
     }
-    _head.store(0, std::memory_order_relaxed);
-    _tail.store(0, std::memory_order_relaxed);
+    std::optional<T> handled_request{std::move(_queue.front())};
+    PopFront(lock);
+    return handled_request;
   }
 
-  bool push(const T& item) {
-    size_t pos = _tail.load(std::memory_order_relaxed);
-    while (true) {
-      Slot&    slot = _buffer[pos % _capacity];
-      size_t   seq  = slot.sequence.load(std::memory_order_acquire);
-      intptr_t diff = (intptr_t)seq - (intptr_t)pos;
-      if (diff == 0) {
-        if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
-          slot.data = item;
-          slot.sequence.store(pos + 1, std::memory_order_release);
-          return true;
-        }
-      } else if (diff < 0) {
-        return false;  // queue is full
-      } else {
-        pos = _tail.load(std::memory_order_relaxed);  // retry
-      }
-    }
+ private:
+  auto HasRoomFor(size_t weight) const -> bool {
+    if (_queue.empty()) return true;
+    if (_has_capacity_limit && _queue.size() >= _max_size) return false;
+    return _max_bytes == 0 || _current_bytes + weight <= _max_bytes;
   }
 
-  std::optional<T> pop() {
-    size_t pos = _head.load(std::memory_order_relaxed);
-    while (true) {
-      Slot&    slot = _buffer[pos % _capacity];
-      size_t   seq  = slot.sequence.load(std::memory_order_acquire);
-      intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
-      if (diff == 0) {
-        if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
-          T result = slot.data;
-          slot.sequence.store(pos + _capacity, std::memory_order_release);
-          return result;
-        }
-      } else if (diff < 0) {
-        return std::nullopt;  // queue is empty
-      } else {
-        pos = _head.load(std::memory_order_relaxed);  // retry
-      }
+  void PopFront(std::unique_lock<std::mutex>& lock) {
+    _queue.pop();
+    _current_bytes -= _weights.front();
+    _weights.pop();
+    lock.unlock();
+    if (_weigher) {
+      // Elements have different weights, any of the waiting producers may fit now
+      _producer_cv.notify_all();
+    } else {
+      _producer_cv.notify_one();
     }
+    if (_on_space) _on_space();
   }
-
-  bool empty() const {
-    return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
-  }
-
- private:
-  struct Slot {
-    std::atomic<size_t> sequence;
-    T                   data;
-  };
-
-  size_t              _capacity;
-  std::vector<Slot>   _buffer;
-  std::atomic<size_t> _head{0};
-  std::atomic<size_t> _tail{0};
 };
 
+/**
+ * @brief A bounded lock-free queue, capacity is rounded up to a power of two.
+ */
 template <typename T>
-class BlockingMPMCQueue {
- public:
-  explicit BlockingMPMCQueue(size_t capacity) : _queue(capacity) {}
-
-  void push(const T& item) {
-    while (true) {
-      if (_queue.push(item)) {
-        {
-          std::lock_guard<std::mutex> lock(_cv_mutex);
-          _not_empty.notify_one();
-        }
-        return;
-      }
-
-      std::unique_lock<std::mutex> lock(_cv_mutex);
-      _not_full.wait(lock);  // wait until space available
-    }
-  }
-
-  T pop() {
-    while (true) {
-      auto item = _queue.pop();
-      if (item.has_value()) {
-        {
-          std::lock_guard<std::mutex> lock(_cv_mutex);
-          _not_full.notify_one();
-        }
-        return item.value();
-      }
-
-      std::unique_lock<std::mutex> lock(_cv_mutex);
-      _not_empty.wait(lock);  // wait until item available
-    }
-  }
+using LockFreeMPMCQueue = MPMCRingBuffer<T>;
 
-  bool empty() const { return _queue.empty(); }
-
- private:
-  LockFreeMPMCQueue<T>    _queue;
-
-  std::condition_variable _not_empty;
-  std::condition_variable _not_full;
-  std::mutex              _cv_mutex;
-};
+/**
+ * @brief A bounded queue whose push/pop block on atomic wait while it is full/empty.
+ */
+template <typename T>
+using BlockingMPMCQueue = BlockingRingBuffer<MPMCRingBuffer<T>>;
 };  // namespace puerhlab
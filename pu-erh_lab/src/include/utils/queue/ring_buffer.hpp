@@ -0,0 +1,456 @@
+/*
+ * @file        pu-erh_lab/src/include/utils/queue/ring_buffer.hpp
+ * @brief       Cache-line padded bounded SPSC/MPMC ring buffers and a blocking wrapper
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace puerhlab {
+// Indices and slots touched by different threads are kept on separate cache lines
+static constexpr size_t kCacheLineSize = 64;
+
+/**
+ * @brief Round a requested capacity up to a power of two so that positions can be masked
+ */
+inline constexpr auto RingCapacity(size_t requested) -> size_t {
+  size_t capacity = 2;
+  while (capacity < requested) capacity <<= 1;
+  return capacity;
+}
+
+/**
+ * @brief A bounded wait-free queue for exactly one producer and one consumer thread.
+ *
+ * Each side keeps a cached copy of the other side's position so that the shared index is only
+ * read when the cached one says the queue is full (or empty).
+ */
+template <typename T>
+class SPSCRingBuffer {
+ public:
+  using value_type = T;
+
+  explicit SPSCRingBuffer(size_t capacity)
+      : _mask(RingCapacity(capacity) - 1), _buffer(std::make_unique<T[]>(_mask + 1)) {}
+
+  SPSCRingBuffer(const SPSCRingBuffer&)            = delete;
+  SPSCRingBuffer& operator=(const SPSCRingBuffer&) = delete;
+
+  bool push(const T& item) { return emplace(item); }
+
+  /**
+   * @brief Enqueue an element, the element is only moved from when the call succeeds
+   *
+   * @return false if the queue is full
+   */
+  bool push(T&& item) { return emplace(std::move(item)); }
+
+  /**
+   * @brief Move up to count elements from items into the queue
+   *
+   * @return size_t the number of elements enqueued, a prefix of items
+   */
+  auto push_batch(T* items, size_t count) -> size_t {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    size_t free = Capacity() - (tail - _head_cache);
+    if (free < count) {
+      _head_cache = _head.load(std::memory_order_acquire);
+      free        = Capacity() - (tail - _head_cache);
+    }
+    size_t n = std::min(free, count);
+    for (size_t i = 0; i < n; ++i) {
+      _buffer[(tail + i) & _mask] = std::move(items[i]);
+    }
+    _tail.store(tail + n, std::memory_order_release);
+    return n;
+  }
+
+  std::optional<T> pop() {
+    std::optional<T> result;
+    T                item;
+    if (pop(item)) result.emplace(std::move(item));
+    return result;
+  }
+
+  /**
+   * @brief Dequeue the front-most element into item
+   *
+   * @return false if the queue is empty
+   */
+  bool pop(T& item) { return pop_batch(&item, 1) == 1; }
+
+  /**
+   * @brief Move up to max_count elements out of the queue
+   *
+   * @return size_t the number of elements written to out
+   */
+  auto pop_batch(T* out, size_t max_count) -> size_t {
+    size_t head      = _head.load(std::memory_order_relaxed);
+    size_t available = _tail_cache - head;
+    if (available < max_count) {
+      _tail_cache = _tail.load(std::memory_order_acquire);
+      available   = _tail_cache - head;
+    }
+    size_t n = std::min(available, max_count);
+    for (size_t i = 0; i < n; ++i) {
+      out[i] = std::move(_buffer[(head + i) & _mask]);
+    }
+    _head.store(head + n, std::memory_order_release);
+    return n;
+  }
+
+  bool empty() const {
+    return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+  }
+
+  auto size() const -> size_t {
+    return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+  }
+
+  auto Capacity() const -> size_t { return _mask + 1; }
+
+ private:
+  template <typename U>
+  bool emplace(U&& item) {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail - _head_cache == Capacity()) {
+      _head_cache = _head.load(std::memory_order_acquire);
+      if (tail - _head_cache == Capacity()) return false;
+    }
+    _buffer[tail & _mask] = std::forward<U>(item);
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  const size_t                                _mask;
+  std::unique_ptr<T[]>                        _buffer;
+
+  // Consumer line: its own position and its last view of the producer's
+  alignas(kCacheLineSize) std::atomic<size_t> _head{0};
+  size_t                                      _tail_cache = 0;
+  // Producer line
+  alignas(kCacheLineSize) std::atomic<size_t> _tail{0};
+  size_t                                      _head_cache = 0;
+};
+
+/**
+ * @brief A bounded lock-free queue for any number of producers and consumers.
+ *
+ * Every slot carries a sequence number telling which lap of the ring it is ready for, so a
+ * producer and a consumer only ever contend on the same slot when the queue is full or empty.
+ */
+template <typename T>
+class MPMCRingBuffer {
+ public:
+  using value_type = T;
+
+  explicit MPMCRingBuffer(size_t capacity)
+      : _mask(RingCapacity(capacity) - 1), _buffer(std::make_unique<Slot[]>(_mask + 1)) {
+    for (size_t i = 0; i <= _mask; ++i) {
+      _buffer[i]._sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  MPMCRingBuffer(const MPMCRingBuffer&)            = delete;
+  MPMCRingBuffer& operator=(const MPMCRingBuffer&) = delete;
+
+  bool push(const T& item) { return emplace(item); }
+
+  /**
+   * @brief Enqueue an element, the element is only moved from when the call succeeds
+   *
+   * @return false if the queue is full
+   */
+  bool push(T&& item) { return emplace(std::move(item)); }
+
+  /**
+   * @brief Claim a run of free slots with a single CAS and move up to count elements into them
+   *
+   * @return size_t the number of elements enqueued, a prefix of items
+   */
+  auto push_batch(T* items, size_t count) -> size_t {
+    size_t pos = _tail.load(std::memory_order_relaxed);
+    size_t n   = 0;
+    while (true) {
+      n = FreeRun(pos, count, 0);
+      if (n == 0) {
+        if (IsBehind(pos, 0)) return 0;  // queue is full
+        pos = _tail.load(std::memory_order_relaxed);
+        continue;
+      }
+      if (_tail.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) break;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      Slot& slot = _buffer[(pos + i) & _mask];
+      slot._data = std::move(items[i]);
+      slot._sequence.store(pos + i + 1, std::memory_order_release);
+    }
+    return n;
+  }
+
+  std::optional<T> pop() {
+    std::optional<T> result;
+    T                item;
+    if (pop(item)) result.emplace(std::move(item));
+    return result;
+  }
+
+  /**
+   * @brief Dequeue the front-most element into item
+   *
+   * @return false if the queue is empty
+   */
+  bool pop(T& item) { return pop_batch(&item, 1) == 1; }
+
+  /**
+   * @brief Claim a run of filled slots with a single CAS and move them out
+   *
+   * @return size_t the number of elements written to out
+   */
+  auto pop_batch(T* out, size_t max_count) -> size_t {
+    size_t pos = _head.load(std::memory_order_relaxed);
+    size_t n   = 0;
+    while (true) {
+      n = FreeRun(pos, max_count, 1);
+      if (n == 0) {
+        if (IsBehind(pos, 1)) return 0;  // queue is empty
+        pos = _head.load(std::memory_order_relaxed);
+        continue;
+      }
+      if (_head.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) break;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      Slot& slot = _buffer[(pos + i) & _mask];
+      out[i]     = std::move(slot._data);
+      slot._sequence.store(pos + i + Capacity(), std::memory_order_release);
+    }
+    return n;
+  }
+
+  bool empty() const {
+    return _head.load(std::memory_order_acquire) >= _tail.load(std::memory_order_acquire);
+  }
+
+  auto size() const -> size_t {
+    size_t head = _head.load(std::memory_order_acquire);
+    size_t tail = _tail.load(std::memory_order_acquire);
+    return tail > head ? tail - head : 0;
+  }
+
+  auto Capacity() const -> size_t { return _mask + 1; }
+
+ private:
+  struct alignas(kCacheLineSize) Slot {
+    std::atomic<size_t> _sequence;
+    T                   _data;
+  };
+
+  template <typename U>
+  bool emplace(U&& item) {
+    size_t pos = _tail.load(std::memory_order_relaxed);
+    while (true) {
+      if (FreeRun(pos, 1, 0) == 1) {
+        if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+      } else if (IsBehind(pos, 0)) {
+        return false;  // queue is full
+      } else {
+        pos = _tail.load(std::memory_order_relaxed);  // another producer claimed pos
+      }
+    }
+    Slot& slot = _buffer[pos & _mask];
+    slot._data = std::forward<U>(item);
+    slot._sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Count the consecutive slots from pos whose sequence is pos + offset, i.e. free slots
+   * for producers (offset 0) or filled slots for consumers (offset 1)
+   */
+  auto FreeRun(size_t pos, size_t max_count, size_t offset) const -> size_t {
+    size_t n = 0;
+    while (n < max_count && n <= _mask) {
+      size_t seq = _buffer[(pos + n) & _mask]._sequence.load(std::memory_order_acquire);
+      if (seq != pos + n + offset) break;
+      ++n;
+    }
+    return n;
+  }
+
+  /**
+   * @brief Whether the slot at pos still holds the previous lap, i.e. the ring is full for
+   * producers or empty for consumers rather than pos being stale
+   */
+  auto IsBehind(size_t pos, size_t offset) const -> bool {
+    size_t seq = _buffer[pos & _mask]._sequence.load(std::memory_order_acquire);
+    return static_cast<intptr_t>(seq - (pos + offset)) < 0;
+  }
+
+  const size_t                                _mask;
+  std::unique_ptr<Slot[]>                     _buffer;
+  alignas(kCacheLineSize) std::atomic<size_t> _head{0};
+  alignas(kCacheLineSize) std::atomic<size_t> _tail{0};
+};
+
+/**
+ * @brief Blocking push/pop over a bounded ring buffer. Threads park on C++20 atomic wait
+ * instead of a mutex and condition variables, and the fast path never touches a wait word
+ * unless someone is actually parked.
+ *
+ * @tparam Ring SPSCRingBuffer or MPMCRingBuffer
+ */
+template <typename Ring>
+class BlockingRingBuffer {
+ public:
+  using T = typename Ring::value_type;
+
+  explicit BlockingRingBuffer(size_t capacity) : _ring(capacity) {}
+
+  /**
+   * @brief Enqueue an element, blocks while the queue is full
+   */
+  void push(T item) {
+    while (true) {
+      uint32_t epoch = _pop_epoch.load(std::memory_order_acquire);
+      if (_ring.push(std::move(item))) {
+        Published(_push_epoch, _waiting_consumers, false);
+        return;
+      }
+      Park(_pop_epoch, _waiting_producers, epoch);
+    }
+  }
+
+  /**
+   * @brief Enqueue all count elements, blocks until every one of them fits
+   */
+  void push_batch(T* items, size_t count) {
+    while (count > 0) {
+      uint32_t epoch  = _pop_epoch.load(std::memory_order_acquire);
+      size_t   pushed = _ring.push_batch(items, count);
+      if (pushed > 0) {
+        Published(_push_epoch, _waiting_consumers, pushed > 1);
+        items += pushed;
+        count -= pushed;
+        continue;
+      }
+      Park(_pop_epoch, _waiting_producers, epoch);
+    }
+  }
+
+  /**
+   * @brief Dequeue the front-most element, blocks while the queue is empty
+   */
+  T pop() {
+    T item;
+    pop_batch(&item, 1);
+    return item;
+  }
+
+  /**
+   * @brief Dequeue up to max_count elements, blocks until at least one is available
+   *
+   * @return size_t the number of elements written to out
+   */
+  auto pop_batch(T* out, size_t max_count) -> size_t {
+    while (true) {
+      uint32_t epoch  = _push_epoch.load(std::memory_order_acquire);
+      size_t   popped = _ring.pop_batch(out, max_count);
+      if (popped > 0) {
+        Published(_pop_epoch, _waiting_producers, popped > 1);
+        return popped;
+      }
+      Park(_push_epoch, _waiting_consumers, epoch);
+    }
+  }
+
+  bool try_push(T&& item) {
+    if (!_ring.push(std::move(item))) return false;
+    Published(_push_epoch, _waiting_consumers, false);
+    return true;
+  }
+
+  std::optional<T> try_pop() {
+    auto item = _ring.pop();
+    if (item.has_value()) Published(_pop_epoch, _waiting_producers, false);
+    return item;
+  }
+
+  bool empty() const { return _ring.empty(); }
+
+  auto size() const -> size_t { return _ring.size(); }
+
+ private:
+  /**
+   * @brief Advance the epoch the other side waits on and wake it if anyone is parked. The
+   * epoch bump and the waiter check are both seq_cst, pairing with Park so that a parking
+   * thread either sees the new epoch or is seen as a waiter.
+   */
+  static void Published(std::atomic<uint32_t>& epoch, std::atomic<uint32_t>& waiting,
+                        bool wake_all) {
+    epoch.fetch_add(1);
+    if (waiting.load() == 0) return;
+    if (wake_all) {
+      epoch.notify_all();
+    } else {
+      epoch.notify_one();
+    }
+  }
+
+  /**
+   * @brief Wait until the other side moves epoch past seen. Yields for a few rounds before
+   * registering as a waiter, so a busy peer gets the core and never has to pay for a wake-up.
+   */
+  static void Park(std::atomic<uint32_t>& epoch, std::atomic<uint32_t>& waiting,
+                   uint32_t seen) {
+    for (size_t round = 0; round < _spin_rounds; ++round) {
+      if (epoch.load(std::memory_order_acquire) != seen) return;
+      std::this_thread::yield();
+    }
+    waiting.fetch_add(1);
+    epoch.wait(seen);
+    waiting.fetch_sub(1);
+  }
+
+  static constexpr size_t                       _spin_rounds = 64;
+
+  Ring                                          _ring;
+  alignas(kCacheLineSize) std::atomic<uint32_t> _push_epoch{0};
+  std::atomic<uint32_t>                         _waiting_consumers{0};
+  alignas(kCacheLineSize) std::atomic<uint32_t> _pop_epoch{0};
+  std::atomic<uint32_t>                         _waiting_producers{0};
+};
+};  // namespace puerhlab
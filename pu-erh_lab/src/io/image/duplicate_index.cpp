@@ -0,0 +1,185 @@
+/*
+ * @file        pu-erh_lab/src/io/image/duplicate_index.cpp
+ * @brief       Pre-decode detection of files which were already imported
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "io/image/duplicate_index.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <system_error>
+#include <vector>
+#include <xxhash.hpp>
+
+namespace puerhlab {
+/**
+ * @brief Compute the signature of a file. Files of up to two blocks are hashed whole.
+ *
+ * @param path
+ * @return std::optional<QuickSignature> std::nullopt if the file cannot be read
+ */
+auto QuickSignature::FromFile(const image_path_t& path) -> std::optional<QuickSignature> {
+  std::error_code ec;
+  auto            file_size = std::filesystem::file_size(path, ec);
+  if (ec) {
+    return std::nullopt;
+  }
+  auto modified_time = std::filesystem::last_write_time(path, ec);
+  if (ec) {
+    return std::nullopt;
+  }
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return std::nullopt;
+  }
+
+  std::vector<char> blocks(static_cast<size_t>(std::min<uint64_t>(file_size, 2 * _block_size)));
+  if (file_size <= 2 * _block_size) {
+    file.read(blocks.data(), static_cast<std::streamsize>(blocks.size()));
+  } else {
+    file.read(blocks.data(), _block_size);
+    file.seekg(static_cast<std::streamoff>(file_size - _block_size));
+    file.read(blocks.data() + _block_size, _block_size);
+  }
+  if (!file) {
+    return std::nullopt;
+  }
+  return QuickSignature{file_size, static_cast<int64_t>(modified_time.time_since_epoch().count()),
+                        xxh::xxhash3<64>(blocks.data(), blocks.size(), file_size)};
+}
+
+/**
+ * @brief Register a known file
+ *
+ * @param signature
+ * @param content_hash may be empty, the entry then only matches on the modification time
+ */
+void DuplicateIndex::Add(const QuickSignature& signature, const ContentHash& content_hash) {
+  std::lock_guard<std::mutex> lock(_mtx);
+  auto&                       bucket = _entries[signature._partial_hash];
+  for (const auto& entry : bucket) {
+    if (entry._file_size == signature._file_size &&
+        entry._modified_time == signature._modified_time &&
+        entry._content_hash == content_hash) {
+      return;
+    }
+  }
+  bucket.push_back({signature._file_size, signature._modified_time, content_hash});
+  ++_size;
+}
+
+/**
+ * @brief Register an imported image, its file is read to compute the signature
+ *
+ * @param image
+ * @return true the image is now known
+ * @return false its file cannot be read anymore
+ */
+auto DuplicateIndex::Add(const Image& image) -> bool {
+  auto signature = QuickSignature::FromFile(image._image_path);
+  if (!signature.has_value()) {
+    return false;
+  }
+  Add(*signature, image._content_hash);
+  return true;
+}
+
+/**
+ * @brief Check whether the content of a file has already been imported
+ *
+ * @param path
+ * @return true the file is a duplicate of a known image
+ * @return false the file is new, or cannot be read, in which case the decoder reports the failure
+ */
+auto DuplicateIndex::Contains(const image_path_t& path) -> bool {
+  auto signature = QuickSignature::FromFile(path);
+  if (!signature.has_value()) {
+    return false;
+  }
+  return Contains(path, *signature);
+}
+
+/**
+ * @brief Same as Contains(path), with a signature the caller already computed for the file
+ *
+ * @param path
+ * @param signature
+ * @return true
+ * @return false
+ */
+auto DuplicateIndex::Contains(const image_path_t& path, const QuickSignature& signature) -> bool {
+  bool collision = false;
+  {
+    std::lock_guard<std::mutex> lock(_mtx);
+    auto                        it = _entries.find(signature._partial_hash);
+    if (it == _entries.end()) {
+      return false;
+    }
+    for (const auto& entry : it->second) {
+      if (entry._file_size != signature._file_size) {
+        continue;
+      }
+      if (entry._modified_time == signature._modified_time) {
+        return true;
+      }
+      collision = collision || !entry._content_hash.IsEmpty();
+    }
+  }
+  if (!collision) {
+    return false;
+  }
+
+  // Hashed without holding the lock, the whole file is read
+  auto content_hash = ContentHash::FromFile(path);
+  if (!content_hash.has_value()) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(_mtx);
+  auto&                       bucket = _entries[signature._partial_hash];
+  auto                        same   = [&](const Entry& e) {
+    return e._file_size == signature._file_size && e._content_hash == *content_hash;
+  };
+  bool                        found  = std::any_of(bucket.begin(), bucket.end(), same);
+  if (found) {
+    // Remember this copy so that the next import matches it without reading it whole
+    bucket.push_back({signature._file_size, signature._modified_time, *content_hash});
+    ++_size;
+  }
+  return found;
+}
+
+auto DuplicateIndex::Size() -> size_t {
+  std::lock_guard<std::mutex> lock(_mtx);
+  return _size;
+}
+};  // namespace puerhlab
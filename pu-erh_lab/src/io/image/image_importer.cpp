@@ -0,0 +1,305 @@
+/*
+ * @file        pu-erh_lab/src/io/image/image_importer.cpp
+ * @brief       Streaming import of image files with bounded in-flight work
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "io/image/image_importer.hpp"
+
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+
+#include "decoders/decoder_scheduler.hpp"
+#include "image/sidecar.hpp"
+#include "type/supported_file_type.hpp"
+
+namespace puerhlab {
+namespace {
+using SignatureMap = std::unordered_map<image_path_t::string_type, QuickSignature>;
+};  // namespace
+
+/**
+ * @brief Construct a new DirectoryWalker object
+ *
+ * @param root the directory to walk, nothing is yielded if it is not a readable directory
+ * @param recursive whether to descend into sub-directories
+ * @param pair_sidecars whether to skip the JPEG files shot together with a raw file
+ */
+DirectoryWalker::DirectoryWalker(const image_path_t& root, bool recursive, bool pair_sidecars)
+    : _recursive(recursive), _pair_sidecars(pair_sidecars) {
+  std::error_code                     ec;
+  std::filesystem::directory_iterator it(
+      root, std::filesystem::directory_options::skip_permission_denied, ec);
+  if (!ec) {
+    _stack.push_back(std::move(it));
+  }
+}
+
+/**
+ * @brief Advance to the next supported file, directories are visited depth-first
+ *
+ * @return std::optional<image_path_t> std::nullopt once the whole tree has been walked
+ */
+auto DirectoryWalker::Next() -> std::optional<image_path_t> {
+  while (!_stack.empty()) {
+    auto& it = _stack.back();
+    if (it == std::filesystem::directory_iterator{}) {
+      _stack.pop_back();
+      continue;
+    }
+    std::filesystem::directory_entry entry = *it;
+    std::error_code                  ec;
+    it.increment(ec);
+    if (ec) {
+      // Unreadable entry, give up on the rest of this directory
+      it = std::filesystem::directory_iterator{};
+    }
+
+    if (_recursive && entry.is_directory(ec) && !entry.is_symlink(ec)) {
+      std::filesystem::directory_iterator child(
+          entry.path(), std::filesystem::directory_options::skip_permission_denied, ec);
+      if (!ec) {
+        _stack.push_back(std::move(child));
+      }
+      continue;
+    }
+    if (!is_supported_file(entry.path())) {
+      continue;
+    }
+    if (_pair_sidecars && Sidecar::HasRawSibling(entry.path())) {
+      continue;
+    }
+    return entry.path();
+  }
+  return std::nullopt;
+}
+
+void ImportControl::Pause() {
+  std::lock_guard<std::mutex> lock(_mtx);
+  _paused = true;
+}
+
+void ImportControl::Resume() {
+  {
+    std::lock_guard<std::mutex> lock(_mtx);
+    _paused = false;
+  }
+  _cv.notify_all();
+}
+
+void ImportControl::Cancel() {
+  {
+    std::lock_guard<std::mutex> lock(_mtx);
+    _token.Cancel();
+  }
+  _cv.notify_all();
+}
+
+auto ImportControl::IsPaused() -> bool {
+  std::lock_guard<std::mutex> lock(_mtx);
+  return _paused;
+}
+
+auto ImportControl::IsCancelled() const -> bool { return _token.IsCancelled(); }
+
+auto ImportControl::Token() const -> CancellationToken { return _token; }
+
+/**
+ * @brief Block the calling thread while the import is paused
+ *
+ * @return true the import may go on
+ * @return false the import has been cancelled
+ */
+auto ImportControl::WaitWhilePaused() -> bool {
+  std::unique_lock<std::mutex> lock(_mtx);
+  _cv.wait(lock, [this] { return !_paused || _token.IsCancelled(); });
+  return !_token.IsCancelled();
+}
+
+/**
+ * @brief Construct a new ImageImporter object
+ *
+ * @param loader the loader used to decode the files, its decoded buffer must not be consumed by
+ * anyone else during an import
+ * @param max_in_flight maximum number of files scheduled but not yet collected
+ * @param decode_type SLEEVE_LOADING reads the metadata only, IMPORT also produces the thumbnail
+ * and the checksum
+ */
+ImageImporter::ImageImporter(ImageLoader& loader, uint32_t max_in_flight, DecodeType decode_type)
+    : _loader(loader), _max_in_flight(max_in_flight), _decode_type(decode_type) {}
+
+/**
+ * @brief Skip the files found in known_files. The check happens before a file is scheduled, so a
+ * duplicate costs a stat and two block reads instead of a full read and decode. The imported
+ * files are added to known_files with the signature computed by the check.
+ *
+ * @param known_files nullptr to import every file
+ */
+void ImageImporter::SetDuplicateIndex(std::shared_ptr<DuplicateIndex> known_files) {
+  _known_files = std::move(known_files);
+}
+
+/**
+ * @brief Time the duplicate pre-check of every file. The loader needs the same profiler for the
+ * stages it runs, see ImageLoader::SetImportProfiler.
+ *
+ * @param profiler nullptr to stop profiling
+ */
+void ImageImporter::SetImportProfiler(std::shared_ptr<ImportProfiler> profiler) {
+  _profiler = std::move(profiler);
+}
+
+auto ImageImporter::IsKnown(const image_path_t& path, std::optional<QuickSignature>& signature)
+    -> bool {
+  ImportStageTimer timer(_profiler.get(), path, ImportStage::DEDUP);
+  signature = QuickSignature::FromFile(path);
+  return signature.has_value() && _known_files->Contains(path, *signature);
+}
+
+/**
+ * @brief Count the requests which have finished. Every successful request pushes exactly one
+ * image to the loader's buffer, failed or cancelled ones push nothing.
+ *
+ * @param in_flight
+ * @param progress
+ * @return size_t number of requests which succeeded
+ */
+auto ImageImporter::Resolve(std::deque<std::future<image_id_t>>& in_flight,
+                            ImportProgress&                      progress) -> size_t {
+  size_t succeeded = 0;
+  for (auto it = in_flight.begin(); it != in_flight.end();) {
+    if (it->wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      ++it;
+      continue;
+    }
+    try {
+      it->get();
+      ++succeeded;
+    } catch (OperationCancelled&) {
+      ++progress._cancelled;
+    } catch (std::exception&) {
+      ++progress._failed;
+    }
+    it = in_flight.erase(it);
+  }
+  return succeeded;
+}
+
+/**
+ * @brief Import every path produced by next_path. Paths are only pulled from the source when a
+ * slot frees up, so neither the path list nor the promises of the whole import are materialized.
+ *
+ * The importer never blocks on a future: the loader's buffer is bounded, so a decoder may be
+ * waiting for the importer to take an image before it can fulfil its promise.
+ *
+ * @param next_path
+ * @param on_loaded invoked on the calling thread for every imported image
+ * @param on_progress invoked on the calling thread after every collected file
+ * @param control optional, used to pause or cancel the import from another thread
+ * @return ImportProgress the final counters
+ */
+auto ImageImporter::Import(PathSource next_path, LoadedCallback on_loaded,
+                           ProgressCallback on_progress, std::shared_ptr<ImportControl> control)
+    -> ImportProgress {
+  ImportProgress                      progress;
+  CancellationToken                   token = control ? control->Token() : CancellationToken{};
+  std::deque<std::future<image_id_t>> in_flight;
+  bool                                exhausted = false;
+  // Images announced by a fulfilled promise and images taken from the buffer, an image may be
+  // taken before its promise is fulfilled
+  size_t                              succeeded = 0;
+  size_t                              taken     = 0;
+  // Signatures of the scheduled files, registered in the index once their image is taken
+  SignatureMap                        signatures;
+
+  while (true) {
+    bool running = !control || control->WaitWhilePaused();
+    // Cancelled: requests which have not been read yet are dropped by the scheduler, the images
+    // which were already decoded are discarded. Both are counted as cancelled.
+    size_t waiting        = succeeded > taken ? succeeded - taken : 0;
+    auto   skipped_before = progress._skipped;
+    while (running && !exhausted && in_flight.size() + waiting < _max_in_flight) {
+      auto path = next_path();
+      if (!path.has_value()) {
+        exhausted = true;
+        break;
+      }
+      ++progress._discovered;
+      if (_known_files) {
+        std::optional<QuickSignature> signature;
+        if (IsKnown(*path, signature)) {
+          ++progress._skipped;
+          continue;
+        }
+        if (signature.has_value()) {
+          signatures.insert_or_assign(path->native(), *signature);
+        }
+      }
+      in_flight.push_back(_loader.StartLoading(std::move(*path), _decode_type,
+                                               DecodePriority::BACKGROUND, token));
+    }
+
+    auto failed_before    = progress._failed;
+    auto cancelled_before = progress._cancelled;
+    succeeded += Resolve(in_flight, progress);
+    bool changed = progress._failed != failed_before || progress._skipped != skipped_before ||
+                   progress._cancelled != cancelled_before;
+    if ((exhausted || !running) && in_flight.empty() && taken >= succeeded) {
+      break;
+    }
+
+    if (auto img = _loader.TryLoadImage(_poll_interval)) {
+      ++taken;
+      if (auto it = signatures.find(img->_image_path.native()); it != signatures.end()) {
+        if (running) {
+          _known_files->Add(it->second, img->_content_hash);
+        }
+        signatures.erase(it);
+      }
+      if (running) {
+        on_loaded(std::move(img));
+        ++progress._imported;
+      } else {
+        ++progress._cancelled;
+      }
+      changed = true;
+    }
+    if (changed && on_progress) {
+      on_progress(progress);
+    }
+  }
+  return progress;
+}
+};  // namespace puerhlab
@@ -30,37 +30,92 @@
 
 #include "io/image/image_loader.hpp"
 
+#include <chrono>
+#include <coroutine>
 #include <cstddef>
 #include <cstdint>
 #include <future>
 #include <memory>
+#include <stdexcept>
+#include <utility>
 
 #include "decoders/decoder_scheduler.hpp"
 #include "type/supported_file_type.hpp"
 #include "type/type.hpp"
 
 namespace puerhlab {
+namespace {
+/**
+ * @brief Suspends a coroutine until the decoder scheduler has finished a request, the
+ * coroutine is resumed on the thread which finished it
+ */
+class DecodeAwaiter {
+ public:
+  DecodeAwaiter(DecoderScheduler& scheduler, std::shared_ptr<Image> image, DecodeType decode_type,
+                DecodePriority priority, CancellationToken token)
+      : _scheduler(scheduler),
+        _image(std::move(image)),
+        _decode_type(decode_type),
+        _priority(priority),
+        _token(std::move(token)) {}
+
+  auto await_ready() const noexcept -> bool { return false; }
+
+  void await_suspend(std::coroutine_handle<> handle) {
+    auto promise = std::make_shared<std::promise<image_id_t>>();
+    _result      = promise->get_future();
+    // The coroutine may be resumed before ScheduleDecode returns, the awaiter must not be
+    // touched after the call
+    _scheduler.ScheduleDecode(_image, _decode_type, std::move(promise),
+                              [handle] { handle.resume(); }, _priority, std::move(_token));
+  }
+
+  auto await_resume() -> std::shared_ptr<Image> {
+    // Already satisfied, get() only rethrows the error of a failed request
+    _result.get();
+    return std::move(_image);
+  }
+
+ private:
+  DecoderScheduler&       _scheduler;
+  std::shared_ptr<Image>  _image;
+  DecodeType              _decode_type;
+  DecodePriority          _priority;
+  CancellationToken       _token;
+  std::future<image_id_t> _result;
+};
+};  // namespace
+
 /**
  * @brief Construct a new ImageLoader::ImageLoader object
  *
  * @param buffer_size size of loader's buffer
- * @param use_thread number of thread used to decode image
+ * @param use_thread number of files read at once when io_uring is not available, decoding runs
+ * on the shared executor
+ * @param buffer_bytes estimated size of the decoded images the buffer may hold, 0 for no limit
+ * @param read_queue_depth number of file reads kept in flight when io_uring is available
  */
-ImageLoader::ImageLoader(uint32_t buffer_size, size_t use_thread, image_id_t start_id)
-    : _buffer_decoded(std::make_shared<BufferQueue>(buffer_size)),
+ImageLoader::ImageLoader(uint32_t buffer_size, size_t use_thread, image_id_t start_id,
+                         size_t buffer_bytes, uint32_t read_queue_depth)
+    : _buffer_decoded(std::make_shared<BufferQueue>(
+          buffer_size, buffer_bytes,
+          [](const std::shared_ptr<Image>& img) { return img ? img->EstimateBytes() : 0; })),
       _buffer_size(buffer_size),
+      _buffer_bytes(buffer_bytes),
       _use_thread(use_thread),
       _start_id(start_id),
       _next_id(start_id),
-      _decoder_scheduler(use_thread, _buffer_decoded) {}
+      _decoder_scheduler(use_thread, _buffer_decoded, read_queue_depth) {}
 
 /**
  * @brief Loads a batch of images
  *
  * @param images
  * @param decode_type
+ * @param token cancel it to drop the requests which have not been started yet
  */
-void ImageLoader::StartLoading(std::vector<image_path_t> images, DecodeType decode_type) {
+void ImageLoader::StartLoading(std::vector<image_path_t> images, DecodeType decode_type,
+                               CancellationToken token) {
   for (const auto& img : images) {
     // Skip unsupported file type
     // if (!is_supported_file(img)) {
@@ -68,9 +123,10 @@ void ImageLoader::StartLoading(std::vector<image_path_t> images, DecodeType deco
     // }
 
     promises.emplace_back(std::make_shared<std::promise<image_id_t>>());
-    futures.emplace_back(promises[_next_id]->get_future());
+    futures.emplace_back(promises.back()->get_future());
     if (decode_type == DecodeType::SLEEVE_LOADING)
-      _decoder_scheduler.ScheduleDecode(_next_id, img, promises[_next_id]);
+      _decoder_scheduler.ScheduleDecode(_next_id, img, promises.back(),
+                                        DecodePriority::BACKGROUND, token);
     ++_next_id;
   }
 }
@@ -80,18 +136,120 @@ void ImageLoader::StartLoading(std::vector<image_path_t> images, DecodeType deco
  *
  * @param images
  * @param decode_type
+ * @param priority requests with higher priority are read and decoded first
+ * @param token cancel it to drop the request if it has not been started yet
  */
-void ImageLoader::StartLoading(std::shared_ptr<Image> image, DecodeType decode_type) {
+void ImageLoader::StartLoading(std::shared_ptr<Image> image, DecodeType decode_type,
+                               DecodePriority priority, CancellationToken token) {
   promises.emplace_back(std::make_shared<std::promise<image_id_t>>());
-  futures.emplace_back(promises[_next_id]->get_future());
-  _decoder_scheduler.ScheduleDecode(image, decode_type, promises[_next_id]);
+  futures.emplace_back(promises.back()->get_future());
+  _decoder_scheduler.ScheduleDecode(image, decode_type, promises.back(), priority,
+                                    std::move(token));
   ++_next_id;
 }
 
+/**
+ * @brief Loads a single file without retaining its promise, the caller owns the returned future.
+ * Used to stream large imports with a bounded number of requests in flight.
+ *
+ * @param image_path
+ * @param decode_type SLEEVE_LOADING or IMPORT
+ * @param priority
+ * @param token cancel it to drop the request if it has not been started yet
+ * @return std::future<image_id_t>
+ */
+auto ImageLoader::StartLoading(image_path_t image_path, DecodeType decode_type,
+                               DecodePriority priority, CancellationToken token)
+    -> std::future<image_id_t> {
+  auto promise = std::make_shared<std::promise<image_id_t>>();
+  auto future  = promise->get_future();
+  _decoder_scheduler.ScheduleDecode(_next_id++, std::move(image_path), decode_type,
+                                    std::move(promise), priority, std::move(token));
+  return future;
+}
+
+/**
+ * @brief Load image data into image without blocking a thread while it is read and decoded.
+ * The image is not pushed to the buffer read by LoadImage().
+ *
+ * @param image
+ * @param decode_type THUMB, RAW or REGULAR
+ * @param priority
+ * @param token cancels the request at the next stage boundary
+ * @return Task<std::shared_ptr<Image>> image once loaded. The awaiting coroutine is resumed on
+ * the thread completing the request: a CPU pool thread once decoded, but an IO pool thread when a
+ * THUMB request is served from the thumbnail store. CPU-heavy continuations should move on with
+ * co_await Executor::Instance().Cpu().Schedule(). Throws if the request failed, and
+ * OperationCancelled if it was cancelled; a request still waiting to be read is failed at once,
+ * on the thread cancelling the token.
+ */
+auto ImageLoader::LoadAsync(std::shared_ptr<Image> image, DecodeType decode_type,
+                            DecodePriority priority, CancellationToken token)
+    -> Task<std::shared_ptr<Image>> {
+  co_return co_await DecodeAwaiter{_decoder_scheduler, std::move(image), decode_type, priority,
+                                   std::move(token)};
+}
+
+/**
+ * @brief co_await loader.LoadThumb(img) loads the thumbnail of img, see LoadAsync(). Thumbnails
+ * found in the thumbnail store resume the caller on the IO pool.
+ *
+ * @param image
+ * @param priority
+ * @param token
+ * @return Task<std::shared_ptr<Image>>
+ */
+auto ImageLoader::LoadThumb(std::shared_ptr<Image> image, DecodePriority priority,
+                            CancellationToken token) -> Task<std::shared_ptr<Image>> {
+  return LoadAsync(std::move(image), DecodeType::THUMB, priority, std::move(token));
+}
+
 auto ImageLoader::LoadImage() -> std::shared_ptr<Image> {
   // If there's no finished image in the buffer, will block the load routine
   std::shared_ptr<Image> img = _buffer_decoded->pop();
   return img;
 }
 
+/**
+ * @brief Same as LoadImage(), but gives up after timeout
+ *
+ * @param timeout
+ * @return std::shared_ptr<Image> nullptr if no image was decoded in time
+ */
+auto ImageLoader::TryLoadImage(std::chrono::milliseconds timeout) -> std::shared_ptr<Image> {
+  return _buffer_decoded->try_pop_for(timeout).value_or(nullptr);
+}
+
+/**
+ * @brief Let THUMB requests be served from (and written back to) a persistent thumbnail store
+ *
+ * @param store
+ */
+void ImageLoader::SetThumbnailStore(std::shared_ptr<ThumbnailStore> store) {
+  _decoder_scheduler.SetThumbnailStore(std::move(store));
+}
+
+/**
+ * @brief Time the stages IMPORT requests go through, see ImportStage
+ *
+ * @param profiler nullptr to stop profiling
+ */
+void ImageLoader::SetImportProfiler(std::shared_ptr<ImportProfiler> profiler) {
+  _decoder_scheduler.SetImportProfiler(std::move(profiler));
+}
+
+/**
+ * @brief Return the metrics of the stages the requests of this loader go through
+ *
+ * @return std::vector<StageMetrics>
+ */
+auto ImageLoader::Metrics() -> std::vector<StageMetrics> { return _decoder_scheduler.Metrics(); }
+
+/**
+ * @brief Return the id the next file loaded by path receives
+ *
+ * @return image_id_t
+ */
+auto ImageLoader::NextId() const -> image_id_t { return _next_id; }
+
 };  // namespace puerhlab
\ No newline at end of file
@@ -15,6 +15,7 @@
 namespace puerhlab {
 FileSystem::FileSystem(std::filesystem::path db_path, sl_element_id_t start_id)
     : _id_gen(start_id),
+      _image_id_gen(0),
       _db_path(db_path),
       _storage_service(db_path),
       _storage_handler(_storage_service.GetElementController(), _storage),
@@ -102,6 +103,21 @@ void FileSystem::Copy(std::filesystem::path from, std::filesystem::path dest) {
   dest_node->AddElementToMap(from_node);
 }
 
+// The generator holds the next free id, so that the first image imported into a sleeve gets id 0
+auto FileSystem::NextImageId() -> image_id_t { return _image_id_gen.GetCurrentID(); }
+
+// Marks the ids below next_id as used, e.g. once an import assigned them
+void FileSystem::ReserveImageIds(image_id_t next_id) {
+  if (next_id > NextImageId()) {
+    _image_id_gen.SetStartID(next_id);
+  }
+}
+
+// The images imported by earlier sessions, as stored in the database
+auto FileSystem::GetStoredImages() -> std::vector<std::shared_ptr<Image>> {
+  return _storage_service.GetImageController().GetAllImages();
+}
+
 void FileSystem::SyncToDB() {
   auto& element_ctrl = _storage_service.GetElementController();
   for (auto& pair : _storage) {
@@ -120,6 +136,7 @@ void FileSystem::WriteSleeveMeta(const std::filesystem::path& meta_path) {
   metadata["db_path"]   = conv::ToBytes(_db_path.wstring());
   metadata["meta_path"] = conv::ToBytes(_meta_path.wstring());
   metadata["start_id"]  = _id_gen.GetCurrentID();
+  metadata["image_id"]  = _image_id_gen.GetCurrentID();
 
   std::ofstream file(meta_path);
   if (file.is_open()) {
@@ -136,6 +153,10 @@ void FileSystem::ReadSleeveMeta(const std::filesystem::path& meta_path) {
     _db_path   = std::filesystem::path(conv::FromBytes(metadata["db_path"]));
     _meta_path = std::filesystem::path(conv::FromBytes(metadata["meta_path"]));
     _id_gen.SetStartID(static_cast<uint32_t>(metadata["start_id"]));
+    // Written since images are imported with ids allocated by the sleeve
+    if (metadata.contains("image_id")) {
+      _image_id_gen.SetStartID(static_cast<uint32_t>(metadata["image_id"]));
+    }
   }
 }
 auto FileSystem::Tree(const std::filesystem::path& path) -> std::wstring {
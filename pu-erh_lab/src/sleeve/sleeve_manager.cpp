@@ -5,10 +5,17 @@
 #include <cassert>
 #include <codecvt>
 #include <cstddef>
+#include <algorithm>
 #include <cstdint>
 #include <exception>
 #include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
 
+#include "concurrency/executor.hpp"
+#include "io/image/duplicate_index.hpp"
+#include "io/image/image_importer.hpp"
 #include "io/image/image_loader.hpp"
 #include "sleeve/sleeve_base.hpp"
 #include "sleeve/sleeve_element/sleeve_element.hpp"
@@ -16,6 +23,7 @@
 #include "sleeve/sleeve_filesystem.hpp"
 #include "sleeve/sleeve_view.hpp"
 #include "storage/image_pool/image_pool_manager.hpp"
+#include "storage/thumbnail_store/thumbnail_store.hpp"
 #include "type/type.hpp"
 #include "utils/clock/time_provider.hpp"
 
@@ -29,8 +37,39 @@ SleeveManager::SleeveManager(std::filesystem::path db_path) {
   TimeProvider::Refresh();
   _fs = std::make_shared<FileSystem>(db_path, 0);
   _fs->InitRoot();
-  _image_pool = std::make_shared<ImagePoolManager>(128, 4);
-  _view       = std::make_shared<SleeveView>(_fs, _image_pool);
+  _image_pool      = std::make_shared<ImagePoolManager>();
+  _view            = std::make_shared<SleeveView>(_fs, _image_pool);
+  // Thumbnails persist next to the sleeve database, e.g. "sleeve.db" -> "sleeve.thumbs/"
+  _thumbnail_store =
+      std::make_shared<ThumbnailStore>(std::filesystem::path(db_path).replace_extension(".thumbs"));
+  _view->SetThumbnailStore(_thumbnail_store);
+  _known_files     = std::make_shared<DuplicateIndex>();
+  _import_profiler = std::make_shared<ImportProfiler>();
+  SeedKnownFiles();
+}
+
+/**
+ * @brief Register the images stored by earlier sessions in the duplicate index, so that
+ * re-importing them is a no-op. Their ids are reserved as well, in case the sleeve metadata
+ * predates the image id counter.
+ *
+ */
+void SleeveManager::SeedKnownFiles() {
+  auto       images  = _fs->GetStoredImages();
+  image_id_t next_id = 0;
+  for (const auto& image : images) {
+    next_id = std::max<image_id_t>(next_id, image->_image_id + 1);
+  }
+  _fs->ReserveImageIds(next_id);
+  // A signature costs a stat and two block reads per file, opening the sleeve does not wait for
+  // them. The first import does.
+  auto seed = [known_files = _known_files, images = std::move(images)] {
+    for (const auto& image : images) {
+      known_files->Add(*image);
+    }
+  };
+  _known_files_seeded =
+      Executor::Instance().Io().Submit(std::move(seed), TaskPriority::LOW).share();
 }
 
 /**
@@ -49,7 +88,20 @@ auto SleeveManager::GetView() -> std::shared_ptr<SleeveView> { return _view; }
 
 auto SleeveManager::GetPool() -> std::shared_ptr<ImagePoolManager> { return _image_pool; }
 
-auto SleeveManager::GetImgCount() -> uint32_t { return _image_pool->Capacity(AccessType::META); }
+auto SleeveManager::GetThumbnailStore() -> std::shared_ptr<ThumbnailStore> {
+  return _thumbnail_store;
+}
+
+/**
+ * @brief Return the profiler of the imports, its report covers the last import
+ *
+ * @return std::shared_ptr<ImportProfiler>
+ */
+auto SleeveManager::GetImportProfiler() -> std::shared_ptr<ImportProfiler> {
+  return _import_profiler;
+}
+
+auto SleeveManager::GetImgCount() -> uint32_t { return _image_pool->Count(AccessType::META); }
 
 /**
  * @brief Load a batch of images to the destination path
@@ -59,19 +111,66 @@ auto SleeveManager::GetImgCount() -> uint32_t { return _image_pool->Capacity(Acc
  * @return uint32_t
  */
 auto SleeveManager::LoadToPath(std::vector<image_path_t> img_os_paths, sl_path_t dest) -> uint32_t {
-  ImageLoader loader{256, 8, 0};
-  auto        expected_size = img_os_paths.size();
-  auto        total_size    = 0;
-  loader.StartLoading(std::move(img_os_paths), DecodeType::SLEEVE_LOADING);
-  while (expected_size > 0) {
-    std::shared_ptr<Image> loaded  = loader.LoadImage();
-    auto                   element = _fs->Create(dest, loaded->_image_name, ElementType::FILE);
-    std::static_pointer_cast<SleeveFile>(element)->SetImage(loaded);
-    _image_pool->Insert(loaded);
-    total_size++;
-    --expected_size;
-  }
-  return total_size;
+  size_t next     = 0;
+  auto   progress = ImportFrom(
+      [&]() -> std::optional<image_path_t> {
+        if (next == img_os_paths.size()) return std::nullopt;
+        return std::move(img_os_paths[next++]);
+      },
+      dest, {}, nullptr);
+  return static_cast<uint32_t>(progress._imported);
+}
+
+/**
+ * @brief Import the supported images found under a directory into the destination path. The
+ * directory is walked lazily and only a bounded number of files is in flight at any time.
+ *
+ * @param root
+ * @param dest
+ * @param on_progress invoked on the calling thread after every file
+ * @param control optional, used to pause or cancel the import from another thread
+ * @param recursive whether to descend into sub-directories
+ * @return ImportProgress
+ */
+auto SleeveManager::ImportDirectory(const image_path_t& root, sl_path_t dest,
+                                    ImageImporter::ProgressCallback on_progress,
+                                    std::shared_ptr<ImportControl> control, bool recursive)
+    -> ImportProgress {
+  DirectoryWalker walker{root, recursive};
+  return ImportFrom([&walker] { return walker.Next(); }, dest, std::move(on_progress),
+                    std::move(control));
+}
+
+auto SleeveManager::ImportFrom(ImageImporter::PathSource next_path, sl_path_t dest,
+                               ImageImporter::ProgressCallback on_progress,
+                               std::shared_ptr<ImportControl>  control) -> ImportProgress {
+  _known_files_seeded.wait();
+  // Ids continue after the ones of earlier imports, which the thumbnail store still holds
+  ImageLoader loader{256, 8, _fs->NextImageId()};
+  // Metadata, thumbnail and checksum come from a single read of each file, browsing the new
+  // images afterwards is served from the thumbnail store
+  loader.SetThumbnailStore(_thumbnail_store);
+  _import_profiler->Clear();
+  loader.SetImportProfiler(_import_profiler);
+  ImageImporter importer{loader, ImageImporter::_default_max_in_flight, DecodeType::IMPORT};
+  importer.SetDuplicateIndex(_known_files);
+  importer.SetImportProfiler(_import_profiler);
+  auto progress = importer.Import(
+      std::move(next_path),
+      [this, &dest](std::shared_ptr<Image> loaded) {
+        std::shared_ptr<SleeveElement> element;
+        {
+          ImportStageTimer timer(_import_profiler.get(), loaded->_image_path, ImportStage::CREATE);
+          element = _fs->Create(dest, loaded->_image_name, ElementType::FILE);
+        }
+        ImportStageTimer timer(_import_profiler.get(), loaded->_image_path, ImportStage::INSERT);
+        std::static_pointer_cast<SleeveFile>(element)->SetImage(loaded);
+        _image_pool->Insert(loaded);
+      },
+      std::move(on_progress), std::move(control));
+  // Files which failed or were skipped keep their ids unused
+  _fs->ReserveImageIds(loader.NextId());
+  return progress;
 }
 
 };  // namespace puerhlab
\ No newline at end of file
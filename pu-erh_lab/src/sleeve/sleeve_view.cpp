@@ -1,11 +1,17 @@
 #include "sleeve/sleeve_view.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <exception>
+#include <future>
 #include <memory>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "concurrency/task.hpp"
 #include "io/image/image_loader.hpp"
 #include "sleeve/sleeve_element/sleeve_element.hpp"
 #include "sleeve/sleeve_element/sleeve_file.hpp"
@@ -14,24 +20,69 @@
 #include "type/type.hpp"
 
 namespace puerhlab {
+namespace {
+/**
+ * @brief Load the thumbnail of an image
+ *
+ * @return Task<std::shared_ptr<Image>> nullptr if the request failed or was cancelled
+ */
+auto LoadThumbOrNull(ImageLoader& loader, std::shared_ptr<Image> img, DecodePriority priority,
+                     CancellationToken token) -> Task<std::shared_ptr<Image>> {
+  try {
+    co_return co_await loader.LoadThumb(std::move(img), priority, std::move(token));
+  } catch (...) {
+    // A prefetch runs detached, nothing may escape it
+    co_return nullptr;
+  }
+}
 
-DisplayingImage::DisplayingImage(std::weak_ptr<Image> displaying, bool _require_thumb,
-                                 bool _require_full) {
-  _displaying                = displaying.lock();
-  _displaying->_full_pinned  = _require_full;
-  _displaying->_thumb_pinned = _require_thumb;
+/**
+ * @brief Start a prefetch without waiting for it, its thumbnail is handed over through thumb
+ */
+auto Prefetch(ImageLoader& loader, std::shared_ptr<Image> img, CancellationToken token,
+              std::promise<std::shared_ptr<Image>> thumb) -> DetachedTask {
+  thumb.set_value(
+      co_await LoadThumbOrNull(loader, std::move(img), DecodePriority::PREFETCH, std::move(token)));
 }
+};  // namespace
+
+DisplayingImage::DisplayingImage(std::shared_ptr<ImagePoolManager> pool,
+                                 std::weak_ptr<Image> displaying, bool require_thumb,
+                                 bool require_full)
+    : DisplayingImage(std::move(pool), displaying.lock(), require_thumb, require_full) {}
 
-DisplayingImage::DisplayingImage(std::shared_ptr<Image> displaying, bool _require_thumb,
-                                 bool _require_full) {
-  _displaying                = displaying;
-  _displaying->_full_pinned  = _require_full;
-  _displaying->_thumb_pinned = _require_thumb;
+DisplayingImage::DisplayingImage(std::shared_ptr<ImagePoolManager> pool,
+                                 std::shared_ptr<Image> displaying, bool require_thumb,
+                                 bool require_full)
+    : _pool(std::move(pool)),
+      _displaying(std::move(displaying)),
+      _require_thumb(require_thumb),
+      _require_full(require_full) {
+  if (_require_thumb) {
+    _pool->Pin(_displaying->_image_id, AccessType::THUMB);
+  }
+  if (_require_full) {
+    _pool->Pin(_displaying->_image_id, AccessType::FULL_IMG);
+  }
 }
 
+DisplayingImage::DisplayingImage(DisplayingImage&& other) noexcept
+    : _pool(std::move(other._pool)),
+      _displaying(std::move(other._displaying)),
+      _require_thumb(other._require_thumb),
+      _require_full(other._require_full) {}
+
 DisplayingImage::~DisplayingImage() {
-  _displaying->_full_pinned  = false;
-  _displaying->_thumb_pinned = false;
+  // Moved from
+  if (_displaying == nullptr) {
+    return;
+  }
+  if (_require_thumb) {
+    _pool->Unpin(_displaying->_image_id, AccessType::THUMB);
+  }
+  if (_require_full) {
+    _pool->Unpin(_displaying->_image_id, AccessType::FULL_IMG);
+  }
 }
 
 SleeveView::SleeveView(std::shared_ptr<FileSystem> fs, std::shared_ptr<ImagePoolManager> image_pool)
@@ -74,48 +125,117 @@ void SleeveView::UpdateView(sl_path_t new_viewing_path) {
   UpdateView();
 }
 
+void SleeveView::SetPrefetchMargin(uint32_t margin) { _prefetch_margin = margin; }
+
+void SleeveView::SetThumbnailStore(std::shared_ptr<ThumbnailStore> store) {
+  _loader.SetThumbnailStore(std::move(store));
+}
+
 void SleeveView::LoadPreview(uint32_t range_low, uint32_t range_high,
                              std::function<void(size_t, std::weak_ptr<Image>)> callback) {
-  std::unordered_map<image_id_t, size_t> index_map;
-  uint32_t                               empty_img_count = 0;
-
+  if (_children.empty()) {
+    return;
+  }
   // to_display is a array to store images that require thumbnail lock.
   // once LoadPreview returns, all the images in the to_display will be released from their
   // thumbnail locks
-  std::vector<DisplayingImage>           to_display;
+  std::vector<DisplayingImage> to_display;
   range_high = range_high > _children.size() - 1 ? _children.size() - 1 : range_high;
-  for (size_t i = range_low; i <= range_high; ++i) {
+  size_t prefetch_low  = range_low > _prefetch_margin ? range_low - _prefetch_margin : 0;
+  size_t prefetch_high = std::min<size_t>(range_high + _prefetch_margin, _children.size() - 1);
+
+  // Map the images within the prefetch window to their index in the view
+  std::unordered_map<image_id_t, size_t> index_map;
+  for (size_t i = prefetch_low; i <= prefetch_high; ++i) {
+    auto e_shared = _children[i].lock();
+    if (e_shared->_type == ElementType::FILE) {
+      auto e_file = std::dynamic_pointer_cast<SleeveFile>(e_shared);
+      index_map[e_file->GetImage()->_image_id] = i;
+    }
+  }
+
+  // Requests for images that left the window are stale, drop them before they are decoded
+  for (auto it = _in_flight.begin(); it != _in_flight.end();) {
+    if (!index_map.contains(it->first)) {
+      it->second._token.Cancel();
+      it = _in_flight.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  // Prefetches which completed since the last call. Failed ones are requested again below.
+  for (auto it = _in_flight.begin(); it != _in_flight.end();) {
+    auto& thumb = it->second._thumb;
+    if (thumb.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      ++it;
+      continue;
+    }
+    if (thumb.get() != nullptr) {
+      _image_pool->RecordAccess(it->first, AccessType::THUMB);
+    }
+    it = _in_flight.erase(it);
+  }
+
+  // Visible thumbnails prefetched by an earlier call, awaited through their own request
+  std::vector<image_id_t>                   awaiting;
+  // Visible thumbnails not requested yet
+  std::vector<Task<std::shared_ptr<Image>>> visible_loads;
+  std::vector<image_id_t>                   visible_ids;
+  auto                                      is_visible = [&](size_t i) {
+    return i >= range_low && i <= range_high;
+  };
+  for (size_t i = prefetch_low; i <= prefetch_high; ++i) {
     auto e_shared = _children[i].lock();
     if (e_shared->_type == ElementType::FILE) {
       auto e_file  = std::dynamic_pointer_cast<SleeveFile>(e_shared);
-      auto img_opt = _image_pool->AccessElement(e_file->GetImage()->_image_id, AccessType::THUMB);
-      if (!img_opt.has_value()) {
-        _loader.StartLoading(e_file->GetImage(), DecodeType::THUMB);
-        ++empty_img_count;
+      auto img     = e_file->GetImage();
+      auto img_opt = _image_pool->AccessElement(img->_image_id, AccessType::THUMB);
+      if (img_opt.has_value()) {
+        if (is_visible(i)) {
+          // TODO: notify the UI framework in advance
+          callback(i, img_opt.value());
+          to_display.emplace_back(_image_pool, img_opt.value(), true, false);
+        }
+        continue;
+      }
+      if (_in_flight.contains(img->_image_id)) {
+        if (is_visible(i)) {
+          awaiting.push_back(img->_image_id);
+        }
+        continue;
+      }
+      if (is_visible(i)) {
+        visible_ids.push_back(img->_image_id);
+        visible_loads.push_back(
+            LoadThumbOrNull(_loader, img, DecodePriority::VISIBLE, CancellationToken::Create()));
       } else {
-        // TODO: notify the UI framework in advance
-        callback(i, img_opt.value());
-        to_display.push_back({img_opt.value(), true, false});
+        auto                                 token = CancellationToken::Create();
+        std::promise<std::shared_ptr<Image>> thumb;
+        _in_flight.emplace(img->_image_id, ThumbRequest{token, thumb.get_future()});
+        Prefetch(_loader, img, std::move(token), std::move(thumb));
       }
-      index_map[e_file->GetImage()->_image_id] = i;
     } else {
       // Notify UI to display the "folder icon"
     }
   }
 
-  // The size of the thumbnail cache should be slightly bigger than the window size
-  // TODO: For now, the cache size can only be expanded. It is okay, since the sleeve view will
-  // flush the cache periodically
-  if (_image_pool->Capacity(AccessType::THUMB) < range_high - range_low + 10)
-    _image_pool->ResizeCache(range_high - range_low + 10, AccessType::THUMB);
-  // TODO: Fetch the loaded image, notify UI to update
-  for (size_t i = 0; i < empty_img_count; i++) {
-    auto   loaded     = _loader.LoadImage();
-    size_t view_index = index_map.at(loaded->_image_id);
-    // Do something with view_index...
-    callback(view_index, loaded);
-    _image_pool->RecordAccess(loaded->_image_id, AccessType::THUMB);
-    to_display.push_back({loaded, true, false});
+  // Wait only for the visible images. Prefetched ones are collected whenever they complete,
+  // either here or in a later call.
+  auto visible = SyncWait(WhenAll(std::move(visible_loads)));
+  for (auto id : awaiting) {
+    // Every request completes, a failed or cancelled one with nullptr
+    visible_ids.push_back(id);
+    visible.push_back(_in_flight[id]._thumb.get());
+    _in_flight.erase(id);
+  }
+  for (size_t k = 0; k < visible.size(); ++k) {
+    if (visible[k] == nullptr) {
+      continue;
+    }
+    _image_pool->RecordAccess(visible_ids[k], AccessType::THUMB);
+    callback(index_map[visible_ids[k]], visible[k]);
+    to_display.emplace_back(_image_pool, visible[k], true, false);
   }
 }
 
@@ -55,10 +55,17 @@ void DBController::InitializeDB() {
   }
 
   // SQL query to create the tables
-  auto guard = GetConnectionGuard();
-  if (_initialized) return;
-
+  auto          guard = GetConnectionGuard();
   duckdb_result result;
+  if (_initialized) {
+    if (duckdb_query(guard._conn, upgrade_table_query, &result) != DuckDBSuccess) {
+      auto error_message = duckdb_result_error(&result);
+      duckdb_destroy_result(&result);
+      throw std::exception(error_message);
+    }
+    duckdb_destroy_result(&result);
+    return;
+  }
 
   // Run the SQL query to create the tables
   if (duckdb_query(guard._conn, init_table_query, &result) != DuckDBSuccess) {
@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 
+#include "concurrency/executor.hpp"
 #include "concurrency/thread_pool.hpp"
 #include "image/image.hpp"
 #include "storage/service/image/image_service.hpp"
@@ -26,14 +27,17 @@ ImageController::ImageController(ConnectionGuard&& guard)
  * @param image_pool
  */
 void ImageController::CaptureImagePool(std::shared_ptr<ImagePoolManager> image_pool) {
-  ThreadPool                                 thread_pool{8};
-  auto&                                      pool = image_pool->GetPool();
+  auto                                       pool = image_pool->Snapshot();
   ConcurrentBlockingQueue<ImageMapperParams> converted_params{348};
-  for (auto& pool_val : pool) {
-    auto img = pool_val.second;
-    thread_pool.Submit(
+  // Declared after the queue, the conversions are waited for before it is destroyed
+  TaskGroup                                  conversion_tasks{Executor::Instance().Cpu()};
+  std::vector<ThreadPool::Task>              conversions;
+  conversions.reserve(pool.size());
+  for (auto& img : pool) {
+    conversions.emplace_back(
         [img, &converted_params]() { converted_params.push_r(ImageService::ToParams(img)); });
   }
+  conversion_tasks.PostBatch(std::move(conversions));
 
   for (size_t i = 0; i < pool.size(); ++i) {
     auto result = converted_params.pop_r();
@@ -115,4 +119,13 @@ auto ImageController::GetImageByPath(const std::filesystem::path path)
     -> std::vector<std::shared_ptr<Image>> {
   return _service.GetImageByPath(path);
 }
+
+/**
+ * @brief Get every image stored in the database.
+ *
+ * @return std::vector<std::shared_ptr<Image>>
+ */
+auto ImageController::GetAllImages() -> std::vector<std::shared_ptr<Image>> {
+  return _service.GetAllImages();
+}
 };  // namespace puerhlab
\ No newline at end of file
@@ -1,26 +1,97 @@
 #include "storage/image_pool/image_pool_manager.hpp"
 
+#include <atomic>
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <shared_mutex>
 
 #include "decoders/raw_decoder.hpp"
 #include "type/type.hpp"
 
 namespace puerhlab {
+namespace {
+/**
+ * @brief Size of the buffer a cache holds for an image
+ */
+auto ChargeOf(const Image& image, const AccessType type) -> size_t {
+  return type == AccessType::FULL_IMG ? image._image_data.ByteSize() : image._thumbnail.ByteSize();
+}
+
+/**
+ * @brief Release the buffer a cache holds for an image
+ */
+void ClearBuffer(Image& image, const AccessType type) {
+  if (type == AccessType::FULL_IMG) {
+    image.ClearData();
+  } else {
+    image.ClearThumbnail();
+  }
+}
+
+auto PinFlag(Image& image, const AccessType type) -> std::atomic<bool>& {
+  return type == AccessType::FULL_IMG ? image._full_pinned : image._thumb_pinned;
+}
+};  // namespace
+
 ImagePoolManager::ImagePoolManager()
-    : _capacity_thumb(_default_capacity_thumb), _capacity_full(_default_capacity_full) {}
+    : ImagePoolManager(_default_budget_thumb, _default_budget_full) {}
 
-ImagePoolManager::ImagePoolManager(uint32_t capacity_thumb, uint32_t capacity_full)
-    : _capacity_thumb(capacity_thumb), _capacity_full(capacity_full) {}
+ImagePoolManager::ImagePoolManager(size_t budget_thumb, size_t budget_full) {
+  _caches[static_cast<size_t>(AccessType::THUMB)]._budget    = budget_thumb;
+  _caches[static_cast<size_t>(AccessType::FULL_IMG)]._budget = budget_full;
+}
+
+auto ImagePoolManager::ShardOf(const image_id_t& id) -> Shard& {
+  return _shards[static_cast<size_t>(id) % _shard_count];
+}
 
 /**
- * @brief
+ * @brief Get the cache of an access type
  *
- * @return std::unordered_map<image_id_t, std::shared_ptr<Image>>
+ * @param type
+ * @return Cache* nullptr for META, which has no cache
  */
-auto ImagePoolManager::GetPool() -> std::unordered_map<image_id_t, std::shared_ptr<Image>>& {
-  return _image_pool;
+auto ImagePoolManager::CacheOf(const AccessType type) -> Cache* {
+  if (type == AccessType::META) {
+    return nullptr;
+  }
+  return &_caches[static_cast<size_t>(type)];
+}
+
+/**
+ * @brief Look an image up under its shard's read lock. The entry stays valid while the caller holds
+ * one of the cache mutexes, Clear erases entries only with both of them held
+ *
+ * @param id
+ * @return std::pair<std::shared_ptr<Image>, Entry*> both null if the image is not in the pool
+ */
+auto ImagePoolManager::Find(const image_id_t& id) -> std::pair<std::shared_ptr<Image>, Entry*> {
+  auto&            shard = ShardOf(id);
+  std::shared_lock lock(shard._mutex);
+  auto             it = shard._entries.find(id);
+  if (it == shard._entries.end()) {
+    return {nullptr, nullptr};
+  }
+  return {it->second._image, &it->second};
+}
+
+/**
+ * @brief Copy the images in the pool. Images inserted meanwhile may or may not be included
+ *
+ * @return std::vector<std::shared_ptr<Image>>
+ */
+auto ImagePoolManager::Snapshot() const -> std::vector<std::shared_ptr<Image>> {
+  std::vector<std::shared_ptr<Image>> images;
+  images.reserve(_size.load(std::memory_order_relaxed));
+  for (auto& shard : _shards) {
+    std::shared_lock lock(shard._mutex);
+    for (auto& [id, entry] : shard._entries) {
+      images.push_back(entry._image);
+    }
+  }
+  return images;
 }
 
 /**
@@ -29,7 +100,13 @@ auto ImagePoolManager::GetPool() -> std::unordered_map<image_id_t, std::shared_p
  * @param img
  */
 void ImagePoolManager::Insert(const std::shared_ptr<Image> img) {
-  _image_pool[img->_image_id] = img;
+  auto&            shard = ShardOf(img->_image_id);
+  std::unique_lock lock(shard._mutex);
+  auto [it, inserted] = shard._entries.try_emplace(img->_image_id);
+  it->second._image   = img;
+  if (inserted) {
+    _size.fetch_add(1, std::memory_order_relaxed);
+  }
 }
 
 /**
@@ -40,24 +117,68 @@ void ImagePoolManager::Insert(const std::shared_ptr<Image> img) {
  * @return false image not exists
  */
 auto ImagePoolManager::PoolContains(const image_id_t& id) -> bool {
-  return _image_pool.contains(id);
+  auto&            shard = ShardOf(id);
+  std::shared_lock lock(shard._mutex);
+  return shard._entries.contains(id);
 }
 
-auto ImagePoolManager::Capacity(AccessType type) -> uint32_t {
-  switch (type) {
-    case AccessType::FULL_IMG: {
-      return _capacity_full;
-    }
-    case AccessType::THUMB: {
-      return _capacity_thumb;
-    }
-    case AccessType::META:
-      return _image_pool.size();
+/**
+ * @brief Number of images in the pool for META, or in the cache of the access type
+ *
+ * @param type
+ * @return uint32_t
+ */
+auto ImagePoolManager::Count(const AccessType type) -> uint32_t {
+  auto* cache = CacheOf(type);
+  if (cache == nullptr) {
+    return static_cast<uint32_t>(_size.load(std::memory_order_relaxed));
+  }
+  std::lock_guard lock(cache->_mutex);
+  return static_cast<uint32_t>(cache->_records.size());
+}
+
+/**
+ * @brief Byte budget of a cache, 0 for META
+ *
+ * @param type
+ * @return size_t
+ */
+auto ImagePoolManager::Budget(const AccessType type) -> size_t {
+  auto* cache = CacheOf(type);
+  return cache == nullptr ? 0 : cache->_budget.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Bytes charged to a cache, pinned images included. Stays above the budget while the pinned
+ * images or the most recently recorded one do not fit in it
+ *
+ * @param type
+ * @return size_t
+ */
+auto ImagePoolManager::Usage(const AccessType type) -> size_t {
+  auto* cache = CacheOf(type);
+  return cache == nullptr ? 0 : cache->_usage.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Change the byte budget of a cache, evicting until the cache fits in it
+ *
+ * @param type
+ * @param bytes
+ */
+void ImagePoolManager::SetBudget(const AccessType type, const size_t bytes) {
+  auto* cache = CacheOf(type);
+  if (cache == nullptr) {
+    return;
   }
-  return 0;
+  std::lock_guard lock(cache->_mutex);
+  cache->_budget.store(bytes, std::memory_order_relaxed);
+  ShrinkLocked(*cache, type, std::nullopt);
 }
+
 /**
- * @brief Access an with-data image from the cache
+ * @brief Access an with-data image from the cache. A hit only stamps the image, the LRU order is
+ * brought up to date when the image is about to be evicted
  *
  * @param id
  * @param type
@@ -65,111 +186,168 @@ auto ImagePoolManager::Capacity(AccessType type) -> uint32_t {
  */
 auto ImagePoolManager::AccessElement(const image_id_t& id, const AccessType type)
     -> std::optional<std::weak_ptr<Image>> {
-  switch (type) {
-    case AccessType::FULL_IMG: {
-      auto it = _cache_map_full.find(id);
-      if (it == _cache_map_full.end()) {
-        return std::nullopt;
-      }
-      // LRU, place the most recent record to the front
-      _cache_list_full.splice(_cache_list_full.begin(), _cache_list_full, it->second);
-      return _image_pool[it->first];
-    }
-    case AccessType::THUMB: {
-      auto it = _cache_map_thumb.find(id);
-      if (it == _cache_map_thumb.end()) {
-        return std::nullopt;
-      }
-      // LRU, place the most recent record to the front
-      _cache_list_thumb.splice(_cache_list_thumb.begin(), _cache_list_thumb, it->second);
-      return _image_pool[it->first];
-    }
-    case AccessType::META:
-      // For empty image, return it from the pool directly
-      return _image_pool.at(id);
+  auto&            shard = ShardOf(id);
+  std::shared_lock lock(shard._mutex);
+  auto             it = shard._entries.find(id);
+  if (it == shard._entries.end()) {
+    return std::nullopt;
   }
-  return std::nullopt;
+  if (type == AccessType::META) {
+    // For empty image, return it from the pool directly
+    return it->second._image;
+  }
+  auto&    stamp = it->second._stamps[static_cast<size_t>(type)];
+  uint64_t now   = _clock.fetch_add(1, std::memory_order_relaxed) + 1;
+  uint64_t seen  = stamp.load(std::memory_order_relaxed);
+  // Eviction resets the stamp to 0 under the cache mutex, never revive an evicted image. Keep the
+  // stamp of a racing hit that ticked later, stamps of cached images only grow
+  while (seen != 0 && seen < now &&
+         !stamp.compare_exchange_weak(seen, now, std::memory_order_relaxed)) {
+  }
+  if (seen == 0) {
+    return std::nullopt;
+  }
+  return it->second._image;
 }
 
 /**
- * @brief Add a with-data image into the cache
+ * @brief Add a with-data image into the cache and charge it the current size of the image's
+ * buffer, then evict the least recently used other images until the cache is under budget
  *
  * @param id
  * @param type
  */
 void ImagePoolManager::RecordAccess(const image_id_t& id, const AccessType type) {
-  switch (type) {
-    case AccessType::FULL_IMG: {
-      auto it = _cache_map_full.find(id);
-      if (it == _cache_map_full.end()) {
-        if (_cache_list_full.size() >= _capacity_full) {
-          Evict(type);
-        }
-        // Place the new-added record to the front
-        _cache_list_full.push_front(id);
-        _cache_map_full[id] = _cache_list_full.begin();
-      } else {
-        _cache_list_full.splice(_cache_list_full.begin(), _cache_list_full, it->second);
-        if (_cache_list_full.front() != id) {
-          _cache_list_full.front() = id;
-        }
-        _with_full.insert(id);
-      }
-      break;
-    }
-    case AccessType::THUMB: {
-      auto it = _cache_map_thumb.find(id);
-      if (it == _cache_map_thumb.end()) {
-        if (_cache_list_thumb.size() >= _capacity_thumb) {
-          Evict(type);
-        }
-        _cache_list_thumb.push_front(id);
-        _cache_map_thumb[id] = _cache_list_thumb.begin();
-      } else {
-        _cache_list_thumb.splice(_cache_list_thumb.begin(), _cache_list_thumb, it->second);
-        if (_cache_list_thumb.front() != id) {
-          _cache_list_thumb.front() = id;
-        }
-        _with_thumb.insert(id);
-      }
-      break;
-    }
-    case AccessType::META: {
+  auto* cache = CacheOf(type);
+  if (cache == nullptr) {
+    return;
+  }
+  std::lock_guard lock(cache->_mutex);
+  auto [image, entry] = Find(id);
+  if (entry == nullptr) {
+    return;
+  }
+  auto& record = cache->_records[id];
+  if (record._key != 0) {
+    // Recorded before, the buffer may have been reloaded with another size since
+    if (!record._pinned) {
+      cache->_order.erase(record._key);
     }
+    cache->_usage.fetch_sub(record._bytes, std::memory_order_relaxed);
   }
+  uint64_t now   = _clock.fetch_add(1, std::memory_order_relaxed) + 1;
+  record._key    = now;
+  record._bytes  = ChargeOf(*image, type);
+  record._pinned = PinFlag(*image, type).load();
+  if (!record._pinned) {
+    // Place the new-added record to the most recent end
+    cache->_order.emplace(now, id);
+  }
+  cache->_usage.fetch_add(record._bytes, std::memory_order_relaxed);
+  entry->_stamps[static_cast<size_t>(type)].store(now, std::memory_order_relaxed);
+  ShrinkLocked(*cache, type, id);
 }
 
 /**
- * @brief Remove a record according to its id
+ * @brief Remove a record according to its id, pinned or not
  *
  * @param id
  * @param type
  */
 void ImagePoolManager::RemoveRecord(const image_id_t& id, const AccessType type) {
-  switch (type) {
-    case AccessType::FULL_IMG: {
-      auto it = _cache_map_full.find(id);
-      if (it != _cache_map_full.end()) {
-        _cache_list_full.erase(it->second);
-        _cache_map_full.erase(it);
-        _with_full.erase(it->second);
-        auto img = _image_pool[it->first];
-        img->ClearThumbnail();
-      }
-      break;
+  auto* cache = CacheOf(type);
+  if (cache == nullptr) {
+    return;
+  }
+  std::lock_guard lock(cache->_mutex);
+  auto            record = cache->_records.find(id);
+  if (record == cache->_records.end()) {
+    return;
+  }
+  if (!record->second._pinned) {
+    cache->_order.erase(record->second._key);
+  }
+  cache->_usage.fetch_sub(record->second._bytes, std::memory_order_relaxed);
+  cache->_records.erase(record);
+  auto [image, entry] = Find(id);
+  if (entry == nullptr) {
+    return;
+  }
+  entry->_stamps[static_cast<size_t>(type)].store(0, std::memory_order_relaxed);
+  ClearBuffer(*image, type);
+}
+
+/**
+ * @brief Evict the least recently used unpinned image, the cache mutex must be held. Pinned images
+ * are not in the order, the scan never steps over them
+ *
+ * @param cache
+ * @param type
+ * @param keep image that must stay, the one just recorded
+ * @return std::optional<std::weak_ptr<Image>>
+ */
+auto ImagePoolManager::EvictLocked(Cache& cache, const AccessType type,
+                                   const std::optional<image_id_t>& keep)
+    -> std::optional<std::weak_ptr<Image>> {
+  auto it = cache._order.begin();
+  while (it != cache._order.end()) {
+    auto  id            = it->second;
+    auto& record        = cache._records.at(id);
+    auto [image, entry] = Find(id);
+    if (entry == nullptr) {
+      // Dropped from the pool, nothing left to clear
+      cache._usage.fetch_sub(record._bytes, std::memory_order_relaxed);
+      cache._records.erase(id);
+      it = cache._order.erase(it);
+      continue;
     }
-    case AccessType::THUMB: {
-      auto it = _cache_map_thumb.find(id);
-      if (it != _cache_map_thumb.end()) {
-        _cache_list_thumb.erase(it->second);
-        _cache_map_thumb.erase(it);
-        _with_thumb.erase(it->second);
-        auto img = _image_pool[it->first];
-        img->ClearData();
-      }
-      break;
+    auto&    stamp = entry->_stamps[static_cast<size_t>(type)];
+    uint64_t seen  = stamp.load(std::memory_order_relaxed);
+    if (seen != it->first) {
+      // Hit since it was ordered, move it to where its last access puts it. Stamps only grow, so
+      // the scan reaches it again at the latest once the images older than it are considered
+      it = cache._order.erase(it);
+      cache._order.emplace(seen, id);
+      record._key = seen;
+      continue;
+    }
+    if (PinFlag(*image, type).load()) {
+      // Pinned through the flag rather than Pin, leave the order until Unpin
+      it             = cache._order.erase(it);
+      record._pinned = true;
+      continue;
+    }
+    if (keep == id) {
+      ++it;
+      continue;
     }
-    case AccessType::META: {
+    if (!stamp.compare_exchange_strong(seen, 0, std::memory_order_relaxed)) {
+      // Lost to a hit, look at the same record again with the new stamp
+      continue;
+    }
+    cache._usage.fetch_sub(record._bytes, std::memory_order_relaxed);
+    cache._records.erase(id);
+    cache._order.erase(it);
+    ClearBuffer(*image, type);
+    return image;
+  }
+  return std::nullopt;
+}
+
+/**
+ * @brief Evict until the cache is under its budget or only pinned images and keep are left, the
+ * cache mutex must be held
+ *
+ * @param cache
+ * @param type
+ * @param keep image that must stay, the one just recorded
+ */
+void ImagePoolManager::ShrinkLocked(Cache& cache, const AccessType type,
+                                    const std::optional<image_id_t>& keep) {
+  while (cache._usage.load(std::memory_order_relaxed) >
+         cache._budget.load(std::memory_order_relaxed)) {
+    if (!EvictLocked(cache, type, keep).has_value()) {
+      break;
     }
   }
 }
@@ -181,50 +359,12 @@ void ImagePoolManager::RemoveRecord(const image_id_t& id, const AccessType type)
  * @return std::optional<std::weak_ptr<Image>>
  */
 auto ImagePoolManager::Evict(const AccessType type) -> std::optional<std::weak_ptr<Image>> {
-  switch (type) {
-    case AccessType::FULL_IMG: {
-      if (_cache_list_full.empty()) {
-        return std::nullopt;
-      }
-      auto last = _cache_list_full.end();
-      do {
-        --last;
-      } while (_image_pool[*last]->_full_pinned && last != _cache_list_full.begin());
-
-      if (_image_pool[*last]->_full_pinned) {
-        return std::nullopt;
-      }
-      _cache_map_full.erase(*last);
-      _with_full.erase(*last);
-      auto evicted_img = _image_pool[*last];
-      _cache_list_full.pop_back();
-      evicted_img->ClearData();
-      return evicted_img;
-    }
-    case AccessType::THUMB: {
-      if (_cache_list_thumb.empty()) {
-        return std::nullopt;
-      }
-      auto last = _cache_list_thumb.end();
-      do {
-        --last;
-      } while (_image_pool[*last]->_thumb_pinned && last != _cache_list_thumb.begin());
-
-      if (_image_pool[*last]->_thumb_pinned) {
-        return std::nullopt;
-      }
-      _cache_map_thumb.erase(*last);
-      _with_thumb.erase(*last);
-      auto evicted_img = _image_pool[*last];
-      _cache_list_thumb.pop_back();
-      evicted_img->ClearThumbnail();
-      return evicted_img;
-    }
-    case AccessType::META: {
-      return std::nullopt;
-    }
+  auto* cache = CacheOf(type);
+  if (cache == nullptr) {
+    return std::nullopt;
   }
-  return std::nullopt;
+  std::lock_guard lock(cache->_mutex);
+  return EvictLocked(*cache, type, std::nullopt);
 }
 
 /**
@@ -236,56 +376,101 @@ auto ImagePoolManager::Evict(const AccessType type) -> std::optional<std::weak_p
  * @return false
  */
 auto ImagePoolManager::CacheContains(const image_id_t& id, const AccessType type) -> bool {
-  switch (type) {
-    case AccessType::FULL_IMG: {
-      return _cache_map_full.contains(id);
-    }
-    case AccessType::THUMB: {
-      return _cache_map_thumb.contains(id);
-    }
-    case AccessType::META: {
-      return _image_pool.contains(id);
-    }
+  auto&            shard = ShardOf(id);
+  std::shared_lock lock(shard._mutex);
+  auto             it = shard._entries.find(id);
+  if (it == shard._entries.end()) {
+    return false;
+  }
+  if (type == AccessType::META) {
+    return true;
   }
-  return false;
+  return it->second._stamps[static_cast<size_t>(type)].load(std::memory_order_relaxed) != 0;
 }
 
-void ImagePoolManager::ResizeCache(const uint32_t new_capacity, const AccessType type) {
-  switch (type) {
-    case AccessType::FULL_IMG: {
-      while (_cache_list_full.size() > new_capacity) {
-        Evict(type);
-      }
-      _capacity_full = new_capacity;
-    }
-    case AccessType::THUMB: {
-      while (_cache_list_thumb.size() > new_capacity) {
-        Evict(type);
-      }
-      _capacity_thumb = new_capacity;
-    }
-    case AccessType::META: {
-    }
+/**
+ * @brief Keep an image's buffer out of eviction until Unpin, it still counts towards the usage
+ *
+ * @param id
+ * @param type
+ */
+void ImagePoolManager::Pin(const image_id_t& id, const AccessType type) {
+  auto* cache = CacheOf(type);
+  if (cache == nullptr) {
+    return;
+  }
+  std::lock_guard lock(cache->_mutex);
+  auto [image, entry] = Find(id);
+  if (entry == nullptr) {
+    return;
+  }
+  PinFlag(*image, type) = true;
+  auto record           = cache->_records.find(id);
+  if (record != cache->_records.end() && !record->second._pinned) {
+    cache->_order.erase(record->second._key);
+    record->second._pinned = true;
   }
 }
 
 /**
- * @brief Flush the cache and clear all the corresponding image data
+ * @brief Return a pinned image to the eviction order, evicting if the cache went over budget while
+ * it was pinned
  *
+ * @param id
+ * @param type
  */
-void ImagePoolManager::Flush() {
-  _cache_list_full.clear();
-  _cache_list_thumb.clear();
-  _cache_map_full.clear();
-  _cache_map_thumb.clear();
-
-  for (auto& id : _with_thumb) {
-    _image_pool.at(id)->ClearThumbnail();
+void ImagePoolManager::Unpin(const image_id_t& id, const AccessType type) {
+  auto* cache = CacheOf(type);
+  if (cache == nullptr) {
+    return;
+  }
+  std::lock_guard lock(cache->_mutex);
+  auto [image, entry] = Find(id);
+  if (entry == nullptr) {
+    return;
+  }
+  PinFlag(*image, type) = false;
+  auto record           = cache->_records.find(id);
+  if (record != cache->_records.end() && record->second._pinned) {
+    // Hits while pinned moved the stamp on, order the image by its last access
+    uint64_t key           = entry->_stamps[static_cast<size_t>(type)].load();
+    record->second._key    = key;
+    record->second._pinned = false;
+    cache->_order.emplace(key, id);
+    ShrinkLocked(*cache, type, std::nullopt);
   }
+}
 
-  for (auto& id : _with_full) {
-    _image_pool.at(id)->ClearData();
+/**
+ * @brief Drop every record of a cache and clear the data it held, the cache mutex must be held
+ *
+ * @param cache
+ * @param type
+ */
+void ImagePoolManager::FlushLocked(Cache& cache, const AccessType type) {
+  for (auto& [id, record] : cache._records) {
+    auto [image, entry] = Find(id);
+    if (entry == nullptr) {
+      continue;
+    }
+    entry->_stamps[static_cast<size_t>(type)].store(0, std::memory_order_relaxed);
+    ClearBuffer(*image, type);
   }
+  cache._order.clear();
+  cache._records.clear();
+  cache._usage.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Flush the cache and clear all the corresponding image data
+ *
+ */
+void ImagePoolManager::Flush() {
+  auto&            thumb = _caches[static_cast<size_t>(AccessType::THUMB)];
+  auto&            full  = _caches[static_cast<size_t>(AccessType::FULL_IMG)];
+  std::scoped_lock lock(thumb._mutex, full._mutex);
+  FlushLocked(thumb, AccessType::THUMB);
+  FlushLocked(full, AccessType::FULL_IMG);
 }
 
 /**
@@ -293,8 +478,16 @@ void ImagePoolManager::Flush() {
  *
  */
 void ImagePoolManager::Clear() {
-  Flush();
-  _image_pool.clear();
+  auto&            thumb = _caches[static_cast<size_t>(AccessType::THUMB)];
+  auto&            full  = _caches[static_cast<size_t>(AccessType::FULL_IMG)];
+  std::scoped_lock lock(thumb._mutex, full._mutex);
+  FlushLocked(thumb, AccessType::THUMB);
+  FlushLocked(full, AccessType::FULL_IMG);
+  for (auto& shard : _shards) {
+    std::unique_lock shard_lock(shard._mutex);
+    _size.fetch_sub(shard._entries.size(), std::memory_order_relaxed);
+    shard._entries.clear();
+  }
 }
 
-};  // namespace puerhlab
\ No newline at end of file
+};  // namespace puerhlab
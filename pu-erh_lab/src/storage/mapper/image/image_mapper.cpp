@@ -10,6 +10,8 @@
 //   const char* file_name;
 //   uint32_t    type;
 //   const char* metadata;
+//   const char* sidecar_path;
+//   const char* content_hash;
 // };
 
 namespace puerhlab {
@@ -17,16 +19,19 @@ auto ImageMapper::FromRawData(std::vector<duckorm::VarTypes>&& data) -> ImageMap
   if (data.size() != FieldCount()) {
     throw std::runtime_error("Invalid DuckFieldDesc for Image");
   }
-  auto id         = std::get_if<sl_element_id_t>(&data[0]);
-  auto image_path = std::get_if<std::unique_ptr<std::string>>(&data[1]);
-  auto file_name  = std::get_if<std::unique_ptr<std::string>>(&data[2]);
-  auto type       = std::get_if<uint32_t>(&data[3]);
-  auto metadata   = std::get_if<std::unique_ptr<std::string>>(&data[4]);
+  auto id           = std::get_if<sl_element_id_t>(&data[0]);
+  auto image_path   = std::get_if<std::unique_ptr<std::string>>(&data[1]);
+  auto file_name    = std::get_if<std::unique_ptr<std::string>>(&data[2]);
+  auto type         = std::get_if<uint32_t>(&data[3]);
+  auto metadata     = std::get_if<std::unique_ptr<std::string>>(&data[4]);
+  auto sidecar_path = std::get_if<std::unique_ptr<std::string>>(&data[5]);
+  auto content_hash = std::get_if<std::unique_ptr<std::string>>(&data[6]);
 
   if (id == nullptr || image_path == nullptr || file_name == nullptr || type == nullptr ||
-      metadata == nullptr) {
+      metadata == nullptr || sidecar_path == nullptr || content_hash == nullptr) {
     throw std::runtime_error("Encounting unmatching types when parsing the data from the DB");
   }
-  return {*id, std::move(*image_path), std::move(*file_name), *type, std::move(*metadata)};
+  return {*id, std::move(*image_path), std::move(*file_name), *type, std::move(*metadata),
+          std::move(*sidecar_path), std::move(*content_hash)};
 }
 };  // namespace puerhlab
\ No newline at end of file
@@ -16,6 +16,7 @@
 #include "storage/mapper/image/image_mapper.hpp"
 #include "type/type.hpp"
 #include "utf8/checked.h"
+#include "utils/hash/content_hash.hpp"
 #include "utils/string/convert.hpp"
 
 namespace puerhlab {
@@ -24,9 +25,15 @@ auto ImageService::ToParams(const std::shared_ptr<Image> source) -> ImageMapperP
   std::string utf8_path     = conv::ToBytes(source->_image_path.wstring());
 
   std::string utf8_img_name = conv::ToBytes(source->_image_name);
-  return {source->_image_id, std::make_unique<std::string>(utf8_path),
-          std::make_unique<std::string>(utf8_img_name), static_cast<uint32_t>(source->_image_type),
-          std::make_unique<std::string>(source->ExifToJson())};
+  std::string utf8_sidecar  = conv::ToBytes(source->_sidecar_path.wstring());
+  return {source->_image_id,
+          std::make_unique<std::string>(utf8_path),
+          std::make_unique<std::string>(utf8_img_name),
+          static_cast<uint32_t>(source->_image_type),
+          std::make_unique<std::string>(source->ExifToJson()),
+          std::make_unique<std::string>(utf8_sidecar),
+          std::make_unique<std::string>(
+              source->_content_hash.IsEmpty() ? "" : source->_content_hash.ToHex())};
 }
 auto ImageService::FromParams(const ImageMapperParams&& param) -> std::shared_ptr<Image> {
   // TODO: Replace it with ImageFactory once the more fine-grained Image loader is implemented
@@ -34,6 +41,12 @@ auto ImageService::FromParams(const ImageMapperParams&& param) -> std::shared_pt
                                            conv::FromBytes(*param.file_name),
                                            static_cast<ImageType>(param.type));
   recovered->JsonToExif(*param.metadata);
+  if (param.sidecar_path && !param.sidecar_path->empty()) {
+    recovered->_sidecar_path = std::filesystem::path(conv::FromBytes(*param.sidecar_path));
+  }
+  if (param.content_hash) {
+    recovered->_content_hash = ContentHash::FromHex(*param.content_hash).value_or(ContentHash{});
+  }
   return recovered;
 }
 
@@ -54,6 +67,16 @@ auto ImageService::GetImageByPath(const std::filesystem::path path)
   return GetByPredicate(conv::ToBytes(predicate_w));
 }
 
+auto ImageService::GetImageByContentHash(const ContentHash& hash)
+    -> std::vector<std::shared_ptr<Image>> {
+  std::string predicate = std::format("content_hash='{}'", hash.ToHex());
+  return GetByPredicate(std::move(predicate));
+}
+
+auto ImageService::GetAllImages() -> std::vector<std::shared_ptr<Image>> {
+  return GetByPredicate("TRUE");
+}
+
 auto ImageService::GetImageByType(const ImageType type) -> std::vector<std::shared_ptr<Image>> {
   std::string predicate = std::format("type={}", static_cast<uint32_t>(type));
   return GetByPredicate(std::move(predicate));
@@ -0,0 +1,440 @@
+#include "storage/thumbnail_store/thumbnail_store.hpp"
+
+#include <opencv2/core/hal/interface.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <opencv2/imgproc.hpp>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <xxhash.hpp>
+
+namespace puerhlab {
+namespace {
+struct ThumbnailIndexHeader {
+  char     _magic[8];
+  uint32_t _version;
+  uint32_t _entry_size;
+};
+static_assert(sizeof(ThumbnailIndexHeader) == 16, "ThumbnailIndexHeader must stay 16 bytes");
+
+constexpr char     kIndexMagic[8] = {'P', 'E', 'H', 'T', 'H', 'M', 'B', 'I'};
+constexpr uint32_t kIndexVersion  = 1;
+
+auto MakeHeader() -> ThumbnailIndexHeader {
+  ThumbnailIndexHeader header;
+  std::memcpy(header._magic, kIndexMagic, sizeof(kIndexMagic));
+  header._version    = kIndexVersion;
+  header._entry_size = sizeof(ThumbnailIndexEntry);
+  return header;
+}
+
+/**
+ * @brief Convert a decoded thumbnail into the 8-bit layout kept in the pack file
+ *
+ * @param thumbnail
+ * @param max_edge
+ * @return cv::Mat
+ */
+auto ToStoredFormat(const cv::Mat& thumbnail, uint32_t max_edge) -> cv::Mat {
+  cv::Mat stored;
+  switch (thumbnail.depth()) {
+    case CV_8U:
+      stored = thumbnail;
+      break;
+    case CV_16U:
+      thumbnail.convertTo(stored, CV_MAKETYPE(CV_8U, thumbnail.channels()), 1.0 / 257.0);
+      break;
+    default:
+      // Float thumbnails are normalized to [0, 1]
+      thumbnail.convertTo(stored, CV_MAKETYPE(CV_8U, thumbnail.channels()), 255.0);
+      break;
+  }
+  int long_edge = std::max(stored.rows, stored.cols);
+  if (long_edge > static_cast<int>(max_edge)) {
+    double  scale = static_cast<double>(max_edge) / long_edge;
+    cv::Mat resized;
+    cv::resize(stored, resized, cv::Size(), scale, scale, cv::INTER_AREA);
+    stored = std::move(resized);
+  }
+  if (!stored.isContinuous()) {
+    stored = stored.clone();
+  }
+  return stored;
+}
+
+void WriteEntry(std::ofstream& out, const ThumbnailIndexEntry& entry) {
+  out.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+  out.flush();
+}
+};  // namespace
+
+/**
+ * @brief Compute the fingerprint of a file from its path and stat data, the file is not read
+ *
+ * @param path
+ * @return std::optional<ThumbnailFingerprint> std::nullopt if the file cannot be stat-ed
+ */
+auto ThumbnailFingerprint::FromFile(const image_path_t& path)
+    -> std::optional<ThumbnailFingerprint> {
+  std::error_code ec;
+  auto            file_size = std::filesystem::file_size(path, ec);
+  if (ec) {
+    return std::nullopt;
+  }
+  auto modified_time = std::filesystem::last_write_time(path, ec);
+  if (ec) {
+    return std::nullopt;
+  }
+  const auto& native = path.native();
+  return ThumbnailFingerprint{
+      xxh::xxhash<64>(native.data(), native.size() * sizeof(native[0])),
+      static_cast<int64_t>(modified_time.time_since_epoch().count()), file_size};
+}
+
+/**
+ * @brief Open (or create) the thumbnail store residing in store_dir
+ *
+ * @param store_dir
+ * @param max_edge thumbnails are downscaled so that their long edge does not exceed this value
+ */
+ThumbnailStore::ThumbnailStore(const std::filesystem::path& store_dir, uint32_t max_edge)
+    : _pack_path(store_dir / "thumbnails.pack"),
+      _index_path(store_dir / "thumbnails.idx"),
+      _max_edge(max_edge) {
+  std::filesystem::create_directories(store_dir);
+  LoadIndex();
+  OpenWriters();
+  _pack_map.Open(_pack_path);
+  MaybeScheduleCompaction();
+}
+
+ThumbnailStore::~ThumbnailStore() {
+  if (_compaction_thread.joinable()) {
+    _compaction_thread.join();
+  }
+}
+
+/**
+ * @brief Replay the memory mapped index file into the in-memory lookup table
+ *
+ */
+void ThumbnailStore::LoadIndex() {
+  std::error_code ec;
+  _pack_size = std::filesystem::exists(_pack_path, ec) ? std::filesystem::file_size(_pack_path)
+                                                        : 0;
+  size_t valid_size = 0;
+  {
+    MappedFile index_map(_index_path);
+    if (!index_map.IsOpen()) {
+      return;
+    }
+    ThumbnailIndexHeader header;
+    if (index_map.Size() < sizeof(header)) {
+      valid_size = 0;
+    } else {
+      std::memcpy(&header, index_map.Data(), sizeof(header));
+      if (std::memcmp(header._magic, kIndexMagic, sizeof(kIndexMagic)) != 0 ||
+          header._version != kIndexVersion || header._entry_size != sizeof(ThumbnailIndexEntry)) {
+        valid_size = 0;
+      } else {
+        size_t entry_count = (index_map.Size() - sizeof(header)) / sizeof(ThumbnailIndexEntry);
+        valid_size  = sizeof(header) + entry_count * sizeof(ThumbnailIndexEntry);
+        const uint8_t* cursor = index_map.Data() + sizeof(header);
+        for (size_t i = 0; i < entry_count; ++i, cursor += sizeof(ThumbnailIndexEntry)) {
+          ThumbnailIndexEntry entry;
+          std::memcpy(&entry, cursor, sizeof(entry));
+          auto it = _index.find(entry._image_id);
+          if (it != _index.end()) {
+            _dead_bytes += it->second._length;
+            _index.erase(it);
+          }
+          // Tombstones and records pointing past the pack file (torn writes) are dropped
+          if (entry._length == 0 || entry._offset + entry._length > _pack_size) {
+            continue;
+          }
+          _index.emplace(entry._image_id, entry);
+        }
+      }
+    }
+  }
+  if (valid_size == 0) {
+    // Unknown layout, start over with an empty store
+    _index.clear();
+    _dead_bytes = 0;
+    _pack_size  = 0;
+    std::filesystem::remove(_index_path, ec);
+    std::filesystem::remove(_pack_path, ec);
+  } else if (valid_size != std::filesystem::file_size(_index_path)) {
+    // Drop a partially written trailing record so that new records stay aligned
+    std::filesystem::resize_file(_index_path, valid_size);
+  }
+}
+
+void ThumbnailStore::OpenWriters() {
+  std::error_code ec;
+  bool            new_index =
+      !std::filesystem::exists(_index_path, ec) || std::filesystem::file_size(_index_path) == 0;
+  _pack_out.open(_pack_path, std::ios::binary | std::ios::app);
+  _index_out.open(_index_path, std::ios::binary | std::ios::app);
+  if (!_pack_out.is_open() || !_index_out.is_open()) {
+    throw std::runtime_error("ThumbnailStore: Unable to open the thumbnail store for writing");
+  }
+  if (new_index) {
+    auto header = MakeHeader();
+    _index_out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    _index_out.flush();
+  }
+}
+
+void ThumbnailStore::AppendEntry(const ThumbnailIndexEntry& entry) {
+  WriteEntry(_index_out, entry);
+  if (!_index_out) {
+    throw std::runtime_error("ThumbnailStore: Unable to append to the thumbnail index");
+  }
+}
+
+/**
+ * @brief Look up the thumbnail of an image. Entries whose fingerprint no longer matches the source
+ * file are invalidated.
+ *
+ * @param id
+ * @param fingerprint fingerprint of the source file as it is now
+ * @return std::optional<cv::Mat> an 8-bit thumbnail, or std::nullopt on miss
+ */
+auto ThumbnailStore::Get(const image_id_t id, const ThumbnailFingerprint& fingerprint)
+    -> std::optional<cv::Mat> {
+  auto read_entry = [this](const ThumbnailIndexEntry& entry) {
+    cv::Mat thumbnail(static_cast<int>(entry._rows), static_cast<int>(entry._cols),
+                      static_cast<int>(entry._type));
+    std::memcpy(thumbnail.data, _pack_map.Data() + entry._offset, entry._length);
+    return thumbnail;
+  };
+  {
+    std::shared_lock<std::shared_mutex> lock(_mtx);
+    auto                                it = _index.find(id);
+    if (it == _index.end()) {
+      return std::nullopt;
+    }
+    const auto& entry = it->second;
+    if (entry._path_hash != fingerprint._path_hash ||
+        entry._modified_time != fingerprint._modified_time ||
+        entry._file_size != fingerprint._file_size) {
+      lock.unlock();
+      Invalidate(id);
+      return std::nullopt;
+    }
+    if (entry._offset + entry._length <= _pack_map.Size()) {
+      return read_entry(entry);
+    }
+  }
+  // The entry was appended after the pack file was mapped
+  std::unique_lock<std::shared_mutex> lock(_mtx);
+  auto                                it = _index.find(id);
+  if (it == _index.end()) {
+    return std::nullopt;
+  }
+  if (it->second._offset + it->second._length > _pack_map.Size()) {
+    _pack_map.Open(_pack_path);
+    if (it->second._offset + it->second._length > _pack_map.Size()) {
+      return std::nullopt;
+    }
+  }
+  return read_entry(it->second);
+}
+
+/**
+ * @brief Append the thumbnail of an image to the store, superseding any previous one
+ *
+ * @param id
+ * @param fingerprint fingerprint of the file the thumbnail was decoded from
+ * @param thumbnail
+ */
+void ThumbnailStore::Put(const image_id_t id, const ThumbnailFingerprint& fingerprint,
+                         const cv::Mat& thumbnail) {
+  if (thumbnail.empty()) {
+    return;
+  }
+  cv::Mat             pixels = ToStoredFormat(thumbnail, _max_edge);
+  ThumbnailIndexEntry entry{};
+  entry._image_id      = id;
+  entry._type          = static_cast<uint32_t>(pixels.type());
+  entry._path_hash     = fingerprint._path_hash;
+  entry._modified_time = fingerprint._modified_time;
+  entry._file_size     = fingerprint._file_size;
+  entry._length        = static_cast<uint32_t>(pixels.total() * pixels.elemSize());
+  entry._rows          = static_cast<uint32_t>(pixels.rows);
+  entry._cols          = static_cast<uint32_t>(pixels.cols);
+  {
+    std::unique_lock<std::shared_mutex> lock(_mtx);
+    entry._offset = _pack_size;
+    _pack_out.write(reinterpret_cast<const char*>(pixels.data), entry._length);
+    _pack_out.flush();
+    if (!_pack_out) {
+      throw std::runtime_error("ThumbnailStore: Unable to append to the thumbnail pack");
+    }
+    _pack_size += entry._length;
+    AppendEntry(entry);
+
+    auto it = _index.find(id);
+    if (it != _index.end()) {
+      _dead_bytes += it->second._length;
+    }
+    _index[id] = entry;
+    ++_generation;
+  }
+  MaybeScheduleCompaction();
+}
+
+/**
+ * @brief Drop the thumbnail of an image, its pixels are reclaimed by the next compaction
+ *
+ * @param id
+ */
+void ThumbnailStore::Invalidate(const image_id_t id) {
+  {
+    std::unique_lock<std::shared_mutex> lock(_mtx);
+    auto                                it = _index.find(id);
+    if (it == _index.end()) {
+      return;
+    }
+    _dead_bytes += it->second._length;
+    _index.erase(it);
+
+    ThumbnailIndexEntry tombstone{};
+    tombstone._image_id = id;
+    AppendEntry(tombstone);
+    ++_generation;
+  }
+  MaybeScheduleCompaction();
+}
+
+auto ThumbnailStore::Contains(const image_id_t id) -> bool {
+  std::shared_lock<std::shared_mutex> lock(_mtx);
+  return _index.contains(id);
+}
+
+auto ThumbnailStore::Size() -> size_t {
+  std::shared_lock<std::shared_mutex> lock(_mtx);
+  return _index.size();
+}
+
+/**
+ * @brief Share of the pack file occupied by superseded or invalidated thumbnails
+ *
+ * @return double
+ */
+auto ThumbnailStore::StaleRatio() -> double {
+  std::shared_lock<std::shared_mutex> lock(_mtx);
+  return _pack_size == 0 ? 0.0 : static_cast<double>(_dead_bytes) / _pack_size;
+}
+
+void ThumbnailStore::MaybeScheduleCompaction() {
+  {
+    std::shared_lock<std::shared_mutex> lock(_mtx);
+    if (_pack_size < _compaction_min_bytes ||
+        static_cast<double>(_dead_bytes) / _pack_size < _compaction_threshold) {
+      return;
+    }
+  }
+  CompactAsync();
+}
+
+/**
+ * @brief Rewrite the pack and index files with live thumbnails only. The index is copied under
+ * the lock, the pixels are copied without it, so readers and writers are only blocked while the
+ * rewritten files are swapped in. If the store is modified while copying, the compaction is
+ * abandoned and retried on a later trigger.
+ *
+ */
+void ThumbnailStore::Compact() {
+  auto pack_tmp  = _pack_path;
+  auto index_tmp = _index_path;
+  pack_tmp += ".compact";
+  index_tmp += ".compact";
+
+  uint64_t                         generation;
+  std::vector<ThumbnailIndexEntry> live;
+  {
+    std::shared_lock<std::shared_mutex> lock(_mtx);
+    if (_dead_bytes == 0) {
+      return;
+    }
+    generation = _generation;
+    live.reserve(_index.size());
+    for (const auto& [id, entry] : _index) {
+      live.push_back(entry);
+    }
+  }
+
+  // The pack file is only appended to, the records of the snapshot stay where they are
+  uint64_t                                            new_pack_size = 0;
+  std::unordered_map<image_id_t, ThumbnailIndexEntry> new_index;
+  {
+    MappedFile    source(_pack_path);
+    std::ofstream pack_out(pack_tmp, std::ios::binary | std::ios::trunc);
+    std::ofstream index_out(index_tmp, std::ios::binary | std::ios::trunc);
+    auto          header = MakeHeader();
+    index_out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const auto& entry : live) {
+      if (entry._offset + entry._length > source.Size()) {
+        continue;
+      }
+      ThumbnailIndexEntry moved = entry;
+      moved._offset             = new_pack_size;
+      pack_out.write(reinterpret_cast<const char*>(source.Data() + entry._offset), entry._length);
+      index_out.write(reinterpret_cast<const char*>(&moved), sizeof(moved));
+      new_pack_size += entry._length;
+      new_index.emplace(entry._image_id, moved);
+    }
+    if (!pack_out || !index_out) {
+      throw std::runtime_error("ThumbnailStore: Unable to write the compacted thumbnail store");
+    }
+  }
+
+  std::unique_lock<std::shared_mutex> lock(_mtx);
+  std::error_code                     ec;
+  if (_generation != generation) {
+    std::filesystem::remove(pack_tmp, ec);
+    std::filesystem::remove(index_tmp, ec);
+    return;
+  }
+  _pack_map.Close();
+  _pack_out.close();
+  _index_out.close();
+  std::filesystem::rename(pack_tmp, _pack_path);
+  std::filesystem::rename(index_tmp, _index_path);
+  _index      = std::move(new_index);
+  _pack_size  = new_pack_size;
+  _dead_bytes = 0;
+  ++_generation;
+  OpenWriters();
+  _pack_map.Open(_pack_path);
+}
+
+/**
+ * @brief Run Compact() on a background thread, does nothing if a compaction is already running
+ *
+ */
+void ThumbnailStore::CompactAsync() {
+  bool expected = false;
+  if (!_compacting.compare_exchange_strong(expected, true)) {
+    return;
+  }
+  if (_compaction_thread.joinable()) {
+    _compaction_thread.join();
+  }
+  _compaction_thread = std::thread([this] {
+    try {
+      Compact();
+    } catch (std::exception&) {
+      // TODO: Append error message to log
+    }
+    _compacting = false;
+  });
+}
+};  // namespace puerhlab
@@ -0,0 +1,119 @@
+/*
+ * @file        pu-erh_lab/src/utils/hash/content_hash.cpp
+ * @brief       XXH3-128 content hash of image files
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "utils/hash/content_hash.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <xxhash.hpp>
+
+namespace puerhlab {
+namespace {
+constexpr char kHexDigits[] = "0123456789abcdef";
+
+auto HexValue(char c) -> int {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+};  // namespace
+
+/**
+ * @brief Canonical representation, the high half comes first
+ *
+ * @return std::string 32 lower case hex digits
+ */
+auto ContentHash::ToHex() const -> std::string {
+  std::string hex(32, '0');
+  for (int i = 0; i < 16; ++i) {
+    hex[15 - i] = kHexDigits[(_high >> (4 * i)) & 0xF];
+    hex[31 - i] = kHexDigits[(_low >> (4 * i)) & 0xF];
+  }
+  return hex;
+}
+
+auto ContentHash::FromHex(std::string_view hex) -> std::optional<ContentHash> {
+  if (hex.size() != 32) {
+    return std::nullopt;
+  }
+  ContentHash hash;
+  for (size_t i = 0; i < 32; ++i) {
+    int value = HexValue(hex[i]);
+    if (value < 0) {
+      return std::nullopt;
+    }
+    uint64_t& half = i < 16 ? hash._high : hash._low;
+    half           = (half << 4) | static_cast<uint64_t>(value);
+  }
+  return hash;
+}
+
+auto ContentHash::FromBuffer(const void* data, size_t size) -> ContentHash {
+  auto hash = xxh::xxhash3<128>(data, size);
+  return {hash.low64, hash.high64};
+}
+
+/**
+ * @brief Hash a file which is not going through a FileReader, in chunks of
+ * ContentHasher::_chunk_size
+ *
+ * @param path
+ * @return std::optional<ContentHash> std::nullopt if the file cannot be read
+ */
+auto ContentHash::FromFile(const std::filesystem::path& path) -> std::optional<ContentHash> {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return std::nullopt;
+  }
+  ContentHasher     hasher;
+  std::vector<char> chunk(ContentHasher::_chunk_size);
+  while (file) {
+    file.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+    hasher.Update(chunk.data(), static_cast<size_t>(file.gcount()));
+  }
+  if (file.bad()) {
+    return std::nullopt;
+  }
+  return hasher.Digest();
+}
+
+void ContentHasher::Update(const void* data, size_t size) { _state.update(data, size); }
+
+auto ContentHasher::Digest() -> ContentHash {
+  auto hash = _state.digest();
+  return {hash.low64, hash.high64};
+}
+};  // namespace puerhlab
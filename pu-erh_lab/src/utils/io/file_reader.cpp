@@ -0,0 +1,130 @@
+/*
+ * @file        pu-erh_lab/src/utils/io/file_reader.cpp
+ * @brief       Asynchronous whole-file readers feeding the decoders
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "utils/io/file_reader.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "utils/hash/content_hash.hpp"
+#include "utils/io/io_uring_file_reader.hpp"
+
+namespace puerhlab {
+/**
+ * @brief Create the most efficient reader available on this platform, io_uring is preferred and
+ * the thread pool reader is used when io_uring is not compiled in or refused by the kernel
+ *
+ * @param queue_depth number of reads kept in flight by the io_uring reader
+ * @param fallback_threads number of reads the fallback reader keeps in flight
+ * @return std::unique_ptr<FileReader>
+ */
+auto FileReader::Create([[maybe_unused]] uint32_t queue_depth, size_t fallback_threads)
+    -> std::unique_ptr<FileReader> {
+#ifdef PUERHLAB_HAS_IO_URING
+  try {
+    return std::make_unique<IoUringFileReader>(queue_depth);
+  } catch (const std::exception&) {
+    // e.g. io_uring disabled by seccomp or sysctl, fall back to blocking reads
+  }
+#endif
+  return std::make_unique<ThreadPoolFileReader>(fallback_threads);
+}
+
+/**
+ * @brief Construct a new ThreadPoolFileReader object
+ *
+ * @param max_in_flight queue depth reported to the caller, the reads of all readers share the pool
+ * @param pool
+ */
+ThreadPoolFileReader::ThreadPoolFileReader(size_t max_in_flight, ThreadPool& pool)
+    : _max_in_flight(static_cast<uint32_t>(std::max<size_t>(max_in_flight, 1))), _reads(pool) {}
+
+/**
+ * @brief Read a file in chunks, hashing each chunk right after it has been read while it is still
+ * in cache
+ *
+ */
+void ThreadPoolFileReader::ReadHashed(const image_path_t& path, HashedCallback callback) {
+  _reads.Post([path, callback = std::move(callback)]() {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+      callback({}, {}, std::make_exception_ptr(
+                           std::runtime_error("File not exists or no read permission.")));
+      return;
+    }
+
+    std::streamsize   file_size = file.tellg();
+    file.seekg(0, std::ios::beg);
+    std::vector<char> buffer(file_size);
+    ContentHasher     hasher;
+    for (size_t offset = 0; offset < buffer.size(); offset += ContentHasher::_chunk_size) {
+      size_t chunk = std::min(ContentHasher::_chunk_size, buffer.size() - offset);
+      if (!file.read(buffer.data() + offset, static_cast<std::streamsize>(chunk))) {
+        callback({}, {}, std::make_exception_ptr(
+                             std::runtime_error("File not exists or no read permission.")));
+        return;
+      }
+      hasher.Update(buffer.data() + offset, chunk);
+    }
+    callback(std::move(buffer), hasher.Digest(), nullptr);
+  });
+}
+
+void ThreadPoolFileReader::Read(const image_path_t& path, Callback callback) {
+  _reads.Post([path, callback = std::move(callback)]() {
+    // Open file as an ifstream
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+      callback({}, std::make_exception_ptr(
+                       std::runtime_error("File not exists or no read permission.")));
+      return;
+    }
+
+    // Read file into memory
+    std::streamsize   file_size = file.tellg();
+    file.seekg(0, std::ios::beg);
+    std::vector<char> buffer(file_size);
+    if (!file.read(buffer.data(), file_size)) {
+      callback({}, std::make_exception_ptr(
+                       std::runtime_error("File not exists or no read permission.")));
+      return;
+    }
+    callback(std::move(buffer), nullptr);
+  });
+}
+
+auto ThreadPoolFileReader::QueueDepth() const -> uint32_t { return _max_in_flight; }
+};  // namespace puerhlab
@@ -0,0 +1,145 @@
+/*
+ * @file        pu-erh_lab/src/utils/io/mapped_file.cpp
+ * @brief       Read-only memory mapped file
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "utils/io/mapped_file.hpp"
+
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace puerhlab {
+MappedFile::MappedFile(const std::filesystem::path& path) { Open(path); }
+
+MappedFile::MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+  if (this != &other) {
+    Close();
+    _data = std::exchange(other._data, nullptr);
+    _size = std::exchange(other._size, 0);
+#ifdef _WIN32
+    _file_handle    = std::exchange(other._file_handle, nullptr);
+    _mapping_handle = std::exchange(other._mapping_handle, nullptr);
+#else
+    _fd = std::exchange(other._fd, -1);
+#endif
+  }
+  return *this;
+}
+
+MappedFile::~MappedFile() { Close(); }
+
+/**
+ * @brief Map the whole file into memory. Empty files cannot be mapped.
+ *
+ * @param path
+ * @return true the file is mapped
+ * @return false the file cannot be opened or is empty
+ */
+auto MappedFile::Open(const std::filesystem::path& path) -> bool {
+  Close();
+#ifdef _WIN32
+  HANDLE file = CreateFileW(path.wstring().c_str(), GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+    CloseHandle(file);
+    return false;
+  }
+  HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping == nullptr) {
+    CloseHandle(file);
+    return false;
+  }
+  void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (view == nullptr) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+  _file_handle    = file;
+  _mapping_handle = mapping;
+  _data           = static_cast<const uint8_t*>(view);
+  _size           = static_cast<size_t>(file_size.QuadPart);
+#else
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+  void* view = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+  if (view == MAP_FAILED) {
+    ::close(fd);
+    return false;
+  }
+  _fd   = fd;
+  _data = static_cast<const uint8_t*>(view);
+  _size = static_cast<size_t>(st.st_size);
+#endif
+  return true;
+}
+
+void MappedFile::Close() {
+  if (_data == nullptr) {
+    return;
+  }
+#ifdef _WIN32
+  UnmapViewOfFile(_data);
+  CloseHandle(static_cast<HANDLE>(_mapping_handle));
+  CloseHandle(static_cast<HANDLE>(_file_handle));
+  _mapping_handle = nullptr;
+  _file_handle    = nullptr;
+#else
+  ::munmap(const_cast<uint8_t*>(_data), _size);
+  ::close(_fd);
+  _fd = -1;
+#endif
+  _data = nullptr;
+  _size = 0;
+}
+};  // namespace puerhlab
@@ -0,0 +1,202 @@
+/*
+ * @file        pu-erh_lab/src/utils/profiling/import_profiler.cpp
+ * @brief       Per-file timing of the import stages
+ * @author      Yurun Zi
+ * @date        2026-10-19
+ * @license     MIT
+ *
+ * @copyright   Copyright (c) 2026 Yurun Zi
+ */
+
+// Copyright (c) 2026 Yurun Zi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "utils/profiling/import_profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <format>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "utils/string/convert.hpp"
+
+namespace puerhlab {
+namespace {
+auto ToMilliseconds(ImportProfiler::Clock::duration elapsed) -> double {
+  return std::chrono::duration<double, std::milli>(elapsed).count();
+}
+
+/**
+ * @brief Nearest-rank percentile
+ *
+ * @param sorted ascending, not empty
+ * @param percent in (0, 100]
+ */
+auto Percentile(const std::vector<double>& sorted, double percent) -> double {
+  auto rank = static_cast<size_t>(std::ceil(percent / 100.0 * sorted.size()));
+  return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+};  // namespace
+
+auto ImportStageName(ImportStage stage) -> const char* {
+  switch (stage) {
+    case ImportStage::DEDUP:
+      return "dedup";
+    case ImportStage::QUEUE:
+      return "queue";
+    case ImportStage::READ:
+      return "read";
+    case ImportStage::DISPATCH:
+      return "dispatch";
+    case ImportStage::EXIF:
+      return "exif";
+    case ImportStage::THUMBNAIL:
+      return "thumbnail";
+    case ImportStage::CREATE:
+      return "create";
+    case ImportStage::INSERT:
+      return "insert";
+  }
+  return "unknown";
+}
+
+/**
+ * @brief Format the report as a table of the stages followed by the slowest files
+ *
+ * @return std::string
+ */
+auto ImportReport::ToString() const -> std::string {
+  std::string out = std::format("{:<10}{:>8}{:>10}{:>10}{:>10}{:>10}{:>12}\n", "stage", "files",
+                                "p50 ms", "p90 ms", "p99 ms", "max ms", "total ms");
+  for (const auto& stats : _stages) {
+    out += std::format("{:<10}{:>8}{:>10.2f}{:>10.2f}{:>10.2f}{:>10.2f}{:>12.1f}\n",
+                       ImportStageName(stats._stage), stats._count, stats._p50_ms, stats._p90_ms,
+                       stats._p99_ms, stats._max_ms, stats._total_ms);
+  }
+  if (!_slowest.empty()) {
+    out += "slowest files:\n";
+  }
+  for (const auto& file : _slowest) {
+    out += std::format("{:>10.2f} ms  {} {:.2f} ms  {}\n", file._total_ms,
+                       ImportStageName(file._bottleneck), file._bottleneck_ms,
+                       conv::ToBytes(file._path.wstring()));
+  }
+  return out;
+}
+
+/**
+ * @brief Add the time a file spent in a stage, a stage recorded twice for the same file is summed
+ *
+ * @param path
+ * @param stage
+ * @param elapsed
+ */
+void ImportProfiler::Record(const image_path_t& path, ImportStage stage, Clock::duration elapsed) {
+  std::lock_guard<std::mutex> lock(_mtx);
+  // The durations of a file seen for the first time are value-initialized, i.e. zero
+  _files[path.native()][static_cast<size_t>(stage)] += elapsed;
+}
+
+/**
+ * @brief Aggregate what has been recorded so far
+ *
+ * @param slowest_count number of files listed in the report
+ * @return ImportReport
+ */
+auto ImportProfiler::Report(size_t slowest_count) -> ImportReport {
+  ImportReport                                       report;
+  std::array<std::vector<double>, kImportStageCount> per_stage;
+  {
+    std::lock_guard<std::mutex> lock(_mtx);
+    for (const auto& [path, durations] : _files) {
+      ImportSlowFile file{path, 0.0, ImportStage::DEDUP, 0.0};
+      for (size_t i = 0; i < kImportStageCount; ++i) {
+        // Files skipped as duplicates, or which failed, never reach the later stages
+        if (durations[i] == Clock::duration::zero()) {
+          continue;
+        }
+        double ms = ToMilliseconds(durations[i]);
+        per_stage[i].push_back(ms);
+        file._total_ms += ms;
+        if (ms > file._bottleneck_ms) {
+          file._bottleneck    = static_cast<ImportStage>(i);
+          file._bottleneck_ms = ms;
+        }
+      }
+      report._slowest.push_back(std::move(file));
+    }
+  }
+
+  for (size_t i = 0; i < kImportStageCount; ++i) {
+    auto& samples = per_stage[i];
+    if (samples.empty()) {
+      continue;
+    }
+    std::sort(samples.begin(), samples.end());
+    ImportStageStats stats{static_cast<ImportStage>(i)};
+    stats._count  = samples.size();
+    stats._p50_ms = Percentile(samples, 50.0);
+    stats._p90_ms = Percentile(samples, 90.0);
+    stats._p99_ms = Percentile(samples, 99.0);
+    stats._max_ms = samples.back();
+    for (double ms : samples) {
+      stats._total_ms += ms;
+    }
+    report._stages.push_back(stats);
+  }
+
+  auto slower = [](const ImportSlowFile& lhs, const ImportSlowFile& rhs) {
+    return lhs._total_ms > rhs._total_ms;
+  };
+  slowest_count = std::min(slowest_count, report._slowest.size());
+  std::partial_sort(report._slowest.begin(), report._slowest.begin() + slowest_count,
+                    report._slowest.end(), slower);
+  report._slowest.resize(slowest_count);
+  return report;
+}
+
+auto ImportProfiler::FileCount() -> size_t {
+  std::lock_guard<std::mutex> lock(_mtx);
+  return _files.size();
+}
+
+void ImportProfiler::Clear() {
+  std::lock_guard<std::mutex> lock(_mtx);
+  _files.clear();
+}
+
+ImportStageTimer::ImportStageTimer(ImportProfiler* profiler, const image_path_t& path,
+                                   ImportStage stage)
+    : _profiler(profiler), _path(path), _stage(stage) {
+  if (_profiler) {
+    _start = ImportProfiler::Clock::now();
+  }
+}
+
+ImportStageTimer::~ImportStageTimer() {
+  if (_profiler) {
+    _profiler->Record(_path, _stage, ImportProfiler::Clock::now() - _start);
+  }
+}
+};  // namespace puerhlab
@@ -0,0 +1,67 @@
+#include "concurrency/cancellation_token.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+
+namespace puerhlab {
+TEST(CancellationTokenTest, DefaultTokenIsNeverCancelled) {
+  CancellationToken token;
+  token.Cancel();
+  EXPECT_FALSE(token.CanBeCancelled());
+  EXPECT_FALSE(token.IsCancelled());
+  EXPECT_NO_THROW(token.ThrowIfCancelled());
+
+  bool called       = false;
+  auto registration = token.OnCancel([&] { called = true; });
+  EXPECT_FALSE(called);
+}
+
+TEST(CancellationTokenTest, CopiesShareTheState) {
+  auto token = CancellationToken::Create();
+  auto copy  = token;
+  copy.Cancel();
+  EXPECT_TRUE(token.IsCancelled());
+  EXPECT_THROW(token.ThrowIfCancelled(), OperationCancelled);
+}
+
+TEST(CancellationTokenTest, CallbacksRunOnceAndCanBeUnregistered) {
+  auto token  = CancellationToken::Create();
+  int  called = 0;
+  int  reset  = 0;
+  auto first  = token.OnCancel([&] { ++called; });
+  auto second = token.OnCancel([&] { ++reset; });
+  second.Reset();
+
+  token.Cancel();
+  token.Cancel();
+  EXPECT_EQ(called, 1);
+  EXPECT_EQ(reset, 0);
+
+  // Registering with a cancelled token runs the callback right away
+  auto late = token.OnCancel([&] { ++called; });
+  EXPECT_EQ(called, 2);
+}
+
+TEST(CancellationTokenTest, LinkedTokensFollowTheirParent) {
+  auto view   = CancellationToken::Create();
+  auto first  = CancellationToken::CreateLinked(view);
+  auto second = CancellationToken::CreateLinked(view);
+  auto nested = CancellationToken::CreateLinked(first);
+
+  // A child is cancelled alone
+  second.Cancel();
+  EXPECT_TRUE(second.IsCancelled());
+  EXPECT_FALSE(view.IsCancelled());
+  EXPECT_FALSE(first.IsCancelled());
+
+  // The parent cancels the whole subtree
+  view.Cancel();
+  EXPECT_TRUE(first.IsCancelled());
+  EXPECT_TRUE(nested.IsCancelled());
+
+  auto orphan = CancellationToken::CreateLinked(CancellationToken{});
+  EXPECT_TRUE(orphan.CanBeCancelled());
+  EXPECT_FALSE(orphan.IsCancelled());
+}
+};  // namespace puerhlab
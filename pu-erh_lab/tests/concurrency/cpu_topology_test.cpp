@@ -0,0 +1,111 @@
+#include "concurrency/cpu_topology.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace puerhlab {
+namespace {
+/**
+ * @brief A fake /sys/devices/system tree in the temporary directory, removed by the destructor
+ */
+class FakeSysfs {
+ public:
+  explicit FakeSysfs(const std::string& name)
+      : _root(std::filesystem::temp_directory_path() / ("puerhlab_sysfs_" + name)) {
+    std::filesystem::remove_all(_root);
+  }
+  ~FakeSysfs() { std::filesystem::remove_all(_root); }
+
+  void Write(const std::filesystem::path& relative, const std::string& content) {
+    std::filesystem::create_directories((_root / relative).parent_path());
+    std::ofstream file(_root / relative);
+    file << content << "\n";
+  }
+
+  void AddCpu(uint32_t cpu, const std::string& l3) {
+    auto dir = std::filesystem::path("cpu") / ("cpu" + std::to_string(cpu)) / "cache";
+    Write(dir / "index0" / "level", "1");
+    Write(dir / "index0" / "shared_cpu_list", std::to_string(cpu));
+    if (!l3.empty()) {
+      Write(dir / "index3" / "level", "3");
+      Write(dir / "index3" / "shared_cpu_list", l3);
+    }
+  }
+
+  auto Root() const -> const std::filesystem::path& { return _root; }
+
+ private:
+  std::filesystem::path _root;
+};
+};  // namespace
+
+TEST(CpuTopologyTest, ParsesCpuLists) {
+  EXPECT_EQ(ParseCpuList("0-3,8,10-11\n"), (std::vector<uint32_t>{0, 1, 2, 3, 8, 10, 11}));
+  EXPECT_EQ(ParseCpuList("5"), (std::vector<uint32_t>{5}));
+  EXPECT_TRUE(ParseCpuList("").empty());
+  EXPECT_TRUE(ParseCpuList("3-1").empty());
+  EXPECT_TRUE(ParseCpuList("a-b").empty());
+}
+
+TEST(CpuTopologyTest, DualSocketHasOneDomainPerCache) {
+  FakeSysfs sysfs{"dual_socket"};
+  sysfs.Write("cpu/online", "0-7");
+  sysfs.Write("node/node0/cpulist", "0-3");
+  sysfs.Write("node/node1/cpulist", "4-7");
+  // A memory-only node is not counted
+  sysfs.Write("node/node2/cpulist", "");
+  for (uint32_t cpu = 0; cpu < 8; ++cpu) {
+    sysfs.AddCpu(cpu, cpu < 4 ? "0-3" : "4-7");
+  }
+
+  auto topology = CpuTopology::Discover(sysfs.Root());
+  ASSERT_EQ(topology.Domains().size(), 2u);
+  EXPECT_EQ(topology.NodeCount(), 2u);
+  EXPECT_EQ(topology.CpuCount(), 8u);
+  EXPECT_TRUE(topology.IsNuma());
+  EXPECT_EQ(topology.Domains()[0]._node, 0u);
+  EXPECT_EQ(topology.Domains()[0]._cpus, (std::vector<uint32_t>{0, 1, 2, 3}));
+  EXPECT_EQ(topology.Domains()[1]._node, 1u);
+  EXPECT_EQ(topology.Domains()[1]._cpus, (std::vector<uint32_t>{4, 5, 6, 7}));
+}
+
+TEST(CpuTopologyTest, NodesAreDomainsWithoutCacheInfo) {
+  FakeSysfs sysfs{"no_cache"};
+  sysfs.Write("cpu/online", "0-3");
+  sysfs.Write("node/node0/cpulist", "0,2");
+  sysfs.Write("node/node1/cpulist", "1,3");
+
+  auto topology = CpuTopology::Discover(sysfs.Root());
+  ASSERT_EQ(topology.Domains().size(), 2u);
+  EXPECT_EQ(topology.Domains()[0]._cpus, (std::vector<uint32_t>{0, 2}));
+  EXPECT_EQ(topology.Domains()[1]._cpus, (std::vector<uint32_t>{1, 3}));
+  EXPECT_TRUE(topology.IsNuma());
+}
+
+TEST(CpuTopologyTest, SingleNodeIsNotPlaced) {
+  FakeSysfs sysfs{"single_node"};
+  sysfs.Write("cpu/online", "0-3");
+  sysfs.Write("node/node0/cpulist", "0-3");
+  // Two caches on one node, e.g. two core complexes
+  for (uint32_t cpu = 0; cpu < 4; ++cpu) {
+    sysfs.AddCpu(cpu, cpu < 2 ? "0-1" : "2-3");
+  }
+
+  auto topology = CpuTopology::Discover(sysfs.Root());
+  EXPECT_EQ(topology.Domains().size(), 2u);
+  EXPECT_EQ(topology.NodeCount(), 1u);
+  EXPECT_FALSE(topology.IsNuma());
+}
+
+TEST(CpuTopologyTest, MissingSysfsFallsBackToOneDomain) {
+  auto topology = CpuTopology::Discover(std::filesystem::temp_directory_path() / "puerhlab_none");
+  ASSERT_EQ(topology.Domains().size(), 1u);
+  EXPECT_GE(topology.CpuCount(), 1u);
+  EXPECT_FALSE(topology.IsNuma());
+}
+};  // namespace puerhlab
@@ -0,0 +1,59 @@
+#include "concurrency/executor.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "concurrency/thread_pool.hpp"
+
+namespace puerhlab {
+TEST(ExecutorTest, InstanceIsShared) {
+  auto& executor = Executor::Instance();
+  EXPECT_EQ(&executor, &Executor::Instance());
+  EXPECT_NE(&executor.Cpu(), &executor.Io());
+  EXPECT_EQ(executor.Cpu().ThreadCount(), Executor::DefaultCpuThreads());
+  EXPECT_EQ(executor.Io().ThreadCount(), Executor::DefaultIoThreads());
+  EXPECT_GE(Executor::DefaultCpuThreads(), 1u);
+}
+
+TEST(ExecutorTest, WaitCoversNestedTasks) {
+  Executor         executor{2, 1};
+  std::atomic<int> done = 0;
+  {
+    TaskGroup reads{executor.Io()};
+    TaskGroup decodes{executor.Cpu()};
+    for (int i = 0; i < 100; ++i) {
+      // e.g. a read completion starting the decode of the file
+      reads.Post([&] {
+        decodes.Post([&] {
+          std::this_thread::sleep_for(std::chrono::microseconds(50));
+          ++done;
+        });
+      });
+    }
+    reads.Wait();
+    decodes.Wait();
+    EXPECT_EQ(done.load(), 100);
+  }
+}
+
+TEST(ExecutorTest, DestructionWaitsForBatch) {
+  ThreadPool       pool{3};
+  std::atomic<int> done = 0;
+  {
+    TaskGroup                     group{pool};
+    std::vector<ThreadPool::Task> tasks;
+    for (int i = 0; i < 64; ++i) {
+      tasks.emplace_back([&done] {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        ++done;
+      });
+    }
+    group.PostBatch(std::move(tasks));
+  }
+  EXPECT_EQ(done.load(), 64);
+}
+};  // namespace puerhlab
@@ -0,0 +1,129 @@
+#include "concurrency/stage_pipeline.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "concurrency/thread_pool.hpp"
+
+namespace puerhlab {
+TEST(StagePipelineTest, ItemsFlowThroughEveryStage) {
+  ThreadPool         pool{4};
+  std::mutex         mtx;
+  std::vector<int>   results;
+  StagePipeline<int> pipeline;
+  pipeline.AddStage({"double", 4, 16, false, &pool}, [](int& value) {
+    value *= 2;
+    return true;
+  });
+  pipeline.AddStage({"increment", 2, 16, false, &pool}, [](int& value) {
+    value += 1;
+    return true;
+  });
+  pipeline.AddStage({"consume", 1, 16, false, &pool}, [&](int& value) {
+    std::lock_guard<std::mutex> lock(mtx);
+    results.push_back(value);
+    return true;
+  });
+  for (int i = 0; i < 1000; ++i) {
+    pipeline.Push(i);
+  }
+  pipeline.WaitIdle();
+  EXPECT_EQ(pipeline.InFlight(), 0u);
+
+  std::sort(results.begin(), results.end());
+  ASSERT_EQ(results.size(), 1000u);
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_EQ(results[i], i * 2 + 1);
+  }
+}
+
+TEST(StagePipelineTest, OrderedStageKeepsArrivalOrder) {
+  ThreadPool         pool{4};
+  std::vector<int>   results;
+  StagePipeline<int> pipeline;
+  pipeline.AddStage({"filter", 4, 8, true, &pool}, [](int& value) {
+    // Later items tend to finish first
+    std::this_thread::sleep_for(std::chrono::microseconds((7 - value % 8) * 20));
+    return value % 3 != 0;
+  });
+  pipeline.AddStage({"consume", 1, 8, false, &pool}, [&](int& value) {
+    results.push_back(value);
+    return true;
+  });
+  for (int i = 0; i < 300; ++i) {
+    pipeline.Push(i);
+  }
+  pipeline.WaitIdle();
+
+  std::vector<int> expected;
+  for (int i = 0; i < 300; ++i) {
+    if (i % 3 != 0) expected.push_back(i);
+  }
+  EXPECT_EQ(results, expected);
+
+  auto metrics = pipeline.Metrics();
+  ASSERT_EQ(metrics.size(), 2u);
+  EXPECT_EQ(metrics[0]._name, "filter");
+  EXPECT_EQ(metrics[0]._processed, 300u);
+  EXPECT_EQ(metrics[0]._dropped, 100u);
+  EXPECT_EQ(metrics[1]._processed, 200u);
+  EXPECT_GT(metrics[0]._busy.count(), 0);
+}
+
+TEST(StagePipelineTest, SlowStageHoldsBackTheOthers) {
+  ThreadPool         pool{4};
+  std::atomic<int>   waiting      = 0;
+  std::atomic<int>   peak_waiting = 0;
+  StagePipeline<int> pipeline;
+  pipeline.AddStage({"fast", 3, 4, false, &pool}, [&](int&) {
+    int now  = ++waiting;
+    int peak = peak_waiting.load();
+    while (now > peak && !peak_waiting.compare_exchange_weak(peak, now)) {
+    }
+    return true;
+  });
+  pipeline.AddStage({"slow", 1, 2, false, &pool}, [&](int&) {
+    --waiting;
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+    return true;
+  });
+  for (int i = 0; i < 100; ++i) {
+    pipeline.Push(i);
+  }
+  pipeline.WaitIdle();
+
+  // Items done by the fast stage never exceed the slow queue plus the one being processed
+  EXPECT_LE(peak_waiting.load(), 3);
+  auto metrics = pipeline.Metrics();
+  EXPECT_LE(metrics[1]._peak_queue, 2u);
+  EXPECT_LE(metrics[0]._peak_queue, 4u);
+}
+
+TEST(StagePipelineTest, TryPushFailsWhenFull) {
+  ThreadPool         pool{1};
+  std::atomic<bool>  release = false;
+  StagePipeline<int> pipeline;
+  pipeline.AddStage({"blocked", 1, 1, false, &pool}, [&](int&) {
+    while (!release.load()) std::this_thread::yield();
+    return true;
+  });
+  int item = 0;
+  ASSERT_TRUE(pipeline.TryPush(item));
+  // The first item may still be queued, one of the next two pushes finds the queue full
+  bool rejected = false;
+  for (int i = 0; i < 2 && !rejected; ++i) {
+    rejected = !pipeline.TryPush(item);
+    if (!rejected) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  EXPECT_TRUE(rejected);
+  EXPECT_THROW(pipeline.AddStage({"late"}, [](int&) { return true; }), std::runtime_error);
+  release = true;
+  pipeline.WaitIdle();
+}
+};  // namespace puerhlab
@@ -0,0 +1,115 @@
+#include "concurrency/task.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "concurrency/thread_pool.hpp"
+
+namespace puerhlab {
+namespace {
+auto Square(int64_t value) -> Task<int64_t> { co_return value * value; }
+
+auto SumOfSquares(int64_t count) -> Task<int64_t> {
+  int64_t sum = 0;
+  for (int64_t i = 1; i <= count; ++i) sum += co_await Square(i);
+  co_return sum;
+}
+
+auto Fail() -> Task<int> {
+  throw std::runtime_error("boom");
+  co_return 0;
+}
+
+auto SquareOnPool(ThreadPool& pool, int value) -> Task<int> {
+  co_await pool.Schedule();
+  co_return value * value;
+}
+};  // namespace
+
+TEST(TaskTest, IsLazyAndReturnsValue) {
+  bool started = false;
+  // The lambda must outlive the task, a coroutine refers to its captures
+  auto body    = [&]() -> Task<int> {
+    started = true;
+    co_return 42;
+  };
+  auto task    = body();
+  EXPECT_FALSE(started);
+  EXPECT_EQ(SyncWait(std::move(task)), 42);
+  EXPECT_TRUE(started);
+}
+
+TEST(TaskTest, LongAwaitChainsDoNotGrowTheStack) {
+  // Tasks finishing synchronously return to their awaiter instead of resuming it
+  // n(n+1)(2n+1)/6, beyond the range of int
+  EXPECT_EQ(SyncWait(SumOfSquares(200000)), int64_t{2666686666700000});
+  EXPECT_EQ(SyncWait(SumOfSquares(3)), 14);
+}
+
+TEST(TaskTest, ExceptionsPropagateToTheAwaiter) {
+  EXPECT_THROW(SyncWait(Fail()), std::runtime_error);
+  auto outer = []() -> Task<bool> {
+    try {
+      co_await Fail();
+    } catch (const std::runtime_error&) {
+      co_return true;
+    }
+    co_return false;
+  };
+  EXPECT_TRUE(SyncWait(outer()));
+}
+
+TEST(TaskTest, ScheduleResumesOnThePool) {
+  ThreadPool pool{2};
+  auto       caller = std::this_thread::get_id();
+  auto       task   = [&]() -> Task<std::thread::id> {
+    co_await pool.Schedule();
+    co_return std::this_thread::get_id();
+  };
+  EXPECT_NE(SyncWait(task()), caller);
+}
+
+TEST(TaskTest, WhenAllRunsThousandsOfTasksOnAFewThreads) {
+  ThreadPool             pool{4};
+  std::vector<Task<int>> tasks;
+  for (int i = 0; i < 5000; ++i) tasks.push_back(SquareOnPool(pool, i % 100));
+
+  auto results = SyncWait(WhenAll(std::move(tasks)));
+  ASSERT_EQ(results.size(), 5000u);
+  for (int i = 0; i < 5000; ++i) EXPECT_EQ(results[i], (i % 100) * (i % 100));
+
+  std::vector<Task<int>> failing;
+  failing.push_back(SquareOnPool(pool, 2));
+  failing.push_back(Fail());
+  EXPECT_THROW(SyncWait(WhenAll(std::move(failing))), std::runtime_error);
+  EXPECT_TRUE(SyncWait(WhenAll(std::vector<Task<int>>{})).empty());
+}
+
+TEST(TaskTest, WhenAllOfVoidTasksAndDetach) {
+  ThreadPool              pool{2};
+  std::atomic<int>        ran = 0;
+  std::vector<Task<void>> tasks;
+  for (int i = 0; i < 100; ++i) {
+    tasks.push_back([](ThreadPool& pool, std::atomic<int>& ran) -> Task<void> {
+      co_await pool.Schedule(TaskPriority::LOW);
+      ran.fetch_add(1);
+    }(pool, ran));
+  }
+  SyncWait(WhenAll(std::move(tasks)));
+  EXPECT_EQ(ran.load(), 100);
+
+  std::atomic<bool> detached_done = false;
+  Detach([](ThreadPool& pool, std::atomic<bool>& done) -> Task<void> {
+    co_await pool.Schedule();
+    done.store(true);
+    done.notify_one();
+  }(pool, detached_done));
+  detached_done.wait(false);
+  EXPECT_TRUE(detached_done.load());
+}
+};  // namespace puerhlab
@@ -0,0 +1,165 @@
+// Per-task cost of the thread pool submission paths. Not a test, run by hand:
+//   ThreadPoolBenchmark [tasks per configuration] [worker count]
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "concurrency/thread_pool.hpp"
+#include "type/type.hpp"
+
+namespace puerhlab {
+namespace {
+constexpr size_t kBatchSize = 256;
+
+struct Result {
+  // Time spent by the submitting thread
+  double _submit_ns;
+  // Time until the last task has run
+  double _total_ns;
+};
+
+/**
+ * @brief Time submit_all, then wait until every task it queued has incremented done
+ *
+ * @return Result nanoseconds per task
+ */
+template <typename SubmitAll>
+auto Measure(size_t total, std::atomic<size_t>& done, SubmitAll submit_all) -> Result {
+  done.store(0, std::memory_order_relaxed);
+  auto start = std::chrono::steady_clock::now();
+  submit_all();
+  auto submitted = std::chrono::steady_clock::now();
+  while (done.load(std::memory_order_acquire) < total) std::this_thread::yield();
+  auto finished = std::chrono::steady_clock::now();
+  auto per_task = [total](auto elapsed) {
+    return std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(total);
+  };
+  return {per_task(submitted - start), per_task(finished - start)};
+}
+
+/**
+ * @brief The submission path before UniqueTask: the packaged_task is shared so that the copyable
+ * wrapper can hold it
+ */
+auto SharedPackagedTask(ThreadPool& pool, size_t total) -> Result {
+  std::atomic<size_t>            done = 0;
+  std::vector<std::future<void>> futures;
+  futures.reserve(total);
+  return Measure(total, done, [&] {
+    for (size_t i = 0; i < total; ++i) {
+      auto task = std::make_shared<std::packaged_task<void()>>(
+          [&done] { done.fetch_add(1, std::memory_order_release); });
+      futures.push_back(task->get_future());
+      pool.Post([task] { (*task)(); });
+    }
+  });
+}
+
+auto SubmitWithFuture(ThreadPool& pool, size_t total) -> Result {
+  std::atomic<size_t>            done = 0;
+  std::vector<std::future<void>> futures;
+  futures.reserve(total);
+  return Measure(total, done, [&] {
+    for (size_t i = 0; i < total; ++i) {
+      futures.push_back(pool.Submit([&done] { done.fetch_add(1, std::memory_order_release); }));
+    }
+  });
+}
+
+auto Post(ThreadPool& pool, size_t total) -> Result {
+  std::atomic<size_t> done = 0;
+  return Measure(total, done, [&] {
+    for (size_t i = 0; i < total; ++i) {
+      pool.Post([&done] { done.fetch_add(1, std::memory_order_release); });
+    }
+  });
+}
+
+auto SubmitBatch(ThreadPool& pool, size_t total) -> Result {
+  std::atomic<size_t> done = 0;
+  return Measure(total, done, [&] {
+    for (size_t i = 0; i < total; i += kBatchSize) {
+      std::vector<ThreadPool::Task> batch;
+      batch.reserve(kBatchSize);
+      for (size_t j = i; j < total && j < i + kBatchSize; ++j) {
+        batch.emplace_back([&done] { done.fetch_add(1, std::memory_order_release); });
+      }
+      pool.SubmitBatch(std::move(batch));
+    }
+  });
+}
+
+/**
+ * @brief Allocation of the promise each loader request carries, from the global heap and from a
+ * synchronized pool. Single threaded, no task is queued.
+ *
+ * @return double nanoseconds per promise
+ */
+auto PromiseAllocation(size_t total, bool pooled) -> double {
+  std::pmr::synchronized_pool_resource                   resource;
+  std::vector<std::shared_ptr<std::promise<image_id_t>>> promises;
+  promises.reserve(kBatchSize);
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < total; ++i) {
+    if (pooled) {
+      promises.push_back(std::allocate_shared<std::promise<image_id_t>>(
+          std::pmr::polymorphic_allocator<std::promise<image_id_t>>(&resource)));
+    } else {
+      promises.push_back(std::make_shared<std::promise<image_id_t>>());
+    }
+    // Requests are short lived, the promises are released in batches as they complete
+    if (promises.size() == kBatchSize) promises.clear();
+  }
+  promises.clear();
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(total);
+}
+};  // namespace
+};  // namespace puerhlab
+
+int main(int argc, char** argv) {
+  using namespace puerhlab;
+  size_t total   = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+  size_t workers = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 4;
+
+  struct Variant {
+    std::string _name;
+    Result (*_run)(ThreadPool&, size_t);
+  };
+  const Variant variants[] = {
+      {"shared packaged_task", &SharedPackagedTask},
+      {"Submit (future)", &SubmitWithFuture},
+      {"Post", &Post},
+      {"SubmitBatch (" + std::to_string(kBatchSize) + ")", &SubmitBatch},
+  };
+
+  std::cout << "tasks per configuration: " << total << ", workers: " << workers
+            << ", hardware threads: " << std::thread::hardware_concurrency() << "\n\n";
+  std::cout << std::left << std::setw(24) << "path" << std::right << std::setw(12) << "submit"
+            << std::setw(12) << "total" << "   (ns per task)\n";
+
+  ThreadPool pool{workers};
+  for (const auto& variant : variants) {
+    auto result = variant._run(pool, total);
+    std::cout << std::left << std::setw(24) << variant._name << std::right << std::fixed
+              << std::setprecision(1) << std::setw(12) << result._submit_ns << std::setw(12)
+              << result._total_ns << "\n";
+  }
+
+  std::cout << "\npromise allocation\n";
+  std::cout << std::left << std::setw(24) << "  make_shared" << std::right << std::setw(12)
+            << PromiseAllocation(total, false) << "\n";
+  std::cout << std::left << std::setw(24) << "  synchronized pool" << std::right << std::setw(12)
+            << PromiseAllocation(total, true) << "\n";
+  return 0;
+}
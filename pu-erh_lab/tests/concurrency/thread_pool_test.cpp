@@ -0,0 +1,230 @@
+#include "concurrency/thread_pool.hpp"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "concurrency/cpu_topology.hpp"
+#include "concurrency/unique_task.hpp"
+
+namespace puerhlab {
+TEST(UniqueTaskTest, SmallAndLargeCallables) {
+  int        calls = 0;
+  UniqueTask small([&calls] { ++calls; });
+  ASSERT_TRUE(small);
+  small();
+
+  std::array<char, 256> payload{};
+  payload[255] = 1;
+  UniqueTask large([&calls, payload] { calls += payload[255]; });
+  UniqueTask moved(std::move(large));
+  EXPECT_FALSE(large);
+  moved();
+  EXPECT_EQ(calls, 2);
+
+  moved = nullptr;
+  EXPECT_FALSE(moved);
+}
+
+TEST(UniqueTaskTest, DestroysCapturesExactlyOnce) {
+  auto counter = std::make_shared<int>(0);
+  {
+    UniqueTask first([counter] {});
+    UniqueTask second([owned = std::make_unique<int>(1), counter] {});
+    EXPECT_EQ(counter.use_count(), 3);
+    first = std::move(second);
+    EXPECT_EQ(counter.use_count(), 2);
+  }
+  EXPECT_EQ(counter.use_count(), 1);
+}
+
+TEST(ThreadPoolTest, SubmitReturnsResults) {
+  ThreadPool                    pool{4};
+  std::vector<std::future<int>> futures;
+  for (int i = 0; i < 1000; ++i) {
+    futures.push_back(pool.Submit([i] { return i * i; }));
+  }
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_EQ(futures[i].get(), i * i);
+  }
+}
+
+TEST(ThreadPoolTest, ExceptionsReachTheFuture) {
+  ThreadPool pool{2};
+  auto       future = pool.Submit([]() -> int { throw std::runtime_error("failed"); });
+  EXPECT_THROW(future.get(), std::runtime_error);
+  // The worker survived
+  EXPECT_EQ(pool.Submit([] { return 7; }).get(), 7);
+}
+
+TEST(ThreadPoolTest, AcceptsMoveOnlyTasks) {
+  ThreadPool pool{2};
+  auto       value = std::make_unique<int>(42);
+  auto       future = pool.Submit([value = std::move(value)]() mutable { return *value; });
+  EXPECT_EQ(future.get(), 42);
+}
+
+TEST(ThreadPoolTest, TasksSpawnedFromWorkers) {
+  ThreadPool                     pool{4};
+  std::atomic<int>               leaves = 0;
+  std::vector<std::future<void>> roots;
+  for (int i = 0; i < 64; ++i) {
+    roots.push_back(pool.Submit([&pool, &leaves] {
+      for (int j = 0; j < 64; ++j) {
+        pool.Submit([&leaves] { leaves.fetch_add(1); });
+      }
+    }));
+  }
+  for (auto& root : roots) {
+    root.get();
+  }
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (leaves.load() < 64 * 64 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ(leaves.load(), 64 * 64);
+}
+
+TEST(ThreadPoolTest, HigherPriorityRunsFirst) {
+  ThreadPool         pool{1};
+  std::promise<void> started;
+  std::promise<void> release;
+  auto               gate = release.get_future().share();
+  pool.Submit([&started, gate] {
+    started.set_value();
+    gate.wait();
+  });
+  // Everything below is queued while the only worker is busy
+  started.get_future().wait();
+
+  std::mutex       mtx;
+  std::vector<int> order;
+  auto             record = [&](int value) {
+    return [&, value] {
+      std::lock_guard<std::mutex> lock(mtx);
+      order.push_back(value);
+    };
+  };
+  pool.Submit(record(2), TaskPriority::LOW);
+  pool.Submit(record(1), TaskPriority::NORMAL);
+  pool.Submit(record(0), TaskPriority::HIGH);
+  auto done = pool.Submit([] {}, TaskPriority::LOW);
+  release.set_value();
+  done.get();
+  std::lock_guard<std::mutex> lock(mtx);
+  EXPECT_EQ(order, (std::vector<int>{0, 1, 2}));
+}
+
+TEST(ThreadPoolTest, ExternalTasksRunInSubmissionOrder) {
+  ThreadPool         pool{1};
+  std::promise<void> started;
+  std::promise<void> release;
+  auto               gate = release.get_future().share();
+  pool.Submit([&started, gate] {
+    started.set_value();
+    gate.wait();
+  });
+  started.get_future().wait();
+
+  std::vector<int> order;
+  for (int i = 0; i < 8; ++i) {
+    pool.Submit([&order, i] { order.push_back(i); });
+  }
+  auto done = pool.Submit([] {});
+  release.set_value();
+  done.get();
+  EXPECT_EQ(order, (std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7}));
+}
+
+TEST(ThreadPoolTest, PostAndSubmitBatch) {
+  std::atomic<int> ran = 0;
+  {
+    ThreadPool                    pool{4};
+    std::vector<ThreadPool::Task> batch;
+    for (int i = 0; i < 1000; ++i) {
+      batch.emplace_back([&ran] { ran.fetch_add(1); });
+    }
+    pool.SubmitBatch(std::move(batch), TaskPriority::LOW);
+    EXPECT_TRUE(batch.empty());
+    pool.Post([&ran] { ran.fetch_add(1000); }, TaskPriority::HIGH);
+  }
+  EXPECT_EQ(ran.load(), 2000);
+}
+
+TEST(ThreadPoolTest, DestructorRunsQueuedTasks) {
+  std::atomic<int> ran = 0;
+  {
+    ThreadPool pool{2};
+    for (int i = 0; i < 500; ++i) {
+      pool.Submit([&ran] { ran.fetch_add(1); });
+    }
+  }
+  EXPECT_EQ(ran.load(), 500);
+}
+
+TEST(ThreadPoolTest, ParallelForRunsEveryIndexOnce) {
+  ThreadPool                    pool{4};
+  std::vector<std::atomic<int>> hits(1000);
+  pool.ParallelFor(hits.size(), [&hits](size_t i) { hits[i].fetch_add(1); });
+  // Called from a worker, the worker runs its share instead of blocking
+  pool.Submit([&] { pool.ParallelFor(100, [&hits](size_t i) { hits[i].fetch_add(1); }); }).get();
+  for (size_t i = 0; i < hits.size(); ++i) {
+    EXPECT_EQ(hits[i].load(), i < 100 ? 2 : 1);
+  }
+
+  EXPECT_THROW(pool.ParallelFor(10,
+                                [](size_t i) {
+                                  if (i == 3) throw std::runtime_error("failed");
+                                }),
+               std::runtime_error);
+}
+
+TEST(ThreadPoolTest, DomainTasksStayInTheirDomain) {
+  // CPUs the machine may not have, pinning then fails and only the placement is checked
+  auto       topology = CpuTopology::FromDomains({{0, {0, 1}}, {1, {2, 3}}});
+  ThreadPool pool{4, topology};
+  ASSERT_EQ(pool.DomainCount(), 2u);
+  EXPECT_EQ(pool.CurrentDomain(), 0u);
+
+  std::atomic<int> misplaced = 0;
+  std::atomic<int> ran       = 0;
+  for (size_t i = 0; i < 200; ++i) {
+    size_t domain = i % 2;
+    pool.PostToDomain(domain, [&, domain] {
+      if (pool.CurrentDomain() != domain) misplaced.fetch_add(1);
+      ran.fetch_add(1);
+    });
+  }
+  pool.Submit([&] {
+        auto domain = pool.CurrentDomain();
+        pool.ParallelFor(64, [&](size_t) {
+          if (pool.CurrentDomain() != domain) misplaced.fetch_add(1);
+        });
+      })
+      .get();
+  while (ran.load() < 200) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ(misplaced.load(), 0);
+}
+
+TEST(ThreadPoolTest, SingleNodeTopologyIsNotPlaced) {
+  auto       topology = CpuTopology::FromDomains({{0, {0, 1}}, {0, {2, 3}}});
+  ThreadPool pool{2, topology};
+  EXPECT_EQ(pool.DomainCount(), 1u);
+  std::atomic<int> ran = 0;
+  pool.PostToDomain(1, [&ran] { ran.fetch_add(1); });
+  pool.ParallelFor(8, [&ran](size_t) { ran.fetch_add(1); });
+  while (ran.load() < 9) {
+    std::this_thread::yield();
+  }
+}
+};  // namespace puerhlab
@@ -0,0 +1,121 @@
+#include "decoders/bayer_demosaic.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <opencv2/core.hpp>
+#include <stdexcept>
+
+namespace puerhlab {
+namespace {
+constexpr float kBlack = 256.0f;
+constexpr float kWhite = 16383.0f;
+
+// RGGB with a distinct second green, an identity color matrix and unit white balance
+auto MakeParams() -> BayerDevelopParams {
+  return {{{0, 1}, {3, 2}},
+          {{kBlack, kBlack}, {kBlack, kBlack}},
+          kWhite,
+          {1.0f, 1.0f, 1.0f, 1.0f},
+          {{1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}}};
+}
+
+/**
+ * @brief Sample a scene given in white balanced camera RGB through the mosaic of params
+ */
+auto Mosaic(int rows, int cols, const BayerDevelopParams& params,
+            const std::function<float(int, int, int)>& scene) -> cv::Mat {
+  float   wb_min = std::fmin(std::fmin(params._wb[0], params._wb[1]),
+                             std::fmin(params._wb[2], params._wb[3]));
+  cv::Mat cfa(rows, cols, CV_16UC1);
+  for (int row = 0; row < rows; ++row) {
+    auto* dst = cfa.ptr<uint16_t>(row);
+    for (int col = 0; col < cols; ++col) {
+      int   index = params._pattern[row & 1][col & 1];
+      int   color = index == 3 ? 1 : index;
+      float black = params._black[row & 1][col & 1];
+      float value = scene(row, col, color) * wb_min / params._wb[index];
+      dst[col]    = static_cast<uint16_t>(std::lround(value * (kWhite - black) + black));
+    }
+  }
+  return cfa;
+}
+
+auto MaxError(const cv::Mat& rgb, const std::function<float(int, int, int)>& scene) -> float {
+  float error = 0.0f;
+  for (int row = 0; row < rgb.rows; ++row) {
+    const auto* src = rgb.ptr<cv::Vec3f>(row);
+    for (int col = 0; col < rgb.cols; ++col) {
+      for (int c = 0; c < 3; ++c) {
+        error = std::fmax(error, std::fabs(src[col][c] - scene(row, col, c)));
+      }
+    }
+  }
+  return error;
+}
+};  // namespace
+
+TEST(BayerDemosaicTest, FlatFieldIsExact) {
+  auto params = MakeParams();
+  auto scene  = [](int, int, int color) { return 0.25f * (color + 1); };
+  auto rgb    = BayerDemosaic::Develop(Mosaic(40, 30, params, scene), params);
+  ASSERT_EQ(rgb.type(), CV_32FC3);
+  ASSERT_EQ(rgb.rows, 40);
+  ASSERT_EQ(rgb.cols, 30);
+  EXPECT_LT(MaxError(rgb, scene), 1e-3f);
+}
+
+TEST(BayerDemosaicTest, GradientAcrossBands) {
+  // Odd sizes and several bands, every pattern phase and band seam is exercised
+  int  rows  = 3 * BayerDemosaic::_rows_per_band + 7;
+  int  cols  = 101;
+  auto scene = [&](int row, int col, int color) {
+    return 0.1f + 0.2f * color + 0.5f * static_cast<float>(row + col) / (rows + cols);
+  };
+  const uint8_t patterns[3][2][2] = {{{0, 1}, {3, 2}}, {{1, 2}, {0, 3}}, {{2, 3}, {1, 0}}};
+  for (const auto& pattern : patterns) {
+    auto params = MakeParams();
+    std::memcpy(params._pattern, pattern, sizeof(pattern));
+    auto rgb = BayerDemosaic::Develop(Mosaic(rows, cols, params, scene), params);
+    EXPECT_LT(MaxError(rgb, scene), 2e-3f);
+  }
+}
+
+TEST(BayerDemosaicTest, WhiteBalanceAndColorMatrix) {
+  auto params         = MakeParams();
+  params._wb[0]       = 2.0f;
+  params._wb[2]       = 1.5f;
+  params._black[1][1] = 512.0f;
+  // Swap red and blue on output
+  params._cam_to_out[0][0] = 0.0f;
+  params._cam_to_out[0][2] = 1.0f;
+  params._cam_to_out[2][0] = 1.0f;
+  params._cam_to_out[2][2] = 0.0f;
+  auto scene  = [](int, int, int color) { return 0.2f + 0.3f * color; };
+  auto rgb    = BayerDemosaic::Develop(Mosaic(16, 16, params, scene), params);
+  auto output = [&](int row, int col, int color) { return scene(row, col, 2 - color); };
+  EXPECT_LT(MaxError(rgb, output), 1e-3f);
+}
+
+TEST(BayerDemosaicTest, ClipsHighlights) {
+  auto    params = MakeParams();
+  cv::Mat cfa(8, 8, CV_16UC1);
+  for (int row = 0; row < cfa.rows; ++row) {
+    for (int col = 0; col < cfa.cols; ++col) {
+      cfa.ptr<uint16_t>(row)[col] = 65535;
+    }
+  }
+  auto rgb = BayerDemosaic::Develop(cfa, params);
+  EXPECT_LT(MaxError(rgb, [](int, int, int) { return 1.0f; }), 1e-6f);
+}
+
+TEST(BayerDemosaicTest, RejectsInvalidInput) {
+  auto params = MakeParams();
+  EXPECT_THROW(BayerDemosaic::Develop(cv::Mat(4, 4, CV_32FC3), params), std::runtime_error);
+  params._white = kBlack;
+  EXPECT_THROW(BayerDemosaic::Develop(cv::Mat(4, 4, CV_16UC1), params), std::runtime_error);
+}
+};  // namespace puerhlab
@@ -0,0 +1,126 @@
+#include "decoders/decoder_registry.hpp"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <string>
+#include <vector>
+
+#include "decoders/metadata_decoder.hpp"
+#include "decoders/raw_decoder.hpp"
+#include "image/image.hpp"
+
+namespace puerhlab {
+namespace {
+auto Encode(const std::string& ext) -> std::vector<char> {
+  std::vector<uchar> encoded;
+  cv::imencode(ext, cv::Mat(8, 8, CV_8UC3, cv::Scalar(10, 20, 30)), encoded);
+  return {encoded.begin(), encoded.end()};
+}
+
+auto MakeEntry(const std::string& name, std::vector<ImageType> formats, uint32_t capabilities,
+               uint32_t cost) -> DecoderEntry {
+  return {name, std::move(formats), capabilities, cost,
+          [](const DecoderContext&) { return std::make_shared<MetadataDecoder>(); }};
+}
+};  // namespace
+
+TEST(DecoderRegistryTest, SelectsCheapestCapableDecoder) {
+  DecoderRegistry registry;
+  registry.Register(MakeEntry("Expensive", {}, FULL_DECODE | SCALED_DECODE, 10));
+  registry.Register(MakeEntry("Cheap", {}, SCALED_DECODE, 2));
+  registry.Register(MakeEntry("Tied", {}, SCALED_DECODE, 2));
+
+  auto scaled = registry.Select(ImageType::JPEG, SCALED_DECODE);
+  ASSERT_TRUE(scaled.has_value());
+  EXPECT_EQ(scaled->_name, "Cheap");
+
+  auto full = registry.Select(ImageType::JPEG, FULL_DECODE);
+  ASSERT_TRUE(full.has_value());
+  EXPECT_EQ(full->_name, "Expensive");
+
+  EXPECT_FALSE(registry.Select(ImageType::JPEG, PARTIAL_READ).has_value());
+}
+
+TEST(DecoderRegistryTest, RespectsFormats) {
+  DecoderRegistry registry;
+  registry.Register(MakeEntry("RawOnly", {ImageType::CR2, ImageType::NEF}, FULL_DECODE, 1));
+  EXPECT_TRUE(registry.Select(ImageType::NEF, FULL_DECODE).has_value());
+  EXPECT_FALSE(registry.Select(ImageType::PNG, FULL_DECODE).has_value());
+}
+
+TEST(DecoderRegistryTest, BuiltinRouting) {
+  DecoderRegistry registry;
+  registry.RegisterBuiltins();
+  EXPECT_EQ(registry.Select(ImageType::CR3, METADATA_ONLY)->_name, "Metadata");
+  EXPECT_EQ(registry.Select(ImageType::JPEG, METADATA_ONLY | EMBEDDED_PREVIEW)->_name, "Import");
+  EXPECT_EQ(registry.Select(ImageType::ARW, EMBEDDED_PREVIEW)->_name, "Thumbnail");
+  EXPECT_EQ(registry.Select(ImageType::PNG, FULL_DECODE)->_name, "Regular");
+  EXPECT_EQ(registry.Select(ImageType::DNG, FULL_DECODE)->_name, "Raw");
+
+  auto entry = registry.Select(ImageType::TIFF, FULL_DECODE);
+  ASSERT_TRUE(entry.has_value());
+  EXPECT_NE(entry->_factory({}), nullptr);
+}
+
+TEST(DecoderRegistryTest, RawQualityFollowsTheRequest) {
+  DecoderRegistry registry;
+  registry.RegisterBuiltins();
+  auto entry = registry.Select(ImageType::NEF, FULL_DECODE);
+  ASSERT_TRUE(entry.has_value());
+
+  DecoderContext render;
+  auto           full = std::dynamic_pointer_cast<RawDecoder>(entry->_factory(render));
+  ASSERT_NE(full, nullptr);
+  EXPECT_EQ(full->Quality(), RawQuality::FULL);
+
+  DecoderContext open;
+  open._interactive = true;
+  auto preview      = std::dynamic_pointer_cast<RawDecoder>(entry->_factory(open));
+  ASSERT_NE(preview, nullptr);
+  EXPECT_EQ(preview->Quality(), RawQuality::PREVIEW);
+
+  EXPECT_EQ(RawDecoder().Quality(), RawQuality::FULL);
+}
+
+TEST(DecoderRegistryTest, SniffImageType) {
+  auto jpeg = Encode(".jpg");
+  auto png  = Encode(".png");
+  EXPECT_EQ(SniffImageType(jpeg.data(), jpeg.size()), ImageType::JPEG);
+  EXPECT_EQ(SniffImageType(png.data(), png.size()), ImageType::PNG);
+
+  const char cr3[] = "\0\0\0\x18" "ftypcrx ";
+  EXPECT_EQ(SniffImageType(cr3, sizeof(cr3) - 1), ImageType::CR3);
+  const char cr2[] = "II*\0\x10\0\0\0CR\x02\0";
+  EXPECT_EQ(SniffImageType(cr2, sizeof(cr2) - 1), ImageType::CR2);
+
+  EXPECT_EQ(SniffImageType("plain", 5), ImageType::DEFAULT);
+  EXPECT_EQ(SniffImageType(nullptr, 0), ImageType::DEFAULT);
+
+  const char raf[] = "FUJIFILMCCD-RAW 0201";
+  EXPECT_EQ(SniffImageType(raf, sizeof(raf) - 1), ImageType::RAF);
+  const char orf[] = "IIRO\x08\0\0\0";
+  EXPECT_EQ(SniffImageType(orf, sizeof(orf) - 1), ImageType::ORF);
+  const char rw2[] = "IIU\0\x18\0\0\0";
+  EXPECT_EQ(SniffImageType(rw2, sizeof(rw2) - 1), ImageType::RW2);
+}
+
+TEST(DecoderRegistryTest, RawExtensionsFallBackToLibRaw) {
+  // A raw format the sniffing does not know, e.g. a TIFF based raw from another maker
+  const char tiff[] = "II*\0\x08\0\0\0\0\0";
+  EXPECT_EQ(DetectImageType(tiff, sizeof(tiff) - 1, "photo.tif"), ImageType::TIFF);
+  EXPECT_EQ(DetectImageType(tiff, sizeof(tiff) - 1, "photo.PEF"), ImageType::OTHER_RAW);
+  EXPECT_EQ(DetectImageType("plain", 5, "photo.raw"), ImageType::OTHER_RAW);
+  EXPECT_EQ(DetectImageType("plain", 5, "photo.bin"), ImageType::DEFAULT);
+
+  DecoderRegistry registry;
+  registry.RegisterBuiltins();
+  for (auto type : {ImageType::ORF, ImageType::RAF, ImageType::RW2, ImageType::PEF,
+                    ImageType::OTHER_RAW}) {
+    EXPECT_TRUE(IsRawType(type));
+    EXPECT_EQ(registry.Select(type, FULL_DECODE)->_name, "Raw");
+  }
+}
+};  // namespace puerhlab
@@ -1,12 +1,167 @@
 #include "decoders/decoder_scheduler.hpp"
+#include "decoders/image_decoder.hpp"
 #include "../leak_detector/memory_leak_detector.hpp"
 #include "image/image.hpp"
 #include "utils/queue/queue.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <filesystem>
+#include <fstream>
 #include <future>
 #include <gtest/gtest.h>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+/**
+ * @brief Decodes nothing, records the order in which requests reach a decoder. Held requests
+ * wait in the decoder, and so keep a CPU worker busy, until they are released.
+ */
+struct DecodeLog {
+  std::mutex              _mtx;
+  std::condition_variable _cv;
+  std::vector<image_id_t> _order;
+  std::set<image_id_t>    _held;
+  size_t                  _waiting = 0;
+
+  void Release(image_id_t id) {
+    std::lock_guard<std::mutex> lock(_mtx);
+    _held.erase(id);
+    _cv.notify_all();
+  }
+
+  void ReleaseAll() {
+    std::lock_guard<std::mutex> lock(_mtx);
+    _held.clear();
+    _cv.notify_all();
+  }
+
+  void WaitUntilWaiting(size_t count) {
+    std::unique_lock<std::mutex> lock(_mtx);
+    _cv.wait(lock, [&] { return _waiting >= count; });
+  }
+};
+
+class RecordingDecoder : public puerhlab::ImageDecoder {
+ private:
+  std::shared_ptr<DecodeLog> _log;
+
+ public:
+  explicit RecordingDecoder(std::shared_ptr<DecodeLog> log) : _log(std::move(log)) {}
+
+  void Decode(std::vector<char>, std::filesystem::path,
+              std::shared_ptr<puerhlab::ConcurrentBlockingQueue<std::shared_ptr<puerhlab::Image>>>,
+              image_id_t id, std::shared_ptr<std::promise<image_id_t>> promise) override {
+    {
+      std::unique_lock<std::mutex> lock(_log->_mtx);
+      _log->_order.push_back(id);
+      ++_log->_waiting;
+      _log->_cv.notify_all();
+      _log->_cv.wait(lock, [&] { return _log->_held.count(id) == 0; });
+      --_log->_waiting;
+    }
+    promise->set_value(id);
+  }
+};
+
+/**
+ * @brief Hands an image over through the decoded buffer before satisfying the promise, as the
+ * builtin SLEEVE_LOADING decoders do
+ */
+class BufferingDecoder : public puerhlab::ImageDecoder {
+ public:
+  using DecodedBuffer = puerhlab::ConcurrentBlockingQueue<std::shared_ptr<puerhlab::Image>>;
+
+  void Decode(std::vector<char>, std::filesystem::path file_path,
+              std::shared_ptr<DecodedBuffer> result, image_id_t id,
+              std::shared_ptr<std::promise<image_id_t>> promise) override {
+    result->push(std::make_shared<puerhlab::Image>(id, file_path, puerhlab::ImageType::DEFAULT));
+    promise->set_value(id);
+  }
+};
+
+/**
+ * @brief Throws like a decoder library given a corrupt file
+ */
+class ThrowingDecoder : public puerhlab::ImageDecoder {
+ public:
+  void Decode(std::vector<char>, std::filesystem::path,
+              std::shared_ptr<puerhlab::ConcurrentBlockingQueue<std::shared_ptr<puerhlab::Image>>>,
+              image_id_t, std::shared_ptr<std::promise<image_id_t>>) override {
+    throw std::runtime_error("Corrupt file.");
+  }
+};
+
+/**
+ * @brief Serve the SLEEVE_LOADING requests of the scheduler with a RecordingDecoder, it is
+ * cheaper than every builtin decoder
+ */
+void RegisterRecordingDecoder(puerhlab::DecoderScheduler& scheduler,
+                              std::shared_ptr<DecodeLog>  log) {
+  scheduler.Registry().Register({"Recording", {}, puerhlab::METADATA_ONLY, 0,
+                                 [log](const puerhlab::DecoderContext&) {
+                                   return std::make_shared<RecordingDecoder>(log);
+                                 }});
+}
+
+auto WriteSample(const std::string& name) -> std::filesystem::path {
+  auto          path = std::filesystem::temp_directory_path() / name;
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file << name;
+  return path;
+}
+
+auto Schedule(puerhlab::DecoderScheduler& scheduler, image_id_t id,
+              const std::filesystem::path& path, puerhlab::DecodePriority priority,
+              puerhlab::CancellationToken token = {}) -> std::future<image_id_t> {
+  auto promise = std::make_shared<std::promise<image_id_t>>();
+  auto future  = promise->get_future();
+  scheduler.ScheduleDecode(id, path, promise, priority, std::move(token));
+  return future;
+}
+
+/**
+ * @brief Keep every CPU worker busy with a held request, then let request hold_id take the only
+ * read slot. It waits for a worker, so the requests scheduled afterwards stay in the pending heap.
+ *
+ * @return std::vector<std::future<image_id_t>> the futures of the held requests
+ */
+auto HoldWorkersAndReadSlot(puerhlab::DecoderScheduler& scheduler, DecodeLog& log,
+                            const std::filesystem::path& path, image_id_t hold_id)
+    -> std::vector<std::future<image_id_t>> {
+  auto                                 workers = puerhlab::Executor::Instance().Cpu().ThreadCount();
+  std::vector<std::future<image_id_t>> held;
+  for (image_id_t id = 0; id < workers; ++id) {
+    log._held.insert(id);
+  }
+  for (image_id_t id = 0; id < workers; ++id) {
+    held.push_back(Schedule(scheduler, id, path, puerhlab::DecodePriority::VISIBLE));
+    log.WaitUntilWaiting(id + 1);
+  }
+  held.push_back(Schedule(scheduler, hold_id, path, puerhlab::DecodePriority::VISIBLE));
+  return held;
+}
+
+auto IsCancelled(std::future<image_id_t>& future) -> bool {
+  if (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+    return false;
+  }
+  try {
+    future.get();
+  } catch (puerhlab::OperationCancelled& e) {
+    return std::string(e.what()) == "Decode request cancelled.";
+  } catch (...) {
+  }
+  return false;
+}
+};  // namespace
 
 TEST(MultipleImageDecoder, FORCE_LEAK) {
   // MemoryLeakDetector leakDetector;
@@ -89,4 +244,228 @@ TEST(MultipleImageDecoder, FORCE_LEAK) {
 
   // decoder_future2.get();
   // std::cin >> a;
-}
\ No newline at end of file
+}
+
+TEST(MultipleImageDecoder, CancelledRequestIsDropped) {
+  puerhlab::DecoderScheduler scheduler(
+      2, std::make_shared<puerhlab::ConcurrentBlockingQueue<std::shared_ptr<puerhlab::Image>>>(64));
+
+  auto token = puerhlab::CancellationToken::Create();
+  token.Cancel();
+
+  auto decode_promise = std::make_shared<std::promise<uint32_t>>();
+  auto decode_future  = decode_promise->get_future();
+  // The path does not exist, a cancelled request must fail without trying to open it
+  scheduler.ScheduleDecode(1, L"NOT_EXIST.jpg", decode_promise,
+                           puerhlab::DecodePriority::BACKGROUND, token);
+  EXPECT_THROW(
+      {
+        try {
+          decode_future.get();
+        } catch (std::runtime_error& e) {
+          EXPECT_STREQ(e.what(), "Decode request cancelled.");
+          throw;
+        }
+      },
+      std::runtime_error);
+}
+
+TEST(MultipleImageDecoder, ReadFilesGoThroughTheDecodeAndDeliverStages) {
+  puerhlab::DecoderScheduler scheduler(
+      2, std::make_shared<puerhlab::ConcurrentBlockingQueue<std::shared_ptr<puerhlab::Image>>>(64));
+
+  // Readable, but in no format a decoder understands
+  auto path = std::filesystem::temp_directory_path() / "puerhlab_not_an_image.bin";
+  {
+    std::ofstream file(path, std::ios::binary);
+    file << "not an image";
+  }
+  auto decode_promise = std::make_shared<std::promise<uint32_t>>();
+  auto decode_future  = decode_promise->get_future();
+  scheduler.ScheduleDecode(1, path, decode_promise);
+  // The metadata decoder satisfies the promise even when it cannot read the metadata
+  EXPECT_EQ(decode_future.get(), 1u);
+
+  // A stage records the request once its function has returned
+  for (int i = 0; i < 200 && scheduler.Metrics().back()._processed == 0; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  auto metrics = scheduler.Metrics();
+  ASSERT_EQ(metrics.size(), 3u);
+  EXPECT_EQ(metrics[0]._name, "thumbnail lookup");
+  EXPECT_EQ(metrics[0]._processed, 0u);
+  EXPECT_EQ(metrics[1]._name, "decode");
+  EXPECT_EQ(metrics[1]._processed, 1u);
+  EXPECT_EQ(metrics[2]._name, "deliver");
+  EXPECT_EQ(metrics[2]._processed, 1u);
+  std::filesystem::remove(path);
+}
+
+TEST(MultipleImageDecoder, VisibleRequestsOvertakeBackgroundOnes) {
+  auto                       buffer =
+      std::make_shared<puerhlab::ConcurrentBlockingQueue<std::shared_ptr<puerhlab::Image>>>(64);
+  // One read at a time, so that every request but the one being read waits in the pending heap
+  puerhlab::DecoderScheduler scheduler(1, buffer, 1);
+  auto                       log = std::make_shared<DecodeLog>();
+  RegisterRecordingDecoder(scheduler, log);
+  auto                                 path    = WriteSample("puerhlab_priority_sample.bin");
+
+  // Keep all CPU workers busy. The next request read then holds the only read slot until a
+  // worker is free to decode it, while the following ones are queued behind it.
+  auto                                 workers = puerhlab::Executor::Instance().Cpu().ThreadCount();
+  std::vector<std::future<image_id_t>> holders;
+  for (image_id_t id = 0; id < workers; ++id) {
+    log->_held.insert(id);
+  }
+  for (image_id_t id = 0; id < workers; ++id) {
+    holders.push_back(Schedule(scheduler, id, path, puerhlab::DecodePriority::VISIBLE));
+    log->WaitUntilWaiting(id + 1);
+  }
+
+  std::vector<std::future<image_id_t>> futures;
+  for (image_id_t id : {101u, 102u, 103u}) {
+    futures.push_back(Schedule(scheduler, id, path, puerhlab::DecodePriority::BACKGROUND));
+  }
+  for (image_id_t id : {201u, 202u, 203u}) {
+    futures.push_back(Schedule(scheduler, id, path, puerhlab::DecodePriority::VISIBLE));
+  }
+  // 101 got the read slot, the others wait in the heap
+  EXPECT_EQ(scheduler.PendingCount(), 5u);
+
+  // A single free worker decodes the requests one after the other
+  log->Release(0);
+  for (auto& future : futures) {
+    future.get();
+  }
+  log->ReleaseAll();
+  for (auto& future : holders) {
+    future.get();
+  }
+
+  std::vector<image_id_t> order(log->_order.begin() + workers, log->_order.end());
+  std::vector<image_id_t> expected = {101, 201, 202, 203, 102, 103};
+  EXPECT_EQ(order, expected);
+  std::filesystem::remove(path);
+}
+
+TEST(MultipleImageDecoder, AFullBufferDoesNotHoldDecodeThreads) {
+  auto                       buffer =
+      std::make_shared<puerhlab::ConcurrentBlockingQueue<std::shared_ptr<puerhlab::Image>>>(1);
+  puerhlab::DecoderScheduler scheduler(4, buffer);
+  scheduler.Registry().Register({"Buffering", {}, puerhlab::METADATA_ONLY, 0,
+                                 [](const puerhlab::DecoderContext&) {
+                                   return std::make_shared<BufferingDecoder>();
+                                 }});
+  auto                                 path    = WriteSample("puerhlab_full_buffer_sample.bin");
+
+  // More requests than CPU workers, and no image is taken before all of them are decoded
+  auto                                 workers = puerhlab::Executor::Instance().Cpu().ThreadCount();
+  std::vector<std::future<image_id_t>> futures;
+  for (image_id_t id = 0; id < workers * 2 + 2; ++id) {
+    futures.push_back(Schedule(scheduler, id, path, puerhlab::DecodePriority::BACKGROUND));
+  }
+  for (auto& future : futures) {
+    ASSERT_EQ(future.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+  }
+  auto probe = puerhlab::Executor::Instance().Cpu().Submit([] { return true; });
+  ASSERT_EQ(probe.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+
+  // The images the buffer had no room for come out as the consumer makes room
+  std::set<image_id_t> taken;
+  for (size_t i = 0; i < futures.size(); ++i) {
+    taken.insert(buffer->pop()->_image_id);
+  }
+  EXPECT_EQ(taken.size(), futures.size());
+  EXPECT_FALSE(buffer->try_pop_for(std::chrono::milliseconds(0)).has_value());
+  std::filesystem::remove(path);
+}
+
+TEST(MultipleImageDecoder, AThrowingDecoderFailsOnlyItsRequest) {
+  auto                       buffer =
+      std::make_shared<puerhlab::ConcurrentBlockingQueue<std::shared_ptr<puerhlab::Image>>>(64);
+  puerhlab::DecoderScheduler scheduler(2, buffer);
+  scheduler.Registry().Register({"Throwing", {}, puerhlab::METADATA_ONLY, 0,
+                                 [](const puerhlab::DecoderContext&) {
+                                   return std::make_shared<ThrowingDecoder>();
+                                 }});
+  auto path = WriteSample("puerhlab_throwing_sample.bin");
+
+  // The scheduler keeps serving requests after each failure
+  for (image_id_t id = 0; id < 4; ++id) {
+    auto future = Schedule(scheduler, id, path, puerhlab::DecodePriority::VISIBLE);
+    EXPECT_THROW(
+        {
+          try {
+            future.get();
+          } catch (std::runtime_error& e) {
+            EXPECT_STREQ(e.what(), "Corrupt file.");
+            throw;
+          }
+        },
+        std::runtime_error);
+  }
+  std::filesystem::remove(path);
+}
+
+TEST(MultipleImageDecoder, CancellingAPendingRequestFailsItAtOnce) {
+  auto                       buffer =
+      std::make_shared<puerhlab::ConcurrentBlockingQueue<std::shared_ptr<puerhlab::Image>>>(64);
+  puerhlab::DecoderScheduler scheduler(1, buffer, 1);
+  auto                       log = std::make_shared<DecodeLog>();
+  RegisterRecordingDecoder(scheduler, log);
+  auto path   = WriteSample("puerhlab_cancel_pending_sample.bin");
+  auto held   = HoldWorkersAndReadSlot(scheduler, *log, path, 100);
+  auto token  = puerhlab::CancellationToken::Create();
+  auto future = Schedule(scheduler, 301, path, puerhlab::DecodePriority::BACKGROUND, token);
+  EXPECT_EQ(scheduler.PendingCount(), 1u);
+
+  // Dropped from the heap on this thread, nothing has to be decoded first
+  token.Cancel();
+  EXPECT_EQ(scheduler.PendingCount(), 0u);
+  EXPECT_TRUE(IsCancelled(future));
+
+  log->ReleaseAll();
+  for (auto& held_future : held) {
+    held_future.get();
+  }
+  EXPECT_EQ(std::count(log->_order.begin(), log->_order.end(), 301u), 0);
+  std::filesystem::remove(path);
+}
+
+TEST(MultipleImageDecoder, LinkedTokensDropManyRequestsAtOnce) {
+  auto                       buffer =
+      std::make_shared<puerhlab::ConcurrentBlockingQueue<std::shared_ptr<puerhlab::Image>>>(64);
+  puerhlab::DecoderScheduler scheduler(1, buffer, 1);
+  auto                       log = std::make_shared<DecodeLog>();
+  RegisterRecordingDecoder(scheduler, log);
+  auto path = WriteSample("puerhlab_cancel_linked_sample.bin");
+  auto held = HoldWorkersAndReadSlot(scheduler, *log, path, 100);
+  EXPECT_EQ(scheduler.PendingCount(), 0u);
+
+  // e.g. a folder view: one token per batch of thumbnails, all linked to the view's token
+  auto                                     view    = puerhlab::CancellationToken::Create();
+  std::vector<puerhlab::CancellationToken> batches = {
+      puerhlab::CancellationToken::CreateLinked(view),
+      puerhlab::CancellationToken::CreateLinked(view)};
+  std::vector<std::future<image_id_t>>     dropped;
+  for (image_id_t id = 0; id < 8; ++id) {
+    dropped.push_back(
+        Schedule(scheduler, 400 + id, path, puerhlab::DecodePriority::PREFETCH, batches[id % 2]));
+  }
+  auto unrelated = Schedule(scheduler, 500, path, puerhlab::DecodePriority::BACKGROUND,
+                            puerhlab::CancellationToken::Create());
+  EXPECT_EQ(scheduler.PendingCount(), 9u);
+
+  view.Cancel();
+  EXPECT_EQ(scheduler.PendingCount(), 1u);
+  for (auto& future : dropped) {
+    EXPECT_TRUE(IsCancelled(future));
+  }
+
+  log->ReleaseAll();
+  EXPECT_EQ(unrelated.get(), 500u);
+  for (auto& held_future : held) {
+    held_future.get();
+  }
+  std::filesystem::remove(path);
+}
@@ -0,0 +1,108 @@
+#include "decoders/import_decoder.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <vector>
+
+#include "image/image.hpp"
+#include "storage/thumbnail_store/thumbnail_store.hpp"
+#include "utils/hash/content_hash.hpp"
+#include "utils/queue/queue.hpp"
+
+namespace puerhlab {
+namespace {
+auto WriteJpeg(const std::filesystem::path& path, int rows, int cols) -> std::vector<char> {
+  std::vector<uchar> encoded;
+  cv::imencode(".jpg", cv::Mat(rows, cols, CV_8UC3, cv::Scalar(40, 80, 120)), encoded);
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+  return {encoded.begin(), encoded.end()};
+}
+};  // namespace
+
+TEST(ImportDecoderTest, ThumbnailIsReduced) {
+  auto    path      = std::filesystem::temp_directory_path() / "puerhlab_import_reduced.jpg";
+  auto    buffer    = WriteJpeg(path, 4000, 6000);
+  cv::Mat thumbnail = ImportDecoder::DecodeThumbnail(buffer);
+  ASSERT_FALSE(thumbnail.empty());
+  EXPECT_EQ(thumbnail.type(), CV_8UC3);
+  EXPECT_LE(std::max(thumbnail.rows, thumbnail.cols),
+            static_cast<int>(ThumbnailStore::_default_max_edge));
+}
+
+TEST(ImportDecoderTest, SingleReadPopulatesImageAndStore) {
+  auto path     = std::filesystem::temp_directory_path() / "puerhlab_import_single.jpg";
+  auto buffer   = WriteJpeg(path, 480, 640);
+  auto checksum = ContentHash::FromBuffer(buffer.data(), buffer.size());
+
+  auto store_dir = std::filesystem::temp_directory_path() / "puerhlab_import_store";
+  std::filesystem::remove_all(store_dir);
+  auto          store   = std::make_shared<ThumbnailStore>(store_dir);
+  auto          result  = std::make_shared<BufferQueue>(4);
+  auto          promise = std::make_shared<std::promise<image_id_t>>();
+  ImportDecoder decoder{store};
+  decoder.Decode(std::move(buffer), path, result, 7, promise);
+
+  EXPECT_EQ(promise->get_future().get(), 7);
+  auto img = result->pop();
+  EXPECT_EQ(img->_content_hash, checksum);
+  // The thumbnail went to the store instead of staying in memory
+  EXPECT_FALSE(img->_has_thumbnail);
+  auto fingerprint = ThumbnailFingerprint::FromFile(path);
+  ASSERT_TRUE(fingerprint.has_value());
+  EXPECT_TRUE(store->Get(7, *fingerprint).has_value());
+}
+
+TEST(ImportDecoderTest, WithoutStoreThumbnailStaysInImage) {
+  auto path    = std::filesystem::temp_directory_path() / "puerhlab_import_no_store.jpg";
+  auto buffer  = WriteJpeg(path, 480, 640);
+  auto result  = std::make_shared<BufferQueue>(4);
+  auto promise = std::make_shared<std::promise<image_id_t>>();
+  ImportDecoder decoder;
+  decoder.Decode(std::move(buffer), path, result, 1, promise);
+
+  auto img = result->pop();
+  EXPECT_TRUE(img->_has_thumbnail);
+  EXPECT_EQ(img->GetThumbnailData().type(), CV_32FC3);
+}
+
+TEST(ImportDecoderTest, RawJpegPairUsesSidecarThumbnail) {
+  auto dir = std::filesystem::temp_directory_path() / "puerhlab_import_pair";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  auto sidecar = dir / "IMG_0001.JPG";
+  WriteJpeg(sidecar, 480, 640);
+  // A CR2 header LibRaw cannot decode, the thumbnail can only come from the sidecar
+  std::vector<char> raw = {'I', 'I', '*', '\0', 0x10, 0, 0, 0, 'C', 'R', 0x02, 0};
+  raw.resize(4096);
+  auto raw_path = dir / "IMG_0001.CR2";
+  {
+    std::ofstream out(raw_path, std::ios::binary);
+    out.write(raw.data(), raw.size());
+  }
+
+  auto store_dir = std::filesystem::temp_directory_path() / "puerhlab_import_pair_store";
+  std::filesystem::remove_all(store_dir);
+  auto          store   = std::make_shared<ThumbnailStore>(store_dir);
+  auto          result  = std::make_shared<BufferQueue>(4);
+  auto          promise = std::make_shared<std::promise<image_id_t>>();
+  ImportDecoder decoder{store};
+  decoder.Decode(std::move(raw), raw_path, result, 3, promise);
+
+  EXPECT_EQ(promise->get_future().get(), 3);
+  auto img = result->pop();
+  EXPECT_EQ(img->_image_type, ImageType::CR2);
+  EXPECT_EQ(img->_sidecar_path, sidecar);
+  // Stored under the fingerprint of the file THUMB requests will read
+  auto fingerprint = ThumbnailFingerprint::FromFile(sidecar);
+  ASSERT_TRUE(fingerprint.has_value());
+  EXPECT_TRUE(store->Get(3, *fingerprint).has_value());
+}
+};  // namespace puerhlab
@@ -0,0 +1,48 @@
+#include "decoders/regular_decoder.hpp"
+
+#include <gtest/gtest.h>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <string>
+#include <vector>
+
+namespace puerhlab {
+namespace {
+auto Encode(const cv::Mat& image, const std::string& ext) -> std::vector<char> {
+  std::vector<uchar> encoded;
+  cv::imencode(ext, image, encoded);
+  return {encoded.begin(), encoded.end()};
+}
+};  // namespace
+
+TEST(RegularDecoderTest, EightBitIsLinearized) {
+  // BGR order: blue 0, green 128, red 255
+  cv::Mat        image(16, 16, CV_8UC3, cv::Scalar(0, 128, 255));
+  RegularDecoder decoder;
+  cv::Mat        linear = decoder.Decode(Encode(image, ".png"));
+
+  ASSERT_EQ(linear.type(), CV_32FC3);
+  auto pixel = linear.at<cv::Vec3f>(8, 8);
+  // Channels come out in RGB order
+  EXPECT_FLOAT_EQ(pixel[0], 1.0f);
+  EXPECT_NEAR(pixel[1], 0.2158f, 1e-3);
+  EXPECT_FLOAT_EQ(pixel[2], 0.0f);
+}
+
+TEST(RegularDecoderTest, SixteenBitKeepsPrecision) {
+  // Two levels which collapse into the same 8-bit value
+  cv::Mat image(16, 16, CV_16UC3, cv::Scalar(30000, 30000, 30000));
+  image.rowRange(8, 16).setTo(cv::Scalar(30100, 30100, 30100));
+  RegularDecoder decoder;
+  cv::Mat        linear = decoder.Decode(Encode(image, ".png"));
+
+  ASSERT_EQ(linear.type(), CV_32FC3);
+  EXPECT_LT(linear.at<cv::Vec3f>(0, 0)[0], linear.at<cv::Vec3f>(15, 0)[0]);
+}
+
+TEST(RegularDecoderTest, InvalidDataThrows) {
+  RegularDecoder decoder;
+  EXPECT_THROW(decoder.Decode(std::vector<char>(64, 'x')), std::runtime_error);
+}
+};  // namespace puerhlab
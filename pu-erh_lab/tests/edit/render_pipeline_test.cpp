@@ -0,0 +1,85 @@
+#include "edit/pipeline/render_pipeline.hpp"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <opencv2/core.hpp>
+#include <stdexcept>
+#include <vector>
+
+#include "concurrency/cancellation_token.hpp"
+#include "concurrency/task.hpp"
+#include "concurrency/thread_pool.hpp"
+#include "image/image_buffer.hpp"
+
+namespace puerhlab {
+namespace {
+struct AddOp {
+  float _offset;
+
+  auto  Apply(ImageBuffer& input) -> ImageBuffer {
+    cv::Mat output = input.GetCPUData() + _offset;
+    return ImageBuffer{std::move(output)};
+  }
+};
+
+auto MakeBuffer(float value) -> ImageBuffer {
+  return ImageBuffer{cv::Mat(4, 4, CV_32FC1, cv::Scalar(value))};
+}
+};  // namespace
+
+TEST(RenderPipelineTest, AppliesStagesInOrder) {
+  RenderPipeline pipeline;
+  pipeline.AddOperator(std::make_shared<AddOp>(AddOp{1.0f}));
+  pipeline.AddStage([](ImageBuffer& input) {
+    cv::Mat output = input.GetCPUData() * 2.0;
+    return ImageBuffer{std::move(output)};
+  });
+  EXPECT_EQ(pipeline.StageCount(), 2u);
+
+  auto rendered = SyncWait(pipeline.Render(MakeBuffer(1.0f)));
+  EXPECT_FLOAT_EQ(rendered.GetCPUData().at<float>(3, 3), 4.0f);
+}
+
+TEST(RenderPipelineTest, ManyRendersShareAFewThreads) {
+  ThreadPool     pool{2};
+  RenderPipeline pipeline{pool};
+  pipeline.AddOperator(std::make_shared<AddOp>(AddOp{0.5f}));
+
+  std::vector<Task<ImageBuffer>> renders;
+  for (int i = 0; i < 500; ++i) {
+    renders.push_back(pipeline.Render(MakeBuffer(static_cast<float>(i)), TaskPriority::LOW));
+  }
+  auto rendered = SyncWait(WhenAll(std::move(renders)));
+  ASSERT_EQ(rendered.size(), 500u);
+  for (int i = 0; i < 500; ++i) {
+    EXPECT_FLOAT_EQ(rendered[i].GetCPUData().at<float>(0, 0), i + 0.5f);
+  }
+}
+
+TEST(RenderPipelineTest, CancelledRenderStopsBetweenStages) {
+  RenderPipeline pipeline;
+  auto           token = CancellationToken::Create();
+  int            ran   = 0;
+  pipeline.AddStage([&](ImageBuffer& input) {
+    ++ran;
+    // e.g. the slider moved again while this render was running
+    token.Cancel();
+    return std::move(input);
+  });
+  pipeline.AddOperator(std::make_shared<AddOp>(AddOp{1.0f}));
+
+  EXPECT_THROW(SyncWait(pipeline.Render(MakeBuffer(0.0f), TaskPriority::HIGH, token)),
+               OperationCancelled);
+  EXPECT_EQ(ran, 1);
+  EXPECT_THROW(SyncWait(pipeline.Render(MakeBuffer(0.0f), TaskPriority::HIGH, token)),
+               OperationCancelled);
+  EXPECT_EQ(ran, 1);
+}
+
+TEST(RenderPipelineTest, StageErrorsReachTheAwaiter) {
+  RenderPipeline pipeline;
+  pipeline.AddStage([](ImageBuffer&) -> ImageBuffer { throw std::runtime_error("bad stage"); });
+  EXPECT_THROW(SyncWait(pipeline.Render(MakeBuffer(0.0f))), std::runtime_error);
+}
+};  // namespace puerhlab
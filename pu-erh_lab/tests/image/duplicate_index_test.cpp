@@ -0,0 +1,93 @@
+#include "io/image/duplicate_index.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "utils/hash/content_hash.hpp"
+
+namespace puerhlab {
+namespace {
+auto WriteSample(const std::string& name, size_t size, char salt = 0) -> std::filesystem::path {
+  auto          path = std::filesystem::temp_directory_path() / name;
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  for (size_t i = 0; i < size; ++i) {
+    out.put(static_cast<char>(i % 251 + salt));
+  }
+  return path;
+}
+
+void ShiftModifiedTime(const std::filesystem::path& path) {
+  std::filesystem::last_write_time(
+      path, std::filesystem::last_write_time(path) - std::chrono::hours(24));
+}
+};  // namespace
+
+TEST(DuplicateIndexTest, SignatureOnlyReadsBlocksAtBothEnds) {
+  size_t size     = QuickSignature::_block_size * 4;
+  auto   original = WriteSample("puerhlab_dup_sig_a.bin", size);
+  auto   other    = WriteSample("puerhlab_dup_sig_b.bin", size);
+  // Differs from the original in the middle only, which the signature does not cover
+  {
+    std::fstream out(other, std::ios::binary | std::ios::in | std::ios::out);
+    out.seekp(static_cast<std::streamoff>(size / 2));
+    out.put('!');
+  }
+  std::filesystem::last_write_time(other, std::filesystem::last_write_time(original));
+
+  auto a = QuickSignature::FromFile(original);
+  auto b = QuickSignature::FromFile(other);
+  ASSERT_TRUE(a.has_value());
+  ASSERT_TRUE(b.has_value());
+  EXPECT_EQ(a->_file_size, size);
+  EXPECT_EQ(*a, *b);
+
+  auto small = QuickSignature::FromFile(WriteSample("puerhlab_dup_sig_c.bin", 100));
+  ASSERT_TRUE(small.has_value());
+  EXPECT_NE(small->_partial_hash, a->_partial_hash);
+  EXPECT_FALSE(
+      QuickSignature::FromFile(std::filesystem::temp_directory_path() / "puerhlab_dup_missing")
+          .has_value());
+}
+
+TEST(DuplicateIndexTest, MatchesKnownFiles) {
+  auto known = WriteSample("puerhlab_dup_known.bin", 300000);
+  auto fresh = WriteSample("puerhlab_dup_fresh.bin", 300000, 1);
+
+  DuplicateIndex index;
+  index.Add(*QuickSignature::FromFile(known), *ContentHash::FromFile(known));
+  EXPECT_EQ(index.Size(), 1u);
+  EXPECT_TRUE(index.Contains(known));
+  EXPECT_FALSE(index.Contains(fresh));
+  EXPECT_FALSE(index.Contains(std::filesystem::temp_directory_path() / "puerhlab_dup_missing"));
+}
+
+TEST(DuplicateIndexTest, CopyWithNewTimeFallsBackToContentHash) {
+  auto known = WriteSample("puerhlab_dup_card.bin", 300000);
+  auto copy  = std::filesystem::temp_directory_path() / "puerhlab_dup_copy.bin";
+  std::filesystem::copy_file(known, copy, std::filesystem::copy_options::overwrite_existing);
+  ShiftModifiedTime(copy);
+
+  DuplicateIndex without_hash;
+  without_hash.Add(*QuickSignature::FromFile(known), ContentHash{});
+  EXPECT_FALSE(without_hash.Contains(copy));
+
+  DuplicateIndex index;
+  index.Add(*QuickSignature::FromFile(known), *ContentHash::FromFile(known));
+  EXPECT_TRUE(index.Contains(copy));
+  // The copy is remembered under its own modification time
+  EXPECT_EQ(index.Size(), 2u);
+
+  // Same size, same blocks at both ends, different content
+  {
+    std::fstream out(copy, std::ios::binary | std::ios::in | std::ios::out);
+    out.seekp(150000);
+    out.put('!');
+  }
+  ShiftModifiedTime(copy);
+  EXPECT_FALSE(index.Contains(copy));
+}
+};  // namespace puerhlab
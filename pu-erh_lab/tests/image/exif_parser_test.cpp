@@ -0,0 +1,275 @@
+#include "image/exif_parser.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <exiv2/exiv2.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "image/metadata.hpp"
+
+namespace puerhlab {
+namespace {
+/**
+ * @brief Assemble a TIFF structure with IFD0 and an EXIF IFD, values which do not fit in an entry
+ * are appended to a data area after both IFDs
+ */
+class TiffBuilder {
+ private:
+  struct Entry {
+    uint16_t             tag;
+    uint16_t             type;
+    uint32_t             count;
+    std::vector<uint8_t> value;
+  };
+  bool               _little_endian;
+  std::vector<Entry> _ifd0;
+  std::vector<Entry> _exif;
+  uint16_t           _exif_pointer_type = 4;
+
+  void Put16(std::vector<uint8_t>& out, uint16_t v) const {
+    if (_little_endian) {
+      out.insert(out.end(), {static_cast<uint8_t>(v), static_cast<uint8_t>(v >> 8)});
+    } else {
+      out.insert(out.end(), {static_cast<uint8_t>(v >> 8), static_cast<uint8_t>(v)});
+    }
+  }
+
+  void Put32(std::vector<uint8_t>& out, uint32_t v) const {
+    if (_little_endian) {
+      Put16(out, static_cast<uint16_t>(v));
+      Put16(out, static_cast<uint16_t>(v >> 16));
+    } else {
+      Put16(out, static_cast<uint16_t>(v >> 16));
+      Put16(out, static_cast<uint16_t>(v));
+    }
+  }
+
+  void WriteIfd(std::vector<uint8_t>& out, const std::vector<Entry>& entries,
+                std::vector<uint8_t>& data, uint32_t data_base) const {
+    Put16(out, static_cast<uint16_t>(entries.size()));
+    for (const auto& e : entries) {
+      Put16(out, e.tag);
+      Put16(out, e.type);
+      Put32(out, e.count);
+      if (e.value.size() <= 4) {
+        auto value = e.value;
+        value.resize(4, 0);
+        out.insert(out.end(), value.begin(), value.end());
+      } else {
+        Put32(out, data_base + static_cast<uint32_t>(data.size()));
+        data.insert(data.end(), e.value.begin(), e.value.end());
+      }
+    }
+    Put32(out, 0);
+  }
+
+ public:
+  explicit TiffBuilder(bool little_endian) : _little_endian(little_endian) {}
+
+  // Some cameras write the EXIF IFD pointer with the IFD type (13) rather than LONG
+  void SetExifPointerType(uint16_t type) { _exif_pointer_type = type; }
+
+  void Ascii(bool exif, uint16_t tag, const std::string& text) {
+    std::vector<uint8_t> value(text.begin(), text.end());
+    value.push_back(0);
+    (exif ? _exif : _ifd0).push_back({tag, 2, static_cast<uint32_t>(value.size()), value});
+  }
+
+  void Short(bool exif, uint16_t tag, uint16_t v) {
+    std::vector<uint8_t> value;
+    Put16(value, v);
+    (exif ? _exif : _ifd0).push_back({tag, 3, 1, value});
+  }
+
+  void Long(bool exif, uint16_t tag, uint32_t v) {
+    std::vector<uint8_t> value;
+    Put32(value, v);
+    (exif ? _exif : _ifd0).push_back({tag, 4, 1, value});
+  }
+
+  void Rational(bool exif, uint16_t tag, uint32_t num, uint32_t den) {
+    std::vector<uint8_t> value;
+    Put32(value, num);
+    Put32(value, den);
+    (exif ? _exif : _ifd0).push_back({tag, 5, 1, value});
+  }
+
+  auto Build() -> std::vector<uint8_t> {
+    // A plain TIFF has no EXIF IFD
+    bool     has_exif  = !_exif.empty();
+    uint32_t ifd0_size = 2 + 12 * static_cast<uint32_t>(_ifd0.size() + has_exif) + 4;
+    uint32_t exif_size = has_exif ? 2 + 12 * static_cast<uint32_t>(_exif.size()) + 4 : 0;
+    uint32_t exif_base = 8 + ifd0_size;
+    uint32_t data_base = exif_base + exif_size;
+    if (has_exif) {
+      Long(false, 0x8769, exif_base);
+      _ifd0.back().type = _exif_pointer_type;
+    }
+
+    std::vector<uint8_t> out;
+    out.push_back(_little_endian ? 'I' : 'M');
+    out.push_back(_little_endian ? 'I' : 'M');
+    Put16(out, 42);
+    Put32(out, 8);
+    std::vector<uint8_t> data;
+    WriteIfd(out, _ifd0, data, data_base);
+    if (has_exif) {
+      WriteIfd(out, _exif, data, data_base);
+    }
+    out.insert(out.end(), data.begin(), data.end());
+    return out;
+  }
+};
+
+auto SampleTiff(bool little_endian) -> std::vector<uint8_t> {
+  TiffBuilder builder{little_endian};
+  builder.Ascii(false, 0x010F, "NIKON CORPORATION");
+  builder.Ascii(false, 0x0110, "NIKON Z 8");
+  builder.Short(false, 0x0112, 6);
+  builder.Long(false, 0x0100, 8256);
+  builder.Long(false, 0x0101, 5504);
+  builder.Rational(true, 0x829A, 1, 250);
+  builder.Rational(true, 0x829D, 28, 10);
+  builder.Short(true, 0x8827, 800);
+  builder.Ascii(true, 0x9003, "2024:05:17 13:45:10");
+  builder.Rational(true, 0x920A, 50, 1);
+  builder.Ascii(true, 0xA434, "NIKKOR Z 50mm f/1.8 S");
+  return builder.Build();
+}
+
+void ExpectSample(const ImageMetadata& metadata) {
+  EXPECT_EQ(metadata.Make(), "NIKON CORPORATION");
+  EXPECT_EQ(metadata.Model(), "NIKON Z 8");
+  EXPECT_EQ(metadata.Lens(), "NIKKOR Z 50mm f/1.8 S");
+  EXPECT_EQ(metadata._orientation, 6);
+  EXPECT_FLOAT_EQ(metadata._exposure_time, 0.004f);
+  EXPECT_FLOAT_EQ(metadata._aperture, 2.8f);
+  EXPECT_FLOAT_EQ(metadata._focal_length, 50.0f);
+  EXPECT_EQ(metadata._iso, 800);
+  EXPECT_EQ(metadata._capture_time, 1715953510);
+}
+
+auto Parse(const std::vector<uint8_t>& data) -> std::optional<ImageMetadata> {
+  return ExifParser::Parse(reinterpret_cast<const char*>(data.data()), data.size());
+}
+};  // namespace
+
+TEST(ExifParserTest, LittleEndianTiff) {
+  auto metadata = Parse(SampleTiff(true));
+  ASSERT_TRUE(metadata.has_value());
+  ExpectSample(*metadata);
+  EXPECT_EQ(metadata->_width, 8256);
+  EXPECT_EQ(metadata->_height, 5504);
+}
+
+TEST(ExifParserTest, BigEndianTiff) {
+  auto metadata = Parse(SampleTiff(false));
+  ASSERT_TRUE(metadata.has_value());
+  ExpectSample(*metadata);
+}
+
+TEST(ExifParserTest, ExifPointerOfTypeIfd) {
+  TiffBuilder builder{true};
+  builder.SetExifPointerType(13);
+  builder.Ascii(false, 0x010F, "OLYMPUS");
+  builder.Short(true, 0x8827, 400);
+  builder.Rational(true, 0x920A, 25, 1);
+  auto metadata = Parse(builder.Build());
+  ASSERT_TRUE(metadata.has_value());
+  EXPECT_EQ(metadata->_iso, 400);
+  EXPECT_FLOAT_EQ(metadata->_focal_length, 25.0f);
+}
+
+TEST(ExifParserTest, PlainTiffHasNoExif) {
+  TiffBuilder builder{true};
+  builder.Long(false, 0x0100, 640);
+  builder.Long(false, 0x0101, 480);
+  builder.Short(false, 0x0112, 1);
+  EXPECT_FALSE(Parse(builder.Build()).has_value());
+}
+
+TEST(ExifParserTest, JpegApp1AndFrameHeader) {
+  auto                 tiff = SampleTiff(true);
+  std::vector<uint8_t> jpeg = {0xFF, 0xD8, 0xFF, 0xE1};
+  uint16_t             app1_length = static_cast<uint16_t>(2 + 6 + tiff.size());
+  jpeg.insert(jpeg.end(), {static_cast<uint8_t>(app1_length >> 8),
+                           static_cast<uint8_t>(app1_length), 'E', 'x', 'i', 'f', 0, 0});
+  jpeg.insert(jpeg.end(), tiff.begin(), tiff.end());
+  // SOF0: precision 8, height 3000, width 4000
+  jpeg.insert(jpeg.end(), {0xFF, 0xC0, 0x00, 0x0B, 0x08, 0x0B, 0xB8, 0x0F, 0xA0, 0x01, 0x01,
+                           0x11, 0x00});
+
+  auto metadata = Parse(jpeg);
+  ASSERT_TRUE(metadata.has_value());
+  ExpectSample(*metadata);
+  EXPECT_EQ(metadata->_width, 4000);
+  EXPECT_EQ(metadata->_height, 3000);
+}
+
+TEST(ExifParserTest, UnsupportedOrCorruptedData) {
+  // No EXIF segment in the JPEG
+  EXPECT_FALSE(Parse({0xFF, 0xD8, 0xFF, 0xDA, 0x00, 0x02}).has_value());
+  // ORF magic number
+  EXPECT_FALSE(Parse({'I', 'I', 'R', 'O', 8, 0, 0, 0}).has_value());
+  // IFD0 beyond the end of the data
+  EXPECT_FALSE(Parse({'I', 'I', 42, 0, 0xFF, 0, 0, 0}).has_value());
+
+  // Truncated data must never be read out of bounds
+  auto tiff = SampleTiff(true);
+  for (size_t size = 0; size < tiff.size(); ++size) {
+    ExifParser::Parse(reinterpret_cast<const char*>(tiff.data()), size);
+  }
+}
+
+/**
+ * @brief Compare the parse time against Exiv2 on the files of the directory given by the
+ * PUERHLAB_EXIF_CORPUS environment variable
+ */
+TEST(ExifParserTest, BenchmarkAgainstExiv2) {
+  const char* corpus = std::getenv("PUERHLAB_EXIF_CORPUS");
+  if (!corpus) {
+    GTEST_SKIP() << "PUERHLAB_EXIF_CORPUS is not set";
+  }
+  using clock = std::chrono::steady_clock;
+  clock::duration fast_time{}, exiv2_time{};
+  size_t          files = 0, fast_hits = 0;
+  for (const auto& entry : std::filesystem::recursive_directory_iterator(corpus)) {
+    if (!entry.is_regular_file()) {
+      continue;
+    }
+    std::ifstream     in(entry.path(), std::ios::binary);
+    std::vector<char> buffer((std::istreambuf_iterator<char>(in)), {});
+
+    auto              start = clock::now();
+    auto              fast  = ExifParser::Parse(buffer.data(), buffer.size());
+    fast_time += clock::now() - start;
+
+    start = clock::now();
+    try {
+      auto exif_image = Exiv2::ImageFactory::open(
+          reinterpret_cast<const Exiv2::byte*>(buffer.data()), buffer.size());
+      exif_image->readMetadata();
+    } catch (std::exception& e) {
+    }
+    exiv2_time += clock::now() - start;
+
+    ++files;
+    fast_hits += fast.has_value();
+  }
+  ASSERT_GT(files, 0u);
+  auto per_file = [files](clock::duration d) {
+    return std::chrono::duration<double, std::micro>(d).count() / files;
+  };
+  std::cout << files << " files, " << fast_hits << " parsed without Exiv2\n"
+            << "ExifParser: " << per_file(fast_time) << " us/file\n"
+            << "Exiv2:      " << per_file(exiv2_time) << " us/file" << std::endl;
+}
+};  // namespace puerhlab
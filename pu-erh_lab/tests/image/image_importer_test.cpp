@@ -0,0 +1,201 @@
+#include "io/image/image_importer.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <thread>
+
+#include "io/image/duplicate_index.hpp"
+#include "type/type.hpp"
+
+namespace puerhlab {
+namespace {
+void Touch(const std::filesystem::path& path) {
+  std::filesystem::create_directories(path.parent_path());
+  std::ofstream out(path, std::ios::binary);
+  out << "x";
+}
+};  // namespace
+
+TEST(ImageImporterTest, WalkerYieldsSupportedFilesRecursively) {
+  auto root = std::filesystem::temp_directory_path() / "puerhlab_walker";
+  std::filesystem::remove_all(root);
+  Touch(root / "a.jpg");
+  Touch(root / "notes.txt");
+  Touch(root / "day1" / "b.CR2");
+  Touch(root / "day1" / "deep" / "c.dng");
+  Touch(root / "day2" / "d.xmp");
+  std::filesystem::create_directories(root / "empty");
+
+  std::set<image_path_t> found;
+  DirectoryWalker        walker{root};
+  while (auto path = walker.Next()) {
+    found.insert(path->filename());
+  }
+  EXPECT_EQ(found, (std::set<image_path_t>{L"a.jpg", L"b.CR2", L"c.dng"}));
+
+  std::set<image_path_t> top_level;
+  DirectoryWalker        flat_walker{root, false};
+  while (auto path = flat_walker.Next()) {
+    top_level.insert(path->filename());
+  }
+  EXPECT_EQ(top_level, (std::set<image_path_t>{L"a.jpg"}));
+}
+
+TEST(ImageImporterTest, WalkerSkipsRawJpegSidecars) {
+  auto root = std::filesystem::temp_directory_path() / "puerhlab_walker_pairs";
+  std::filesystem::remove_all(root);
+  Touch(root / "IMG_0001.CR3");
+  Touch(root / "IMG_0001.JPG");
+  Touch(root / "IMG_0002.nef");
+  Touch(root / "IMG_0002.jpeg");
+  Touch(root / "IMG_0003.JPG");
+
+  std::set<image_path_t> found;
+  DirectoryWalker        walker{root};
+  while (auto path = walker.Next()) {
+    found.insert(path->filename());
+  }
+  EXPECT_EQ(found, (std::set<image_path_t>{L"IMG_0001.CR3", L"IMG_0002.nef", L"IMG_0003.JPG"}));
+
+  std::set<image_path_t> unpaired;
+  DirectoryWalker        unpaired_walker{root, true, false};
+  while (auto path = unpaired_walker.Next()) {
+    unpaired.insert(path->filename());
+  }
+  EXPECT_EQ(unpaired.size(), 5u);
+}
+
+TEST(ImageImporterTest, WalkerOnMissingDirectory) {
+  DirectoryWalker walker{std::filesystem::temp_directory_path() / "puerhlab_walker_missing"};
+  EXPECT_FALSE(walker.Next().has_value());
+}
+
+TEST(ImageImporterTest, ControlPauseResumeCancel) {
+  ImportControl control;
+  EXPECT_TRUE(control.WaitWhilePaused());
+
+  control.Pause();
+  EXPECT_TRUE(control.IsPaused());
+  std::thread resumer([&control] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    control.Resume();
+  });
+  EXPECT_TRUE(control.WaitWhilePaused());
+  resumer.join();
+
+  control.Pause();
+  std::thread canceller([&control] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    control.Cancel();
+  });
+  EXPECT_FALSE(control.WaitWhilePaused());
+  canceller.join();
+  EXPECT_TRUE(control.Token().IsCancelled());
+}
+
+TEST(ImageImporterTest, CancelledImportStopsPullingPaths) {
+  ImageLoader   loader{16, 2, 0};
+  ImageImporter importer{loader, 4};
+  auto          control = std::make_shared<ImportControl>();
+  control->Cancel();
+
+  int           pulled   = 0;
+  auto          progress = importer.Import(
+      [&pulled]() -> std::optional<image_path_t> {
+        ++pulled;
+        return std::filesystem::temp_directory_path() / "puerhlab_missing.jpg";
+      },
+      [](std::shared_ptr<Image>) {}, {}, control);
+  EXPECT_EQ(pulled, 0);
+  EXPECT_EQ(progress._imported, 0u);
+}
+
+TEST(ImageImporterTest, FilesInFlightWhenCancelledAreCounted) {
+  auto sample = std::filesystem::temp_directory_path() / "puerhlab_importer_cancel.jpg";
+  Touch(sample);
+
+  ImageLoader   loader{16, 2, 0};
+  ImageImporter importer{loader, 4};
+  auto          control  = std::make_shared<ImportControl>();
+  // The first image cancels the import, the other files scheduled with it are still in flight
+  auto          progress = importer.Import([&]() -> std::optional<image_path_t> { return sample; },
+                                           [&](std::shared_ptr<Image>) { control->Cancel(); }, {},
+                                           control);
+  EXPECT_EQ(progress._discovered, 4u);
+  EXPECT_EQ(progress._imported, 1u);
+  EXPECT_EQ(progress._failed, 0u);
+  EXPECT_EQ(progress._cancelled, 3u);
+}
+
+TEST(ImageImporterTest, FailedFilesAreCounted) {
+  ImageLoader   loader{16, 2, 0};
+  ImageImporter importer{loader, 4};
+
+  int           remaining = 10;
+  auto          progress  = importer.Import(
+      [&remaining]() -> std::optional<image_path_t> {
+        if (remaining == 0) return std::nullopt;
+        --remaining;
+        return std::filesystem::temp_directory_path() / "puerhlab_missing.jpg";
+      },
+      [](std::shared_ptr<Image>) { FAIL(); });
+  EXPECT_EQ(progress._discovered, 10u);
+  EXPECT_EQ(progress._failed, 10u);
+  EXPECT_EQ(progress._imported, 0u);
+}
+
+TEST(ImageImporterTest, KnownFilesAreSkippedBeforeDecoding) {
+  auto known = std::filesystem::temp_directory_path() / "puerhlab_importer_known.jpg";
+  Touch(known);
+  auto index = std::make_shared<DuplicateIndex>();
+  index->Add(*QuickSignature::FromFile(known), ContentHash{});
+
+  ImageLoader   loader{16, 2, 0};
+  ImageImporter importer{loader, 4};
+  importer.SetDuplicateIndex(index);
+
+  int           remaining = 5;
+  auto          progress  = importer.Import(
+      [&]() -> std::optional<image_path_t> {
+        if (remaining == 0) return std::nullopt;
+        --remaining;
+        return known;
+      },
+      [](std::shared_ptr<Image>) { FAIL(); });
+  EXPECT_EQ(progress._discovered, 5u);
+  EXPECT_EQ(progress._skipped, 5u);
+  EXPECT_EQ(progress._failed, 0u);
+}
+
+TEST(ImageImporterTest, ImportedFilesAreAddedToTheIndex) {
+  auto sample = std::filesystem::temp_directory_path() / "puerhlab_importer_added.jpg";
+  Touch(sample);
+  auto        index = std::make_shared<DuplicateIndex>();
+
+  ImageLoader loader{16, 2, 0};
+  auto        import_once = [&] {
+    ImageImporter importer{loader, 4};
+    importer.SetDuplicateIndex(index);
+    bool pulled = false;
+    return importer.Import(
+        [&]() -> std::optional<image_path_t> {
+          if (pulled) return std::nullopt;
+          pulled = true;
+          return sample;
+        },
+        [](std::shared_ptr<Image>) {});
+  };
+
+  auto first = import_once();
+  EXPECT_EQ(first._imported, 1u);
+  EXPECT_EQ(index->Size(), 1u);
+
+  auto second = import_once();
+  EXPECT_EQ(second._skipped, 1u);
+  EXPECT_EQ(second._imported, 0u);
+}
+};  // namespace puerhlab
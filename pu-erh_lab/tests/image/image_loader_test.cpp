@@ -1,4 +1,5 @@
 #include "../leak_detector/memory_leak_detector.hpp"
+#include "concurrency/task.hpp"
 #include "decoders/decoder_scheduler.hpp"
 #include "image/image.hpp"
 #include "io/image/image_loader.hpp"
@@ -30,4 +31,26 @@ TEST(ImageLoaderTest, BatchLoad) {
     // std::wcout << *img << std::endl;
     total_size--;
   }
+}
+
+TEST(ImageLoaderTest, AwaitThumbnails) {
+  using namespace puerhlab;
+  ImageLoader  image_loader(128, 8, 0);
+  image_path_t path = L"D:\\Projects\\pu-erh_lab\\pu-erh_"
+                      L"lab\\tests\\resources\\sample_images\\jpg";
+  std::vector<Task<std::shared_ptr<Image>>> loads;
+  image_id_t                                id = 0;
+  for (const auto &img : std::filesystem::directory_iterator(path)) {
+    auto image = std::make_shared<Image>(id++, img.path(), ImageType::DEFAULT);
+    loads.push_back(image_loader.LoadThumb(image));
+  }
+
+  // No thread waits on a future, every load resumes the WhenAll once decoded
+  auto loaded = SyncWait(WhenAll(std::move(loads)));
+  EXPECT_EQ(loaded.size(), id);
+  for (const auto &img : loaded) {
+    EXPECT_FALSE(img->GetThumbnailData().empty());
+  }
+  // Awaited loads are not pushed to the buffer read by LoadImage()
+  EXPECT_EQ(image_loader.TryLoadImage(std::chrono::milliseconds(10)), nullptr);
 }
\ No newline at end of file
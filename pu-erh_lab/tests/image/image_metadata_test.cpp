@@ -0,0 +1,67 @@
+#include "image/metadata.hpp"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "image/image.hpp"
+
+namespace puerhlab {
+TEST(ImageMetadataTest, ParseCaptureTime) {
+  EXPECT_EQ(ImageMetadata::ParseCaptureTime("1970:01:01 00:00:00"), 0);
+  EXPECT_EQ(ImageMetadata::ParseCaptureTime("2024:05:17 13:45:10"), 1715953510);
+  EXPECT_EQ(ImageMetadata::ParseCaptureTime("2024:02:30 00:00:00"), 0);
+  EXPECT_EQ(ImageMetadata::ParseCaptureTime("    :  :     :  :  "), 0);
+}
+
+TEST(ImageMetadataTest, JsonRoundTrip) {
+  auto metadata = ImageMetadata::FromJson({{"make", "SONY"},
+                                           {"model", "ILCE-7RM5"},
+                                           {"lens", "FE 35mm F1.4 GM"},
+                                           {"aperture", 1.4f},
+                                           {"focal_length", 35.0f},
+                                           {"exposure_time", 0.004f},
+                                           {"iso", 200},
+                                           {"capture_time", 1715953510},
+                                           {"width", 9504},
+                                           {"height", 6336},
+                                           {"orientation", 6}});
+  auto restored = ImageMetadata::FromJson(metadata.ToJson());
+  EXPECT_EQ(restored.Make(), "SONY");
+  EXPECT_EQ(restored.Model(), "ILCE-7RM5");
+  EXPECT_EQ(restored.Lens(), "FE 35mm F1.4 GM");
+  EXPECT_FLOAT_EQ(restored._aperture, 1.4f);
+  EXPECT_EQ(restored._iso, 200);
+  EXPECT_EQ(restored._capture_time, 1715953510);
+  EXPECT_EQ(restored._width, 9504);
+  EXPECT_EQ(restored._orientation, 6);
+}
+
+TEST(ImageMetadataTest, LongStringsAreTruncated) {
+  auto metadata = ImageMetadata::FromJson({{"make", std::string(100, 'a') + "   "}});
+  EXPECT_EQ(metadata.Make().size(), sizeof(metadata._make) - 1);
+  EXPECT_EQ(ImageMetadata::FromJson({{"make", "Canon   "}}).Make(), "Canon");
+}
+
+TEST(ImageMetadataTest, ImageJsonRoundTrip) {
+  Image image{0, "sample.jpg", ImageType::JPEG};
+  image.JsonToExif(R"({"make":"FUJIFILM","iso":640})");
+  EXPECT_TRUE(image._has_exif);
+  EXPECT_EQ(image._metadata.Make(), "FUJIFILM");
+
+  Image restored{1, "sample.jpg", ImageType::JPEG};
+  restored.JsonToExif(image.ExifToJson());
+  EXPECT_EQ(restored._metadata._iso, 640);
+
+  // Records written by older versions carry none of the known fields
+  Image legacy{2, "sample.jpg", ImageType::JPEG};
+  legacy.JsonToExif(R"({"IFD0":[2,1]})");
+  EXPECT_EQ(legacy._metadata._iso, 0);
+  EXPECT_FALSE(legacy._has_exif);
+
+  // The record saved for a file without EXIF
+  Image plain{3, "sample.png", ImageType::PNG};
+  plain.JsonToExif(ImageMetadata{}.ToJson().dump());
+  EXPECT_FALSE(plain._has_exif);
+}
+};  // namespace puerhlab
@@ -0,0 +1,91 @@
+#include "utils/io/file_reader.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "utils/hash/content_hash.hpp"
+
+namespace puerhlab {
+namespace {
+auto WriteSample(const std::string& name, size_t size) -> std::filesystem::path {
+  auto          path = std::filesystem::temp_directory_path() / name;
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  for (size_t i = 0; i < size; ++i) {
+    out.put(static_cast<char>(i % 251));
+  }
+  return path;
+}
+};  // namespace
+
+TEST(FileReaderTest, ReadsWholeFiles) {
+  constexpr int                                file_count = 64;
+  auto                                         reader     = FileReader::Create(8, 4);
+
+  std::vector<std::promise<std::vector<char>>> promises(file_count);
+  std::vector<std::future<std::vector<char>>>  futures;
+  for (int i = 0; i < file_count; ++i) {
+    futures.push_back(promises[i].get_future());
+    auto path = WriteSample("puerhlab_reader_" + std::to_string(i) + ".bin", 4096 * (i + 1) + i);
+    reader->Read(path, [&promises, i](std::vector<char>&& buffer, std::exception_ptr error) {
+      if (error) {
+        promises[i].set_exception(error);
+      } else {
+        promises[i].set_value(std::move(buffer));
+      }
+    });
+  }
+  for (int i = 0; i < file_count; ++i) {
+    auto buffer = futures[i].get();
+    ASSERT_EQ(buffer.size(), static_cast<size_t>(4096 * (i + 1) + i));
+    EXPECT_EQ(static_cast<unsigned char>(buffer.back()), (buffer.size() - 1) % 251);
+  }
+}
+
+TEST(FileReaderTest, MissingFileReportsError) {
+  auto                             reader = FileReader::Create(8, 4);
+  std::promise<std::exception_ptr> promise;
+  auto                             future = promise.get_future();
+  reader->Read(std::filesystem::temp_directory_path() / "puerhlab_reader_missing.bin",
+               [&promise](std::vector<char>&&, std::exception_ptr error) {
+                 promise.set_value(error);
+               });
+  EXPECT_NE(future.get(), nullptr);
+}
+
+TEST(FileReaderTest, ReadHashedMatchesOneShotHash) {
+  auto reader = FileReader::Create(8, 4);
+  // One file below the chunk size and one spanning several chunks
+  for (size_t size : {size_t{70000}, ContentHasher::_chunk_size * 2 + 12345}) {
+    auto path = WriteSample("puerhlab_reader_hashed_" + std::to_string(size) + ".bin", size);
+    std::promise<std::pair<std::vector<char>, ContentHash>> promise;
+    auto                                                    future = promise.get_future();
+    reader->ReadHashed(path, [&promise](std::vector<char>&& buffer, ContentHash hash,
+                                        std::exception_ptr error) {
+      if (error) {
+        promise.set_exception(error);
+      } else {
+        promise.set_value({std::move(buffer), hash});
+      }
+    });
+    auto [buffer, hash] = future.get();
+    ASSERT_EQ(buffer.size(), size);
+    EXPECT_FALSE(hash.IsEmpty());
+    EXPECT_EQ(hash, ContentHash::FromBuffer(buffer.data(), buffer.size()));
+    EXPECT_EQ(hash, ContentHash::FromFile(path));
+  }
+}
+
+TEST(FileReaderTest, ThreadPoolFallbackDepth) {
+  ThreadPoolFileReader reader{6};
+  EXPECT_EQ(reader.QueueDepth(), 6u);
+}
+};  // namespace puerhlab
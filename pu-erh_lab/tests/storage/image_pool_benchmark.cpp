@@ -0,0 +1,142 @@
+// Lookup throughput of ImagePoolManager under many reader threads, against the same pool behind a
+// single mutex. Not a test, run by hand:
+//   ImagePoolBenchmark [operations per configuration]
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <opencv2/core.hpp>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "image/image.hpp"
+#include "storage/image_pool/image_pool_manager.hpp"
+#include "type/type.hpp"
+
+namespace puerhlab {
+namespace {
+constexpr image_id_t kImageCount   = 4096;
+constexpr uint32_t   kCachedThumbs = 1024;
+constexpr int        kThumbSide    = 64;
+
+void LoadThumbnail(Image& image) {
+  image.LoadThumbnail(ImageBuffer{cv::Mat(kThumbSide, kThumbSide, CV_8UC1)});
+}
+
+/**
+ * @brief Fill a pool and warm its thumbnail cache with the first kCachedThumbs images
+ */
+auto MakePool() -> std::unique_ptr<ImagePoolManager> {
+  auto pool = std::make_unique<ImagePoolManager>(kCachedThumbs * kThumbSide * kThumbSide, 0);
+  for (image_id_t id = 0; id < kImageCount; ++id) {
+    auto image = std::make_shared<Image>(id, L"PATH", ImageType::DEFAULT);
+    LoadThumbnail(*image);
+    pool->Insert(image);
+  }
+  for (image_id_t id = 0; id < kCachedThumbs; ++id) {
+    pool->RecordAccess(id, AccessType::THUMB);
+  }
+  return pool;
+}
+
+/**
+ * @brief Run threads threads, each doing total / threads operations of a browsing mix: thumbnail
+ * lookups, metadata lookups and the occasional cache miss recorded after a load. A thread only
+ * loads the images of its own stripe, no two threads write the same buffer
+ *
+ * @return double nanoseconds per operation end to end
+ */
+template <typename Guard>
+auto RunMix(size_t threads, size_t total, ImagePoolManager& pool, Guard guard) -> double {
+  size_t                   per_thread = total / threads;
+  std::atomic<bool>        go         = false;
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      std::mt19937                              rng{static_cast<uint32_t>(t)};
+      std::uniform_int_distribution<image_id_t> pick(0, kImageCount - 1);
+      std::uniform_int_distribution<int>        roll(0, 99);
+      while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+      for (size_t i = 0; i < per_thread; ++i) {
+        auto id = pick(rng);
+        int  op = roll(rng);
+        guard([&] {
+          if (op < 80) {
+            auto image = pool.AccessElement(id, AccessType::THUMB);
+            if (!image.has_value() && id % threads == t) {
+              LoadThumbnail(*pool.AccessElement(id, AccessType::META)->lock());
+              pool.RecordAccess(id, AccessType::THUMB);
+            }
+          } else {
+            pool.AccessElement(id, AccessType::META);
+          }
+        });
+      }
+    });
+  }
+  auto start = std::chrono::steady_clock::now();
+  go.store(true, std::memory_order_release);
+  for (auto& worker : workers) worker.join();
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() /
+         static_cast<double>(per_thread * threads);
+}
+
+auto Sharded(size_t threads, size_t total) -> double {
+  auto pool = MakePool();
+  return RunMix(threads, total, *pool, [](auto&& op) { op(); });
+}
+
+/**
+ * @brief Every operation behind one mutex, what serializing the whole pool would cost
+ */
+auto GlobalMutex(size_t threads, size_t total) -> double {
+  auto       pool = MakePool();
+  std::mutex mutex;
+  return RunMix(threads, total, *pool, [&](auto&& op) {
+    std::lock_guard lock(mutex);
+    op();
+  });
+}
+};  // namespace
+};  // namespace puerhlab
+
+int main(int argc, char** argv) {
+  using namespace puerhlab;
+  size_t total = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4'000'000;
+
+  struct Variant {
+    std::string _name;
+    double (*_run)(size_t, size_t);
+  };
+  const Variant variants[] = {
+      {"global mutex", &GlobalMutex},
+      {"sharded", &Sharded},
+  };
+
+  std::cout << "operations per configuration: " << total << ", images: " << kImageCount
+            << ", cached thumbnails: " << kCachedThumbs
+            << ", hardware threads: " << std::thread::hardware_concurrency() << "\n\n";
+  std::cout << std::left << std::setw(16) << "pool" << std::right;
+  for (size_t threads : {1, 2, 4, 8, 16}) {
+    std::cout << std::setw(10) << (std::to_string(threads) + "T");
+  }
+  std::cout << "   (ns per operation)\n";
+
+  for (const auto& variant : variants) {
+    std::cout << std::left << std::setw(16) << variant._name << std::right << std::fixed
+              << std::setprecision(1);
+    for (size_t threads : {1, 2, 4, 8, 16}) {
+      std::cout << std::setw(10) << variant._run(threads, total) << std::flush;
+    }
+    std::cout << "\n";
+  }
+  return 0;
+}
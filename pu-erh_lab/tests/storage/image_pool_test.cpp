@@ -1,10 +1,13 @@
 #include <gtest/gtest.h>
 
+#include <atomic>
 #include <cstddef>
 #include <exception>
 #include <exiv2/exif.hpp>
 #include <memory>
+#include <opencv2/core.hpp>
 #include <random>
+#include <thread>
 #include <vector>
 
 #include "image/image.hpp"
@@ -12,21 +15,38 @@
 #include "type/type.hpp"
 
 namespace puerhlab {
+namespace {
+constexpr int    kThumbSide  = 64;
+constexpr int    kFullSide   = 512;
+constexpr size_t kThumbBytes = kThumbSide * kThumbSide;
+constexpr size_t kFullBytes  = kFullSide * kFullSide;
+
+/**
+ * @brief Image with a kThumbBytes thumbnail and a kFullBytes full image loaded
+ */
+auto MakeImage(image_id_t id, image_path_t path) -> std::shared_ptr<Image> {
+  auto img = std::make_shared<Image>(id, path, ImageType::DEFAULT);
+  img->LoadThumbnail(ImageBuffer{cv::Mat(kThumbSide, kThumbSide, CV_8UC1)});
+  img->LoadData(ImageBuffer{cv::Mat(kFullSide, kFullSide, CV_8UC1)});
+  return img;
+}
+};  // namespace
+
 TEST(ImagePoolTest, SimpleTest1) {
-  // Using default setting, thumbnail cache 64, full img cache 3
-  ImagePoolManager                    img_pool{};
+  // Room for 64 thumbnails and 3 full images
+  ImagePoolManager                    img_pool{64 * kThumbBytes, 3 * kFullBytes};
 
   std::vector<std::shared_ptr<Image>> images_thumb;
   image_id_t                          start_id = 0;
   for (int i = 0; i < 128; i++) {
-    auto img = std::make_shared<Image>(start_id++, L"PATH", ImageType::DEFAULT);
+    auto img = MakeImage(start_id++, L"PATH");
     images_thumb.push_back(img);
     img_pool.Insert(img);
   }
 
   std::vector<std::shared_ptr<Image>> images_full;
   for (int i = 0; i < 8; i++) {
-    auto img = std::make_shared<Image>(start_id++, L"PATH_FOR_FULL", ImageType::DEFAULT);
+    auto img = MakeImage(start_id++, L"PATH_FOR_FULL");
     images_full.push_back(img);
     img_pool.Insert(img);
   }
@@ -48,20 +68,20 @@ TEST(ImagePoolTest, SimpleTest1) {
 }
 
 TEST(ImagePoolTest, SimpleTest2) {
-  // Using default setting, thumbnail cache 64, full img cache 3
-  ImagePoolManager                    img_pool{32, 3};
+  // Room for 32 thumbnails and 3 full images
+  ImagePoolManager                    img_pool{32 * kThumbBytes, 3 * kFullBytes};
 
   std::vector<std::shared_ptr<Image>> images_thumb;
   image_id_t                          start_id = 0;
   for (int i = 0; i < 128; i++) {
-    auto img = std::make_shared<Image>(start_id++, L"PATH", ImageType::DEFAULT);
+    auto img = MakeImage(start_id++, L"PATH");
     images_thumb.push_back(img);
     img_pool.Insert(img);
   }
 
   std::vector<std::shared_ptr<Image>> images_full;
   for (int i = 0; i < 8; i++) {
-    auto img = std::make_shared<Image>(start_id++, L"PATH_FOR_FULL", ImageType::DEFAULT);
+    auto img = MakeImage(start_id++, L"PATH_FOR_FULL");
     images_full.push_back(img);
     img_pool.Insert(img);
   }
@@ -85,20 +105,20 @@ TEST(ImagePoolTest, SimpleTest2) {
 
 TEST(ImagePoolTest, RandomTest1) {
   try {
-    // Using default setting, thumbnail cache 64, full img cache 3
-    ImagePoolManager                    img_pool{32, 3};
+    // Room for 32 thumbnails and 3 full images
+    ImagePoolManager                    img_pool{32 * kThumbBytes, 3 * kFullBytes};
 
     std::vector<std::shared_ptr<Image>> images_thumb;
     image_id_t                          start_id = 0;
     for (int i = 0; i < 128; i++) {
-      auto img = std::make_shared<Image>(start_id++, L"PATH", ImageType::DEFAULT);
+      auto img = MakeImage(start_id++, L"PATH");
       images_thumb.push_back(img);
       img_pool.Insert(img);
     }
 
     std::vector<std::shared_ptr<Image>> images_full;
     for (int i = 0; i < 8; i++) {
-      auto img = std::make_shared<Image>(start_id++, L"PATH_FOR_FULL", ImageType::DEFAULT);
+      auto img = MakeImage(start_id++, L"PATH_FOR_FULL");
       images_full.push_back(img);
       img_pool.Insert(img);
     }
@@ -127,4 +147,205 @@ TEST(ImagePoolTest, RandomTest1) {
     std::cout << e.what() << std::endl;
   }
 }
+
+TEST(ImagePoolTest, HitsReorderBeforeEviction) {
+  ImagePoolManager                    img_pool{3 * kThumbBytes, 3 * kFullBytes};
+
+  std::vector<std::shared_ptr<Image>> images;
+  for (image_id_t id = 0; id < 4; id++) {
+    images.push_back(MakeImage(id, L"PATH"));
+    img_pool.Insert(images.back());
+  }
+  for (image_id_t id = 0; id < 3; id++) {
+    img_pool.RecordAccess(id, AccessType::THUMB);
+  }
+  // 0 becomes the most recent, 1 the least recent
+  EXPECT_TRUE(img_pool.AccessElement(0, AccessType::THUMB).has_value());
+  img_pool.RecordAccess(3, AccessType::THUMB);
+
+  EXPECT_TRUE(img_pool.CacheContains(0, AccessType::THUMB));
+  EXPECT_FALSE(img_pool.CacheContains(1, AccessType::THUMB));
+  EXPECT_TRUE(img_pool.CacheContains(2, AccessType::THUMB));
+  EXPECT_TRUE(img_pool.CacheContains(3, AccessType::THUMB));
+  EXPECT_EQ(img_pool.Usage(AccessType::THUMB), 3 * kThumbBytes);
+
+  // Pinned images are skipped
+  img_pool.Pin(2, AccessType::THUMB);
+  auto evicted = img_pool.Evict(AccessType::THUMB);
+  ASSERT_TRUE(evicted.has_value());
+  EXPECT_EQ(evicted->lock()->_image_id, 0u);
+  EXPECT_TRUE(img_pool.CacheContains(2, AccessType::THUMB));
+
+  // Shrinking the budget stops at pinned images, which still count towards the usage
+  img_pool.SetBudget(AccessType::THUMB, 0);
+  EXPECT_TRUE(img_pool.CacheContains(2, AccessType::THUMB));
+  EXPECT_FALSE(img_pool.CacheContains(3, AccessType::THUMB));
+  EXPECT_EQ(img_pool.Budget(AccessType::THUMB), 0u);
+  EXPECT_EQ(img_pool.Usage(AccessType::THUMB), kThumbBytes);
+
+  // Unpinning puts the image back in reach of the budget
+  img_pool.Unpin(2, AccessType::THUMB);
+  EXPECT_FALSE(img_pool.CacheContains(2, AccessType::THUMB));
+  EXPECT_FALSE(images[2]->_thumb_pinned);
+  EXPECT_EQ(img_pool.Usage(AccessType::THUMB), 0u);
+  EXPECT_EQ(img_pool.Count(AccessType::THUMB), 0u);
+}
+
+TEST(ImagePoolTest, BudgetIsChargedInBytes) {
+  ImagePoolManager img_pool{0, 4 * kFullBytes};
+
+  // One large image takes the room of several small ones
+  auto             large = MakeImage(0, L"LARGE");
+  large->LoadData(ImageBuffer{cv::Mat(2 * kFullSide, kFullSide, CV_8UC1)});
+  img_pool.Insert(large);
+  for (image_id_t id = 1; id <= 3; id++) {
+    img_pool.Insert(MakeImage(id, L"SMALL"));
+  }
+  img_pool.RecordAccess(0, AccessType::FULL_IMG);
+  img_pool.RecordAccess(1, AccessType::FULL_IMG);
+  img_pool.RecordAccess(2, AccessType::FULL_IMG);
+  EXPECT_EQ(img_pool.Usage(AccessType::FULL_IMG), 4 * kFullBytes);
+
+  img_pool.RecordAccess(3, AccessType::FULL_IMG);
+  EXPECT_FALSE(img_pool.CacheContains(0, AccessType::FULL_IMG));
+  EXPECT_FALSE(large->_has_full_img);
+  EXPECT_EQ(img_pool.Count(AccessType::FULL_IMG), 3u);
+  EXPECT_EQ(img_pool.Usage(AccessType::FULL_IMG), 3 * kFullBytes);
+
+  // The budget is changed at runtime, evicting the least recent images
+  img_pool.SetBudget(AccessType::FULL_IMG, kFullBytes);
+  EXPECT_FALSE(img_pool.CacheContains(1, AccessType::FULL_IMG));
+  EXPECT_FALSE(img_pool.CacheContains(2, AccessType::FULL_IMG));
+  EXPECT_TRUE(img_pool.CacheContains(3, AccessType::FULL_IMG));
+
+  // An image over the whole budget stays until the next access is recorded
+  large->LoadData(ImageBuffer{cv::Mat(2 * kFullSide, kFullSide, CV_8UC1)});
+  img_pool.RecordAccess(0, AccessType::FULL_IMG);
+  EXPECT_TRUE(img_pool.CacheContains(0, AccessType::FULL_IMG));
+  EXPECT_FALSE(img_pool.CacheContains(3, AccessType::FULL_IMG));
+  EXPECT_EQ(img_pool.Usage(AccessType::FULL_IMG), 2 * kFullBytes);
+}
+
+TEST(ImagePoolTest, PinnedImagesStayOutOfTheEvictionOrder) {
+  constexpr image_id_t                pinned_count = 1000;
+  ImagePoolManager                    img_pool{2 * kThumbBytes, 0};
+
+  std::vector<std::shared_ptr<Image>> images;
+  for (image_id_t id = 0; id < pinned_count + 3; id++) {
+    images.push_back(MakeImage(id, L"PATH"));
+    img_pool.Insert(images.back());
+  }
+  for (image_id_t id = 0; id < pinned_count; id++) {
+    img_pool.Pin(id, AccessType::THUMB);
+    img_pool.RecordAccess(id, AccessType::THUMB);
+  }
+  EXPECT_EQ(img_pool.Count(AccessType::THUMB), pinned_count);
+
+  img_pool.RecordAccess(pinned_count, AccessType::THUMB);
+  img_pool.RecordAccess(pinned_count + 1, AccessType::THUMB);
+  img_pool.RecordAccess(pinned_count + 2, AccessType::THUMB);
+  EXPECT_FALSE(img_pool.CacheContains(pinned_count, AccessType::THUMB));
+  EXPECT_FALSE(img_pool.CacheContains(pinned_count + 1, AccessType::THUMB));
+  EXPECT_TRUE(img_pool.CacheContains(pinned_count + 2, AccessType::THUMB));
+  for (image_id_t id = 0; id < pinned_count; id++) {
+    EXPECT_TRUE(img_pool.CacheContains(id, AccessType::THUMB));
+  }
+
+  for (image_id_t id = 0; id < pinned_count; id++) {
+    img_pool.Unpin(id, AccessType::THUMB);
+  }
+  EXPECT_LE(img_pool.Usage(AccessType::THUMB), 2 * kThumbBytes);
+  EXPECT_TRUE(img_pool.CacheContains(pinned_count - 1, AccessType::THUMB));
+  EXPECT_FALSE(img_pool.CacheContains(0, AccessType::THUMB));
+}
+
+TEST(ImagePoolTest, ConcurrentInsertsAllLand) {
+  ImagePoolManager         img_pool{};
+  constexpr int            threads    = 8;
+  constexpr int            per_thread = 500;
+
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+      for (int i = 0; i < per_thread; i++) {
+        image_id_t id = static_cast<image_id_t>(t * per_thread + i);
+        img_pool.Insert(std::make_shared<Image>(id, L"PATH", ImageType::DEFAULT));
+        EXPECT_TRUE(img_pool.PoolContains(id));
+      }
+    });
+  }
+  for (auto& worker : workers) worker.join();
+
+  EXPECT_EQ(img_pool.Count(AccessType::META), static_cast<uint32_t>(threads * per_thread));
+  EXPECT_EQ(img_pool.Snapshot().size(), static_cast<size_t>(threads * per_thread));
+}
+
+TEST(ImagePoolTest, ConcurrentStressKeepsCachesWithinBudget) {
+  constexpr size_t                    budget_thumb = 32 * kThumbBytes;
+  constexpr size_t                    budget_full  = 3 * kFullBytes;
+  constexpr image_id_t                image_count  = 256;
+  ImagePoolManager                    img_pool{budget_thumb, budget_full};
+
+  std::vector<std::shared_ptr<Image>> images;
+  for (image_id_t id = 0; id < image_count; id++) {
+    images.push_back(MakeImage(id, L"PATH"));
+    img_pool.Insert(images.back());
+  }
+
+  std::atomic<int>         hits = 0;
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < 8; t++) {
+    workers.emplace_back([&, t] {
+      std::mt19937                              rng{t};
+      std::uniform_int_distribution<image_id_t> pick(0, image_count - 1);
+      std::uniform_int_distribution<int>        op(0, 99);
+      for (int i = 0; i < 20000; i++) {
+        auto id   = pick(rng);
+        auto type = op(rng) % 4 == 0 ? AccessType::FULL_IMG : AccessType::THUMB;
+        int  roll = op(rng);
+        if (roll < 60) {
+          auto img = img_pool.AccessElement(id, type);
+          if (img.has_value()) {
+            EXPECT_EQ(img->lock()->_image_id, id);
+            hits.fetch_add(1, std::memory_order_relaxed);
+          }
+        } else if (roll < 80) {
+          img_pool.RecordAccess(id, type);
+        } else if (roll < 85) {
+          img_pool.RemoveRecord(id, type);
+        } else if (roll < 88) {
+          img_pool.Evict(type);
+        } else if (roll < 93) {
+          img_pool.Pin(id, type);
+          img_pool.AccessElement(id, type);
+          img_pool.Unpin(id, type);
+        } else if (roll < 95) {
+          img_pool.Insert(images[id]);
+        } else {
+          img_pool.CacheContains(id, type);
+          img_pool.AccessElement(id, AccessType::META);
+        }
+      }
+    });
+  }
+  for (auto& worker : workers) worker.join();
+
+  EXPECT_LE(img_pool.Usage(AccessType::THUMB), budget_thumb);
+  EXPECT_LE(img_pool.Usage(AccessType::FULL_IMG), budget_full);
+  EXPECT_GT(hits.load(), 0);
+  EXPECT_EQ(img_pool.Count(AccessType::META), image_count);
+
+  // The order survived the races, a full cache turns over completely
+  img_pool.Flush();
+  for (auto& img : images) {
+    img->LoadThumbnail(ImageBuffer{cv::Mat(kThumbSide, kThumbSide, CV_8UC1)});
+  }
+  for (image_id_t id = 0; id < image_count; id++) {
+    img_pool.RecordAccess(id, AccessType::THUMB);
+  }
+  for (image_id_t id = 0; id < image_count; id++) {
+    EXPECT_EQ(img_pool.CacheContains(id, AccessType::THUMB), id >= image_count - 32);
+  }
+  EXPECT_EQ(img_pool.Usage(AccessType::THUMB), budget_thumb);
+}
 };  // namespace puerhlab
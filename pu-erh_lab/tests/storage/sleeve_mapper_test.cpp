@@ -36,6 +36,35 @@ TEST(SleeveMapperTest, InitTest1) {
   std::filesystem::remove(db_path);
 }
 
+TEST(SleeveMapperTest, UpgradesOldImageTable) {
+  if (std::filesystem::exists(db_path)) {
+    std::filesystem::remove(db_path);
+  }
+  {
+    // Image table as written before the sidecar and content hash columns were added
+    duckdb_database   db;
+    duckdb_connection conn;
+    ASSERT_EQ(duckdb_open(db_path.string().c_str(), &db), DuckDBSuccess);
+    ASSERT_EQ(duckdb_connect(db, &conn), DuckDBSuccess);
+    EXPECT_EQ(duckdb_query(conn,
+                           "CREATE TABLE Image (id BIGINT PRIMARY KEY, image_path TEXT, file_name "
+                           "TEXT, type INTEGER, metadata JSON);",
+                           nullptr),
+              DuckDBSuccess);
+    duckdb_disconnect(&conn);
+    duckdb_close(&db);
+  }
+  {
+    DBController  db_ctr{db_path};
+    auto          guard = db_ctr.GetConnectionGuard();
+    duckdb_result result;
+    EXPECT_EQ(duckdb_query(guard._conn, "SELECT sidecar_path, content_hash FROM Image;", &result),
+              DuckDBSuccess);
+    duckdb_destroy_result(&result);
+  }
+  std::filesystem::remove(db_path);
+}
+
 TEST(SleeveMapperTest, SimpleCaptureTest1) {
   if (std::filesystem::exists(db_path)) {
     std::filesystem::remove(db_path);
@@ -0,0 +1,118 @@
+#include "storage/thumbnail_store/thumbnail_store.hpp"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <opencv2/core.hpp>
+
+#include "type/type.hpp"
+
+namespace puerhlab {
+namespace {
+auto MakeStoreDir(const std::string& name) -> std::filesystem::path {
+  auto dir = std::filesystem::temp_directory_path() / name;
+  std::filesystem::remove_all(dir);
+  return dir;
+}
+
+auto MakeThumbnail(int rows, int cols, uchar value) -> cv::Mat {
+  return cv::Mat(rows, cols, CV_8UC3, cv::Scalar(value, value / 2, value / 4));
+}
+};  // namespace
+
+TEST(ThumbnailStoreTest, PutGetRoundTrip) {
+  auto                 dir = MakeStoreDir("puerhlab_thumb_round_trip");
+  ThumbnailStore       store{dir};
+  ThumbnailFingerprint fingerprint{42, 1000, 2048};
+
+  auto                 thumbnail = MakeThumbnail(64, 96, 200);
+  store.Put(0, fingerprint, thumbnail);
+
+  auto loaded = store.Get(0, fingerprint);
+  ASSERT_TRUE(loaded.has_value());
+  EXPECT_EQ(loaded->rows, 64);
+  EXPECT_EQ(loaded->cols, 96);
+  EXPECT_EQ(cv::norm(*loaded, thumbnail, cv::NORM_INF), 0);
+  EXPECT_FALSE(store.Get(1, fingerprint).has_value());
+}
+
+TEST(ThumbnailStoreTest, DownscaleAndFloatInput) {
+  auto           dir = MakeStoreDir("puerhlab_thumb_downscale");
+  ThumbnailStore store{dir, 128};
+
+  cv::Mat        thumbnail(512, 256, CV_32FC3, cv::Scalar(1.0f, 0.5f, 0.0f));
+  store.Put(0, {1, 1, 1}, thumbnail);
+
+  auto loaded = store.Get(0, {1, 1, 1});
+  ASSERT_TRUE(loaded.has_value());
+  EXPECT_EQ(loaded->type(), CV_8UC3);
+  EXPECT_EQ(loaded->rows, 128);
+  EXPECT_EQ(loaded->cols, 64);
+  EXPECT_EQ(loaded->at<cv::Vec3b>(0, 0)[0], 255);
+}
+
+TEST(ThumbnailStoreTest, StaleFingerprintIsInvalidated) {
+  auto           dir = MakeStoreDir("puerhlab_thumb_stale");
+  ThumbnailStore store{dir};
+  store.Put(0, {42, 1000, 2048}, MakeThumbnail(32, 32, 10));
+
+  // The source file has been modified since the thumbnail was stored
+  EXPECT_FALSE(store.Get(0, {42, 2000, 2048}).has_value());
+  EXPECT_FALSE(store.Contains(0));
+  EXPECT_GT(store.StaleRatio(), 0.0);
+}
+
+TEST(ThumbnailStoreTest, ReopenKeepsLatestEntries) {
+  auto dir = MakeStoreDir("puerhlab_thumb_reopen");
+  {
+    ThumbnailStore store{dir};
+    for (image_id_t id = 0; id < 16; ++id) {
+      store.Put(id, {id, 1, 1}, MakeThumbnail(16, 16, static_cast<uchar>(id)));
+    }
+    // Superseded and invalidated entries must not come back after reopening
+    store.Put(3, {3, 1, 1}, MakeThumbnail(16, 16, 100));
+    store.Invalidate(5);
+  }
+  ThumbnailStore store{dir};
+  EXPECT_EQ(store.Size(), 15);
+  EXPECT_FALSE(store.Contains(5));
+  auto loaded = store.Get(3, {3, 1, 1});
+  ASSERT_TRUE(loaded.has_value());
+  EXPECT_EQ(loaded->at<cv::Vec3b>(0, 0)[0], 100);
+}
+
+TEST(ThumbnailStoreTest, CompactionDropsStaleData) {
+  auto           dir = MakeStoreDir("puerhlab_thumb_compact");
+  ThumbnailStore store{dir};
+  for (image_id_t id = 0; id < 8; ++id) {
+    store.Put(id, {id, 1, 1}, MakeThumbnail(16, 16, static_cast<uchar>(id)));
+  }
+  for (image_id_t id = 0; id < 4; ++id) {
+    store.Invalidate(id);
+  }
+  auto size_before = std::filesystem::file_size(dir / "thumbnails.pack");
+  store.Compact();
+  EXPECT_EQ(store.StaleRatio(), 0.0);
+  EXPECT_EQ(std::filesystem::file_size(dir / "thumbnails.pack"), size_before / 2);
+  for (image_id_t id = 4; id < 8; ++id) {
+    auto loaded = store.Get(id, {id, 1, 1});
+    ASSERT_TRUE(loaded.has_value());
+    EXPECT_EQ(loaded->at<cv::Vec3b>(0, 0)[0], id);
+  }
+}
+
+TEST(ThumbnailStoreTest, FingerprintFromFile) {
+  auto path = std::filesystem::temp_directory_path() / "puerhlab_thumb_fingerprint.bin";
+  {
+    std::ofstream out(path, std::ios::binary);
+    out << "pu-erh";
+  }
+  auto fingerprint = ThumbnailFingerprint::FromFile(path);
+  ASSERT_TRUE(fingerprint.has_value());
+  EXPECT_EQ(fingerprint->_file_size, 6);
+  EXPECT_EQ(fingerprint, ThumbnailFingerprint::FromFile(path));
+  EXPECT_FALSE(ThumbnailFingerprint::FromFile(path.string() + ".missing").has_value());
+}
+};  // namespace puerhlab
@@ -0,0 +1,79 @@
+#include "utils/profiling/import_profiler.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+namespace puerhlab {
+namespace {
+using std::chrono::milliseconds;
+};  // namespace
+
+TEST(ImportProfilerTest, PercentilesPerStage) {
+  ImportProfiler profiler;
+  for (int i = 1; i <= 100; ++i) {
+    profiler.Record("file_" + std::to_string(i) + ".jpg", ImportStage::READ, milliseconds(i));
+  }
+  profiler.Record("file_1.jpg", ImportStage::EXIF, milliseconds(3));
+
+  auto report = profiler.Report();
+  ASSERT_EQ(report._stages.size(), 2u);
+  const auto& read = report._stages[0];
+  EXPECT_EQ(read._stage, ImportStage::READ);
+  EXPECT_EQ(read._count, 100u);
+  EXPECT_DOUBLE_EQ(read._p50_ms, 50.0);
+  EXPECT_DOUBLE_EQ(read._p90_ms, 90.0);
+  EXPECT_DOUBLE_EQ(read._p99_ms, 99.0);
+  EXPECT_DOUBLE_EQ(read._max_ms, 100.0);
+  EXPECT_DOUBLE_EQ(read._total_ms, 5050.0);
+  EXPECT_EQ(report._stages[1]._stage, ImportStage::EXIF);
+  EXPECT_EQ(report._stages[1]._count, 1u);
+}
+
+TEST(ImportProfilerTest, SlowestFilesNameTheirBottleneck) {
+  ImportProfiler profiler;
+  profiler.Record("fast.jpg", ImportStage::READ, milliseconds(2));
+  profiler.Record("fast.jpg", ImportStage::THUMBNAIL, milliseconds(1));
+  profiler.Record("huge.dng", ImportStage::READ, milliseconds(40));
+  profiler.Record("huge.dng", ImportStage::THUMBNAIL, milliseconds(300));
+  profiler.Record("slow_disk.cr3", ImportStage::READ, milliseconds(200));
+  // Stages recorded twice for a file add up
+  profiler.Record("slow_disk.cr3", ImportStage::READ, milliseconds(50));
+
+  auto report = profiler.Report(2);
+  ASSERT_EQ(report._slowest.size(), 2u);
+  EXPECT_EQ(report._slowest[0]._path, "huge.dng");
+  EXPECT_EQ(report._slowest[0]._bottleneck, ImportStage::THUMBNAIL);
+  EXPECT_DOUBLE_EQ(report._slowest[0]._total_ms, 340.0);
+  EXPECT_EQ(report._slowest[1]._path, "slow_disk.cr3");
+  EXPECT_EQ(report._slowest[1]._bottleneck, ImportStage::READ);
+  EXPECT_DOUBLE_EQ(report._slowest[1]._bottleneck_ms, 250.0);
+
+  auto text = report.ToString();
+  EXPECT_NE(text.find("thumbnail"), std::string::npos);
+  EXPECT_NE(text.find("huge.dng"), std::string::npos);
+
+  profiler.Clear();
+  EXPECT_EQ(profiler.FileCount(), 0u);
+  EXPECT_TRUE(profiler.Report()._slowest.empty());
+}
+
+TEST(ImportProfilerTest, StageTimer) {
+  ImportProfiler profiler;
+  image_path_t   path = "timed.jpg";
+  {
+    ImportStageTimer timer(&profiler, path, ImportStage::CREATE);
+    std::this_thread::sleep_for(milliseconds(5));
+  }
+  {
+    // Without a profiler nothing is recorded
+    ImportStageTimer timer(nullptr, path, ImportStage::INSERT);
+  }
+  auto report = profiler.Report();
+  ASSERT_EQ(report._stages.size(), 1u);
+  EXPECT_EQ(report._stages[0]._stage, ImportStage::CREATE);
+  EXPECT_GE(report._stages[0]._max_ms, 5.0);
+}
+};  // namespace puerhlab
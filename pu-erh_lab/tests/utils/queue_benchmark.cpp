@@ -0,0 +1,156 @@
+// Throughput of the queue family under symmetric producer/consumer loads. Not a test, run by hand:
+//   QueueBenchmark [items per configuration]
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utils/queue/queue.hpp"
+#include "utils/queue/ring_buffer.hpp"
+
+namespace puerhlab {
+namespace {
+constexpr size_t kCapacity  = 1024;
+constexpr size_t kBatchSize = 32;
+
+/**
+ * @brief Run pairs producers and pairs consumers, each moving total / pairs items
+ *
+ * @return double nanoseconds per item end to end
+ */
+template <typename Produce, typename Consume>
+auto RunPairs(size_t pairs, size_t total, Produce produce, Consume consume) -> double {
+  size_t                   per_thread = total / pairs;
+  std::atomic<bool>        go         = false;
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < pairs; ++i) {
+    threads.emplace_back([&, i] {
+      while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+      produce(i * per_thread, per_thread);
+    });
+    threads.emplace_back([&] {
+      while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+      consume(per_thread);
+    });
+  }
+  auto start = std::chrono::steady_clock::now();
+  go.store(true, std::memory_order_release);
+  for (auto& thread : threads) thread.join();
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() /
+         static_cast<double>(per_thread * pairs);
+}
+
+auto MutexQueue(size_t pairs, size_t total) -> double {
+  ConcurrentBlockingQueue<uint64_t> queue{kCapacity};
+  return RunPairs(
+      pairs, total,
+      [&](size_t first, size_t count) {
+        for (size_t i = 0; i < count; ++i) queue.push(first + i);
+      },
+      [&](size_t count) {
+        for (size_t i = 0; i < count; ++i) queue.pop();
+      });
+}
+
+template <typename Ring>
+auto BlockingRing(size_t pairs, size_t total) -> double {
+  BlockingRingBuffer<Ring> queue{kCapacity};
+  return RunPairs(
+      pairs, total,
+      [&](size_t first, size_t count) {
+        for (size_t i = 0; i < count; ++i) queue.push(first + i);
+      },
+      [&](size_t count) {
+        for (size_t i = 0; i < count; ++i) queue.pop();
+      });
+}
+
+template <typename Ring>
+auto BlockingRingBatched(size_t pairs, size_t total) -> double {
+  BlockingRingBuffer<Ring> queue{kCapacity};
+  return RunPairs(
+      pairs, total,
+      [&](size_t first, size_t count) {
+        uint64_t batch[kBatchSize];
+        for (size_t i = 0; i < count; i += kBatchSize) {
+          size_t n = std::min(kBatchSize, count - i);
+          for (size_t j = 0; j < n; ++j) batch[j] = first + i + j;
+          queue.push_batch(batch, n);
+        }
+      },
+      [&](size_t count) {
+        uint64_t batch[kBatchSize];
+        while (count > 0) count -= queue.pop_batch(batch, std::min(kBatchSize, count));
+      });
+}
+
+/**
+ * @brief Non-blocking ring, both sides spin (yield) when the ring is full or empty
+ */
+template <typename Ring>
+auto SpinningRing(size_t pairs, size_t total) -> double {
+  Ring queue{kCapacity};
+  return RunPairs(
+      pairs, total,
+      [&](size_t first, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+          while (!queue.push(first + i)) std::this_thread::yield();
+        }
+      },
+      [&](size_t count) {
+        uint64_t item;
+        for (size_t i = 0; i < count; ++i) {
+          while (!queue.pop(item)) std::this_thread::yield();
+        }
+      });
+}
+};  // namespace
+};  // namespace puerhlab
+
+int main(int argc, char** argv) {
+  using namespace puerhlab;
+  size_t total = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2'000'000;
+
+  struct Variant {
+    std::string _name;
+    double (*_run)(size_t, size_t);
+    bool _spsc;
+  };
+  const Variant variants[] = {
+      {"mutex + condvar", &MutexQueue, false},
+      {"mpmc blocking", &BlockingRing<MPMCRingBuffer<uint64_t>>, false},
+      {"mpmc blocking batch", &BlockingRingBatched<MPMCRingBuffer<uint64_t>>, false},
+      {"mpmc spinning", &SpinningRing<MPMCRingBuffer<uint64_t>>, false},
+      {"spsc blocking", &BlockingRing<SPSCRingBuffer<uint64_t>>, true},
+      {"spsc blocking batch", &BlockingRingBatched<SPSCRingBuffer<uint64_t>>, true},
+      {"spsc spinning", &SpinningRing<SPSCRingBuffer<uint64_t>>, true},
+  };
+
+  std::cout << "items per configuration: " << total << ", capacity: " << kCapacity
+            << ", hardware threads: " << std::thread::hardware_concurrency() << "\n\n";
+  std::cout << std::left << std::setw(22) << "queue" << std::right;
+  for (size_t pairs : {1, 2, 8, 32}) std::cout << std::setw(10) << (std::to_string(pairs) + "P/C");
+  std::cout << "   (ns per item)\n";
+
+  for (const auto& variant : variants) {
+    std::cout << std::left << std::setw(22) << variant._name << std::right << std::fixed
+              << std::setprecision(1);
+    for (size_t pairs : {1, 2, 8, 32}) {
+      if (variant._spsc && pairs > 1) {
+        std::cout << std::setw(10) << "-";
+        continue;
+      }
+      std::cout << std::setw(10) << variant._run(pairs, total) << std::flush;
+    }
+    std::cout << "\n";
+  }
+  return 0;
+}
@@ -0,0 +1,150 @@
+#include "utils/queue/queue.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+namespace puerhlab {
+TEST(ConcurrentBlockingQueueTest, PushBlocksAtCountLimit) {
+  ConcurrentBlockingQueue<int> queue{2};
+  queue.push(1);
+  queue.push(2);
+
+  std::atomic<bool> pushed = false;
+  std::thread       producer([&] {
+    queue.push(3);
+    pushed = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(pushed);
+
+  EXPECT_EQ(queue.pop(), 1);
+  producer.join();
+  EXPECT_TRUE(pushed);
+  EXPECT_EQ(queue.pop(), 2);
+  EXPECT_EQ(queue.pop(), 3);
+}
+
+TEST(ConcurrentBlockingQueueTest, PushBlocksAtByteLimit) {
+  ConcurrentBlockingQueue<size_t> queue{16, 100, [](const size_t& bytes) { return bytes; }};
+  queue.push(60);
+
+  std::atomic<bool> pushed = false;
+  std::thread       producer([&] {
+    queue.push(60);
+    pushed = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(pushed);
+
+  EXPECT_EQ(queue.pop(), 60);
+  producer.join();
+  EXPECT_TRUE(pushed);
+}
+
+TEST(ConcurrentBlockingQueueTest, OversizedElementIsAdmittedWhenEmpty) {
+  ConcurrentBlockingQueue<size_t> queue{16, 100, [](const size_t& bytes) { return bytes; }};
+  // An element larger than the whole budget must not block forever
+  queue.push(1000);
+  EXPECT_EQ(queue.pop(), 1000);
+}
+
+TEST(ConcurrentBlockingQueueTest, TryPopTimesOut) {
+  ConcurrentBlockingQueue<int> queue{4};
+  EXPECT_FALSE(queue.try_pop_for(std::chrono::milliseconds(10)).has_value());
+  queue.push(7);
+  EXPECT_EQ(queue.try_pop_for(std::chrono::milliseconds(10)), 7);
+}
+
+TEST(RingBufferTest, CapacityIsRoundedToPowerOfTwo) {
+  SPSCRingBuffer<int> spsc{5};
+  MPMCRingBuffer<int> mpmc{64};
+  EXPECT_EQ(spsc.Capacity(), 8u);
+  EXPECT_EQ(mpmc.Capacity(), 64u);
+}
+
+TEST(RingBufferTest, SPSCKeepsOrderAndRejectsWhenFull) {
+  SPSCRingBuffer<std::unique_ptr<int>> queue{4};
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(queue.push(std::make_unique<int>(i)));
+  }
+  auto extra = std::make_unique<int>(4);
+  EXPECT_FALSE(queue.push(std::move(extra)));
+  // A failed push must leave the element with the caller
+  ASSERT_NE(extra, nullptr);
+
+  std::unique_ptr<int> out[8];
+  EXPECT_EQ(queue.pop_batch(out, 8), 4u);
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(*out[i], i);
+  }
+  EXPECT_TRUE(queue.empty());
+  EXPECT_FALSE(queue.pop().has_value());
+}
+
+TEST(RingBufferTest, MPMCBatchPushIsPartialWhenNearlyFull) {
+  MPMCRingBuffer<int> queue{8};
+  std::vector<int>    items(6);
+  std::iota(items.begin(), items.end(), 0);
+  EXPECT_EQ(queue.push_batch(items.data(), items.size()), 6u);
+  EXPECT_EQ(queue.push_batch(items.data(), items.size()), 2u);
+  EXPECT_EQ(queue.size(), 8u);
+
+  int out[16];
+  EXPECT_EQ(queue.pop_batch(out, 16), 8u);
+  EXPECT_EQ(out[0], 0);
+  EXPECT_EQ(out[5], 5);
+  EXPECT_EQ(out[6], 0);
+  EXPECT_EQ(out[7], 1);
+}
+
+TEST(RingBufferTest, BlockingMPMCDeliversEveryElementOnce) {
+  constexpr int                           kThreads   = 4;
+  constexpr int                           kPerThread = 20000;
+  BlockingRingBuffer<MPMCRingBuffer<int>> queue{16};
+  std::atomic<long long>                  sum = 0;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < kPerThread; ++i) queue.push(t * kPerThread + i + 1);
+    });
+    threads.emplace_back([&] {
+      for (int i = 0; i < kPerThread; ++i) sum.fetch_add(queue.pop());
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  long long n = static_cast<long long>(kThreads) * kPerThread;
+  EXPECT_EQ(sum.load(), n * (n + 1) / 2);
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(RingBufferTest, BlockingSPSCBatches) {
+  constexpr int                           kCount = 100000;
+  BlockingRingBuffer<SPSCRingBuffer<int>> queue{64};
+
+  std::thread producer([&] {
+    std::vector<int> batch(32);
+    for (int i = 0; i < kCount; i += 32) {
+      std::iota(batch.begin(), batch.end(), i);
+      queue.push_batch(batch.data(), batch.size());
+    }
+  });
+  int  expected = 0;
+  bool in_order = true;
+  int  out[48];
+  while (expected < kCount) {
+    size_t n = queue.pop_batch(out, 48);
+    for (size_t i = 0; i < n; ++i) in_order &= out[i] == expected++;
+  }
+  producer.join();
+  EXPECT_TRUE(in_order);
+}
+};  // namespace puerhlab